@@ -1,5 +1,6 @@
 #define _USE_MATH_DEFINES
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <eigen3/Eigen/Dense>
@@ -63,6 +64,88 @@ Geodetic ecef2geodetic(ECEF e){
   return to_degrees({lat, lon, h});
 }
 
+// The batch conversions work on blocks of points in structure of arrays layout.
+// The algebraic passes vectorize, the transcendental functions are kept in their
+// own tight loops so a vector math library can pick them up.
+#define BATCH_BLOCK 16
+
+void geodetic2ecef(const double *geodetic, double *ecef, size_t n) {
+  double lat[BATCH_BLOCK], lon[BATCH_BLOCK], alt[BATCH_BLOCK];
+  double slat[BATCH_BLOCK], clat[BATCH_BLOCK], slon[BATCH_BLOCK], clon[BATCH_BLOCK];
+
+  for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+    const int m = std::min<size_t>(BATCH_BLOCK, n - start);
+    const double *in = geodetic + 3 * start;
+    double *out = ecef + 3 * start;
+
+    for (int i = 0; i < m; i++) {
+      lat[i] = DEG2RAD(in[3 * i + 0]);
+      lon[i] = DEG2RAD(in[3 * i + 1]);
+      alt[i] = in[3 * i + 2];
+    }
+    for (int i = 0; i < m; i++) {
+      slat[i] = sin(lat[i]);
+      clat[i] = cos(lat[i]);
+      slon[i] = sin(lon[i]);
+      clon[i] = cos(lon[i]);
+    }
+    for (int i = 0; i < m; i++) {
+      double N = a / sqrt(1.0 - esq * slat[i] * slat[i]);
+      out[3 * i + 0] = (N + alt[i]) * clat[i] * clon[i];
+      out[3 * i + 1] = (N + alt[i]) * clat[i] * slon[i];
+      out[3 * i + 2] = (N * (1.0 - esq) + alt[i]) * slat[i];
+    }
+  }
+}
+
+void ecef2geodetic(const double *ecef, double *geodetic, size_t n) {
+  // Ferrari's solution, same as the single point version
+  const double Esq = a * a - b * b;
+  double x[BATCH_BLOCK], y[BATCH_BLOCK], z[BATCH_BLOCK], r[BATCH_BLOCK];
+  double F[BATCH_BLOCK], G[BATCH_BLOCK], S[BATCH_BLOCK], t[BATCH_BLOCK];
+
+  for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+    const int m = std::min<size_t>(BATCH_BLOCK, n - start);
+    const double *in = ecef + 3 * start;
+    double *out = geodetic + 3 * start;
+
+    for (int i = 0; i < m; i++) {
+      x[i] = in[3 * i + 0];
+      y[i] = in[3 * i + 1];
+      z[i] = in[3 * i + 2];
+    }
+    for (int i = 0; i < m; i++) {
+      double r2 = x[i] * x[i] + y[i] * y[i];
+      double z2 = z[i] * z[i];
+      r[i] = sqrt(r2);
+      F[i] = 54 * b * b * z2;
+      G[i] = r2 + (1 - esq) * z2 - esq * Esq;
+      double C = (esq * esq * F[i] * r2) / (G[i] * G[i] * G[i]);
+      t[i] = 1 + C + sqrt(C * C + 2 * C);
+    }
+    for (int i = 0; i < m; i++) {
+      S[i] = cbrt(t[i]);
+    }
+    for (int i = 0; i < m; i++) {
+      double s = S[i] + 1 / S[i] + 1;
+      double P = F[i] / (3 * s * s * G[i] * G[i]);
+      double Q = sqrt(1 + 2 * esq * esq * P);
+      double z2 = z[i] * z[i];
+      double r_0 = -(P * esq * r[i]) / (1 + Q) + sqrt(0.5 * a * a * (1 + 1.0 / Q) - P * (1 - esq) * z2 / (Q * (1 + Q)) - 0.5 * P * r[i] * r[i]);
+      double rr = r[i] - esq * r_0;
+      double U = sqrt(rr * rr + z2);
+      double V = sqrt(rr * rr + (1 - esq) * z2);
+      double Z_0 = b * b * z[i] / (a * V);
+      out[3 * i + 2] = U * (1 - b * b / (a * V));
+      t[i] = (z[i] + e1sq * Z_0) / r[i];
+    }
+    for (int i = 0; i < m; i++) {
+      out[3 * i + 0] = RAD2DEG(atan(t[i]));
+      out[3 * i + 1] = RAD2DEG(atan2(y[i], x[i]));
+    }
+  }
+}
+
 LocalCoord::LocalCoord(Geodetic g, ECEF e){
   init_ecef <<  e.x, e.y, e.z;
 
@@ -100,3 +183,27 @@ Geodetic LocalCoord::ned2geodetic(NED n){
   ECEF e = ned2ecef(n);
   return ::ecef2geodetic(e);
 }
+
+void LocalCoord::ecef2ned(const double *ecef, double *ned, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    Eigen::Vector3d e = Eigen::Map<const Eigen::Vector3d>(ecef + 3 * i) - init_ecef;
+    Eigen::Map<Eigen::Vector3d>(ned + 3 * i) = ecef2ned_matrix * e;
+  }
+}
+
+void LocalCoord::ned2ecef(const double *ned, double *ecef, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    Eigen::Vector3d v = Eigen::Map<const Eigen::Vector3d>(ned + 3 * i);
+    Eigen::Map<Eigen::Vector3d>(ecef + 3 * i) = ned2ecef_matrix * v + init_ecef;
+  }
+}
+
+void LocalCoord::geodetic2ned(const double *geodetic, double *ned, size_t n) {
+  ::geodetic2ecef(geodetic, ned, n);
+  ecef2ned(ned, ned, n);
+}
+
+void LocalCoord::ned2geodetic(const double *ned, double *geodetic, size_t n) {
+  ned2ecef(ned, geodetic, n);
+  ::ecef2geodetic(geodetic, geodetic, n);
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "common/transformations/coordinates.hpp"
+#include "selfdrive/common/timing.h"
+
+// Compares the throughput of the single point and batch conversions on random
+// points around the globe and checks that both give the same results.
+
+const int N = 1000000;
+
+static double max_diff(const std::vector<double> &a, const std::vector<double> &b) {
+  double d = 0;
+  for (int i = 0; i < a.size(); i++) {
+    d = std::max(d, std::abs(a[i] - b[i]));
+  }
+  return d;
+}
+
+static void report(const char *name, double single_ms, double batch_ms, double diff) {
+  printf("%-14s single %7.1f ms  batch %7.1f ms  %5.2fx  %6.1f Mpts/s  max diff %g\n", name, single_ms, batch_ms,
+         single_ms / batch_ms, N / batch_ms / 1e3, diff);
+}
+
+int main(int argc, char *argv[]) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> lat(-89.0, 89.0), lon(-180.0, 180.0), alt(-100.0, 10000.0);
+  std::vector<double> geodetic(3 * N), ecef(3 * N), ned(3 * N), single(3 * N), batch(3 * N);
+  for (int i = 0; i < N; i++) {
+    geodetic[3 * i + 0] = lat(gen);
+    geodetic[3 * i + 1] = lon(gen);
+    geodetic[3 * i + 2] = alt(gen);
+  }
+
+  double start = millis_since_boot();
+  for (int i = 0; i < N; i++) {
+    ECEF e = geodetic2ecef((Geodetic){geodetic[3 * i], geodetic[3 * i + 1], geodetic[3 * i + 2]});
+    single[3 * i + 0] = e.x, single[3 * i + 1] = e.y, single[3 * i + 2] = e.z;
+  }
+  double single_ms = millis_since_boot() - start;
+  start = millis_since_boot();
+  geodetic2ecef(geodetic.data(), ecef.data(), N);
+  report("geodetic2ecef", single_ms, millis_since_boot() - start, max_diff(single, ecef));
+
+  start = millis_since_boot();
+  for (int i = 0; i < N; i++) {
+    Geodetic g = ecef2geodetic((ECEF){ecef[3 * i], ecef[3 * i + 1], ecef[3 * i + 2]});
+    single[3 * i + 0] = g.lat, single[3 * i + 1] = g.lon, single[3 * i + 2] = g.alt;
+  }
+  single_ms = millis_since_boot() - start;
+  start = millis_since_boot();
+  ecef2geodetic(ecef.data(), batch.data(), N);
+  report("ecef2geodetic", single_ms, millis_since_boot() - start, max_diff(single, batch));
+
+  LocalCoord local((Geodetic){37.7749, -122.4194, 0.0});
+  start = millis_since_boot();
+  for (int i = 0; i < N; i++) {
+    NED n = local.ecef2ned((ECEF){ecef[3 * i], ecef[3 * i + 1], ecef[3 * i + 2]});
+    single[3 * i + 0] = n.n, single[3 * i + 1] = n.e, single[3 * i + 2] = n.d;
+  }
+  single_ms = millis_since_boot() - start;
+  start = millis_since_boot();
+  local.ecef2ned(ecef.data(), ned.data(), N);
+  report("ecef2ned", single_ms, millis_since_boot() - start, max_diff(single, ned));
+
+  start = millis_since_boot();
+  for (int i = 0; i < N; i++) {
+    Geodetic g = local.ned2geodetic((NED){ned[3 * i], ned[3 * i + 1], ned[3 * i + 2]});
+    single[3 * i + 0] = g.lat, single[3 * i + 1] = g.lon, single[3 * i + 2] = g.alt;
+  }
+  single_ms = millis_since_boot() - start;
+  start = millis_since_boot();
+  local.ned2geodetic(ned.data(), batch.data(), N);
+  report("ned2geodetic", single_ms, millis_since_boot() - start, max_diff(single, batch));
+  return 0;
+}
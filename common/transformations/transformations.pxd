@@ -54,6 +54,8 @@ cdef extern from "coordinates.cc":
 
   ECEF geodetic2ecef(Geodetic)
   Geodetic ecef2geodetic(ECEF)
+  void geodetic2ecef_batch "geodetic2ecef"(const double*, double*, size_t)
+  void ecef2geodetic_batch "ecef2geodetic"(const double*, double*, size_t)
 
   cdef cppclass LocalCoord_c "LocalCoord":
     Matrix3 ned2ecef_matrix
@@ -67,6 +69,10 @@ cdef extern from "coordinates.cc":
     ECEF ned2ecef(NED)
     NED geodetic2ned(Geodetic)
     Geodetic ned2geodetic(NED)
+    void ecef2ned_batch "ecef2ned"(const double*, double*, size_t)
+    void ned2ecef_batch "ned2ecef"(const double*, double*, size_t)
+    void geodetic2ned_batch "geodetic2ned"(const double*, double*, size_t)
+    void ned2geodetic_batch "ned2geodetic"(const double*, double*, size_t)
 
 cdef extern from "coordinates.hpp":
   pass
@@ -14,6 +14,8 @@ from common.transformations.transformations cimport ecef_euler_from_ned as ecef_
 from common.transformations.transformations cimport ned_euler_from_ecef as ned_euler_from_ecef_c
 from common.transformations.transformations cimport geodetic2ecef as geodetic2ecef_c
 from common.transformations.transformations cimport ecef2geodetic as ecef2geodetic_c
+from common.transformations.transformations cimport geodetic2ecef_batch as geodetic2ecef_batch_c
+from common.transformations.transformations cimport ecef2geodetic_batch as ecef2geodetic_batch_c
 from common.transformations.transformations cimport LocalCoord_c
 
 
@@ -54,6 +56,9 @@ cdef Geodetic list2geodetic(geodetic):
     g.alt = geodetic[2]
     return g
 
+cdef np.ndarray[double, ndim=2, mode="c"] points2numpy(points):
+    return np.ascontiguousarray(np.reshape(points, (-1, 3)), dtype=np.double)
+
 def euler2quat_single(euler):
     cdef Vector3 e = Vector3(euler[0], euler[1], euler[2])
     cdef Quaternion q = euler2quat_c(e)
@@ -111,6 +116,20 @@ def ecef2geodetic_single(ecef):
     cdef Geodetic g = ecef2geodetic_c(e)
     return [g.lat, g.lon, g.alt]
 
+# batch versions take a point or an array of points and convert them in a single call
+
+def geodetic2ecef_batch(geodetic):
+    cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(geodetic)
+    cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+    geodetic2ecef_batch_c(<double*>inp.data, <double*>out.data, inp.shape[0])
+    return out.reshape(np.shape(geodetic))
+
+def ecef2geodetic_batch(ecef):
+    cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(ecef)
+    cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+    ecef2geodetic_batch_c(<double*>inp.data, <double*>out.data, inp.shape[0])
+    return out.reshape(np.shape(ecef))
+
 
 cdef class LocalCoord:
     cdef LocalCoord_c * lc
@@ -170,5 +189,33 @@ cdef class LocalCoord:
         cdef Geodetic g = self.lc.ned2geodetic(n)
         return [g.lat, g.lon, g.alt]
 
+    def ecef2ned_batch(self, ecef):
+        assert self.lc
+        cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(ecef)
+        cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+        self.lc.ecef2ned_batch(<double*>inp.data, <double*>out.data, inp.shape[0])
+        return out.reshape(np.shape(ecef))
+
+    def ned2ecef_batch(self, ned):
+        assert self.lc
+        cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(ned)
+        cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+        self.lc.ned2ecef_batch(<double*>inp.data, <double*>out.data, inp.shape[0])
+        return out.reshape(np.shape(ned))
+
+    def geodetic2ned_batch(self, geodetic):
+        assert self.lc
+        cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(geodetic)
+        cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+        self.lc.geodetic2ned_batch(<double*>inp.data, <double*>out.data, inp.shape[0])
+        return out.reshape(np.shape(geodetic))
+
+    def ned2geodetic_batch(self, ned):
+        assert self.lc
+        cdef np.ndarray[double, ndim=2, mode="c"] inp = points2numpy(ned)
+        cdef np.ndarray[double, ndim=2, mode="c"] out = np.empty_like(inp)
+        self.lc.ned2geodetic_batch(<double*>inp.data, <double*>out.data, inp.shape[0])
+        return out.reshape(np.shape(ned))
+
     def __dealloc__(self):
         del self.lc
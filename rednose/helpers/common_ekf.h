@@ -24,6 +24,7 @@ struct EKF {
   void (*inv_err_fun)(double *, double *, double *);
   void (*H_mod_fun)(double *, double *);
   void (*predict)(double *, double *, double *, double);
+  void (*update_joint)(double *, double *, int, const int *, double *, double *);
   std::unordered_map<int, void (*)(double *, double *, double *)> hs = {};
   std::unordered_map<int, void (*)(double *, double *, double *)> Hs = {};
   std::unordered_map<int, void (*)(double *, double *, double *, double *, double *)> updates = {};
@@ -6,7 +6,8 @@ using namespace Eigen;
 
 EKFSym::EKFSym(std::string name, Map<MatrixXdr> Q, Map<VectorXd> x_initial, Map<MatrixXdr> P_initial, int dim_main,
     int dim_main_err, int N, int dim_augment, int dim_augment_err, std::vector<int> maha_test_kinds,
-    std::vector<int> quaternion_idxs, std::vector<std::string> global_vars, double max_rewind_age)
+    std::vector<int> quaternion_idxs, std::vector<std::string> global_vars, double max_rewind_age, int rewind_stride)
+    : rewind_history(REWIND_TO_KEEP, rewind_stride)
 {
   // TODO: add logger
 
@@ -86,13 +87,18 @@ std::optional<Estimate> EKFSym::predict_and_update_batch(double t, int kind, std
 {
   // TODO handle rewinding at this level
 
-  std::deque<Observation> rewound;
+  int n_rewound = 0;
   if (!std::isnan(this->filter_time) && t < this->filter_time) {
-    if (this->rewind_t.empty() || t < this->rewind_t.front() || t < this->rewind_t.back() - this->max_rewind_age) {
-      LOGD("observation too old at %d with filter at %d, ignoring!", t, this->filter_time);
+    if (!this->rewind_history.empty() && t >= this->rewind_history.newest_t() - this->max_rewind_age) {
+      n_rewound = this->rewind_history.rewind(t, this->x, this->P, this->filter_time,
+        [this](const Observation& o) { this->predict_and_update_batch(o, false, false); }, this->rewound);
+    } else {
+      n_rewound = -1;
+    }
+    if (n_rewound < 0) {
+      LOGD("observation too old at %f with filter at %f, ignoring!", t, this->filter_time);
       return std::nullopt;
     }
-    rewound = this->rewind(t);
   }
 
   Observation obs;
@@ -109,54 +115,18 @@ std::optional<Estimate> EKFSym::predict_and_update_batch(double t, int kind, std
   std::optional<Estimate> res = std::make_optional(this->predict_and_update_batch(obs, augment));
 
   // optional fast forward
-  while (!rewound.empty()) {
-    this->predict_and_update_batch(rewound.front(), false);
-    rewound.pop_front();
+  for (int i = 0; i < n_rewound; i++) {
+    this->predict_and_update_batch(this->rewound[i], false);
   }
 
   return res;
 }
 
 void EKFSym::reset_rewind() {
-  this->rewind_obscache.clear();
-  this->rewind_t.clear();
-  this->rewind_states.clear();
+  this->rewind_history.clear();
 }
 
-std::deque<Observation> EKFSym::rewind(double t) {
-  std::deque<Observation> rewound;
-
-  // rewind observations until t is after previous observation
-  while (this->rewind_t.back() > t) {
-    rewound.push_front(this->rewind_obscache.back());
-    this->rewind_t.pop_back();
-    this->rewind_states.pop_back();
-    this->rewind_obscache.pop_back();
-  }
-
-  // set the state to the time right before that
-  this->filter_time = this->rewind_t.back();
-  this->x = this->rewind_states.back().first;
-  this->P = this->rewind_states.back().second;
-
-  return rewound;
-}
-
-void EKFSym::checkpoint(Observation& obs) {
-  // push to rewinder
-  this->rewind_t.push_back(this->filter_time);
-  this->rewind_states.push_back(std::make_pair(this->x, this->P));
-  this->rewind_obscache.push_back(obs);
-
-  // only keep a certain number around
-  if (this->rewind_t.size() > REWIND_TO_KEEP) {
-    this->rewind_t.pop_front();
-    this->rewind_states.pop_front();
-    this->rewind_obscache.pop_front();
-  }
-}
-
-Estimate EKFSym::predict_and_update_batch(Observation& obs, bool augment) {
+Estimate EKFSym::predict_and_update_batch(const Observation& obs, bool augment, bool checkpoint) {
   assert(obs.z.size() == obs.R.size());
   assert(obs.z.size() == obs.extra_args.size());
 
@@ -189,7 +159,9 @@ Estimate EKFSym::predict_and_update_batch(Observation& obs, bool augment) {
   //   this->augment();
   // }
 
-  this->checkpoint(obs);
+  if (checkpoint) {
+    this->rewind_history.push(obs, this->x, this->P);
+  }
 
   return res;
 }
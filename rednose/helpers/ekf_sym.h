@@ -4,7 +4,6 @@
 #include <cassert>
 #include <string>
 #include <vector>
-#include <deque>
 #include <unordered_map>
 #include <map>
 #include <cmath>
@@ -13,6 +12,7 @@
 #include <eigen3/Eigen/Dense>
 
 #include "common_ekf.h"
+#include "rewind_history.h"
 
 #define REWIND_TO_KEEP 512
 
@@ -46,7 +46,8 @@ public:
       Eigen::Map<MatrixXdr> P_initial, int dim_main, int dim_main_err, int N = 0, int dim_augment = 0,
       int dim_augment_err = 0, std::vector<int> maha_test_kinds = std::vector<int>(),
       std::vector<int> quaternion_idxs = std::vector<int>(),
-      std::vector<std::string> global_vars = std::vector<std::string>(), double max_rewind_age = 1.0);
+      std::vector<std::string> global_vars = std::vector<std::string>(), double max_rewind_age = 1.0,
+      int rewind_stride = 1);
   void init_state(Eigen::Map<Eigen::VectorXd> state, Eigen::Map<MatrixXdr> covs, double filter_time);
 
   Eigen::VectorXd state();
@@ -65,10 +66,7 @@ public:
   extra_routine_t get_extra_routine(const std::string& routine);
 
 private:
-  std::deque<Observation> rewind(double t);
-  void checkpoint(Observation& obs);
-
-  Estimate predict_and_update_batch(Observation& obs, bool augment);
+  Estimate predict_and_update_batch(const Observation& obs, bool augment, bool checkpoint = true);
   Eigen::VectorXd update(int kind, Eigen::VectorXd z, MatrixXdr R, std::vector<double> extra_args);
 
   // stuct with linked sympy generated functions
@@ -100,9 +98,8 @@ private:
 
   // rewind stuff
   double max_rewind_age;
-  std::deque<double> rewind_t;
-  std::deque<std::pair<Eigen::VectorXd, MatrixXdr>> rewind_states;
-  std::deque<Observation> rewind_obscache;
+  RewindHistory<Observation, Eigen::VectorXd, MatrixXdr> rewind_history;
+  RewindHistory<Observation, Eigen::VectorXd, MatrixXdr>::ObsList rewound;
 
   Eigen::VectorXd augment_times;
 
@@ -10,6 +10,9 @@ from rednose.helpers.sympy_helpers import sympy_into_c
 from rednose.helpers import TEMPLATE_DIR, load_code
 from rednose.helpers.chi2_lookup import chi2_ppf
 
+# bound on the stacked dimension of a joint update
+MAX_JOINT_ZDIM = 24
+
 
 def solve(a, b):
   if a.shape[0] == 1 and a.shape[1] == 1:
@@ -125,13 +128,30 @@ def gen_code(folder, name, f_sym, dt_sym, x_sym, obs_eqs, dim_x, dim_err, eskf_p
   pre_code += "#define EDIM %d\n" % dim_err
   pre_code += "#define MEDIM %d\n" % dim_main_err
   pre_code += "typedef void (*Hfun)(double *, double *, double *);\n"
+  pre_code += "struct ObsFuns { Hfun h; Hfun H; int dim; bool maha_test; double maha_thresh; };\n"
+  pre_code += "const ObsFuns *obs_funs(int kind);\n"
 
   if global_vars is not None:
     for var in global_vars:
       pre_code += f"\ndouble {var.name};\n"
       pre_code += f"\nvoid set_{var.name}(double x){{ {var.name} = x;}}\n"
 
-  post_code = "\n}\n" # namespace
+  # per kind lookup for the joint update
+  max_joint_zdim = max([MAX_JOINT_ZDIM] + [h_sym.shape[0] for h_sym, _, _, _, _ in obs_eqs])
+  post_code = "\nconst ObsFuns *obs_funs(int kind) {\n"
+  post_code += "  switch (kind) {\n"
+  for h_sym, kind, _, _, _ in obs_eqs:
+    if msckf and kind in feature_track_kinds:
+      continue
+    post_code += f"    case {kind}: {{\n"
+    post_code += f"      static const ObsFuns o = {{ h_{kind}, H_{kind}, {h_sym.shape[0]}, {str(kind in maha_test_kinds).lower()}, MAHA_THRESH_{kind} }};\n"
+    post_code += "      return &o;\n"
+    post_code += "    }\n"
+  post_code += "  }\n"
+  post_code += "  return NULL;\n"
+  post_code += "}\n"
+
+  post_code += "\n}\n" # namespace
   post_code += "extern \"C\" {\n\n"
 
   for h_sym, kind, ea_sym, H_sym, He_sym in obs_eqs:
@@ -163,6 +183,10 @@ def gen_code(folder, name, f_sym, dt_sym, x_sym, obs_eqs, dim_x, dim_err, eskf_p
   post_code += f"void {name}_predict(double *in_x, double *in_P, double *in_Q, double dt) {{\n"
   post_code += "  predict(in_x, in_P, in_Q, dt);\n"
   post_code += "}\n"
+  header += f"void {name}_update_joint(double *in_x, double *in_P, int n, const int *kinds, double *in_z, double *in_R);\n"
+  post_code += f"void {name}_update_joint(double *in_x, double *in_P, int n, const int *kinds, double *in_z, double *in_R) {{\n"
+  post_code += f"  update_joint<{max_joint_zdim}>(in_x, in_P, n, kinds, in_z, in_R);\n"
+  post_code += "}\n"
   if global_vars is not None:
     for var in global_vars:
       header += f"void {name}_set_{var.name}(double x);\n"
@@ -172,7 +196,7 @@ def gen_code(folder, name, f_sym, dt_sym, x_sym, obs_eqs, dim_x, dim_err, eskf_p
 
   post_code += "}\n\n" # extern c
 
-  funcs = ['f_fun', 'F_fun', 'err_fun', 'inv_err_fun', 'H_mod_fun', 'predict']
+  funcs = ['f_fun', 'F_fun', 'err_fun', 'inv_err_fun', 'H_mod_fun', 'predict', 'update_joint']
   func_lists = {
     'h': [kind for _, kind, _, _, _ in obs_eqs],
     'H': [kind for _, kind, _, _, _ in obs_eqs],
@@ -204,6 +228,15 @@ def gen_code(folder, name, f_sym, dt_sym, x_sym, obs_eqs, dim_x, dim_err, eskf_p
 
   # merge code blocks
   header += "}"
+
+  # fixed size filter for use from c++, instantiated once here
+  if not msckf:
+    max_zdim = max([8] + [h_sym.shape[0] for h_sym, _, _, _, _ in obs_eqs])
+    fixed_type = f"EKFS::EKFSymFixed<{dim_x}, {dim_err}, {max_zdim}, {max_joint_zdim}>"
+    header += "\n\n#include \"rednose/helpers/ekf_sym_fixed.h\"\n"
+    header += f"extern template class {fixed_type};\n"
+    header += f"typedef {fixed_type} {name}_ekf_sym_fixed_t;\n"
+    post_code += f"template class {fixed_type};\n"
   code = "\n".join([pre_code, code, open(os.path.join(TEMPLATE_DIR, "ekf_c.c")).read(), post_code])
 
   # write to file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/StdVector>
+
+#include "ekf_sym.h"
+#include "rewind_history.h"
+#include "logger/logger.h"
+
+namespace EKFS {
+
+// EKFSym for a filter whose dimensions are known when the code is generated.
+// State, covariance and observations live in fixed-size storage and the rewind
+// history is allocated once up front, so predict and update never touch the heap.
+// Only plain (non-MSCKF) filters are supported, observations take no extra args.
+// MAX_ZDIM bounds a single observation, MAX_JOINT_ZDIM a joint update of several.
+template <int DIM, int EDIM, int MAX_ZDIM = 8, int MAX_JOINT_ZDIM = 24>
+class EKFSymFixed {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  static const int max_joint_zdim = MAX_JOINT_ZDIM;
+
+  typedef Eigen::Matrix<double, DIM, 1> StateVector;
+  typedef Eigen::Matrix<double, EDIM, EDIM, Eigen::RowMajor> CovMatrix;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, MAX_JOINT_ZDIM, 1> ObsVector;
+  // noise matrices of all stacked observations, back to back
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, MAX_JOINT_ZDIM * MAX_ZDIM, 1> ObsNoise;
+
+  EKFSymFixed(const std::string &name, const CovMatrix &Q, const StateVector &x_initial, const CovMatrix &P_initial,
+              std::vector<int> quaternion_idxs = std::vector<int>(), double max_rewind_age = 1.0, int rewind_stride = 1);
+
+  void init_state(const StateVector &state, const CovMatrix &covs, double filter_time);
+
+  const StateVector &state() const { return x; }
+  const CovMatrix &covs() const { return P; }
+  void set_filter_time(double t) { filter_time = t; }
+  double get_filter_time() const { return filter_time; }
+  void set_global(const std::string &global_var, double val) { ekf->sets.at(global_var)(val); }
+  void reset_rewind() { rewind_history.clear(); }
+
+  void predict(double t);
+  // returns false when the observation is too old to rewind to
+  bool predict_and_update(double t, int kind, const double *z, int z_dim, const double *R) {
+    return this->predict_and_update_joint(t, 1, &kind, &z_dim, z, R);
+  }
+  // Applies n observations of possibly different kinds at time t as one update, linearized
+  // around the same state. z and R hold the measurements and their noise matrices back to back.
+  bool predict_and_update_joint(double t, int n, const int *kinds, const int *z_dims, const double *z, const double *R);
+
+  extra_routine_t get_extra_routine(const std::string &routine) const { return ekf->extra_routines.at(routine); }
+
+private:
+  struct Observation {
+    double t;
+    int n;
+    int kinds[MAX_JOINT_ZDIM];
+    ObsVector z;
+    ObsNoise R;
+  };
+
+  void predict_and_update(const Observation &obs, bool checkpoint = true);
+  void normalize_quaternions();
+
+  const EKF *ekf = NULL;
+
+  StateVector x;  // state
+  CovMatrix P;  // covs
+  CovMatrix Q;  // process noise
+  double filter_time;
+
+  std::vector<int> quaternion_idxs;
+
+  // rewind stuff
+  double max_rewind_age;
+  RewindHistory<Observation, StateVector, CovMatrix> rewind_history;
+  typename RewindHistory<Observation, StateVector, CovMatrix>::ObsList rewound;
+  Observation obs_tmp;
+
+  // scratch for the generated updates
+  ObsVector z_tmp;
+  ObsNoise R_tmp;
+};
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::EKFSymFixed(const std::string &name, const CovMatrix &Q, const StateVector &x_initial,
+                                              const CovMatrix &P_initial, std::vector<int> quaternion_idxs, double max_rewind_age,
+                                              int rewind_stride)
+    : Q(Q), quaternion_idxs(quaternion_idxs), max_rewind_age(max_rewind_age),
+      rewind_history(REWIND_TO_KEEP, rewind_stride), rewound(REWIND_TO_KEEP) {
+  this->ekf = ekf_lookup(name);
+  assert(this->ekf);
+  assert(this->ekf->feature_kinds.empty());
+
+  this->init_state(x_initial, P_initial, NAN);
+}
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+void EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::init_state(const StateVector &state, const CovMatrix &covs, double filter_time) {
+  this->x = state;
+  this->P = covs;
+  this->filter_time = filter_time;
+  this->reset_rewind();
+}
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+void EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::normalize_quaternions() {
+  for (int idx : this->quaternion_idxs) {
+    this->x.template segment<4>(idx).normalize();
+  }
+}
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+void EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::predict(double t) {
+  // initialize time
+  if (std::isnan(this->filter_time)) {
+    this->filter_time = t;
+  }
+
+  // predict
+  double dt = t - this->filter_time;
+  assert(dt >= 0.0);
+
+  this->ekf->predict(this->x.data(), this->P.data(), this->Q.data(), dt);
+  this->normalize_quaternions();
+  this->filter_time = t;
+}
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+bool EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::predict_and_update_joint(double t, int n, const int *kinds,
+                                                                         const int *z_dims, const double *z, const double *R) {
+  int z_dim = 0, R_size = 0;
+  for (int i = 0; i < n; ++i) {
+    assert(z_dims[i] > 0 && z_dims[i] <= MAX_ZDIM);
+    z_dim += z_dims[i];
+    R_size += z_dims[i] * z_dims[i];
+  }
+  assert(n > 0 && z_dim <= MAX_JOINT_ZDIM);
+
+  int n_rewound = 0;
+  if (!std::isnan(this->filter_time) && t < this->filter_time) {
+    if (!this->rewind_history.empty() && t >= this->rewind_history.newest_t() - this->max_rewind_age) {
+      n_rewound = this->rewind_history.rewind(t, this->x, this->P, this->filter_time,
+        [this](const Observation &o) { this->predict_and_update(o, false); }, this->rewound);
+    } else {
+      n_rewound = -1;
+    }
+    if (n_rewound < 0) {
+      LOGD("observation too old at %f with filter at %f, ignoring!", t, this->filter_time);
+      return false;
+    }
+  }
+
+  Observation &obs = this->obs_tmp;
+  obs.t = t;
+  obs.n = n;
+  std::copy(kinds, kinds + n, obs.kinds);
+  obs.z = Eigen::Map<const Eigen::VectorXd>(z, z_dim);
+  obs.R = Eigen::Map<const Eigen::VectorXd>(R, R_size);
+  this->predict_and_update(obs);
+
+  // fast forward through everything that was rewound
+  for (int i = 0; i < n_rewound; ++i) {
+    this->predict_and_update(this->rewound[i]);
+  }
+  return true;
+}
+
+template <int DIM, int EDIM, int MAX_ZDIM, int MAX_JOINT_ZDIM>
+void EKFSymFixed<DIM, EDIM, MAX_ZDIM, MAX_JOINT_ZDIM>::predict_and_update(const Observation &obs, bool checkpoint) {
+  this->predict(obs.t);
+
+  // the generated update writes the innovation back into z
+  this->z_tmp = obs.z;
+  this->R_tmp = obs.R;
+  if (obs.n == 1) {
+    this->ekf->updates.at(obs.kinds[0])(this->x.data(), this->P.data(), this->z_tmp.data(), this->R_tmp.data(), NULL);
+  } else {
+    this->ekf->update_joint(this->x.data(), this->P.data(), obs.n, obs.kinds, this->z_tmp.data(), this->R_tmp.data());
+  }
+  this->normalize_quaternions();
+
+  if (checkpoint) {
+    this->rewind_history.push(obs, this->x, this->P);
+  }
+}
+
+}  // namespace EKFS
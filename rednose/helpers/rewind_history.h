@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <eigen3/Eigen/StdVector>
+
+namespace EKFS {
+
+// History of applied observations used to handle out-of-order measurements.
+// Every observation goes into a preallocated ring (the observation log), but the
+// filter state is only snapshotted every `stride` observations. Rewinding restores
+// the nearest older snapshot and recomputes the remaining states from the log.
+// Slots are overwritten in place, so once warmed up nothing is allocated.
+template <typename Obs, typename StateT, typename CovT>
+class RewindHistory {
+public:
+  typedef std::vector<Obs, Eigen::aligned_allocator<Obs>> ObsList;
+
+  RewindHistory(size_t size, size_t stride) : stride(stride), obs_log(size), snapshots(size / stride + 2) {
+    assert(size > 0 && stride > 0);
+  }
+
+  void clear() {
+    this->obs_begin = this->obs_end = 0;
+    this->snap_begin = this->snap_end = 0;
+  }
+
+  bool empty() const { return this->obs_begin == this->obs_end; }
+  double oldest_t() const { return this->obs_at(this->obs_begin).t; }
+  double newest_t() const { return this->obs_at(this->obs_end - 1).t; }
+
+  // obs was just applied and x, P is the resulting filter state
+  void push(const Obs &obs, const StateT &x, const CovT &P) {
+    if (this->obs_end - this->obs_begin == this->obs_log.size()) {
+      ++this->obs_begin;
+    }
+    const uint64_t seq = this->obs_end++;
+    this->obs_at(seq) = obs;
+
+    if (this->snap_begin == this->snap_end || seq - this->snap_at(this->snap_end - 1).seq >= this->stride) {
+      if (this->snap_end - this->snap_begin == this->snapshots.size()) {
+        ++this->snap_begin;
+      }
+      Snapshot &s = this->snap_at(this->snap_end++);
+      s.seq = seq;
+      s.x = x;
+      s.P = P;
+    }
+  }
+
+  // Rewinds to the last observation at or before t. The observations after it are
+  // copied to the front of rewound and dropped from the history, and the state right
+  // after it is written to x, P and filter_time. replay(obs) must apply an observation
+  // without pushing it back. Returns the number of rewound observations, or -1 if the
+  // history doesn't reach back to t.
+  template <typename Replay>
+  int rewind(double t, StateT &x, CovT &P, double &filter_time, Replay replay, ObsList &rewound) {
+    if (this->empty() || t < this->oldest_t()) {
+      return -1;
+    }
+
+    uint64_t last = this->obs_end - 1;
+    while (this->obs_at(last).t > t) {
+      --last;
+    }
+
+    // nearest snapshot whose observation and successors are still in the log,
+    // its time is the filter time to replay from
+    uint64_t snap = this->snap_end;
+    while (snap > this->snap_begin && this->snap_at(snap - 1).seq > last) {
+      --snap;
+    }
+    if (snap == this->snap_begin || this->snap_at(snap - 1).seq < this->obs_begin) {
+      return -1;
+    }
+    const Snapshot &s = this->snap_at(snap - 1);
+
+    const int n = this->obs_end - (last + 1);
+    if (rewound.size() < (size_t)n) {
+      rewound.resize(n);
+    }
+    for (int i = 0; i < n; ++i) {
+      rewound[i] = this->obs_at(last + 1 + i);
+    }
+
+    x = s.x;
+    P = s.P;
+    filter_time = this->obs_at(s.seq).t;
+    for (uint64_t seq = s.seq + 1; seq <= last; ++seq) {
+      replay(this->obs_at(seq));
+    }
+
+    this->obs_end = last + 1;
+    this->snap_end = snap;
+    return n;
+  }
+
+private:
+  struct Snapshot {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    uint64_t seq;
+    StateT x;
+    CovT P;
+  };
+
+  inline Obs &obs_at(uint64_t seq) { return this->obs_log[seq % this->obs_log.size()]; }
+  inline const Obs &obs_at(uint64_t seq) const { return this->obs_log[seq % this->obs_log.size()]; }
+  inline Snapshot &snap_at(uint64_t i) { return this->snapshots[i % this->snapshots.size()]; }
+
+  const size_t stride;
+
+  // monotonic sequence numbers, the valid entries are [begin, end)
+  ObsList obs_log;
+  uint64_t obs_begin = 0, obs_end = 0;
+  std::vector<Snapshot, Eigen::aligned_allocator<Snapshot>> snapshots;
+  uint64_t snap_begin = 0, snap_end = 0;
+};
+
+}  // namespace EKFS
@@ -38,10 +38,13 @@ template <int ZDIM, int EADIM, bool MAHA_TEST>
 void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, double *in_z, double *in_R, double *in_ea, double MAHA_THRESHOLD) {
   typedef Eigen::Matrix<double, ZDIM, ZDIM, Eigen::RowMajor> ZZM;
   typedef Eigen::Matrix<double, ZDIM, DIM, Eigen::RowMajor> ZDM;
-  typedef Eigen::Matrix<double, Eigen::Dynamic, EDIM, Eigen::RowMajor> XEM;
+  // null space projection can only shrink the observation, so bounding the
+  // dynamic sizes by ZDIM keeps all of these on the stack
+  typedef Eigen::Matrix<double, Eigen::Dynamic, DIM, Eigen::RowMajor, ZDIM, DIM> XDM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, EDIM, Eigen::RowMajor, ZDIM, EDIM> XEM;
   //typedef Eigen::Matrix<double, EDIM, ZDIM, Eigen::RowMajor> EZM;
-  typedef Eigen::Matrix<double, Eigen::Dynamic, 1> X1M;
-  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> XXM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, ZDIM, 1> X1M;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor, ZDIM, ZDIM> XXM;
 
   double in_hx[ZDIM] = {0};
   double in_H[ZDIM * DIM] = {0};
@@ -62,7 +65,7 @@ void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, do
 
   // get y (y = z - hx)
   Eigen::Matrix<double, ZDIM, 1> pre_y(in_hx); pre_y = z - pre_y;
-  X1M y; XXM H; XXM R;
+  X1M y; XDM H; XXM R;
   if (Hea_fun){
     typedef Eigen::Matrix<double, ZDIM, EADIM, Eigen::RowMajor> ZAM;
     double in_Hea[ZDIM * EADIM] = {0};
@@ -121,3 +124,86 @@ void update(double *in_x, double *in_P, Hfun h_fun, Hfun H_fun, Hfun Hea_fun, do
 }
 
 
+
+// Stacks n observations, possibly of different kinds, into a single update around
+// one linearization point. in_z holds the measurements and in_R their noise
+// matrices back to back, the stacked R is block diagonal. Outliers are tested per
+// observation. Feature track kinds (extra args) are not supported.
+template <int MAX_ZDIM>
+void update_joint(double *in_x, double *in_P, int n, const int *kinds, double *in_z, double *in_R) {
+  typedef Eigen::Matrix<double, Eigen::Dynamic, DIM, Eigen::RowMajor> HM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, DIM, Eigen::RowMajor, MAX_ZDIM, DIM> XDM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, EDIM, Eigen::RowMajor, MAX_ZDIM, EDIM> XEM;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, MAX_ZDIM, 1> X1M;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor, MAX_ZDIM, MAX_ZDIM> XXM;
+
+  int zdim = 0;
+  for (int i = 0; i < n; i++) {
+    assert(obs_funs(kinds[i]) != NULL);
+    zdim += obs_funs(kinds[i])->dim;
+  }
+  assert(zdim <= MAX_ZDIM);
+
+  double in_hx[MAX_ZDIM] = {0};
+  double in_H[MAX_ZDIM * DIM] = {0};
+  double in_H_mod[EDIM * DIM] = {0};
+  double delta_x[EDIM] = {0};
+  double x_new[DIM] = {0};
+
+  EEM P(in_P);
+
+  // stack y = z - hx, H and R
+  X1M y(zdim);
+  XDM H(zdim, DIM);
+  XXM R = XXM::Zero(zdim, zdim);
+  for (int i = 0, row = 0; i < n; i++) {
+    const ObsFuns *o = obs_funs(kinds[i]);
+    o->h(in_x, NULL, in_hx);
+    o->H(in_x, NULL, in_H);
+    y.segment(row, o->dim) = Eigen::Map<Eigen::VectorXd>(in_z + row, o->dim) - Eigen::Map<Eigen::VectorXd>(in_hx, o->dim);
+    H.middleRows(row, o->dim) = Eigen::Map<HM>(in_H, o->dim, DIM);
+    R.block(row, row, o->dim, o->dim) = Eigen::Map<RM>(in_R, o->dim, o->dim);
+    in_R += o->dim * o->dim;
+    row += o->dim;
+  }
+
+  // get modified H
+  H_mod_fun(in_x, in_H_mod);
+  DEM H_mod(in_H_mod);
+  XEM H_err = H * H_mod;
+  XXM HPHt = (H_err * P) * H_err.transpose();
+
+  // Do mahalobis distance test on each observation
+  for (int i = 0, row = 0; i < n; i++) {
+    const ObsFuns *o = obs_funs(kinds[i]);
+    if (o->maha_test) {
+      XXM a = (HPHt.block(row, row, o->dim, o->dim) + R.block(row, row, o->dim, o->dim)).inverse();
+      double maha_dist = y.segment(row, o->dim).transpose() * a * y.segment(row, o->dim);
+      if (maha_dist > o->maha_thresh) {
+        R.block(row, row, o->dim, o->dim) *= 1.0e16;
+      }
+    }
+    row += o->dim;
+  }
+
+  // kalman gains and I_KH
+  XXM S = HPHt + R;
+  XEM KT = S.fullPivLu().solve(H_err * P.transpose());
+  EEM I_KH = Eigen::Matrix<double, EDIM, EDIM>::Identity() - (KT.transpose() * H_err);
+
+  // update state by injecting dx
+  Eigen::Matrix<double, EDIM, 1> dx(delta_x);
+  dx  = (KT.transpose() * y);
+  memcpy(delta_x, dx.data(), EDIM * sizeof(double));
+  err_fun(in_x, delta_x, x_new);
+  Eigen::Matrix<double, DIM, 1> x(x_new);
+
+  // update cov
+  P = ((I_KH * P) * I_KH.transpose()) + ((KT.transpose() * R) * KT);
+
+  // copy out state
+  memcpy(in_x, x.data(), DIM * sizeof(double));
+  memcpy(in_P, P.data(), EDIM * EDIM * sizeof(double));
+  memcpy(in_z, y.data(), y.rows() * sizeof(double));
+}
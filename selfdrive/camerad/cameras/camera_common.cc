@@ -2,10 +2,12 @@
 
 #include <unistd.h>
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <chrono>
 #include <thread>
+#include <vector>
 
 #include "libyuv.h"
 #include <jpeglib.h>
@@ -107,6 +109,7 @@ CameraBuf::~CameraBuf() {
 
 bool CameraBuf::acquire() {
   if (!safe_queue.try_pop(cur_buf_idx, 1)) return false;
+  const double start_time = millis_since_boot();
 
   if (camera_bufs_metadata[cur_buf_idx].frame_id == -1) {
     LOGE("no frame data? wtf");
@@ -145,11 +148,14 @@ bool CameraBuf::acquire() {
                                cur_rgb_buf->len, 0, 0, &debayer_event));
   }
 
-  clWaitForEvents(1, &debayer_event);
-  CL_CHECK(clReleaseEvent(debayer_event));
-
+  // chain rgb2yuv on the debayer through the wait list and block on the host once for the whole frame
+  cl_event yuv_event;
   cur_yuv_buf = vipc_server->get_buffer(yuv_type);
-  rgb2yuv->queue(q, cur_rgb_buf->buf_cl, cur_yuv_buf->buf_cl);
+  rgb2yuv->queue(q, cur_rgb_buf->buf_cl, cur_yuv_buf->buf_cl, 1, &debayer_event, &yuv_event);
+  CL_CHECK(clFlush(q));
+  CL_CHECK(clWaitForEvents(1, &yuv_event));
+  CL_CHECK(clReleaseEvent(yuv_event));
+  CL_CHECK(clReleaseEvent(debayer_event));
 
   VisionIpcBufExtra extra = {
                         cur_frame_data.frame_id,
@@ -159,6 +165,7 @@ bool CameraBuf::acquire() {
   vipc_server->send(cur_rgb_buf, &extra);
   vipc_server->send(cur_yuv_buf, &extra);
 
+  cur_frame_data.processing_time = (millis_since_boot() - start_time) / 1000.0;
   return true;
 }
 
@@ -188,6 +195,7 @@ void fill_frame_data(cereal::FrameData::Builder &framed, const FrameMetadata &fr
   framed.setLensSag(frame_data.lens_sag);
   framed.setLensErr(frame_data.lens_err);
   framed.setLensTruePos(frame_data.lens_true_pos);
+  framed.setProcessingTime(frame_data.processing_time);
 }
 
 kj::Array<uint8_t> get_frame_image(const CameraBuf *b) {
@@ -216,23 +224,41 @@ kj::Array<uint8_t> get_frame_image(const CameraBuf *b) {
   return kj::mv(frame_image);
 }
 
-static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_width, int thumbnail_height) {
+struct Thumbnail {
+  uint32_t frame_id;
+  uint64_t timestamp_eof;
+  int width, height;
+  std::vector<uint8_t> yuv;
+};
+
+// cheap downscale on the camera thread, the copy lets the yuv buffer be reused right away
+static std::shared_ptr<Thumbnail> get_thumbnail(const CameraBuf *b, int thumbnail_width, int thumbnail_height) {
+  auto t = std::make_shared<Thumbnail>();
+  t->frame_id = b->cur_frame_data.frame_id;
+  t->timestamp_eof = b->cur_frame_data.timestamp_eof;
+  t->width = thumbnail_width;
+  t->height = thumbnail_height;
   // make the buffer big enough. jpeg_write_raw_data requires 16-pixels aligned height to be used.
-  std::unique_ptr<uint8[]> buf(new uint8_t[(thumbnail_width * ((thumbnail_height + 15) & ~15) * 3) / 2]);
-  uint8_t *y_plane = buf.get();
+  t->yuv.resize((thumbnail_width * ((thumbnail_height + 15) & ~15) * 3) / 2);
+  uint8_t *y_plane = t->yuv.data();
   uint8_t *u_plane = y_plane + thumbnail_width * thumbnail_height;
   uint8_t *v_plane = u_plane + (thumbnail_width * thumbnail_height) / 4;
-  {
-    int result = libyuv::I420Scale(
-        b->cur_yuv_buf->y, b->rgb_width, b->cur_yuv_buf->u, b->rgb_width / 2, b->cur_yuv_buf->v, b->rgb_width / 2,
-        b->rgb_width, b->rgb_height,
-        y_plane, thumbnail_width, u_plane, thumbnail_width / 2, v_plane, thumbnail_width / 2,
-        thumbnail_width, thumbnail_height, libyuv::kFilterNone);
-    if (result != 0) {
-      LOGE("Generate YUV thumbnail failed.");
-      return {};
-    }
+  int result = libyuv::I420Scale(
+      b->cur_yuv_buf->y, b->rgb_width, b->cur_yuv_buf->u, b->rgb_width / 2, b->cur_yuv_buf->v, b->rgb_width / 2,
+      b->rgb_width, b->rgb_height,
+      y_plane, thumbnail_width, u_plane, thumbnail_width / 2, v_plane, thumbnail_width / 2,
+      thumbnail_width, thumbnail_height, libyuv::kFilterNone);
+  if (result != 0) {
+    LOGE("Generate YUV thumbnail failed.");
+    return nullptr;
   }
+  return t;
+}
+
+static kj::Array<capnp::byte> yuv420_to_jpeg(const Thumbnail &t) {
+  const uint8_t *y_plane = t.yuv.data();
+  const uint8_t *u_plane = y_plane + t.width * t.height;
+  const uint8_t *v_plane = u_plane + (t.width * t.height) / 4;
 
   struct jpeg_compress_struct cinfo;
   struct jpeg_error_mgr jerr;
@@ -243,8 +269,8 @@ static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_w
   size_t thumbnail_len = 0;
   jpeg_mem_dest(&cinfo, &thumbnail_buffer, &thumbnail_len);
 
-  cinfo.image_width = thumbnail_width;
-  cinfo.image_height = thumbnail_height;
+  cinfo.image_width = t.width;
+  cinfo.image_height = t.height;
   cinfo.input_components = 3;
 
   jpeg_set_defaults(&cinfo);
@@ -257,6 +283,8 @@ static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_w
   cinfo.comp_info[2].h_samp_factor = 1;  // V
   cinfo.comp_info[2].v_samp_factor = 1;
   cinfo.raw_data_in = TRUE;
+  // libjpeg-turbo has SIMD for the fast integer DCT, plenty for a quality 50 thumbnail
+  cinfo.dct_method = JDCT_IFAST;
 
   jpeg_set_quality(&cinfo, 50, TRUE);
   jpeg_start_compress(&cinfo, TRUE);
@@ -266,11 +294,11 @@ static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_w
 
   for (int line = 0; line < cinfo.image_height; line += 16) {
     for (int i = 0; i < 16; ++i) {
-      y[i] = y_plane + (line + i) * cinfo.image_width;
+      y[i] = (JSAMPROW)y_plane + (line + i) * cinfo.image_width;
       if (i % 2 == 0) {
         int offset = (cinfo.image_width / 2) * ((i + line) / 2);
-        u[i / 2] = u_plane + offset;
-        v[i / 2] = v_plane + offset;
+        u[i / 2] = (JSAMPROW)u_plane + offset;
+        v[i / 2] = (JSAMPROW)v_plane + offset;
       }
     }
     jpeg_write_raw_data(&cinfo, planes, 16);
@@ -284,14 +312,14 @@ static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_w
   return dat;
 }
 
-static void publish_thumbnail(PubMaster *pm, const CameraBuf *b) {
-  auto thumbnail = yuv420_to_jpeg(b, b->rgb_width / 4, b->rgb_height / 4);
+static void publish_thumbnail(PubMaster *pm, const Thumbnail &t) {
+  auto thumbnail = yuv420_to_jpeg(t);
   if (thumbnail.size() == 0) return;
 
   MessageBuilder msg;
   auto thumbnaild = msg.initEvent().initThumbnail();
-  thumbnaild.setFrameId(b->cur_frame_data.frame_id);
-  thumbnaild.setTimestampEof(b->cur_frame_data.timestamp_eof);
+  thumbnaild.setFrameId(t.frame_id);
+  thumbnaild.setTimestampEof(t.timestamp_eof);
   thumbnaild.setThumbnail(thumbnail);
 
   pm->send("thumbnail", msg);
@@ -299,23 +327,31 @@ static void publish_thumbnail(PubMaster *pm, const CameraBuf *b) {
 
 float set_exposure_target(const CameraBuf *b, int x_start, int x_end, int x_skip, int y_start, int y_end, int y_skip) {
   int lum_med;
-  uint32_t lum_binning[256] = {0};
+  // four interleaved sub-histograms so consecutive pixels with the same value
+  // don't serialize on a single counter, merged after the loop
+  uint32_t lum_binning[4][256] = {};
   const uint8_t *pix_ptr = b->cur_yuv_buf->y;
 
   unsigned int lum_total = 0;
   for (int y = y_start; y < y_end; y += y_skip) {
-    for (int x = x_start; x < x_end; x += x_skip) {
-      uint8_t lum = pix_ptr[(y * b->rgb_width) + x];
-      lum_binning[lum]++;
-      lum_total += 1;
+    const uint8_t *row = pix_ptr + y * b->rgb_width;
+    int x = x_start;
+    for (; x + 3 * x_skip < x_end; x += 4 * x_skip) {
+      lum_binning[0][row[x]]++;
+      lum_binning[1][row[x + x_skip]]++;
+      lum_binning[2][row[x + 2 * x_skip]]++;
+      lum_binning[3][row[x + 3 * x_skip]]++;
+    }
+    for (; x < x_end; x += x_skip) {
+      lum_binning[0][row[x]]++;
     }
+    lum_total += (std::max(x_end - x_start, 0) + x_skip - 1) / x_skip;
   }
 
-
   // Find mean lumimance value
   unsigned int lum_cur = 0;
   for (lum_med = 255; lum_med >= 0; lum_med--) {
-    lum_cur += lum_binning[lum_med];
+    lum_cur += lum_binning[0][lum_med] + lum_binning[1][lum_med] + lum_binning[2][lum_med] + lum_binning[3][lum_med];
 
     if (lum_cur >= lum_total / 2) {
       break;
@@ -338,19 +374,43 @@ void *processing_thread(MultiCameraState *cameras, CameraState *cs, process_thre
   }
   set_thread_name(thread_name);
 
+  // jpeg encoding takes ~10ms, keep it off the camera thread
+  const bool send_thumbnail = cs == &(cameras->road_cam) && cameras->pm;
+  SafeQueue<std::shared_ptr<Thumbnail>> thumbnail_queue;
+  // set while a thumbnail is queued or encoded
+  std::atomic<bool> thumbnail_busy = false;
+  std::thread thumbnail_thread;
+  if (send_thumbnail) {
+    thumbnail_thread = std::thread([&]() {
+      set_thread_name("thumbnail");
+      std::shared_ptr<Thumbnail> t;
+      while (!do_exit) {
+        if (thumbnail_queue.try_pop(t, 50)) {
+          publish_thumbnail(cameras->pm, *t);
+          thumbnail_busy = false;
+        }
+      }
+    });
+  }
+
   uint32_t cnt = 0;
   while (!do_exit) {
     if (!cs->buf.acquire()) continue;
 
     callback(cameras, cs, cnt);
 
-    if (cs == &(cameras->road_cam) && cameras->pm && cnt % 100 == 3) {
-      // this takes 10ms???
-      publish_thumbnail(cameras->pm, &(cs->buf));
+    // drop the thumbnail rather than queue up behind a slow encode
+    if (send_thumbnail && cnt % 100 == 3 && !thumbnail_busy) {
+      if (auto t = get_thumbnail(&(cs->buf), cs->buf.rgb_width / 4, cs->buf.rgb_height / 4)) {
+        thumbnail_busy = true;
+        thumbnail_queue.push(t);
+      }
     }
     cs->buf.release();
     ++cnt;
   }
+
+  if (thumbnail_thread.joinable()) thumbnail_thread.join();
   return NULL;
 }
 
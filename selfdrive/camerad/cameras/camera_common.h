@@ -85,6 +85,9 @@ typedef struct FrameMetadata {
   float lens_sag;
   float lens_err;
   float lens_true_pos;
+
+  // Processing
+  float processing_time;  // seconds from acquire to VisionIPC publish
 } FrameMetadata;
 
 typedef struct CameraExpInfo {
@@ -1,10 +1,18 @@
 #include "selfdrive/camerad/cameras/camera_replay.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <memory>
 #include <thread>
+#include <vector>
+
+#include "libyuv.h"
 
 #include "selfdrive/common/clutil.h"
+#include "selfdrive/common/timing.h"
 #include "selfdrive/common/util.h"
+#include "selfdrive/hardware/hw.h"
 
 extern ExitHandler do_exit;
 
@@ -15,7 +23,6 @@ namespace {
 const char *BASE_URL = "https://commadataci.blob.core.windows.net/openpilotci/";
 
 const std::string road_camera_route = "0c94aa1e1296d7c6|2021-05-05--19-48-37";
-// const std::string driver_camera_route = "534ccd8a0950a00c|2021-06-08--12-15-37";
 
 std::string get_url(std::string route_name, const std::string &camera, int segment_num) {
   std::replace(route_name.begin(), route_name.end(), '|', '/');
@@ -23,8 +30,8 @@ std::string get_url(std::string route_name, const std::string &camera, int segme
 }
 
 void camera_init(VisionIpcServer *v, CameraState *s, int camera_id, unsigned int fps, cl_device_id device_id, cl_context ctx, VisionStreamType rgb_type, VisionStreamType yuv_type, const std::string &url) {
-  // TODO: cache url file
-  s->frame = new FrameReader();
+  // decodes ahead of the camera thread, streams that fit in the cache are decoded once
+  s->frame = new FrameReader(util::getenv("REPLAY_CACHE_FRAMES", 200));
   if (!s->frame->load(url)) {
     printf("failed to load stream from %s", url.c_str());
     assert(0);
@@ -43,81 +50,114 @@ void camera_init(VisionIpcServer *v, CameraState *s, int camera_id, unsigned int
 
 void camera_close(CameraState *s) {
   delete s->frame;
+  s->frame = nullptr;
 }
 
 void run_camera(CameraState *s) {
-  uint32_t stream_frame_id = 0, frame_id = 0;
-  size_t buf_idx = 0;
+  static const float speed = std::max(util::getenv("REPLAY_SPEED", 1.0f), 0.01f);
+  const auto frame_time = std::chrono::nanoseconds((uint64_t)(1e9 / s->fps / speed));
+
+  uint32_t frame_id = 0;
+  size_t buf_idx = 0, stream_idx = 0;
   std::unique_ptr<uint8_t[]> rgb_buf = std::make_unique<uint8_t[]>(s->frame->getRGBSize());
+  const int w = s->frame->width, h = s->frame->height;
+
+  // pace against absolute deadlines so the time spent here doesn't accumulate as drift
+  auto next_frame = std::chrono::steady_clock::now();
   while (!do_exit) {
-    if (stream_frame_id == s->frame->getFrameCount()) {
-      // loop stream
-      stream_frame_id = 0;
-    }
-    if (s->frame->get(stream_frame_id++, rgb_buf.get(), nullptr)) {
-      s->buf.camera_bufs_metadata[buf_idx] = {.frame_id = frame_id};
-      auto &buf = s->buf.camera_bufs[buf_idx];
-      CL_CHECK(clEnqueueWriteBuffer(buf.copy_q, buf.buf_cl, CL_TRUE, 0, s->frame->getRGBSize(), rgb_buf.get(), 0, NULL, NULL));
-      s->buf.queue(buf_idx);
-      ++frame_id;
-      buf_idx = (buf_idx + 1) % FRAME_BUF_COUNT;
-    }
-    util::sleep_for(1000 / s->fps);
+    // loops over the stream, frames that failed to decode are skipped
+    FrameReader::YUVBuffer yuv = s->frame->get(stream_idx);
+    stream_idx = (stream_idx + 1) % s->frame->getFrameCount();
+    if (!yuv) continue;
+
+    const uint8_t *y = yuv->data(), *u = y + w * h, *v = u + (w / 2) * (h / 2);
+    libyuv::I420ToRGB24(y, w, u, w / 2, v, w / 2, rgb_buf.get(), w * 3, w, h);
+    std::this_thread::sleep_until(next_frame);
+
+    const uint64_t ts = nanos_since_boot();
+    s->buf.camera_bufs_metadata[buf_idx] = {.frame_id = frame_id, .timestamp_sof = ts, .timestamp_eof = ts};
+    auto &buf = s->buf.camera_bufs[buf_idx];
+    CL_CHECK(clEnqueueWriteBuffer(buf.copy_q, buf.buf_cl, CL_TRUE, 0, s->frame->getRGBSize(), rgb_buf.get(), 0, NULL, NULL));
+    s->buf.queue(buf_idx);
+    ++frame_id;
+    buf_idx = (buf_idx + 1) % FRAME_BUF_COUNT;
+
+    // don't burst to catch up if decoding fell behind
+    next_frame = std::max(next_frame + frame_time, std::chrono::steady_clock::now() - frame_time);
   }
 }
 
-void road_camera_thread(CameraState *s) {
-  set_thread_name("replay_road_camera_thread");
+void camera_thread(CameraState *s, const char *name) {
+  set_thread_name(name);
   run_camera(s);
 }
 
-// void driver_camera_thread(CameraState *s) {
-//   set_thread_name("replay_driver_camera_thread");
-//   run_camera(s);
-// }
-
 void process_road_camera(MultiCameraState *s, CameraState *c, int cnt) {
   const CameraBuf *b = &c->buf;
   MessageBuilder msg;
-  auto framed = msg.initEvent().initRoadCameraState();
+  auto framed = c == &s->road_cam ? msg.initEvent().initRoadCameraState() : msg.initEvent().initWideRoadCameraState();
   fill_frame_data(framed, b->cur_frame_data);
-  framed.setImage(kj::arrayPtr((const uint8_t *)b->cur_yuv_buf->addr, b->cur_yuv_buf->len));
+  if (c == &s->road_cam) {
+    framed.setImage(kj::arrayPtr((const uint8_t *)b->cur_yuv_buf->addr, b->cur_yuv_buf->len));
+  }
   framed.setTransform(b->yuv_transform.v);
-  s->pm->send("roadCameraState", msg);
+  s->pm->send(c == &s->road_cam ? "roadCameraState" : "wideRoadCameraState", msg);
 }
 
-// void process_driver_camera(MultiCameraState *s, CameraState *c, int cnt) {
-//   MessageBuilder msg;
-//   auto framed = msg.initEvent().initDriverCameraState();
-//   framed.setFrameType(cereal::FrameData::FrameType::FRONT);
-//   fill_frame_data(framed, c->buf.cur_frame_data);
-//   s->pm->send("driverCameraState", msg);
-// }
+void process_driver_camera(MultiCameraState *s, CameraState *c, int cnt) {
+  common_process_driver_camera(s->sm, s->pm, c, cnt);
+}
 
 }  // namespace
 
+// local streams are given with ROAD_CAMERA/WIDE_ROAD_CAMERA/DRIVER_CAMERA (fcamera/ecamera/dcamera.hevc),
+// without any of them the road camera falls back to streaming the CI route.
 void cameras_init(VisionIpcServer *v, MultiCameraState *s, cl_device_id device_id, cl_context ctx) {
-  camera_init(v, &s->road_cam, CAMERA_ID_LGC920, 20, device_id, ctx,
-              VISION_STREAM_RGB_BACK, VISION_STREAM_YUV_BACK, get_url(road_camera_route, "fcamera", 0));
-  // camera_init(v, &s->driver_cam, CAMERA_ID_LGC615, 10, device_id, ctx,
-  //             VISION_STREAM_RGB_FRONT, VISION_STREAM_YUV_FRONT, get_url(driver_camera_route, "dcamera", 0));
-  s->pm = new PubMaster({"roadCameraState", "driverCameraState", "thumbnail"});
+  const std::string road_path = util::getenv("ROAD_CAMERA");
+  const std::string wide_road_path = util::getenv("WIDE_ROAD_CAMERA");
+  const std::string driver_path = util::getenv("DRIVER_CAMERA");
+  const bool local = !road_path.empty() || !wide_road_path.empty() || !driver_path.empty();
+
+  if (!local || !road_path.empty()) {
+    camera_init(v, &s->road_cam, CAMERA_ID_LGC920, 20, device_id, ctx,
+                VISION_STREAM_RGB_BACK, VISION_STREAM_YUV_BACK, local ? road_path : get_url(road_camera_route, "fcamera", 0));
+  }
+  if (!wide_road_path.empty()) {
+    camera_init(v, &s->wide_road_cam, CAMERA_ID_LGC920, 20, device_id, ctx,
+                VISION_STREAM_RGB_WIDE, VISION_STREAM_YUV_WIDE, wide_road_path);
+  }
+  if (!driver_path.empty()) {
+    camera_init(v, &s->driver_cam, CAMERA_ID_LGC615, Hardware::TICI() ? 20 : 10, device_id, ctx,
+                VISION_STREAM_RGB_FRONT, VISION_STREAM_YUV_FRONT, driver_path);
+  }
+  s->sm = new SubMaster({"driverState"});
+  s->pm = new PubMaster({"roadCameraState", "wideRoadCameraState", "driverCameraState", "thumbnail"});
 }
 
 void cameras_open(MultiCameraState *s) {}
 
 void cameras_close(MultiCameraState *s) {
   camera_close(&s->road_cam);
+  camera_close(&s->wide_road_cam);
   camera_close(&s->driver_cam);
+  delete s->sm;
   delete s->pm;
 }
 
 void cameras_run(MultiCameraState *s) {
   std::vector<std::thread> threads;
-  threads.push_back(start_process_thread(s, &s->road_cam, process_road_camera));
-  // threads.push_back(start_process_thread(s, &s->driver_cam, process_driver_camera));
-  // threads.push_back(std::thread(driver_camera_thread, &s->driver_cam));
-  road_camera_thread(&s->road_cam);
+  if (s->road_cam.frame) {
+    threads.push_back(start_process_thread(s, &s->road_cam, process_road_camera));
+    threads.push_back(std::thread(camera_thread, &s->road_cam, "replay_road_camera_thread"));
+  }
+  if (s->wide_road_cam.frame) {
+    threads.push_back(start_process_thread(s, &s->wide_road_cam, process_road_camera));
+    threads.push_back(std::thread(camera_thread, &s->wide_road_cam, "replay_wide_road_camera_thread"));
+  }
+  if (s->driver_cam.frame) {
+    threads.push_back(start_process_thread(s, &s->driver_cam, process_driver_camera));
+    threads.push_back(std::thread(camera_thread, &s->driver_cam, "replay_driver_camera_thread"));
+  }
 
   for (auto &t : threads) t.join();
 
@@ -18,6 +18,7 @@ typedef struct CameraState {
 
 typedef struct MultiCameraState {
   CameraState road_cam;
+  CameraState wide_road_cam;
   CameraState driver_cam;
 
   SubMaster *sm = nullptr;
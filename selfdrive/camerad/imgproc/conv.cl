@@ -1,110 +1,101 @@
 // const __constant float3 rgb_weights = (0.299, 0.587, 0.114); // opencv rgb2gray weights
 // const __constant float3 bgr_weights = (0.114, 0.587, 0.299); // bgr2gray weights
 
-// convert input rgb image to single channel then conv
+// convert one roi of the input rgb frame to single channel then conv
 __kernel void rgb2gray_conv2d(
   const __global uchar * input,
   __global short * output,
   __constant short * filter,
-  __local uchar3 * cached
+  const int roi_x,
+  const int roi_y
 )
 {
-  const int rowOffset = get_global_id(1) * IMAGE_W;
-  const int my = get_global_id(0) + rowOffset;
-
-  const int localRowLen = TWICE_HALF_FILTER_SIZE + get_local_size(0);
-  const int localRowOffset = ( get_local_id(1) + HALF_FILTER_SIZE ) * localRowLen;
-  const int myLocal = localRowOffset + get_local_id(0) + HALF_FILTER_SIZE;
-
-  // cache local pixels
-  cached[ myLocal ].x = input[ my * 3 ]; // r
-  cached[ myLocal ].y = input[ my * 3 + 1]; // g
-  cached[ myLocal ].z = input[ my * 3 + 2]; // b
+  const int gx = get_global_id(0);
+  const int gy = get_global_id(1);
+  const int my = gy * IMAGE_W + gx;
 
   // pad
-  if (
-    get_global_id(0) < HALF_FILTER_SIZE       ||
-    get_global_id(0) > IMAGE_W - HALF_FILTER_SIZE - 1   ||
-    get_global_id(1) < HALF_FILTER_SIZE     ||
-    get_global_id(1) > IMAGE_H - HALF_FILTER_SIZE - 1
-  )
-  {
-    barrier(CLK_LOCAL_MEM_FENCE);
+  if (gx < HALF_FILTER_SIZE || gx > IMAGE_W - HALF_FILTER_SIZE - 1 ||
+      gy < HALF_FILTER_SIZE || gy > IMAGE_H - HALF_FILTER_SIZE - 1) {
+    output[my] = 0;
     return;
   }
-  else
-  {
-    int localColOffset = -1;
-    int globalColOffset = -1;
 
-    // cache extra
-    if ( get_local_id(0) < HALF_FILTER_SIZE )
-    {
-      localColOffset = get_local_id(0);
-      globalColOffset = -HALF_FILTER_SIZE;
+  // perform convolution
+  int fIndex = 0;
+  short sum = 0;
 
-      cached[ localRowOffset + get_local_id(0) ].x = input[ my * 3 - HALF_FILTER_SIZE * 3 ];
-      cached[ localRowOffset + get_local_id(0) ].y = input[ my * 3 - HALF_FILTER_SIZE * 3 + 1];
-      cached[ localRowOffset + get_local_id(0) ].z = input[ my * 3 - HALF_FILTER_SIZE * 3 + 2];
-    }
-    else if ( get_local_id(0) >= get_local_size(0) - HALF_FILTER_SIZE )
+  for (int r = -HALF_FILTER_SIZE; r <= HALF_FILTER_SIZE; r++)
+  {
+    const __global uchar * row = input + (roi_y + gy + r) * RGB_STRIDE + (roi_x + gx) * 3;
+    for (int c = -HALF_FILTER_SIZE; c <= HALF_FILTER_SIZE; c++, fIndex++)
     {
-      localColOffset = get_local_id(0) + TWICE_HALF_FILTER_SIZE;
-      globalColOffset = HALF_FILTER_SIZE;
-
-      cached[ myLocal + HALF_FILTER_SIZE ].x = input[ my * 3 + HALF_FILTER_SIZE * 3 ];
-      cached[ myLocal + HALF_FILTER_SIZE ].y = input[ my * 3 + HALF_FILTER_SIZE * 3 + 1];
-      cached[ myLocal + HALF_FILTER_SIZE ].z = input[ my * 3 + HALF_FILTER_SIZE * 3 + 2];
+      uchar3 px = vload3(c, row);
+      if (!FLIP_RB){
+        // sum += dot(rgb_weights, px) * filter[ fIndex ];
+        sum += (px.x / 3 + px.y / 2 + px.z / 9) * filter[ fIndex ];
+      } else {
+        // sum += dot(bgr_weights, px) * filter[ fIndex ];
+        sum += (px.x / 9 + px.y / 2 + px.z / 3) * filter[ fIndex ];
+      }
     }
+  }
+  output[my] = sum;
+}
 
+// score of one roi: 5 * variance + max of the laplacian, reduced by a single work group
+__kernel void var_reduce(
+  const __global short * input,
+  __global ushort * scores,
+  const int roi_id,
+  __local int * sums,
+  __local short * maxs
+)
+{
+  const int size = IMAGE_W * IMAGE_H;
+  const int lid = get_local_id(0);
+  const int lsize = get_local_size(0);
 
-    if ( get_local_id(1) < HALF_FILTER_SIZE )
-    {
-      cached[ get_local_id(1) * localRowLen + get_local_id(0) + HALF_FILTER_SIZE ].x = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 ];
-      cached[ get_local_id(1) * localRowLen + get_local_id(0) + HALF_FILTER_SIZE ].y = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 + 1];
-      cached[ get_local_id(1) * localRowLen + get_local_id(0) + HALF_FILTER_SIZE ].z = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 + 2];
-      if (localColOffset > 0)
-      {
-        cached[ get_local_id(1) * localRowLen + localColOffset ].x = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3];
-        cached[ get_local_id(1) * localRowLen + localColOffset ].y = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3 + 1];
-        cached[ get_local_id(1) * localRowLen + localColOffset ].z = input[ my * 3 - HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3 + 2];
-      }
-    }
-    else if ( get_local_id(1) >= get_local_size(1) -HALF_FILTER_SIZE )
-    {
-      int offset = ( get_local_id(1) + TWICE_HALF_FILTER_SIZE ) * localRowLen;
-      cached[ offset + get_local_id(0) + HALF_FILTER_SIZE ].x = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 ];
-      cached[ offset + get_local_id(0) + HALF_FILTER_SIZE ].y = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 + 1];
-      cached[ offset + get_local_id(0) + HALF_FILTER_SIZE ].z = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 + 2];
-      if (localColOffset > 0)
-      {
-        cached[ offset + localColOffset ].x = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3];
-        cached[ offset + localColOffset ].y = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3 + 1];
-        cached[ offset + localColOffset ].z = input[ my * 3 + HALF_FILTER_SIZE_IMAGE_W * 3 + globalColOffset * 3 + 2];
-      }
-    }
+  int sum = 0;
+  short mx = 0;
+  for (int i = lid; i < size; i += lsize) {
+    const short v = input[i];
+    sum += v;
+    mx = max(mx, v);
+  }
+  sums[lid] = sum;
+  maxs[lid] = mx;
+  barrier(CLK_LOCAL_MEM_FENCE);
 
-    // sync
+  for (int s = lsize / 2; s > 0; s >>= 1) {
+    if (lid < s) {
+      sums[lid] += sums[lid + s];
+      maxs[lid] = max(maxs[lid], maxs[lid + s]);
+    }
     barrier(CLK_LOCAL_MEM_FENCE);
+  }
 
-    // perform convolution
-    int fIndex = 0;
-    short sum = 0;
+  const short mean = sums[0] / size;
+  const short roi_max = maxs[0];
+  barrier(CLK_LOCAL_MEM_FENCE);
 
-    for (int r = -HALF_FILTER_SIZE; r <= HALF_FILTER_SIZE; r++)
-    {
-      int curRow = r * localRowLen;
-      for (int c = -HALF_FILTER_SIZE; c <= HALF_FILTER_SIZE; c++, fIndex++)
-      {
-        if (!FLIP_RB){
-          // sum += dot(rgb_weights, cached[ myLocal + curRow + c ]) * filter[ fIndex ];
-          sum += (cached[ myLocal + curRow + c ].x / 3 + cached[ myLocal + curRow + c ].y / 2 + cached[ myLocal + curRow + c ].z / 9) * filter[ fIndex ];
-        } else {
-          // sum += dot(bgr_weights, cached[ myLocal + curRow + c ]) * filter[ fIndex ];
-          sum += (cached[ myLocal + curRow + c ].x / 9 + cached[ myLocal + curRow + c ].y / 2 + cached[ myLocal + curRow + c ].z / 3) * filter[ fIndex ];
-        }
-      }
+  int var = 0;
+  for (int i = lid; i < size; i += lsize) {
+    const int d = input[i] - mean;
+    var += d * d;
+  }
+  sums[lid] = var;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (int s = lsize / 2; s > 0; s >>= 1) {
+    if (lid < s) {
+      sums[lid] += sums[lid + s];
     }
-    output[my] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if (lid == 0) {
+    const float fvar = (float)sums[0] / size;
+    scores[roi_id] = convert_ushort_sat(min(5 * fvar + roi_max, 65535.0f));
   }
-}
\ No newline at end of file
+}
@@ -3,37 +3,12 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
-#include <cmath>
 #include <cstring>
 
 const int16_t lapl_conv_krnl[9] = {0, 1, 0,
                                    1, -4, 1,
                                    0, 1, 0};
 
-// calculate score based on laplacians in one area
-uint16_t get_lapmap_one(const int16_t *lap, int x_pitch, int y_pitch) {
-  const int size = x_pitch * y_pitch;
-  // avg and max of roi
-  int16_t max = 0;
-  int sum = 0;
-  for (int i = 0; i < size; ++i) {
-    const int16_t v = lap[i];
-    sum += v;
-    if (v > max) max = v;
-  }
-
-  const int16_t mean = sum / size;
-
-  // var of roi
-  int var = 0;
-  for (int i = 0; i < size; ++i) {
-    var += std::pow(lap[i] - mean, 2);
-  }
-
-  const float fvar = (float)var / size;
-  return std::min(5 * fvar + max, (float)65535);
-}
-
 bool is_blur(const uint16_t *lapmap, const size_t size) {
   float bad_sum = 0;
   for (int i = 0; i < size; i++) {
@@ -44,63 +19,74 @@ bool is_blur(const uint16_t *lapmap, const size_t size) {
   return (bad_sum > LM_PREC_THRESH);
 }
 
-static cl_program build_conv_program(cl_device_id device_id, cl_context context, int image_w, int image_h, int filter_size) {
+static cl_program build_conv_program(cl_device_id device_id, cl_context context, int image_w, int image_h, int rgb_stride, int filter_size) {
   char args[4096];
   snprintf(args, sizeof(args),
           "-cl-fast-relaxed-math -cl-denorms-are-zero "
-          "-DIMAGE_W=%d -DIMAGE_H=%d -DFLIP_RB=%d "
-          "-DFILTER_SIZE=%d -DHALF_FILTER_SIZE=%d -DTWICE_HALF_FILTER_SIZE=%d -DHALF_FILTER_SIZE_IMAGE_W=%d",
-          image_w, image_h, 1,
-          filter_size, filter_size/2, (filter_size/2)*2, (filter_size/2)*image_w);
+          "-DIMAGE_W=%d -DIMAGE_H=%d -DRGB_STRIDE=%d -DFLIP_RB=%d "
+          "-DFILTER_SIZE=%d -DHALF_FILTER_SIZE=%d",
+          image_w, image_h, rgb_stride, 1,
+          filter_size, filter_size/2);
   return cl_program_from_file(context, device_id, "imgproc/conv.cl", args);
 }
 
-LapConv::LapConv(cl_device_id device_id, cl_context ctx, int rgb_width, int rgb_height, int filter_size)
-    : width(rgb_width / NUM_SEGMENTS_X), height(rgb_height / NUM_SEGMENTS_Y), 
-      roi_buf(width * height * 3), result_buf(width * height) {
+LapConv::LapConv(cl_device_id device_id, cl_context ctx, int rgb_width, int rgb_height, int rgb_stride, int filter_size)
+    : width(rgb_width / NUM_SEGMENTS_X), height(rgb_height / NUM_SEGMENTS_Y) {
+  std::fill_n(scores, NUM_ROIS, 0);
 
-  prg = build_conv_program(device_id, ctx, width, height, filter_size);
-  krnl = CL_CHECK_ERR(clCreateKernel(prg, "rgb2gray_conv2d", &err));
-  // TODO: Removed CL_MEM_SVM_FINE_GRAIN_BUFFER, confirm it doesn't matter
-  roi_cl = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_WRITE, roi_buf.size() * sizeof(roi_buf[0]), NULL, &err));
-  result_cl = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_WRITE, result_buf.size() * sizeof(result_buf[0]), NULL, &err));
+  prg = build_conv_program(device_id, ctx, width, height, rgb_stride, filter_size);
+  krnl_conv = CL_CHECK_ERR(clCreateKernel(prg, "rgb2gray_conv2d", &err));
+  krnl_var = CL_CHECK_ERR(clCreateKernel(prg, "var_reduce", &err));
+  result_cl = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_WRITE, width * height * sizeof(int16_t), NULL, &err));
   filter_cl = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
                                           9 * sizeof(int16_t), (void *)&lapl_conv_krnl, &err));
+  score_cl = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(scores), scores, &err));
 }
 
 LapConv::~LapConv() {
-  CL_CHECK(clReleaseMemObject(roi_cl));
+  if (read_event) {
+    CL_CHECK(clWaitForEvents(1, &read_event));
+    CL_CHECK(clReleaseEvent(read_event));
+  }
   CL_CHECK(clReleaseMemObject(result_cl));
   CL_CHECK(clReleaseMemObject(filter_cl));
-  CL_CHECK(clReleaseKernel(krnl));
+  CL_CHECK(clReleaseMemObject(score_cl));
+  CL_CHECK(clReleaseKernel(krnl_conv));
+  CL_CHECK(clReleaseKernel(krnl_var));
   CL_CHECK(clReleaseProgram(prg));
 }
 
-uint16_t LapConv::Update(cl_command_queue q, const uint8_t *rgb_buf, const int roi_id) {
-  // sharpness scores
-  const int x_offset = ROI_X_MIN + roi_id % (ROI_X_MAX - ROI_X_MIN + 1);
-  const int y_offset = ROI_Y_MIN + roi_id / (ROI_X_MAX - ROI_X_MIN + 1);
-
-  const uint8_t *rgb_offset = rgb_buf + y_offset * height * FULL_STRIDE_X * 3 + x_offset * width * 3;
-  for (int i = 0; i < height; ++i) {
-    memcpy(&roi_buf[i * width * 3], &rgb_offset[i * FULL_STRIDE_X * 3], width * 3);
+void LapConv::Update(cl_command_queue q, cl_mem rgb_cl, const int roi_id, uint16_t *lapres) {
+  // the readback queued last frame has finished long ago on the in-order queue, so this doesn't stall
+  if (read_event) {
+    CL_CHECK(clWaitForEvents(1, &read_event));
+    CL_CHECK(clReleaseEvent(read_event));
+    read_event = nullptr;
+    // only the roi computed last frame was read back, the others keep their score
+    lapres[last_roi_id] = scores[last_roi_id];
   }
 
-  constexpr int local_mem_size = (CONV_LOCAL_WORKSIZE + 2 * (3 / 2)) * (CONV_LOCAL_WORKSIZE + 2 * (3 / 2)) * (3 * sizeof(uint8_t));
-  const size_t global_work_size[] = {(size_t)width, (size_t)height};
-  const size_t local_work_size[] = {CONV_LOCAL_WORKSIZE, CONV_LOCAL_WORKSIZE};
-
-  CL_CHECK(clEnqueueWriteBuffer(q, roi_cl, CL_TRUE, 0, roi_buf.size() * sizeof(roi_buf[0]), roi_buf.data(), 0, 0, 0));
-  CL_CHECK(clSetKernelArg(krnl, 0, sizeof(cl_mem), (void *)&roi_cl));
-  CL_CHECK(clSetKernelArg(krnl, 1, sizeof(cl_mem), (void *)&result_cl));
-  CL_CHECK(clSetKernelArg(krnl, 2, sizeof(cl_mem), (void *)&filter_cl));
-  CL_CHECK(clSetKernelArg(krnl, 3, local_mem_size, 0));
-  cl_event conv_event;
-  CL_CHECK(clEnqueueNDRangeKernel(q, krnl, 2, NULL, global_work_size, local_work_size, 0, 0, &conv_event));
-  CL_CHECK(clWaitForEvents(1, &conv_event));
-  CL_CHECK(clReleaseEvent(conv_event));
-  CL_CHECK(clEnqueueReadBuffer(q, result_cl, CL_TRUE, 0,
-                               result_buf.size() * sizeof(result_buf[0]), result_buf.data(), 0, 0, 0));
-
-  return get_lapmap_one(result_buf.data(), width, height);
+  // sharpness scores, the roi is cropped by the kernel straight from the full rgb frame
+  const int x_offset = (ROI_X_MIN + roi_id % (ROI_X_MAX - ROI_X_MIN + 1)) * width;
+  const int y_offset = (ROI_Y_MIN + roi_id / (ROI_X_MAX - ROI_X_MIN + 1)) * height;
+
+  const size_t conv_work_size[] = {(size_t)width, (size_t)height};
+  CL_CHECK(clSetKernelArg(krnl_conv, 0, sizeof(cl_mem), (void *)&rgb_cl));
+  CL_CHECK(clSetKernelArg(krnl_conv, 1, sizeof(cl_mem), (void *)&result_cl));
+  CL_CHECK(clSetKernelArg(krnl_conv, 2, sizeof(cl_mem), (void *)&filter_cl));
+  CL_CHECK(clSetKernelArg(krnl_conv, 3, sizeof(int), (void *)&x_offset));
+  CL_CHECK(clSetKernelArg(krnl_conv, 4, sizeof(int), (void *)&y_offset));
+  CL_CHECK(clEnqueueNDRangeKernel(q, krnl_conv, 2, NULL, conv_work_size, NULL, 0, 0, NULL));
+
+  const size_t var_work_size = VAR_LOCAL_WORKSIZE;
+  CL_CHECK(clSetKernelArg(krnl_var, 0, sizeof(cl_mem), (void *)&result_cl));
+  CL_CHECK(clSetKernelArg(krnl_var, 1, sizeof(cl_mem), (void *)&score_cl));
+  CL_CHECK(clSetKernelArg(krnl_var, 2, sizeof(int), (void *)&roi_id));
+  CL_CHECK(clSetKernelArg(krnl_var, 3, VAR_LOCAL_WORKSIZE * sizeof(int), NULL));
+  CL_CHECK(clSetKernelArg(krnl_var, 4, VAR_LOCAL_WORKSIZE * sizeof(short), NULL));
+  CL_CHECK(clEnqueueNDRangeKernel(q, krnl_var, 1, NULL, &var_work_size, &var_work_size, 0, 0, NULL));
+
+  CL_CHECK(clEnqueueReadBuffer(q, score_cl, CL_FALSE, roi_id * sizeof(scores[0]), sizeof(scores[0]), &scores[roi_id], 0, 0, &read_event));
+  last_roi_id = roi_id;
+  CL_CHECK(clFlush(q));
 }
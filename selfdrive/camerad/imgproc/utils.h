@@ -2,7 +2,6 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <vector>
 
 #include "selfdrive/common/clutil.h"
 
@@ -21,21 +20,26 @@
 #define FULL_STRIDE_X 1280
 #define FULL_STRIDE_Y 896
 
-#define CONV_LOCAL_WORKSIZE 16
+#define VAR_LOCAL_WORKSIZE 256
 
+#define NUM_ROIS ((ROI_X_MAX - ROI_X_MIN + 1) * (ROI_Y_MAX - ROI_Y_MIN + 1))
+
+// Laplacian sharpness of one rolling roi per frame, computed entirely on the GPU.
+// Scores are read back asynchronously and become visible to the caller one frame late.
 class LapConv {
 public:
-  LapConv(cl_device_id device_id, cl_context ctx, int rgb_width, int rgb_height, int filter_size);
+  LapConv(cl_device_id device_id, cl_context ctx, int rgb_width, int rgb_height, int rgb_stride, int filter_size);
   ~LapConv();
-  uint16_t Update(cl_command_queue q, const uint8_t *rgb_buf, const int roi_id);
+  void Update(cl_command_queue q, cl_mem rgb_cl, const int roi_id, uint16_t *lapres);
 
 private:
-  cl_mem roi_cl, result_cl, filter_cl;
+  cl_mem result_cl, filter_cl, score_cl;
   cl_program prg;
-  cl_kernel krnl;
+  cl_kernel krnl_conv, krnl_var;
   const int width, height;
-  std::vector<uint8_t> roi_buf;
-  std::vector<int16_t> result_buf;
+  cl_event read_event = nullptr;
+  int last_roi_id = 0;
+  uint16_t scores[NUM_ROIS];
 };
 
 bool is_blur(const uint16_t *lapmap, const size_t size);
@@ -6,7 +6,9 @@ class Rgb2Yuv {
 public:
   Rgb2Yuv(cl_context ctx, cl_device_id device_id, int width, int height, int rgb_stride);
   ~Rgb2Yuv();
-  void queue(cl_command_queue q, cl_mem rgb_cl, cl_mem yuv_cl);
+  // blocks until the conversion is done unless an out event is requested
+  void queue(cl_command_queue q, cl_mem rgb_cl, cl_mem yuv_cl,
+             cl_uint num_wait_events = 0, const cl_event *wait_events = nullptr, cl_event *event = nullptr);
 private:
   size_t work_size[2];
   cl_kernel krnl;
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "selfdrive/common/util.h"
+#include "selfdrive/hardware/hw.h"
 
 namespace {  // helper functions
 
@@ -56,6 +57,60 @@ void cl_print_build_errors(cl_program program, cl_device_id device) {
   std::cout << "build failed; status=" << status << ", log:" << std::endl << log << std::endl; 
 }
 
+// 64-bit FNV-1a, stable across builds unlike std::hash
+uint64_t fnv1a_hash(const std::string &data, uint64_t hash = 0xcbf29ce484222325ULL) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// cache entries are keyed on everything that can change the compiled binary
+std::string cl_cache_path(cl_device_id device_id, const char *path, const std::string &src, const char *args) {
+  uint64_t hash = fnv1a_hash(get_device_info(device_id, CL_DEVICE_NAME));
+  hash = fnv1a_hash(get_device_info(device_id, CL_DEVICE_VERSION), hash);
+  hash = fnv1a_hash(get_device_info(device_id, CL_DRIVER_VERSION), hash);
+  hash = fnv1a_hash(src, hash);
+  hash = fnv1a_hash(args ? args : "", hash);
+  return util::string_format("%s/%s_%016llx.bin", Path::cl_cache().c_str(), util::base_name(path).c_str(), (unsigned long long)hash);
+}
+
+cl_program cl_program_from_binary(cl_context ctx, cl_device_id device_id, const std::string &binary, const char *args) {
+  const size_t size = binary.size();
+  const unsigned char *data = (const unsigned char *)binary.data();
+  cl_int binary_status = CL_INVALID_BINARY, err = CL_INVALID_BINARY;
+  cl_program prg = clCreateProgramWithBinary(ctx, 1, &device_id, &size, &data, &binary_status, &err);
+  if (!prg) return nullptr;
+
+  if (err != CL_SUCCESS || binary_status != CL_SUCCESS || clBuildProgram(prg, 1, &device_id, args, NULL, NULL) != CL_SUCCESS) {
+    clReleaseProgram(prg);
+    return nullptr;
+  }
+  return prg;
+}
+
+void cl_write_program_binary(cl_program prg, const std::string &cache_path) {
+  size_t size = 0;
+  if (clGetProgramInfo(prg, CL_PROGRAM_BINARY_SIZES, sizeof(size), &size, NULL) != CL_SUCCESS || size == 0) return;
+
+  std::string binary(size, '\0');
+  unsigned char *data = (unsigned char *)binary.data();
+  if (clGetProgramInfo(prg, CL_PROGRAM_BINARIES, sizeof(data), &data, NULL) != CL_SUCCESS) return;
+
+  if (!util::create_directories(util::dir_name(cache_path), 0775)) {
+    std::cout << "failed to create cl cache dir for " << cache_path << std::endl;
+    return;
+  }
+
+  // several daemons may compile the same program at once, so write to a unique file and rename over
+  std::string tmp_path = util::string_format("%s.%d.tmp", cache_path.c_str(), getpid());
+  if (util::write_file(tmp_path.c_str(), binary.data(), binary.size(), O_WRONLY | O_CREAT | O_TRUNC) != 0 ||
+      rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+  }
+}
+
 }  // namespace
 
 cl_device_id cl_get_device_id(cl_device_type device_type) {
@@ -80,11 +135,22 @@ cl_device_id cl_get_device_id(cl_device_type device_type) {
 cl_program cl_program_from_file(cl_context ctx, cl_device_id device_id, const char* path, const char* args) {
   std::string src = util::read_file(path);
   assert(src.length() > 0);
+
+  const std::string cache_path = cl_cache_path(device_id, path, src, args);
+  if (std::string binary = util::read_file(cache_path); !binary.empty()) {
+    if (cl_program prg = cl_program_from_binary(ctx, device_id, binary, args)) {
+      return prg;
+    }
+    std::cout << "invalid cl cache entry " << cache_path << ", rebuilding from source" << std::endl;
+    unlink(cache_path.c_str());
+  }
+
   cl_program prg = CL_CHECK_ERR(clCreateProgramWithSource(ctx, 1, (const char*[]){src.c_str()}, NULL, &err));
   if (int err = clBuildProgram(prg, 1, &device_id, args, NULL, NULL); err != 0) {
     cl_print_build_errors(prg, device_id);
     assert(0);
   }
+  cl_write_program_binary(prg, cache_path);
   return prg;
 }
 
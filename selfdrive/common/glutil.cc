@@ -0,0 +1,28 @@
+#include "selfdrive/common/glutil.h"
+
+#include <cassert>
+
+GLuint gl_compile_shader(GLenum type, const char *src) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &src, nullptr);
+  glCompileShader(shader);
+  GLint status = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  assert(status);
+  return shader;
+}
+
+GLuint gl_program_from_source(const char *vertex_src, const char *fragment_src) {
+  GLuint vs = gl_compile_shader(GL_VERTEX_SHADER, vertex_src);
+  GLuint fs = gl_compile_shader(GL_FRAGMENT_SHADER, fragment_src);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  GLint status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  assert(status);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  return program;
+}
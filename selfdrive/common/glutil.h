@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef __APPLE__
+  #include <OpenGL/gl3.h>
+#else
+  #include <GLES3/gl3.h>
+#endif
+
+GLuint gl_compile_shader(GLenum type, const char *src);
+// compiles and links a vertex and a fragment shader
+GLuint gl_program_from_source(const char *vertex_src, const char *fragment_src);
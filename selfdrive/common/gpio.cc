@@ -1,10 +1,17 @@
 #include "selfdrive/common/gpio.h"
 
 #include <fcntl.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/gpio.h>
+#endif
+
 #include <cstring>
 
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
 #include "selfdrive/common/util.h"
 
 // We assume that all pins have already been exported on boot,
@@ -30,3 +37,70 @@ int gpio_set(int pin_nr, bool high){
   }
   return util::write_file(pin_val_path, (void*)(high ? "1" : "0"), 1);
 }
+
+#ifdef __linux__
+
+int gpio_event_init(const char *consumer_label, int chip_nr, int pin_nr) {
+  char chip_path[50];
+  snprintf(chip_path, sizeof(chip_path), "/dev/gpiochip%d", chip_nr);
+
+  int chip_fd = HANDLE_EINTR(open(chip_path, O_RDONLY | O_CLOEXEC));
+  if (chip_fd < 0) {
+    LOGE("failed to open %s: %d", chip_path, errno);
+    return -1;
+  }
+
+  struct gpioevent_request req = {};
+  req.lineoffset = pin_nr;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+  req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+  strncpy(req.consumer_label, consumer_label, sizeof(req.consumer_label) - 1);
+
+  int ret = HANDLE_EINTR(ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req));
+  close(chip_fd);
+  if (ret < 0) {
+    LOGE("failed to request events on gpio %d: %d", pin_nr, errno);
+    return -1;
+  }
+  return req.fd;
+}
+
+int gpio_read_events(int fd, uint64_t *timestamp) {
+  // the kernel queues up to 16 events per line
+  struct gpioevent_data events[16];
+  ssize_t len = HANDLE_EINTR(read(fd, events, sizeof(events)));
+  if (len < (ssize_t)sizeof(events[0])) {
+    return -1;
+  }
+
+  // Kernels before 5.7 stamp events with CLOCK_REALTIME, later ones with CLOCK_MONOTONIC,
+  // whichever the timestamp is closer to is converted to the boot clock.
+  const int n = len / sizeof(events[0]);
+  const uint64_t t = events[n - 1].timestamp;
+  const uint64_t boot = nanos_since_boot(), realtime = nanos_since_epoch(), monotonic = nanos_monotonic();
+  if (t > realtime / 2 + monotonic / 2) {
+    *timestamp = t - realtime + boot;
+  } else {
+    *timestamp = t - monotonic + boot;
+  }
+  return n;
+}
+
+#else
+
+#define UNUSED(x) (void)(x)
+
+int gpio_event_init(const char *consumer_label, int chip_nr, int pin_nr) {
+  UNUSED(consumer_label);
+  UNUSED(chip_nr);
+  UNUSED(pin_nr);
+  return -1;
+}
+
+int gpio_read_events(int fd, uint64_t *timestamp) {
+  UNUSED(fd);
+  UNUSED(timestamp);
+  return -1;
+}
+
+#endif
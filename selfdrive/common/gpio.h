@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 // Pin definitions
 #ifdef QCOM2
   #define GPIO_HUB_RST_N        30
@@ -8,6 +10,10 @@
   #define GPIO_UBLOX_PWR_EN     34
   #define GPIO_STM_RST_N        124
   #define GPIO_STM_BOOT0        134
+  #define GPIO_BMX_ACCEL_INT    21
+  #define GPIO_BMX_GYRO_INT     23
+  #define GPIO_LSM_INT          84
+  #define GPIOCHIP_INT          98
 #else
   #define GPIO_HUB_RST_N        0
   #define GPIO_UBLOX_RST_N      0
@@ -15,7 +21,18 @@
   #define GPIO_UBLOX_PWR_EN     0
   #define GPIO_STM_RST_N        0
   #define GPIO_STM_BOOT0        0
+  #define GPIO_BMX_ACCEL_INT    0
+  #define GPIO_BMX_GYRO_INT     0
+  #define GPIO_LSM_INT          0
+  #define GPIOCHIP_INT          0
 #endif
 
 int gpio_init(int pin_nr, bool output);
 int gpio_set(int pin_nr, bool high);
+
+// Requests rising edge events on a line of /dev/gpiochip<chip_nr>, through the GPIO
+// character device. Returns an fd that polls readable when events are pending, or -1.
+int gpio_event_init(const char *consumer_label, int chip_nr, int pin_nr);
+// Reads the pending events of an event fd. Returns how many there were, < 0 on error,
+// and the time of the last one since boot (nanos_since_boot clock) in timestamp.
+int gpio_read_events(int fd, uint64_t *timestamp);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include <sys/types.h>
@@ -8,10 +9,16 @@ class I2CBus {
   private:
     int i2c_fd;
 
+  protected:
+    I2CBus() : i2c_fd(-1) {}  // for buses that aren't backed by a device, e.g. in tests
+
   public:
     I2CBus(uint8_t bus_id);
-    ~I2CBus();
+    virtual ~I2CBus();
 
-    int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len);
-    int set_register(uint8_t device_address, uint register_address, uint8_t data);
+    virtual int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len);
+    virtual int set_register(uint8_t device_address, uint register_address, uint8_t data);
+    // Reads len bytes in one combined transaction, not limited to an SMBus block. Used to
+    // drain sensor FIFOs, whose data register doesn't advance while being read.
+    virtual int read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len);
 };
@@ -0,0 +1,120 @@
+#define CATCH_CONFIG_MAIN
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#include "catch2/catch.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "selfdrive/common/clutil.h"
+#include "selfdrive/common/util.h"
+
+const char *KERNEL_SRC = R"(
+__kernel void add_one(__global int *buf) {
+  buf[get_global_id(0)] += ADD;
+}
+)";
+
+// the cache entries, full paths
+static std::vector<std::string> cache_entries(const std::string &dir) {
+  std::vector<std::string> entries;
+  if (DIR *d = opendir(dir.c_str())) {
+    while (struct dirent *ent = readdir(d)) {
+      std::string name = ent->d_name;
+      if (name.size() > 4 && name.substr(name.size() - 4) == ".bin") {
+        entries.push_back(dir + "/" + name);
+      }
+    }
+    closedir(d);
+  }
+  return entries;
+}
+
+static ino_t inode(const std::string &path) {
+  struct stat st = {};
+  REQUIRE(stat(path.c_str(), &st) == 0);
+  return st.st_ino;
+}
+
+// builds the program and checks that it runs
+static void run_program(cl_context ctx, cl_device_id device_id, const std::string &path, const char *args, int expected) {
+  cl_program prg = cl_program_from_file(ctx, device_id, path.c_str(), args);
+  REQUIRE(prg != nullptr);
+  cl_kernel kernel = CL_CHECK_ERR(clCreateKernel(prg, "add_one", &err));
+  cl_command_queue q = CL_CHECK_ERR(clCreateCommandQueue(ctx, device_id, 0, &err));
+  int value = 1;
+  cl_mem buf = CL_CHECK_ERR(clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(value), &value, &err));
+  CL_CHECK(clSetKernelArg(kernel, 0, sizeof(cl_mem), &buf));
+  const size_t work_size = 1;
+  CL_CHECK(clEnqueueNDRangeKernel(q, kernel, 1, NULL, &work_size, NULL, 0, NULL, NULL));
+  CL_CHECK(clEnqueueReadBuffer(q, buf, CL_TRUE, 0, sizeof(value), &value, 0, NULL, NULL));
+  REQUIRE(value == expected);
+
+  clReleaseMemObject(buf);
+  clReleaseCommandQueue(q);
+  clReleaseKernel(kernel);
+  clReleaseProgram(prg);
+}
+
+TEST_CASE("cl_program_from_file caches program binaries") {
+  char tmp[] = "/tmp/test_clutil_XXXXXX";
+  REQUIRE(mkdtemp(tmp) != nullptr);
+  const std::string dir = tmp, cache_dir = dir + "/cl_cache", src_path = dir + "/add_one.cl";
+  setenv("CL_CACHE", cache_dir.c_str(), 1);
+  REQUIRE(util::write_file(src_path.c_str(), KERNEL_SRC, strlen(KERNEL_SRC), O_WRONLY | O_CREAT | O_TRUNC) == 0);
+
+  cl_device_id device_id = cl_get_device_id(CL_DEVICE_TYPE_DEFAULT);
+  cl_context ctx = CL_CHECK_ERR(clCreateContext(NULL, 1, &device_id, NULL, NULL, &err));
+
+  // a miss builds from source and creates the cache directory and entry
+  run_program(ctx, device_id, src_path, "-DADD=1", 2);
+  auto entries = cache_entries(cache_dir);
+  REQUIRE(entries.size() == 1);
+  const std::string entry = entries[0];
+  const ino_t entry_inode = inode(entry);
+
+  SECTION("hit") {
+    // loaded from the entry, which isn't written again
+    run_program(ctx, device_id, src_path, "-DADD=1", 2);
+    REQUIRE(cache_entries(cache_dir) == entries);
+    REQUIRE(inode(entry) == entry_inode);
+  }
+
+  SECTION("corrupt entry") {
+    // rejected by the driver, rebuilt from source and replaced with a valid binary
+    const std::string garbage = "not a program binary";
+    REQUIRE(util::write_file(entry.c_str(), garbage.data(), garbage.size(), O_WRONLY | O_TRUNC) == 0);
+    run_program(ctx, device_id, src_path, "-DADD=1", 2);
+    REQUIRE(cache_entries(cache_dir) == entries);
+    REQUIRE(util::read_file(entry) != garbage);
+
+    const ino_t rebuilt_inode = inode(entry);
+    run_program(ctx, device_id, src_path, "-DADD=1", 2);
+    REQUIRE(inode(entry) == rebuilt_inode);
+  }
+
+  SECTION("rebuild") {
+    // other build options or source are another entry, the old one stays
+    run_program(ctx, device_id, src_path, "-DADD=2", 3);
+    REQUIRE(cache_entries(cache_dir).size() == 2);
+
+    const std::string src = std::string(KERNEL_SRC) + "\n// changed\n";
+    REQUIRE(util::write_file(src_path.c_str(), src.data(), src.size(), O_WRONLY | O_TRUNC) == 0);
+    run_program(ctx, device_id, src_path, "-DADD=1", 2);
+    REQUIRE(cache_entries(cache_dir).size() == 3);
+    REQUIRE(inode(entry) == entry_inode);
+  }
+
+  clReleaseContext(ctx);
+  for (const auto &path : cache_entries(cache_dir)) unlink(path.c_str());
+  rmdir(cache_dir.c_str());
+  unlink(src_path.c_str());
+  rmdir(dir.c_str());
+  unsetenv("CL_CACHE");
+}
@@ -0,0 +1,223 @@
+#include "radar_cluster.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <limits>
+
+RadarClusterer::RadarClusterer(double dist) : dist(dist), dist_sq(dist * dist) {
+  assert(dist > 0);
+}
+
+inline double RadarClusterer::distance(int i, int j) const {
+  const double *a = this->clusters[i].c, *b = this->clusters[j].c;
+  return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+}
+
+void RadarClusterer::update_nn(int i) {
+  Cluster &ci = this->clusters[i];
+  ci.nn = -1;
+  ci.nn_dist = std::numeric_limits<double>::infinity();
+  const int first = std::max(ci.cell - 1, 0), last = std::min(ci.cell + 1, this->n_cells - 1);
+  for (int cell = first; cell <= last; cell++) {
+    for (int j : this->cells[cell]) {
+      if (j == i) continue;
+      const double d = this->distance(i, j);
+      if (d < ci.nn_dist || (d == ci.nn_dist && j < ci.nn)) {
+        ci.nn = j;
+        ci.nn_dist = d;
+      }
+    }
+  }
+}
+
+void RadarClusterer::cell_remove(int cell, int i) {
+  std::vector<int> &c = this->cells[cell];
+  c.erase(std::find(c.begin(), c.end(), i));
+}
+
+int RadarClusterer::find(int i) {
+  while (this->parent[i] != i) {
+    this->parent[i] = this->parent[this->parent[i]];
+    i = this->parent[i];
+  }
+  return i;
+}
+
+int RadarClusterer::update(int n, const uint64_t *track_ids, const double *pts, int *labels, int *cluster_ids) {
+  if (n == 0) {
+    this->prev_cluster_ids.clear();
+    return 0;
+  }
+
+  // Cells along the range axis, as wide as the cutoff so that any pair within the
+  // cutoff is at most one cell apart. Merged centroids stay within the range of the
+  // points, the cell count is bounded by widening the cells for outliers.
+  double d_min = pts[0], d_max = pts[0];
+  for (int i = 1; i < n; i++) {
+    d_min = std::min(d_min, pts[3 * i]);
+    d_max = std::max(d_max, pts[3 * i]);
+  }
+  const int max_cells = 4 * n + 16;
+  const double cell_size = std::max(this->dist, (d_max - d_min) / (max_cells - 1));
+  const int n_cells = std::min(max_cells, (int)((d_max - d_min) / cell_size) + 1);
+  if (this->cells.size() < n_cells) {
+    this->cells.resize(n_cells);
+  }
+  for (int i = 0; i < n_cells; i++) {
+    this->cells[i].clear();
+  }
+  this->n_cells = n_cells;
+  auto cell_of = [&](double d) { return std::min(n_cells - 1, (int)((d - d_min) / cell_size)); };
+
+  // every point starts as its own cluster
+  this->clusters.resize(n);
+  this->parent.resize(n);
+  for (int i = 0; i < n; i++) {
+    Cluster &c = this->clusters[i];
+    std::copy(pts + 3 * i, pts + 3 * i + 3, c.c);
+    c.size = 1;
+    c.cell = cell_of(c.c[0]);
+    this->cells[c.cell].push_back(i);
+    this->parent[i] = i;
+  }
+  for (int i = 0; i < n; i++) {
+    this->update_nn(i);
+  }
+
+  // merge the closest pair of clusters until none is closer than the cutoff
+  while (true) {
+    int a = -1;
+    for (int i = 0; i < n; i++) {
+      if (this->parent[i] == i && this->clusters[i].nn >= 0 && (a < 0 || this->clusters[i].nn_dist < this->clusters[a].nn_dist)) {
+        a = i;
+      }
+    }
+    if (a < 0 || this->clusters[a].nn_dist >= this->dist_sq) break;
+
+    // merge b into a
+    const int b = this->clusters[a].nn;
+    Cluster &ca = this->clusters[a], &cb = this->clusters[b];
+    for (int k = 0; k < 3; k++) {
+      ca.c[k] = (ca.c[k] * ca.size + cb.c[k] * cb.size) / (ca.size + cb.size);
+    }
+    ca.size += cb.size;
+    this->cell_remove(cb.cell, b);
+    this->parent[b] = a;
+
+    const int old_cell = ca.cell, cell = cell_of(ca.c[0]);
+    if (cell != ca.cell) {
+      this->cell_remove(ca.cell, a);
+      this->cells[cell].push_back(a);
+      ca.cell = cell;
+    }
+
+    // Distances to the moved centroid can grow, so clusters that pointed at a or b
+    // search again. Everyone else can only have gotten a closer neighbour in a. All
+    // of them are at most one cell away from a or b.
+    this->update_nn(a);
+    const int first = std::max(std::min({old_cell, cb.cell, cell}) - 1, 0);
+    const int last = std::min(std::max({old_cell, cb.cell, cell}) + 1, n_cells - 1);
+    for (int c = first; c <= last; c++) {
+      for (int k : this->cells[c]) {
+        if (k == a) continue;
+        Cluster &ck = this->clusters[k];
+        if (ck.nn == a || ck.nn == b) {
+          this->update_nn(k);
+        } else if (std::abs(ck.cell - ca.cell) <= 1) {
+          const double d = this->distance(k, a);
+          if (d < ck.nn_dist || (d == ck.nn_dist && a < ck.nn)) {
+            ck.nn = a;
+            ck.nn_dist = d;
+          }
+        }
+      }
+    }
+  }
+
+  // number the clusters in order of first appearance
+  int n_clusters = 0;
+  this->label_of_root.assign(n, -1);
+  for (int i = 0; i < n; i++) {
+    int &label = this->label_of_root[this->find(i)];
+    if (label < 0) {
+      label = n_clusters++;
+    }
+    if (labels) {
+      labels[i] = label;
+    }
+  }
+
+  // Persistent ids: the largest groups of tracks that stayed together claim their
+  // previous id first, clusters without one get a new id.
+  this->votes.clear();
+  for (int i = 0; i < n; i++) {
+    auto it = std::lower_bound(this->prev_cluster_ids.begin(), this->prev_cluster_ids.end(), std::make_pair(track_ids[i], INT_MIN));
+    if (it != this->prev_cluster_ids.end() && it->first == track_ids[i]) {
+      this->votes.push_back({1, this->label_of_root[this->find(i)], it->second});
+    }
+  }
+  std::sort(this->votes.begin(), this->votes.end(), [](const Vote &a, const Vote &b) {
+    return a.label != b.label ? a.label < b.label : a.id < b.id;
+  });
+  int merged = 0;
+  for (int i = 0; i < this->votes.size(); i++) {
+    if (merged > 0 && this->votes[merged - 1].label == this->votes[i].label && this->votes[merged - 1].id == this->votes[i].id) {
+      this->votes[merged - 1].count++;
+    } else {
+      this->votes[merged++] = this->votes[i];
+    }
+  }
+  this->votes.resize(merged);
+  std::sort(this->votes.begin(), this->votes.end(), [](const Vote &a, const Vote &b) {
+    return a.count != b.count ? a.count > b.count : (a.label != b.label ? a.label < b.label : a.id < b.id);
+  });
+
+  this->taken_ids.clear();
+  for (const Vote &v : this->votes) {
+    this->taken_ids.push_back(v.id);
+  }
+  std::sort(this->taken_ids.begin(), this->taken_ids.end());
+  this->taken_ids.erase(std::unique(this->taken_ids.begin(), this->taken_ids.end()), this->taken_ids.end());
+  this->taken.assign(this->taken_ids.size(), false);
+
+  this->label_ids.assign(n_clusters, -1);
+  for (const Vote &v : this->votes) {
+    const int idx = std::lower_bound(this->taken_ids.begin(), this->taken_ids.end(), v.id) - this->taken_ids.begin();
+    if (this->label_ids[v.label] < 0 && !this->taken[idx]) {
+      this->label_ids[v.label] = v.id;
+      this->taken[idx] = true;
+    }
+  }
+  for (int &id : this->label_ids) {
+    if (id < 0) {
+      id = this->next_id++;
+    }
+  }
+
+  this->prev_cluster_ids.clear();
+  for (int i = 0; i < n; i++) {
+    const int id = this->label_ids[this->label_of_root[this->find(i)]];
+    this->prev_cluster_ids.push_back({track_ids[i], id});
+    if (cluster_ids) {
+      cluster_ids[i] = id;
+    }
+  }
+  std::sort(this->prev_cluster_ids.begin(), this->prev_cluster_ids.end());
+  return n_clusters;
+}
+
+extern "C" {
+  void *radar_clusterer_create(double dist) {
+    return new RadarClusterer(dist);
+  }
+
+  void radar_clusterer_destroy(void *c) {
+    delete (RadarClusterer *)c;
+  }
+
+  int radar_clusterer_update(void *c, int n, const uint64_t *track_ids, const double *pts, int *labels, int *cluster_ids) {
+    return ((RadarClusterer *)c)->update(n, track_ids, pts, labels, cluster_ids);
+  }
+}
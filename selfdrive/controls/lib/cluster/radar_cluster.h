@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Centroid linkage clustering of radar tracks with a distance cutoff, giving the
+// same partition as cluster_points_centroid from fastcluster. Instead of building
+// the full pairwise distance matrix every tick, cluster centroids are bucketed into
+// a grid along the range axis with (at least) the cutoff as cell size, so merge
+// candidates only come from neighbouring cells, and each cluster caches its nearest
+// neighbour between merges. All storage is kept between updates.
+//
+// Clusters get ids that persist across updates: a cluster keeps the id of the
+// previous cluster most of its tracks belonged to.
+class RadarClusterer {
+public:
+  RadarClusterer(double dist);
+
+  // pts holds n keys of 3 doubles, one per track. labels are numbered in order of
+  // first appearance like fastcluster's cutree, cluster_ids are the persistent ids.
+  // Either output may be NULL. Returns the number of clusters.
+  int update(int n, const uint64_t *track_ids, const double *pts, int *labels, int *cluster_ids);
+
+private:
+  struct Cluster {
+    double c[3];  // centroid
+    int size;
+    int cell;
+    int nn;  // nearest neighbour within the neighbouring cells, -1 if none
+    double nn_dist;
+  };
+
+  inline double distance(int i, int j) const;
+  void update_nn(int i);
+  void cell_remove(int cell, int i);
+  int find(int i);
+
+  const double dist, dist_sq;
+
+  std::vector<Cluster> clusters;
+  std::vector<int> parent;  // union find over the points, roots index clusters
+  std::vector<std::vector<int>> cells;  // only the first n_cells are in use, the rest keep their storage
+  int n_cells = 0;
+
+  // persistent ids
+  int next_id = 0;
+  std::vector<std::pair<uint64_t, int>> prev_cluster_ids;  // (track id, cluster id), sorted
+  std::vector<int> taken_ids;
+  std::vector<bool> taken;
+  std::vector<int> label_ids;
+  std::vector<int> label_of_root;
+  struct Vote {
+    int count, label, id;
+  };
+  std::vector<Vote> votes;
+};
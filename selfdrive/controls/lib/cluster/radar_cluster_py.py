@@ -0,0 +1,36 @@
+import os
+import numpy as np
+
+from cffi import FFI
+from common.ffi_wrapper import suffix
+
+cluster_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)))
+cluster_fn = os.path.join(cluster_dir, "libradar_cluster"+suffix())
+
+ffi = FFI()
+ffi.cdef("""
+void *radar_clusterer_create(double dist);
+void radar_clusterer_destroy(void *c);
+int radar_clusterer_update(void *c, int n, const uint64_t *track_ids, const double *pts, int *labels, int *cluster_ids);
+""")
+
+libcluster = ffi.dlopen(cluster_fn)
+
+
+class RadarClusterer():
+  def __init__(self, dist):
+    self.c = ffi.gc(libcluster.radar_clusterer_create(dist), libcluster.radar_clusterer_destroy)
+
+  def update(self, track_ids, pts):
+    """Clusters the (n, 3) pts of the given tracks. Returns the per track labels, numbered
+    like cluster_points_centroid, and cluster ids that persist across updates."""
+    track_ids = np.ascontiguousarray(track_ids, dtype=np.uint64)
+    pts = np.ascontiguousarray(pts, dtype=np.float64).reshape(-1, 3)
+    n = len(track_ids)
+    assert pts.shape[0] == n
+
+    labels = np.empty(n, dtype=np.int32)
+    cluster_ids = np.empty(n, dtype=np.int32)
+    libcluster.radar_clusterer_update(self.c, n, ffi.cast("uint64_t *", track_ids.ctypes.data), ffi.cast("double *", pts.ctypes.data),
+                                      ffi.cast("int *", labels.ctypes.data), ffi.cast("int *", cluster_ids.ctypes.data))
+    return list(labels), list(cluster_ids)
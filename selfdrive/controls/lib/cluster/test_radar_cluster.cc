@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <capnp/serialize.h>
+
+#include "cereal/gen/cpp/log.capnp.h"
+#include "selfdrive/common/util.h"
+#include "selfdrive/controls/lib/cluster/radar_cluster.h"
+
+extern "C" {
+#include "fastcluster.h"
+}
+
+// Checks that RadarClusterer gives the same partition as fastcluster's
+// cluster_points_centroid, on synthetic scenes and, if given a decompressed
+// rlog, on the liveTracks recorded by radard, and that cluster ids follow
+// their tracks across frames. Fails on any mismatch.
+
+const double CLUSTER_DIST = 2.5;
+
+struct Stats {
+  int frames = 0, mismatches = 0;
+  double fastcluster_us = 0, clusterer_us = 0;
+};
+
+static double now_us() {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void compare(RadarClusterer &clusterer, const std::vector<uint64_t> &ids, const std::vector<double> &pts, Stats &stats) {
+  const int n = ids.size();
+  std::vector<int> expected(n, 0), labels(n), cluster_ids(n);
+
+  double start = now_us();
+  if (n > 1) {
+    // hangs on a single point, radard special cases it
+    cluster_points_centroid(n, 3, (double *)pts.data(), CLUSTER_DIST * CLUSTER_DIST, expected.data());
+  }
+  stats.fastcluster_us += now_us() - start;
+
+  start = now_us();
+  clusterer.update(n, ids.data(), pts.data(), labels.data(), cluster_ids.data());
+  stats.clusterer_us += now_us() - start;
+
+  stats.frames++;
+  stats.mismatches += labels != expected;
+}
+
+static void report(const char *name, const Stats &stats) {
+  printf("%s: %d frames, %d mismatches, fastcluster %.1f us/frame, clusterer %.1f us/frame\n", name, stats.frames,
+         stats.mismatches, stats.fastcluster_us / std::max(stats.frames, 1), stats.clusterer_us / std::max(stats.frames, 1));
+}
+
+// one radar point of a vehicle
+struct Point {
+  uint64_t id;
+  double d, y, v;
+};
+
+static std::vector<int> cluster(RadarClusterer &clusterer, const std::vector<Point> &points) {
+  std::vector<uint64_t> ids;
+  std::vector<int> cluster_ids(points.size());
+  std::vector<double> pts;
+  for (const Point &p : points) {
+    ids.push_back(p.id);
+    pts.insert(pts.end(), {p.d, p.y, p.v});
+  }
+  clusterer.update(points.size(), ids.data(), pts.data(), nullptr, cluster_ids.data());
+  return cluster_ids;
+}
+
+static void test_cluster_ids() {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> jitter(-0.3, 0.3);
+  RadarClusterer clusterer(CLUSTER_DIST);
+
+  // ten vehicles 10m apart, their points jitter and a point is replaced now and then,
+  // but each vehicle keeps its id and no two share one
+  const int n_vehicles = 10, n_points = 3;
+  std::vector<int> vehicle_ids(n_vehicles, -1);
+  int next_track = n_vehicles * n_points;
+  std::vector<Point> points;
+  for (int i = 0; i < n_vehicles * n_points; i++) {
+    points.push_back({(uint64_t)i, 0, 0, 0});
+  }
+  for (int frame = 0; frame < 100; frame++) {
+    for (int i = 0; i < points.size(); i++) {
+      const int vehicle = i / n_points;
+      points[i].d = 10 + 10 * vehicle + jitter(gen);
+      points[i].y = jitter(gen);
+      points[i].v = -vehicle + jitter(gen);
+    }
+    if (frame % 7 == 0) {
+      points[gen() % points.size()].id = next_track++;
+    }
+
+    std::vector<int> ids = cluster(clusterer, points);
+    for (int i = 0; i < points.size(); i++) {
+      const int vehicle = i / n_points;
+      if (frame == 0 && i % n_points == 0) vehicle_ids[vehicle] = ids[i];
+      assert(ids[i] == vehicle_ids[vehicle]);
+    }
+  }
+  std::vector<int> sorted = vehicle_ids;
+  std::sort(sorted.begin(), sorted.end());
+  assert(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+
+  // a point drifting away from its vehicle gets a new id, the rest keep theirs
+  const int max_id = sorted.back();
+  points = {{100, 50, 0, 0}, {101, 50.5, 0, 0}, {102, 51, 0, 0}};
+  std::vector<int> ids = cluster(clusterer, points);
+  assert(ids[0] == ids[1] && ids[1] == ids[2] && ids[0] > max_id);
+  const int vehicle_id = ids[0];
+  points[2].d = 60;
+  ids = cluster(clusterer, points);
+  assert(ids[0] == vehicle_id && ids[1] == vehicle_id && ids[2] > vehicle_id);
+
+  // when it joins a larger vehicle, that one's id wins
+  const int single_id = ids[2];
+  points.push_back({103, 80, 0, 0});
+  points.push_back({104, 80.5, 0, 0});
+  points.push_back({105, 81, 0, 0});
+  ids = cluster(clusterer, points);
+  assert(ids[2] == single_id && ids[3] == ids[4] && ids[4] == ids[5] && ids[3] != single_id);
+  const int larger_id = ids[3];
+  points[2].d = 80.25;
+  ids = cluster(clusterer, points);
+  assert(ids[2] == larger_id && ids[3] == larger_id && ids[0] == vehicle_id);
+
+  // track ids are 64 bit, one that only matches in the low bits is a new track
+  points = {{(1ULL << 32) + 7, 20, 0, 0}};
+  const int wide_id = cluster(clusterer, points)[0];
+  points = {{7, 200, 0, 0}};
+  assert(cluster(clusterer, points)[0] != wide_id);
+}
+
+int main(int argc, char *argv[]) {
+  int mismatches = 0;
+
+  // known answer from test.cpp
+  {
+    double pts[] = {59.26000137, -9.35999966, -5.42500019, 91.61999817, -0.31999999, -2.75,
+                    31.38000031, 0.40000001, -0.2, 89.57999725, -8.07999992, -18.04999924,
+                    53.42000122, 0.63999999, -0.175, 31.38000031, 0.47999999, -0.2,
+                    36.33999939, 0.16, -0.2, 53.33999939, 0.95999998, -0.175,
+                    59.26000137, -9.76000023, -5.44999981, 33.93999977, 0.40000001, -0.22499999,
+                    106.74000092, -5.76000023, -18.04999924};
+    uint64_t ids[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    int correct_idx[] = {0, 1, 2, 3, 4, 2, 5, 4, 0, 5, 6};
+    int labels[11];
+    RadarClusterer clusterer(CLUSTER_DIST);
+    assert(clusterer.update(11, ids, pts, labels, NULL) == 7);
+    for (int i = 0; i < 11; i++) {
+      assert(labels[i] == correct_idx[i]);
+    }
+  }
+
+  // synthetic scenes, vehicles made of a few radar points drifting between frames
+  {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> d(0, 150), y(-20, 20), v(-20, 5), jitter(-1.5, 1.5);
+    RadarClusterer clusterer(CLUSTER_DIST);
+    Stats stats;
+    for (int scene = 0; scene < 200; scene++) {
+      std::vector<std::array<double, 3>> vehicles(1 + gen() % 30);
+      for (auto &veh : vehicles) veh = {d(gen), y(gen), v(gen)};
+      for (int frame = 0; frame < 50; frame++) {
+        std::vector<uint64_t> ids;
+        std::vector<double> pts;
+        for (int i = 0; i < vehicles.size(); i++) {
+          vehicles[i][0] += 0.05 * vehicles[i][2];
+          for (int p = 0; p < 1 + (i % 3); p++) {
+            ids.push_back(i * 4 + p);
+            pts.insert(pts.end(), {vehicles[i][0] + jitter(gen), vehicles[i][1] + jitter(gen), vehicles[i][2] + 0.2 * jitter(gen)});
+          }
+        }
+        compare(clusterer, ids, pts, stats);
+      }
+    }
+    report("synthetic", stats);
+    mismatches += stats.mismatches;
+  }
+
+  if (argc > 1) {
+    std::string data = util::read_file(argv[1]);
+    kj::ArrayPtr<const capnp::word> words((const capnp::word *)data.data(), data.size() / sizeof(capnp::word));
+    RadarClusterer clusterer(CLUSTER_DIST);
+    Stats stats;
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      words = kj::arrayPtr(reader.getEnd(), words.end());
+      cereal::Event::Reader event = reader.getRoot<cereal::Event>();
+      if (event.which() != cereal::Event::LIVE_TRACKS || event.getLiveTracks().size() == 0) {
+        continue;
+      }
+
+      // same key as Track.get_key_for_cluster
+      std::vector<uint64_t> ids;
+      std::vector<double> pts;
+      for (const auto &track : event.getLiveTracks()) {
+        ids.push_back(track.getTrackId());
+        pts.insert(pts.end(), {track.getDRel(), track.getYRel() * 2, track.getVRel()});
+      }
+      compare(clusterer, ids, pts, stats);
+    }
+    report(argv[1], stats);
+    mismatches += stats.mismatches;
+  }
+
+  test_cluster_ids();
+  return mismatches == 0 ? 0 : 1;
+}
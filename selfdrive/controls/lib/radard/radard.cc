@@ -0,0 +1,430 @@
+#include "selfdrive/controls/lib/radard/radard.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace {
+
+// the longer lead decels, the more likely it will keep decelerating
+const double LEAD_ACCEL_TAU = 1.5;
+// no stationary object flag below this speed
+const double V_EGO_STATIONARY = 4.;
+const double RADAR_TO_CAMERA = 1.52;
+const double CLUSTER_DIST = 2.5;
+
+// same as numpy_fast.interp
+double interp(double x, const std::vector<double> &xp, const std::vector<double> &fp) {
+  const int N = xp.size();
+  int hi = 0;
+  while (hi < N && x > xp[hi]) hi++;
+  const int low = hi - 1;
+  if (hi == N && x > xp[low]) return fp[N - 1];
+  if (hi == 0) return fp[0];
+  return (x - xp[low]) * (fp[hi] - fp[low]) / (xp[hi] - xp[low]) + fp[low];
+}
+
+double laplacian_cdf(double x, double mu, double b) {
+  b = std::max(b, 1e-4);
+  return std::exp(-std::abs(x - mu) / b);
+}
+
+}  // namespace
+
+void RadarD::Tracks::resize(int n) {
+  ids.resize(n);
+  d_rel.resize(n);
+  y_rel.resize(n);
+  v_rel.resize(n);
+  v_lead.resize(n);
+  v_lead_k.resize(n);
+  a_lead_k.resize(n);
+  a_lead_tau.resize(n);
+  cnt.resize(n);
+  measured.resize(n);
+}
+
+RadarD::RadarD(double radar_ts, int delay) : clusterer(CLUSTER_DIST), v_ego_hist(1, 0.), v_ego_hist_len(delay + 1) {
+  // Lead Kalman Filter params, K is precomputed for radar_ts between 0.01s and 0.1s, see KalmanParams
+  assert(radar_ts > .01 && radar_ts < .1);
+  std::vector<double> dts;
+  for (int i = 1; i < 11; i++) {
+    dts.push_back(i * 0.01);
+  }
+  K[0] = interp(radar_ts, dts, {0.12288, 0.14557, 0.16523, 0.18282, 0.19887, 0.21372, 0.22761, 0.24069, 0.2531, 0.26491});
+  K[1] = interp(radar_ts, dts, {0.29666, 0.29331, 0.29043, 0.28787, 0.28555, 0.28342, 0.28144, 0.27958, 0.27783, 0.27617});
+
+  // A = [[1, dt], [0, 1]], C = [1, 0]
+  A_K[0] = 1.0 - K[0] * 1.0;
+  A_K[1] = radar_ts - K[0] * 0.0;
+  A_K[2] = 0.0 - K[1] * 1.0;
+  A_K[3] = 1.0 - K[1] * 0.0;
+}
+
+void RadarD::update_tracks(cereal::RadarData::Reader rr) {
+  auto pts = rr.getPoints();
+
+  // later points overwrite earlier ones with the same track id, like the dict in radard.py
+  this->points.clear();
+  for (int i = 0; i < pts.size(); i++) {
+    this->points.push_back({pts[i].getTrackId(), i});
+  }
+  std::sort(this->points.begin(), this->points.end());
+  int n = 0;
+  for (int i = 0; i < this->points.size(); i++) {
+    if (n > 0 && this->points[n - 1].first == this->points[i].first) {
+      this->points[n - 1] = this->points[i];
+    } else {
+      this->points[n++] = this->points[i];
+    }
+  }
+  this->points.resize(n);
+
+  // Tracks missing from rr are dropped, both lists are sorted by id so existing
+  // tracks are matched in one pass.
+  std::swap(this->tracks, this->prev_tracks);
+  Tracks &t = this->tracks;
+  const Tracks &prev = this->prev_tracks;
+  t.resize(n);
+
+  // align v_ego by a fixed time to align it with the radar measurement
+  const double v_ego_delayed = this->v_ego_hist.front();
+  for (int i = 0, j = 0; i < n; i++) {
+    const uint64_t id = this->points[i].first;
+    auto pt = pts[this->points[i].second];
+    t.ids[i] = id;
+    t.d_rel[i] = pt.getDRel();
+    t.y_rel[i] = pt.getYRel();
+    t.v_rel[i] = pt.getVRel();
+    t.v_lead[i] = t.v_rel[i] + v_ego_delayed;
+    t.measured[i] = pt.getMeasured();
+
+    while (j < prev.size() && prev.ids[j] < id) j++;
+    if (j < prev.size() && prev.ids[j] == id) {
+      t.cnt[i] = prev.cnt[j];
+      t.v_lead_k[i] = prev.v_lead_k[j];
+      t.a_lead_k[i] = prev.a_lead_k[j];
+      t.a_lead_tau[i] = prev.a_lead_tau[j];
+    } else {
+      t.cnt[i] = 0;
+      t.v_lead_k[i] = t.v_lead[i];
+      t.a_lead_k[i] = 0.;
+      t.a_lead_tau[i] = LEAD_ACCEL_TAU;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    if (t.cnt[i] > 0) {
+      const double v = t.v_lead_k[i], a = t.a_lead_k[i];
+      t.v_lead_k[i] = this->A_K[0] * v + this->A_K[1] * a + this->K[0] * t.v_lead[i];
+      t.a_lead_k[i] = this->A_K[2] * v + this->A_K[3] * a + this->K[1] * t.v_lead[i];
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    // learn if constant acceleration
+    t.a_lead_tau[i] = std::abs(t.a_lead_k[i]) < 0.5 ? LEAD_ACCEL_TAU : t.a_lead_tau[i] * 0.9;
+    t.cnt[i]++;
+  }
+}
+
+void RadarD::update_clusters() {
+  Tracks &t = this->tracks;
+  const int n = t.size();
+
+  // weigh y higher since radar is inaccurate in this dimension
+  this->cluster_pts.resize(3 * n);
+  this->labels.resize(n);
+  for (int i = 0; i < n; i++) {
+    this->cluster_pts[3 * i + 0] = t.d_rel[i];
+    this->cluster_pts[3 * i + 1] = t.y_rel[i] * 2;
+    this->cluster_pts[3 * i + 2] = t.v_rel[i];
+  }
+  const int n_clusters = this->clusterer.update(n, t.ids.data(), this->cluster_pts.data(), this->labels.data(), nullptr);
+
+  this->clusters.assign(n_clusters, Cluster{});
+  for (int i = 0; i < n; i++) {
+    Cluster &c = this->clusters[this->labels[i]];
+    c.d_rel += t.d_rel[i];
+    c.y_rel += t.y_rel[i];
+    c.v_rel += t.v_rel[i];
+    c.v_lead += t.v_lead[i];
+    c.v_lead_k += t.v_lead_k[i];
+    c.n++;
+    if (t.cnt[i] > 1) {
+      c.a_lead_k += t.a_lead_k[i];
+      c.a_lead_tau += t.a_lead_tau[i];
+      c.n_old++;
+    }
+    c.measured = c.measured || t.measured[i];
+  }
+  for (Cluster &c : this->clusters) {
+    c.d_rel /= c.n;
+    c.y_rel /= c.n;
+    c.v_rel /= c.n;
+    c.v_lead /= c.n;
+    c.v_lead_k /= c.n;
+    c.a_lead_k = c.n_old > 0 ? c.a_lead_k / c.n_old : 0.;
+    c.a_lead_tau = c.n_old > 0 ? c.a_lead_tau / c.n_old : LEAD_ACCEL_TAU;
+  }
+
+  // if a new point, reset accel to the rest of the cluster
+  for (int i = 0; i < n; i++) {
+    if (t.cnt[i] <= 1) {
+      const Cluster &c = this->clusters[this->labels[i]];
+      t.v_lead_k[i] = t.v_lead[i];
+      t.a_lead_k[i] = c.a_lead_k;
+      t.a_lead_tau[i] = c.a_lead_tau;
+    }
+  }
+}
+
+void RadarD::fill_cluster_lead(cereal::RadarState::LeadData::Builder lead, const Cluster &c, double model_prob) {
+  lead.setDRel(c.d_rel);
+  lead.setYRel(c.y_rel);
+  lead.setVRel(c.v_rel);
+  lead.setVLead(c.v_lead);
+  lead.setVLeadK(c.v_lead_k);
+  lead.setALeadK(c.a_lead_k);
+  lead.setStatus(true);
+  lead.setFcw(model_prob > .9);
+  lead.setModelProb(model_prob);
+  lead.setRadar(true);
+  lead.setALeadTau(c.a_lead_tau);
+}
+
+void RadarD::fill_lead(cereal::RadarState::LeadData::Builder lead, const cereal::ModelDataV2::LeadDataV3::Reader &lead_msg, bool low_speed_override) {
+  const double prob = lead_msg.getProb();
+
+  // match vision point to best statistical cluster match
+  const Cluster *cluster = nullptr;
+  if (this->clusters.size() > 0 && this->ready && prob > .5) {
+    const double offset_vision_dist = lead_msg.getX()[0] - RADAR_TO_CAMERA;
+    const double y = lead_msg.getY()[0], v = lead_msg.getV()[0];
+    double best = -1.;
+    for (const Cluster &c : this->clusters) {
+      // This is isn't exactly right, but good heuristic
+      const double p = laplacian_cdf(c.d_rel, offset_vision_dist, lead_msg.getXStd()[0]) *
+                       laplacian_cdf(c.y_rel, -y, lead_msg.getYStd()[0]) *
+                       laplacian_cdf(c.v_rel + this->v_ego, v, lead_msg.getVStd()[0]);
+      if (p > best) {
+        best = p;
+        cluster = &c;
+      }
+    }
+
+    // stationary radar points can be false positives
+    const bool dist_sane = std::abs(cluster->d_rel - offset_vision_dist) < std::max(offset_vision_dist * .25, 5.0);
+    const bool vel_sane = (std::abs(cluster->v_rel + this->v_ego - v) < 10) || (this->v_ego + cluster->v_rel > 3);
+    if (!dist_sane || !vel_sane) {
+      cluster = nullptr;
+    }
+  }
+
+  bool status = false;
+  double d_rel = 0.;
+  if (cluster != nullptr) {
+    this->fill_cluster_lead(lead, *cluster, prob);
+    status = true;
+    d_rel = cluster->d_rel;
+  } else if (this->ready && prob > .5) {
+    d_rel = lead_msg.getX()[0] - RADAR_TO_CAMERA;
+    lead.setDRel(d_rel);
+    lead.setYRel(-lead_msg.getY()[0]);
+    lead.setVRel(lead_msg.getV()[0] - this->v_ego);
+    lead.setVLead(lead_msg.getV()[0]);
+    lead.setVLeadK(lead_msg.getV()[0]);
+    lead.setALeadK(0);
+    lead.setALeadTau(LEAD_ACCEL_TAU);
+    lead.setFcw(false);
+    lead.setModelProb(prob);
+    lead.setRadar(false);
+    lead.setStatus(true);
+    status = true;
+  }
+
+  if (low_speed_override) {
+    // stop for stuff in front of you and low speed, even without model confirmation
+    const Cluster *closest = nullptr;
+    for (const Cluster &c : this->clusters) {
+      if (std::abs(c.y_rel) < 1.5 && this->v_ego < V_EGO_STATIONARY && c.d_rel < 25 && (closest == nullptr || c.d_rel < closest->d_rel)) {
+        closest = &c;
+      }
+    }
+
+    // Only choose new cluster if it is actually closer than the previous one
+    if (closest != nullptr && (!status || closest->d_rel < d_rel)) {
+      this->fill_cluster_lead(lead, *closest, 0.);
+    }
+  }
+}
+
+void RadarD::update(SubMaster &sm, cereal::RadarData::Reader rr, bool enable_lead, cereal::Event::Builder event) {
+  // SubMaster::update_msgs doesn't clear the updated flags, compare frames instead.
+  // Both are 0 until the first update
+  auto updated = [&sm](const char *name) { return sm.frame > 0 && sm.rcv_frame(name) == sm.frame; };
+  if (updated("carState")) {
+    this->v_ego = sm["carState"].getCarState().getVEgo();
+    this->v_ego_hist.push_back(this->v_ego);
+    if (this->v_ego_hist.size() > this->v_ego_hist_len) {
+      this->v_ego_hist.pop_front();
+    }
+  }
+  if (updated("modelV2")) {
+    this->ready = true;
+  }
+
+  this->update_tracks(rr);
+  this->update_clusters();
+
+  // *** publish radarState ***
+  event.setValid(sm.allAliveAndValid() && rr.getErrors().size() == 0);
+  auto radar_state = event.initRadarState();
+  radar_state.setMdMonoTime(sm["modelV2"].getLogMonoTime());
+  radar_state.setCanMonoTimes(rr.getCanMonoTimes());
+  radar_state.setRadarErrors(rr.getErrors());
+  radar_state.setCarStateMonoTime(sm["carState"].getLogMonoTime());
+
+  if (enable_lead) {
+    auto leads = sm["modelV2"].getModelV2().getLeadsV3();
+    if (leads.size() > 1) {
+      this->fill_lead(radar_state.initLeadOne(), leads[0], true);
+      this->fill_lead(radar_state.initLeadTwo(), leads[1], false);
+    }
+  }
+}
+
+void RadarD::fill_live_tracks(cereal::Event::Builder event) {
+  // trackId is an Int32, tracks with a larger id are left out rather than aliasing another one
+  const Tracks &t = this->tracks;
+  const int n = std::upper_bound(t.ids.begin(), t.ids.end(), (uint64_t)INT32_MAX) - t.ids.begin();
+  auto live_tracks = event.initLiveTracks(n);
+  for (int i = 0; i < n; i++) {
+    live_tracks[i].setTrackId(t.ids[i]);
+    live_tracks[i].setDRel(t.d_rel[i]);
+    live_tracks[i].setYRel(t.y_rel[i]);
+    live_tracks[i].setVRel(t.v_rel[i]);
+  }
+}
+
+// radard.py keeps parsing the radar from CAN with the car's RadarInterface and
+// hands over the serialized car.RadarData, everything else runs here.
+namespace {
+
+struct NativeRadarD {
+  NativeRadarD(double radar_ts, int delay, bool enable_lead, bool replay)
+      : rd(radar_ts, delay), enable_lead(enable_lead), replay(replay), sm({"modelV2", "carState"}) {
+    if (!replay) {
+      pm = std::make_unique<PubMaster>(std::vector<const char *>{"radarState", "liveTracks"});
+    }
+  }
+
+  RadarD rd;
+  const bool enable_lead, replay;
+  SubMaster sm;
+  std::unique_ptr<PubMaster> pm;
+  AlignedBuffer rr_buf;
+
+  // replayed events, kept until the next one of the same service since the SubMaster points into them
+  struct Replayed {
+    kj::Array<capnp::word> words;
+    std::unique_ptr<capnp::FlatArrayMessageReader> reader;
+  };
+  std::map<std::string, Replayed> replayed;
+};
+
+int serialize(MessageBuilder &msg, char *out, size_t out_len) {
+  auto bytes = msg.toBytes();
+  if (bytes.size() > out_len) {
+    return -1;
+  }
+  memcpy(out, bytes.begin(), bytes.size());
+  return bytes.size();
+}
+
+}  // namespace
+
+extern "C" {
+  void *radard_create(double radar_ts, int delay, bool enable_lead, bool replay) {
+    return new NativeRadarD(radar_ts, delay, enable_lead, replay);
+  }
+
+  void radard_destroy(void *p) {
+    delete (NativeRadarD *)p;
+  }
+
+  // Replay only, instead of polling the sockets: events holds serialized Events back to back.
+  void radard_update_msgs(void *p, uint64_t current_time, const char *events, size_t len) {
+    NativeRadarD *r = (NativeRadarD *)p;
+    assert(r->replay);
+
+    kj::Array<capnp::word> buf = kj::heapArray<capnp::word>(len / sizeof(capnp::word));
+    memcpy(buf.begin(), events, buf.size() * sizeof(capnp::word));
+
+    std::vector<std::pair<std::string, cereal::Event::Reader>> messages;
+    kj::ArrayPtr<const capnp::word> words = buf;
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      const capnp::word *end = reader.getEnd();
+      kj::Array<capnp::word> msg = kj::heapArray<capnp::word>(words.begin(), end - words.begin());
+      words = kj::arrayPtr(end, words.end());
+
+      const char *name;
+      switch (reader.getRoot<cereal::Event>().which()) {
+        case cereal::Event::MODEL_V2: name = "modelV2"; break;
+        case cereal::Event::CAR_STATE: name = "carState"; break;
+        default: continue;
+      }
+      NativeRadarD::Replayed &m = r->replayed[name];
+      m.words = kj::mv(msg);
+      m.reader = std::make_unique<capnp::FlatArrayMessageReader>(m.words);
+      messages.push_back({name, m.reader->getRoot<cereal::Event>()});
+    }
+    r->sm.update_msgs(current_time, messages);
+  }
+
+  // Runs radard on a serialized car.RadarData. When live, the SubMaster is polled and
+  // radarState and liveTracks are published, returns 0. When replaying, the serialized
+  // radarState event is written to out, returns its size or -1 if out is too small.
+  int radard_update(void *p, const char *rr_data, size_t rr_len, float cum_lag_ms, char *out, size_t out_len) {
+    NativeRadarD *r = (NativeRadarD *)p;
+    capnp::FlatArrayMessageReader rr_reader(r->rr_buf.align(rr_data, rr_len));
+    cereal::RadarData::Reader rr = rr_reader.getRoot<cereal::RadarData>();
+
+    if (!r->replay) {
+      r->sm.update(0);
+    }
+
+    MessageBuilder msg;
+    auto event = msg.initEvent();
+    r->rd.update(r->sm, rr, r->enable_lead, event);
+    event.getRadarState().setCumLagMs(cum_lag_ms);
+
+    if (!r->replay) {
+      r->pm->send("radarState", msg);
+
+      // *** publish tracks for UI debugging (keep last) ***
+      MessageBuilder tracks_msg;
+      r->rd.fill_live_tracks(tracks_msg.initEvent());
+      r->pm->send("liveTracks", tracks_msg);
+      return 0;
+    }
+
+    return serialize(msg, out, out_len);
+  }
+
+  // Replay only: writes the serialized liveTracks event of the last update to out,
+  // returns its size or -1 if out is too small.
+  int radard_live_tracks(void *p, char *out, size_t out_len) {
+    NativeRadarD *r = (NativeRadarD *)p;
+    assert(r->replay);
+
+    MessageBuilder msg;
+    r->rd.fill_live_tracks(msg.initEvent());
+    return serialize(msg, out, out_len);
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "cereal/messaging/messaging.h"
+#include "selfdrive/controls/lib/cluster/radar_cluster.h"
+
+// Native counterpart of RadarD in radard.py, producing the same radarState.
+// Tracks are kept sorted by track id in flat arrays, so the per track Kalman filter
+// is a loop over contiguous arrays and clusters are plain sums over labels.
+class RadarD {
+public:
+  RadarD(double radar_ts, int delay = 0);
+
+  // Reads carState and modelV2 from sm, updates the tracks from rr and fills event
+  // with radarState, like RadarD.update.
+  void update(SubMaster &sm, cereal::RadarData::Reader rr, bool enable_lead, cereal::Event::Builder event);
+  void fill_live_tracks(cereal::Event::Builder event);
+
+private:
+  struct Tracks {
+    std::vector<uint64_t> ids;
+    std::vector<double> d_rel, y_rel, v_rel, v_lead;
+    std::vector<double> v_lead_k, a_lead_k, a_lead_tau;  // Kalman filter state is (v_lead_k, a_lead_k)
+    std::vector<int> cnt;
+    std::vector<bool> measured;
+
+    void resize(int n);
+    int size() const { return ids.size(); }
+  };
+
+  struct Cluster {
+    double d_rel, y_rel, v_rel, v_lead, v_lead_k, a_lead_k, a_lead_tau;
+    int n, n_old;  // tracks, tracks seen more than once
+    bool measured;
+  };
+
+  void update_tracks(cereal::RadarData::Reader rr);
+  void update_clusters();
+  void fill_lead(cereal::RadarState::LeadData::Builder lead, const cereal::ModelDataV2::LeadDataV3::Reader &lead_msg, bool low_speed_override);
+  void fill_cluster_lead(cereal::RadarState::LeadData::Builder lead, const Cluster &c, double model_prob);
+
+  // KF1D with constant gain, same as KalmanParams and simple_kalman
+  double A_K[4], K[2];
+
+  Tracks tracks, prev_tracks;
+  std::vector<std::pair<uint64_t, int>> points;  // (track id, index in rr), sorted
+  std::vector<double> cluster_pts;
+  std::vector<int> labels;
+  std::vector<Cluster> clusters;
+  RadarClusterer clusterer;
+
+  double v_ego = 0.;
+  std::deque<double> v_ego_hist;
+  size_t v_ego_hist_len;
+  bool ready = false;
+};
@@ -0,0 +1,47 @@
+import os
+
+from cffi import FFI
+from common.ffi_wrapper import suffix
+
+radard_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)))
+radard_fn = os.path.join(radard_dir, "libradard"+suffix())
+
+ffi = FFI()
+ffi.cdef("""
+void *radard_create(double radar_ts, int delay, bool enable_lead, bool replay);
+void radard_destroy(void *p);
+void radard_update_msgs(void *p, uint64_t current_time, const char *events, size_t len);
+int radard_update(void *p, const char *rr, size_t rr_len, float cum_lag_ms, char *out, size_t out_len);
+int radard_live_tracks(void *p, char *out, size_t out_len);
+""")
+
+libradard = ffi.dlopen(radard_fn)
+
+MAX_RADAR_STATE_SIZE = 1 << 16
+
+
+class NativeRadarD():
+  """radard running in C++, fed with the car.RadarData from the RadarInterface. Owns its
+  SubMaster and publishes radarState and liveTracks, unless replay is set. Then the
+  SubMaster is fed with update_msgs and update returns the serialized radarState event."""
+  def __init__(self, radar_ts, delay=0, enable_lead=True, replay=False):
+    self.replay = replay
+    self.rd = ffi.gc(libradard.radard_create(radar_ts, delay, enable_lead, replay), libradard.radard_destroy)
+    self.out = ffi.new("char[]", MAX_RADAR_STATE_SIZE) if replay else ffi.NULL
+
+  def update_msgs(self, cur_time, msgs):
+    events = b"".join(m.as_builder().to_bytes() for m in msgs if m is not None)
+    libradard.radard_update_msgs(self.rd, int(cur_time * 1e9), events, len(events))
+
+  def update(self, rr, cum_lag_ms=0.):
+    rr = rr.to_bytes()
+    ret = libradard.radard_update(self.rd, rr, len(rr), cum_lag_ms, self.out, MAX_RADAR_STATE_SIZE if self.replay else 0)
+    assert ret >= 0
+    return ffi.buffer(self.out, ret)[:] if self.replay else None
+
+  def live_tracks(self):
+    """The serialized liveTracks event of the last update, replay only."""
+    assert self.replay
+    ret = libradard.radard_live_tracks(self.rd, self.out, MAX_RADAR_STATE_SIZE)
+    assert ret >= 0
+    return ffi.buffer(self.out, ret)[:]
@@ -9,8 +9,9 @@ from common.numpy_fast import interp
 from common.params import Params
 from common.realtime import Ratekeeper, Priority, config_realtime_process
 from selfdrive.config import RADAR_TO_CAMERA
-from selfdrive.controls.lib.cluster.fastcluster_py import cluster_points_centroid
+from selfdrive.controls.lib.cluster.radar_cluster_py import RadarClusterer
 from selfdrive.controls.lib.radar_helpers import Cluster, Track
+from selfdrive.controls.lib.radard.radard_py import NativeRadarD
 from selfdrive.swaglog import cloudlog
 from selfdrive.hardware import TICI
 
@@ -91,6 +92,7 @@ class RadarD():
 
     self.tracks = defaultdict(dict)
     self.kalman_params = KalmanParams(radar_ts)
+    self.clusterer = RadarClusterer(2.5)
 
     # v_ego
     self.v_ego = 0.
@@ -131,23 +133,13 @@ class RadarD():
     idens = list(sorted(self.tracks.keys()))
     track_pts = list([self.tracks[iden].get_key_for_cluster() for iden in idens])
 
-    # If we have multiple points, cluster them
-    if len(track_pts) > 1:
-      cluster_idxs = cluster_points_centroid(track_pts, 2.5)
-      clusters = [None] * (max(cluster_idxs) + 1)
-
-      for idx in range(len(track_pts)):
-        cluster_i = cluster_idxs[idx]
-        if clusters[cluster_i] is None:
-          clusters[cluster_i] = Cluster()
-        clusters[cluster_i].add(self.tracks[idens[idx]])
-    elif len(track_pts) == 1:
-      # FIXME: cluster_point_centroid hangs forever if len(track_pts) == 1
-      cluster_idxs = [0]
-      clusters = [Cluster()]
-      clusters[0].add(self.tracks[idens[0]])
-    else:
-      clusters = []
+    cluster_idxs, _ = self.clusterer.update(idens, track_pts)
+    clusters = [None] * (max(cluster_idxs, default=-1) + 1)
+    for idx in range(len(track_pts)):
+      cluster_i = cluster_idxs[idx]
+      if clusters[cluster_i] is None:
+        clusters[cluster_i] = Cluster()
+      clusters[cluster_i].add(self.tracks[idens[idx]])
 
     # if a new point, reset accel to the rest of the cluster
     for idx in range(len(track_pts)):
@@ -185,22 +177,36 @@ def radard_thread(sm=None, pm=None, can_sock=None):
   cloudlog.info("radard is importing %s", CP.carName)
   RadarInterface = importlib.import_module('selfdrive.car.%s.radar_interface' % CP.carName).RadarInterface
 
-  # *** setup messaging
+  # TODO: always log leads once we can hide them conditionally
+  enable_lead = CP.openpilotLongitudinalControl or not CP.radarOffCan
+
+  RI = RadarInterface(CP)
+  rk = Ratekeeper(1.0 / CP.radarTimeStep, print_delay_threshold=None)
+
   if can_sock is None:
     can_sock = messaging.sub_sock('can')
+
+  # the native radard owns its SubMaster and PubMaster, the Python one is kept for injected sockets
+  if sm is None and pm is None:
+    RD = NativeRadarD(CP.radarTimeStep, RI.delay, enable_lead)
+    while 1:
+      can_strings = messaging.drain_sock_raw(can_sock, wait_for_one=True)
+      rr = RI.update(can_strings)
+
+      if rr is None:
+        continue
+
+      RD.update(rr, -rk.remaining*1000.)
+      rk.monitor_time()
+
+  # *** setup messaging
   if sm is None:
     sm = messaging.SubMaster(['modelV2', 'carState'], ignore_avg_freq=['modelV2', 'carState'])  # Can't check average frequency, since radar determines timing
   if pm is None:
     pm = messaging.PubMaster(['radarState', 'liveTracks'])
 
-  RI = RadarInterface(CP)
-
-  rk = Ratekeeper(1.0 / CP.radarTimeStep, print_delay_threshold=None)
   RD = RadarD(CP.radarTimeStep, RI.delay)
 
-  # TODO: always log leads once we can hide them conditionally
-  enable_lead = CP.openpilotLongitudinalControl or not CP.radarOffCan
-
   while 1:
     can_strings = messaging.drain_sock_raw(can_sock, wait_for_one=True)
     rr = RI.update(can_strings)
@@ -30,6 +30,12 @@ inline std::string log_root() {
 inline std::string params() {
   return Hardware::PC() ? HOME + "/.comma/params" : "/data/params";
 }
+inline std::string cl_cache() {
+  if (const char *env = getenv("CL_CACHE")) {
+    return env;
+  }
+  return Hardware::PC() ? HOME + "/.comma/cl_cache" : "/data/cl_cache";
+}
 inline std::string rsa_file() {
   return Hardware::PC() ? HOME + "/.comma/persist/comma/id_rsa" : "/persist/comma/id_rsa";
 }
@@ -197,6 +197,11 @@ VectorXd Localizer::get_stdev() {
 
 void Localizer::handle_sensors(double current_time, const capnp::List<cereal::SensorEventData, capnp::Kind::STRUCT>::Reader& log) {
   // TODO does not yet account for double sensor readings in the log
+  // FIFO batches carry samples taken over several ms, the ones sharing a timestamp go in one joint update
+  std::vector<double> times;
+  std::vector<int> kinds;
+  std::vector<VectorXd> meas;
+
   for (int i = 0; i < log.size(); i++) {
     const cereal::SensorEventData::Reader& sensor_reading = log[i];
 
@@ -210,7 +215,7 @@ void Localizer::handle_sensors(double current_time, const capnp::List<cereal::Se
     // sensor time and log time should be close
     if (std::abs(current_time - sensor_time) > 0.1) {
       LOGE("Sensor reading ignored, sensor timestamp more than 100ms off from log time");
-      return;
+      break;
     }
 
       // TODO: handle messages from two IMUs at the same time
@@ -221,9 +226,11 @@ void Localizer::handle_sensors(double current_time, const capnp::List<cereal::Se
     // Gyro Uncalibrated
     if (sensor_reading.getSensor() == SENSOR_GYRO_UNCALIBRATED && sensor_reading.getType() == SENSOR_TYPE_GYROSCOPE_UNCALIBRATED) {
       auto v = sensor_reading.getGyroUncalibrated().getV();
-      auto meas = Vector3d(-v[2], -v[1], -v[0]);
-      if (meas.norm() < ROTATION_SANITY_CHECK) {
-        this->kf->predict_and_observe(sensor_time, OBSERVATION_PHONE_GYRO, { meas });
+      auto gyro = Vector3d(-v[2], -v[1], -v[0]);
+      if (gyro.norm() < ROTATION_SANITY_CHECK) {
+        times.push_back(sensor_time);
+        kinds.push_back(OBSERVATION_PHONE_GYRO);
+        meas.push_back(gyro);
       }
     }
 
@@ -235,12 +242,18 @@ void Localizer::handle_sensors(double current_time, const capnp::List<cereal::Se
       // 40m/s**2 is a good filter for falling detection, no false positives in 20k minutes of driving
       this->device_fell |= (floatlist2vector(v) - Vector3d(10.0, 0.0, 0.0)).norm() > 40.0;
 
-      auto meas = Vector3d(-v[2], -v[1], -v[0]);
-      if (meas.norm() < ACCEL_SANITY_CHECK) {
-        this->kf->predict_and_observe(sensor_time, OBSERVATION_PHONE_ACCEL, { meas });
+      auto accel = Vector3d(-v[2], -v[1], -v[0]);
+      if (accel.norm() < ACCEL_SANITY_CHECK) {
+        times.push_back(sensor_time);
+        kinds.push_back(OBSERVATION_PHONE_ACCEL);
+        meas.push_back(accel);
       }
     }
   }
+
+  if (!meas.empty()) {
+    this->kf->predict_and_observe_timed(times, kinds, meas);
+  }
 }
 
 void Localizer::handle_gps(double current_time, const cereal::GpsLocationData::Reader& log) {
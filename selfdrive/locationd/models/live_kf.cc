@@ -1,5 +1,8 @@
 #include "live_kf.h"
 
+#include <algorithm>
+#include <numeric>
+
 using namespace EKFS;
 using namespace Eigen;
 
@@ -38,24 +41,22 @@ LiveKalman::LiveKalman() {
     this->obs_noise[pair.first] = pair.second.asDiagonal();
   }
 
-  // init filter
-  this->filter = std::make_shared<EKFSym>(this->name, get_mapmat(this->Q), get_mapvec(this->initial_x),
-    get_mapmat(initial_P),  this->dim_state, this->dim_state_err, 0, 0, 0, std::vector<int>(),
-    std::vector<int>{3}, std::vector<std::string>(), 0.2);
+  // init filter, late sensor samples are rare so only every 4th state is kept for rewinding
+  this->filter = std::make_shared<live_ekf_sym_fixed_t>(this->name, this->Q, this->initial_x, this->initial_P,
+    std::vector<int>{3}, 0.2, 4);
 }
 
 void LiveKalman::init_state(VectorXd& state, VectorXd& covs_diag, double filter_time) {
   MatrixXdr covs = covs_diag.asDiagonal();
-  this->filter->init_state(get_mapvec(state), get_mapmat(covs), filter_time);
+  this->filter->init_state(state, covs, filter_time);
 }
 
 void LiveKalman::init_state(VectorXd& state, MatrixXdr& covs, double filter_time) {
-  this->filter->init_state(get_mapvec(state), get_mapmat(covs), filter_time);
+  this->filter->init_state(state, covs, filter_time);
 }
 
 void LiveKalman::init_state(VectorXd& state, double filter_time) {
-  MatrixXdr covs = this->filter->covs();
-  this->filter->init_state(get_mapvec(state), get_mapmat(covs), filter_time);
+  this->filter->init_state(state, this->filter->covs(), filter_time);
 }
 
 VectorXd LiveKalman::get_x() {
@@ -78,13 +79,65 @@ std::vector<MatrixXdr> LiveKalman::get_R(int kind, int n) {
   return R;
 }
 
-std::optional<Estimate> LiveKalman::predict_and_observe(double t, int kind, std::vector<VectorXd> meas, std::vector<MatrixXdr> R) {
-  std::optional<Estimate> r;
-  if (R.size() == 0) {
-    R = this->get_R(kind, meas.size());
+void LiveKalman::predict_and_observe(double t, int kind, const std::vector<VectorXd> &meas, const std::vector<MatrixXdr> &R) {
+  for (int i = 0; i < meas.size(); i++) {
+    const MatrixXdr &Ri = R.empty() ? this->obs_noise.at(kind) : R[i];
+    assert(meas[i].size() == Ri.rows() && Ri.rows() == Ri.cols());
+    this->filter->predict_and_update(t, kind, meas[i].data(), meas[i].size(), Ri.data());
+  }
+}
+
+void LiveKalman::predict_and_observe_joint(double t, const std::vector<int> &kinds, const std::vector<VectorXd> &meas) {
+  assert(kinds.size() == meas.size());
+  this->joint_dims.clear();
+  this->joint_z.clear();
+  this->joint_R.clear();
+
+  int start = 0, z_dim = 0;
+  for (int i = 0; i <= meas.size(); i++) {
+    // flush when the next observation doesn't fit in one update anymore
+    if (i == meas.size() || z_dim + meas[i].size() > live_ekf_sym_fixed_t::max_joint_zdim) {
+      if (i > start) {
+        this->filter->predict_and_update_joint(t, i - start, &kinds[start], this->joint_dims.data(),
+                                               this->joint_z.data(), this->joint_R.data());
+      }
+      if (i == meas.size()) {
+        break;
+      }
+      this->joint_dims.clear();
+      this->joint_z.clear();
+      this->joint_R.clear();
+      start = i;
+      z_dim = 0;
+    }
+
+    const MatrixXdr &R = this->obs_noise.at(kinds[i]);
+    assert(meas[i].size() == R.rows());
+    this->joint_dims.push_back(meas[i].size());
+    this->joint_z.insert(this->joint_z.end(), meas[i].data(), meas[i].data() + meas[i].size());
+    this->joint_R.insert(this->joint_R.end(), R.data(), R.data() + R.size());
+    z_dim += meas[i].size();
+  }
+}
+
+void LiveKalman::predict_and_observe_timed(const std::vector<double> &times, const std::vector<int> &kinds, const std::vector<VectorXd> &meas) {
+  assert(times.size() == kinds.size() && kinds.size() == meas.size());
+  this->timed_order.resize(times.size());
+  std::iota(this->timed_order.begin(), this->timed_order.end(), 0);
+  std::stable_sort(this->timed_order.begin(), this->timed_order.end(), [&](int a, int b) { return times[a] < times[b]; });
+
+  this->timed_kinds.clear();
+  this->timed_meas.clear();
+  for (int i = 0; i < this->timed_order.size(); i++) {
+    const int idx = this->timed_order[i];
+    this->timed_kinds.push_back(kinds[idx]);
+    this->timed_meas.push_back(meas[idx]);
+    if (i + 1 == this->timed_order.size() || times[this->timed_order[i + 1]] != times[idx]) {
+      this->predict_and_observe_joint(times[idx], this->timed_kinds, this->timed_meas);
+      this->timed_kinds.clear();
+      this->timed_meas.clear();
+    }
   }
-  r = this->filter->predict_and_update_batch(t, kind, get_vec_mapvec(meas), get_vec_mapmat(R));
-  return r;
 }
 
 Eigen::VectorXd LiveKalman::get_initial_x() {
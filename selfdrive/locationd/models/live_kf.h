@@ -7,6 +7,7 @@
 #include <eigen3/Eigen/Core>
 #include <eigen3/Eigen/Dense>
 
+#include "generated/live.h"
 #include "generated/live_kf_constants.h"
 #include "rednose/helpers/ekf_sym.h"
 
@@ -32,7 +33,11 @@ public:
   double get_filter_time();
   std::vector<MatrixXdr> get_R(int kind, int n);
 
-  std::optional<Estimate> predict_and_observe(double t, int kind, std::vector<Eigen::VectorXd> meas, std::vector<MatrixXdr> R = {});
+  void predict_and_observe(double t, int kind, const std::vector<Eigen::VectorXd> &meas, const std::vector<MatrixXdr> &R = {});
+  // observations of possibly different kinds that are close in time, applied in one joint update at t
+  void predict_and_observe_joint(double t, const std::vector<int> &kinds, const std::vector<Eigen::VectorXd> &meas);
+  // observations with their own sample times, e.g. a FIFO batch, one joint update per distinct time in order
+  void predict_and_observe_timed(const std::vector<double> &times, const std::vector<int> &kinds, const std::vector<Eigen::VectorXd> &meas);
   std::optional<Estimate> predict_and_update_odo_speed(std::vector<Eigen::VectorXd> speed, double t, int kind);
   std::optional<Estimate> predict_and_update_odo_trans(std::vector<Eigen::VectorXd> trans, double t, int kind);
   std::optional<Estimate> predict_and_update_odo_rot(std::vector<Eigen::VectorXd> rot, double t, int kind);
@@ -45,7 +50,7 @@ public:
 private:
   std::string name = "live";
 
-  std::shared_ptr<EKFSym> filter;
+  std::shared_ptr<live_ekf_sym_fixed_t> filter;
 
   int dim_state;
   int dim_state_err;
@@ -54,4 +59,10 @@ private:
   MatrixXdr initial_P;
   MatrixXdr Q;  // process noise
   std::unordered_map<int, MatrixXdr> obs_noise;
+
+  // scratch for the stacked joint observations
+  std::vector<int> joint_dims;
+  std::vector<double> joint_z, joint_R;
+  std::vector<int> timed_order, timed_kinds;
+  std::vector<Eigen::VectorXd> timed_meas;
 };
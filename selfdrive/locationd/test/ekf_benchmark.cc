@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <map>
+#include <random>
+
+#include "selfdrive/common/timing.h"
+#include "selfdrive/locationd/models/live_kf.h"
+
+using namespace Eigen;
+
+// Runs the same stream of gyro and accel observations through the dynamically sized
+// EKFSym and the fixed-size filter LiveKalman uses, and reports throughput and drift.
+
+const int N_OBS = 200000;
+
+int main(int argc, char *argv[]) {
+  VectorXd initial_x = live_initial_x;
+  MatrixXdr initial_P = live_initial_P_diag.asDiagonal();
+  MatrixXdr Q = live_Q_diag.asDiagonal();
+  std::map<int, MatrixXdr> R;
+  for (auto &pair : live_obs_noise_diag) {
+    R[pair.first] = pair.second.asDiagonal();
+  }
+
+  EKFSym dynamic("live", get_mapmat(Q), get_mapvec(initial_x), get_mapmat(initial_P), 23, 22, 0, 0, 0,
+                 std::vector<int>(), std::vector<int>{3}, std::vector<std::string>(), 0.2);
+  live_ekf_sym_fixed_t fixed("live", Q, initial_x, initial_P, std::vector<int>{3}, 0.2);
+
+  std::mt19937 gen(0);
+  std::normal_distribution<double> noise(0.0, 0.01);
+  std::vector<double> t(N_OBS);
+  std::vector<int> kind(N_OBS);
+  std::vector<VectorXd> z(N_OBS);
+  for (int i = 0; i < N_OBS; i++) {
+    // 100Hz gyro and accel, every 50th sample arrives slightly late to exercise rewinds
+    t[i] = i * 0.005 - (i % 50 == 0 ? 0.012 : 0.0);
+    kind[i] = i % 2 ? OBSERVATION_PHONE_ACCEL : OBSERVATION_PHONE_GYRO;
+    z[i] = kind[i] == OBSERVATION_PHONE_ACCEL ? Vector3d(9.81 + noise(gen), noise(gen), noise(gen))
+                                               : Vector3d(noise(gen), noise(gen), noise(gen));
+  }
+
+  double start = millis_since_boot();
+  for (int i = 0; i < N_OBS; i++) {
+    std::vector<Eigen::Map<VectorXd>> zi = {get_mapvec(z[i])};
+    std::vector<Eigen::Map<MatrixXdr>> Ri = {get_mapmat(R[kind[i]])};
+    dynamic.predict_and_update_batch(t[i], kind[i], zi, Ri);
+  }
+  double dynamic_ms = millis_since_boot() - start;
+
+  start = millis_since_boot();
+  for (int i = 0; i < N_OBS; i++) {
+    fixed.predict_and_update(t[i], kind[i], z[i].data(), z[i].size(), R[kind[i]].data());
+  }
+  double fixed_ms = millis_since_boot() - start;
+
+  printf("EKFSym:      %.1f ms, %.2f us/obs\n", dynamic_ms, 1e3 * dynamic_ms / N_OBS);
+  printf("EKFSymFixed: %.1f ms, %.2f us/obs\n", fixed_ms, 1e3 * fixed_ms / N_OBS);
+  printf("speedup %.2fx\n", dynamic_ms / fixed_ms);
+  printf("max state diff %g, max cov diff %g\n", (dynamic.state() - fixed.state()).cwiseAbs().maxCoeff(),
+         (dynamic.covs() - fixed.covs()).cwiseAbs().maxCoeff());
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include <capnp/serialize.h>
+
+#include "cereal/gen/cpp/log.capnp.h"
+#include "selfdrive/common/util.h"
+#include "selfdrive/locationd/models/live_kf.h"
+#include "selfdrive/sensord/sensors/constants.h"
+
+using namespace Eigen;
+
+// Feeds sensorEvents through LiveKalman three ways: a predict and update per sample,
+// one joint update per distinct sample time (what locationd does), and one joint update
+// per message at its newest sample time. Reports the CPU time of each and how far the
+// joint ones drift from the per sample state.
+//
+// The messages come from a decompressed rlog if one is given, and always from a
+// synthetic LSM6DS3 FIFO stream: 104Hz accel/gyro sets drained by a 100Hz loop that
+// stalls now and then, so some messages carry several sets spread over tens of ms.
+
+struct SensorBatch {
+  std::vector<double> times;
+  std::vector<int> kinds;
+  std::vector<VectorXd> meas;
+};
+
+static double cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::vector<SensorBatch> read_rlog(const std::string &data) {
+  std::vector<SensorBatch> batches;
+  kj::ArrayPtr<const capnp::word> words((const capnp::word *)data.data(), data.size() / sizeof(capnp::word));
+  while (words.size() > 0) {
+    capnp::FlatArrayMessageReader reader(words);
+    words = kj::arrayPtr(reader.getEnd(), words.end());
+
+    cereal::Event::Reader event = reader.getRoot<cereal::Event>();
+    if (event.which() != cereal::Event::SENSOR_EVENTS) {
+      continue;
+    }
+
+    // same selection as Localizer::handle_sensors
+    SensorBatch b;
+    for (const auto &reading : event.getSensorEvents()) {
+      if (reading.getTimestamp() == 0 || reading.getSource() == cereal::SensorEventData::SensorSource::BMX055) {
+        continue;
+      }
+      if (reading.getSensor() == SENSOR_GYRO_UNCALIBRATED && reading.getType() == SENSOR_TYPE_GYROSCOPE_UNCALIBRATED) {
+        auto v = reading.getGyroUncalibrated().getV();
+        b.kinds.push_back(OBSERVATION_PHONE_GYRO);
+        b.meas.push_back(Vector3d(-v[2], -v[1], -v[0]));
+        b.times.push_back(1e-9 * reading.getTimestamp());
+      } else if (reading.getSensor() == SENSOR_ACCELEROMETER && reading.getType() == SENSOR_TYPE_ACCELEROMETER) {
+        auto v = reading.getAcceleration().getV();
+        b.kinds.push_back(OBSERVATION_PHONE_ACCEL);
+        b.meas.push_back(Vector3d(-v[2], -v[1], -v[0]));
+        b.times.push_back(1e-9 * reading.getTimestamp());
+      }
+    }
+    if (!b.meas.empty()) {
+      batches.push_back(std::move(b));
+    }
+  }
+  return batches;
+}
+
+static std::vector<SensorBatch> fifo_stream(double seconds) {
+  const double odr = 104, loop_hz = 100;
+  std::mt19937 gen(0);
+  std::normal_distribution<double> noise(0, 0.05);
+  std::uniform_int_distribution<int> stall(0, 19);
+
+  std::vector<SensorBatch> batches;
+  int set = 0;
+  for (double t = 0; t < seconds;) {
+    // every 20th loop on average is 30ms late
+    t += 1 / loop_hz + (stall(gen) == 0 ? 0.03 : 0);
+    SensorBatch b;
+    for (; set / odr <= t; set++) {
+      const double ts = set / odr;
+      b.times.push_back(ts);
+      b.kinds.push_back(OBSERVATION_PHONE_GYRO);
+      b.meas.push_back(Vector3d(0.1 * std::sin(ts) + noise(gen), noise(gen), 0.02 + noise(gen)));
+      b.times.push_back(ts);
+      b.kinds.push_back(OBSERVATION_PHONE_ACCEL);
+      b.meas.push_back(Vector3d(9.81 + noise(gen), std::sin(2 * ts) + noise(gen), noise(gen)));
+    }
+    if (!b.meas.empty()) {
+      batches.push_back(std::move(b));
+    }
+  }
+  return batches;
+}
+
+static void run(const char *name, const std::vector<SensorBatch> &batches) {
+  LiveKalman per_sample, timed, newest;
+  double per_sample_time = 0, timed_time = 0, newest_time = 0;
+  double timed_diff = 0, newest_diff = 0;
+  size_t samples = 0, max_batch = 0;
+
+  for (const SensorBatch &b : batches) {
+    double start = cpu_time();
+    for (int i = 0; i < b.meas.size(); i++) {
+      per_sample.predict_and_observe(b.times[i], b.kinds[i], {b.meas[i]});
+    }
+    per_sample_time += cpu_time() - start;
+
+    start = cpu_time();
+    timed.predict_and_observe_timed(b.times, b.kinds, b.meas);
+    timed_time += cpu_time() - start;
+
+    start = cpu_time();
+    newest.predict_and_observe_joint(*std::max_element(b.times.begin(), b.times.end()), b.kinds, b.meas);
+    newest_time += cpu_time() - start;
+
+    timed_diff = std::max(timed_diff, (per_sample.get_x() - timed.get_x()).cwiseAbs().maxCoeff());
+    newest_diff = std::max(newest_diff, (per_sample.get_x() - newest.get_x()).cwiseAbs().maxCoeff());
+    samples += b.meas.size();
+    max_batch = std::max(max_batch, b.meas.size());
+  }
+
+  const double msgs = std::max<size_t>(batches.size(), 1);
+  printf("%s: %zu sensorEvents, %zu samples, up to %zu per message\n", name, batches.size(), samples, max_batch);
+  printf("  per sample:        %8.1f ms, %7.2f us/msg\n", per_sample_time * 1e3, per_sample_time * 1e6 / msgs);
+  printf("  joint per time:    %8.1f ms, %7.2f us/msg, max state diff %g\n", timed_time * 1e3, timed_time * 1e6 / msgs, timed_diff);
+  printf("  joint at newest:   %8.1f ms, %7.2f us/msg, max state diff %g\n", newest_time * 1e3, newest_time * 1e6 / msgs, newest_diff);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    std::string data = util::read_file(argv[1]);
+    if (data.empty()) {
+      printf("failed to read %s\n", argv[1]);
+      return 1;
+    }
+    run(argv[1], read_rlog(data));
+  }
+  run("lsm6ds3 fifo", fifo_stream(600));
+  return 0;
+}
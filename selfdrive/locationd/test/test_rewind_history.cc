@@ -0,0 +1,96 @@
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "rednose/helpers/rewind_history.h"
+
+// Rewinds RewindHistory at random times and checks the restored state against a filter
+// that kept every state, for a few log sizes and snapshot strides. A rewind may refuse
+// to reach back, but whatever it restores has to match and it must never replay an
+// observation that already left the log.
+
+typedef Eigen::Matrix<double, 1, 1> State;
+typedef Eigen::Matrix<double, 1, 1> Cov;
+
+struct Obs {
+  double t;
+  double z;
+};
+
+struct Filter {
+  State x = State::Zero();
+  Cov P = Cov::Identity();
+  double filter_time = NAN;
+
+  void apply(const Obs &obs) {
+    if (!std::isnan(this->filter_time)) {
+      assert(obs.t >= this->filter_time);
+      this->x(0) += 0.1 * (obs.t - this->filter_time);
+    }
+    this->x(0) = 0.9 * this->x(0) + obs.z;
+    this->P(0, 0) = 0.5 * this->P(0, 0) + 1;
+    this->filter_time = obs.t;
+  }
+};
+
+typedef EKFS::RewindHistory<Obs, State, Cov> History;
+
+// pushes the times in order and rewinds to rewind_t, returns what rewind returned
+static int check(size_t size, size_t stride, const std::vector<double> &times, double rewind_t) {
+  History history(size, stride);
+  Filter f;
+  std::vector<Filter> states;
+  std::vector<Obs> log;
+  for (int i = 0; i < times.size(); ++i) {
+    Obs obs = {times[i], std::sin(i)};
+    f.apply(obs);
+    history.push(obs, f.x, f.P);
+    states.push_back(f);
+    log.push_back(obs);
+  }
+
+  History::ObsList rewound;
+  int n = history.rewind(rewind_t, f.x, f.P, f.filter_time, [&](const Obs &obs) { f.apply(obs); }, rewound);
+  if (n < 0) {
+    return n;
+  }
+
+  int last = log.size() - 1;
+  while (last >= 0 && log[last].t > rewind_t) --last;
+  assert(last >= 0 && n == log.size() - 1 - last);
+  assert(f.x == states[last].x && f.P == states[last].P && f.filter_time == states[last].filter_time);
+  for (int i = 0; i < n; ++i) {
+    assert(rewound[i].t == log[last + 1 + i].t);
+  }
+  return n;
+}
+
+int main() {
+  // the only snapshot before t=1.5 is of t=0, whose slot t=8 already overwrote
+  std::vector<double> times;
+  for (int i = 0; i < 9; ++i) times.push_back(i);
+  assert(check(8, 4, times, 1.5) == -1);
+  assert(check(8, 4, times, 4.5) == 4);
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> count(1, 100);
+  std::exponential_distribution<double> dt(10);
+  int rewinds = 0, refused = 0;
+  for (size_t size : {1, 2, 7, 8, 64}) {
+    for (size_t stride : {1, 3, 4, 16}) {
+      for (int i = 0; i < 200; ++i) {
+        std::vector<double> times = {0};
+        const int n = count(gen);
+        while (times.size() < n) times.push_back(times.back() + dt(gen));
+        std::uniform_real_distribution<double> rewind_t(-0.1, times.back() + 0.1);
+        (check(size, stride, times, rewind_t(gen)) < 0 ? refused : rewinds)++;
+      }
+    }
+  }
+  printf("%d rewinds checked, %d refused\n", rewinds, refused);
+  return 0;
+}
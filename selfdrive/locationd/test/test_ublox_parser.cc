@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cereal/messaging/messaging.h"
+#include "selfdrive/locationd/ublox_msg.h"
+
+// Feeds UBX streams in random chunks through UbloxMsgParser, the same way ubloxd does.
+// Known frames have to come out decoded between garbage, and randomly corrupted streams
+// must only ever produce well formed events. Best run in an --asan build.
+
+struct Output {
+  std::string service;
+  std::string bytes;
+};
+
+static std::string frame(uint16_t msg_type, const std::string &payload) {
+  std::string msg = "\xb5\x62"s;
+  msg.push_back(msg_type >> 8);
+  msg.push_back(msg_type & 0xFF);
+  msg.push_back(payload.size() & 0xFF);
+  msg.push_back(payload.size() >> 8);
+  return ublox::ubx_add_checksum(msg + payload);
+}
+
+template <typename T>
+static void put(std::string &payload, int offset, T v) {
+  memcpy(&payload[offset], &v, sizeof(T));
+}
+
+static std::vector<Output> parse(UbloxMsgParser &parser, const std::string &stream, std::mt19937 &rng) {
+  std::vector<Output> out;
+  size_t pos = 0;
+  while (pos < stream.size()) {
+    const size_t len = std::min<size_t>(1 + rng() % 200, stream.size() - pos);
+    const uint8_t *data = (const uint8_t *)stream.data() + pos;
+    size_t bytes_consumed = 0;
+    while (bytes_consumed < len) {
+      size_t bytes_consumed_this_time = 0U;
+      if (parser.add_data(data + bytes_consumed, (uint32_t)(len - bytes_consumed), bytes_consumed_this_time)) {
+        auto [service, bytes] = parser.gen_msg();
+        if (service) {
+          out.push_back({service, std::string((const char *)bytes.begin(), bytes.size())});
+        }
+        parser.reset();
+      }
+      bytes_consumed += bytes_consumed_this_time;
+    }
+    pos += len;
+  }
+  return out;
+}
+
+static std::string nav_pvt() {
+  std::string p(92, '\0');
+  put<uint16_t>(p, 4, 2021);
+  p[6] = 6; p[7] = 1; p[8] = 12; p[9] = 30; p[10] = 15;
+  put<int32_t>(p, 16, 500000000);  // nano
+  p[21] = 0x01;  // flags
+  put<int32_t>(p, 24, -1223456789);  // lon
+  put<int32_t>(p, 28, 374012345);  // lat
+  put<int32_t>(p, 32, 12345);  // height
+  put<uint32_t>(p, 40, 1500);  // h_acc
+  put<int32_t>(p, 48, 1000);
+  put<int32_t>(p, 52, -2000);
+  put<int32_t>(p, 56, 300);
+  put<int32_t>(p, 60, 22360);  // g_speed
+  put<int32_t>(p, 64, 9000000);  // head_mot
+  return frame(ublox::MSG_NAV_PVT, p);
+}
+
+static std::string rxm_rawx(int num_meas) {
+  std::string p(16 + 32 * num_meas, '\0');
+  put<double>(p, 0, 123456.5);
+  put<uint16_t>(p, 8, 2160);
+  p[10] = 18;
+  p[11] = num_meas;
+  p[12] = 0b101;
+  for (int i = 0; i < num_meas; i++) {
+    const int m = 16 + 32 * i;
+    put<double>(p, m, 2e7 + i);
+    put<double>(p, m + 8, 1e8 + i);
+    put<float>(p, m + 16, -100.f * i);
+    p[m + 21] = i + 1;  // sv id
+    p[m + 26] = 40 + i;  // cno
+    p[m + 30] = 0b0011;  // trk stat
+  }
+  return frame(ublox::MSG_RXM_RAWX, p);
+}
+
+// GPS subframe from its 30 data bytes, as 10 words with the data in bits 29-6
+static std::string rxm_sfrbx(int sv_id, const uint8_t *subframe) {
+  std::string p(8 + 40, '\0');
+  p[0] = 0;  // GPS
+  p[1] = sv_id;
+  p[4] = 10;
+  for (int i = 0; i < 10; i++) {
+    uint32_t word = (subframe[3 * i] << 16) | (subframe[3 * i + 1] << 8) | subframe[3 * i + 2];
+    put<uint32_t>(p, 8 + 4 * i, word << 6);
+  }
+  return frame(ublox::MSG_RXM_SFRBX, p);
+}
+
+static std::string ephemeris_cycle(int sv_id, int iode) {
+  uint8_t sf[5][30] = {};
+  for (int i = 0; i < 5; i++) {
+    sf[i][0] = 0x8B;
+    sf[i][5] = (i + 1) << 2;
+  }
+  sf[0][6] = 112 >> 2; sf[0][7] = (112 & 3) << 6;  // week, modulo 1024
+  sf[0][21] = iode;  // IODC LSBs
+  sf[1][6] = iode;
+  const uint32_t sqrt_a = 5153.6 * (1 << 19);
+  for (int k = 0; k < 4; k++) sf[1][23 + k] = sqrt_a >> (24 - 8 * k);
+  sf[2][27] = iode;
+  sf[2][24] = 0xFF; sf[2][25] = 0xFF; sf[2][26] = 0xFE;  // omega dot -2
+  sf[3][6] = (1 << 6) | 56;  // page 18
+  sf[3][7] = (uint8_t)-3;  // alpha 0
+
+  std::string stream;
+  for (int i = 0; i < 5; i++) stream += rxm_sfrbx(sv_id, sf[i]);
+  return stream;
+}
+
+static cereal::Event::Reader read_event(AlignedBuffer &buf, const Output &out, std::unique_ptr<capnp::FlatArrayMessageReader> &reader) {
+  reader = std::make_unique<capnp::FlatArrayMessageReader>(buf.align(out.bytes.data(), out.bytes.size()));
+  return reader->getRoot<cereal::Event>();
+}
+
+void test_known_frames() {
+  std::mt19937 rng(0);
+  UbloxMsgParser parser;
+  AlignedBuffer buf;
+  std::unique_ptr<capnp::FlatArrayMessageReader> reader;
+
+  std::string stream = "\x01garbage\xb5"s + nav_pvt() + "\xb5\xb5"s + rxm_rawx(3) + nav_pvt() + ephemeris_cycle(7, 42) + ephemeris_cycle(7, 42);
+  auto out = parse(parser, stream, rng);
+  assert(out.size() == 5);
+
+  auto e = read_event(buf, out[0], reader);
+  assert(out[0].service == "gpsLocationExternal" && e.isGpsLocationExternal());
+  auto loc = e.getGpsLocationExternal();
+  assert(std::abs(loc.getLatitude() - 37.4012345) < 1e-9 && std::abs(loc.getLongitude() + 122.3456789) < 1e-9);
+  assert(std::abs(loc.getSpeed() - 22.36) < 1e-6 && std::abs(loc.getBearingDeg() - 90.) < 1e-6);
+  assert(loc.getTimestamp() == 1622550615500);
+  assert(std::abs(loc.getVNED()[1] + 2.f) < 1e-6);
+
+  e = read_event(buf, out[1], reader);
+  auto mr = e.getUbloxGnss().getMeasurementReport();
+  assert(mr.getRcvTow() == 123456.5 && mr.getGpsWeek() == 2160 && mr.getLeapSeconds() == 18 && mr.getNumMeas() == 3);
+  assert(mr.getMeasurements().size() == 3);
+  assert(mr.getMeasurements()[2].getSvId() == 3 && mr.getMeasurements()[2].getPseudorange() == 2e7 + 2);
+  assert(mr.getMeasurements()[2].getCno() == 42 && mr.getMeasurements()[2].getTrackingStatus().getCarrierPhaseValid());
+  assert(mr.getReceiverStatus().getLeapSecValid() && mr.getReceiverStatus().getClkReset());
+
+  assert(out[2].service == "gpsLocationExternal");
+
+  // the ephemeris is published once per complete cycle, the repeat comes from the cache
+  for (int i : {3, 4}) {
+    e = read_event(buf, out[i], reader);
+    auto eph = e.getUbloxGnss().getEphemeris();
+    assert(eph.getSvId() == 7 && eph.getIode() == 42 && eph.getGpsWeek() == 112);
+    assert(std::abs(std::sqrt(eph.getA()) - 5153.6) < 1e-5);
+    assert(eph.getOmegaDot() == -2 * pow(2, -43) * 3.1415926535898);
+    assert(eph.getIonoAlpha().size() == 4 && eph.getIonoAlpha()[0] == -3 * pow(2, -30));
+  }
+}
+
+void test_fuzz() {
+  std::mt19937 rng(1);
+  UbloxMsgParser parser;
+  AlignedBuffer buf;
+  std::unique_ptr<capnp::FlatArrayMessageReader> reader;
+
+  const std::vector<std::string> frames = {nav_pvt(), rxm_rawx(0), rxm_rawx(40), ephemeris_cycle(3, 1), frame(ublox::MSG_MON_HW, std::string(60, '\x01')),
+                                           frame(ublox::MSG_MON_HW2, std::string(28, '\x71')), frame(0x0a04, "")};
+  int events = 0;
+  for (int it = 0; it < 20000; it++) {
+    std::string stream;
+    for (int k = 0; k < 4; k++) {
+      std::string f = frames[rng() % frames.size()];
+      switch (rng() % 6) {
+        case 0:  // bit flip
+          f[rng() % f.size()] ^= 1 << (rng() % 8);
+          break;
+        case 1:  // truncate
+          f.resize(rng() % f.size());
+          break;
+        case 2: {  // wrong length or element count, with a valid checksum
+          std::string msg = f.substr(0, f.size() - 2);
+          msg[4 + rng() % 2] = rng();
+          if (msg.size() > 17) msg[6 + 4 + rng() % 8] = rng();
+          f = ublox::ubx_add_checksum(msg);
+          break;
+        }
+        case 3:  // random bytes
+          for (int i = 0; i < 50; i++) f.push_back(rng());
+          break;
+      }
+      stream += f;
+    }
+
+    for (const Output &out : parse(parser, stream, rng)) {
+      auto e = read_event(buf, out, reader);
+      assert(e.isGpsLocationExternal() || e.isUbloxGnss());
+      events++;
+    }
+  }
+
+  // a maximum length message fits the parse buffer
+  std::string big = frame(0x0a04, std::string(65535, '\0'));
+  parse(parser, big + nav_pvt(), rng);
+  printf("fuzz: %d events\n", events);
+}
+
+int main() {
+  test_known_frames();
+  test_fuzz();
+  printf("ok\n");
+  return 0;
+}
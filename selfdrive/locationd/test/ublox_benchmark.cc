@@ -0,0 +1,101 @@
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <capnp/serialize.h>
+
+#include "cereal/gen/cpp/log.capnp.h"
+#include "selfdrive/common/util.h"
+#include "selfdrive/locationd/ublox_msg.h"
+
+// Runs the ubloxRaw stream of a decompressed rlog through UbloxMsgParser the way
+// ubloxd does, and reports the throughput and the heap allocations per message.
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+static double cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("usage: %s <rlog> [passes]\n", argv[0]);
+    return 1;
+  }
+  const int passes = argc > 2 ? atoi(argv[2]) : 10;
+
+  std::string data = util::read_file(argv[1]);
+  if (data.empty()) {
+    printf("failed to read %s\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<std::string> chunks;
+  size_t total_bytes = 0;
+  kj::ArrayPtr<const capnp::word> words((const capnp::word *)data.data(), data.size() / sizeof(capnp::word));
+  while (words.size() > 0) {
+    capnp::FlatArrayMessageReader reader(words);
+    words = kj::arrayPtr(reader.getEnd(), words.end());
+
+    cereal::Event::Reader event = reader.getRoot<cereal::Event>();
+    if (event.which() == cereal::Event::UBLOX_RAW) {
+      auto raw = event.getUbloxRaw();
+      chunks.emplace_back((const char *)raw.begin(), raw.size());
+      total_bytes += raw.size();
+    }
+  }
+  if (chunks.empty()) {
+    printf("no ubloxRaw in %s\n", argv[1]);
+    return 1;
+  }
+
+  UbloxMsgParser parser;
+  int msgs = 0, events = 0;
+  size_t steady_allocations = 0;
+  double start = cpu_time();
+  for (int pass = 0; pass < passes; pass++) {
+    // the first pass sizes the output buffer
+    if (pass == 1) steady_allocations = allocations;
+
+    for (const std::string &chunk : chunks) {
+      const uint8_t *bytes = (const uint8_t *)chunk.data();
+      size_t bytes_consumed = 0;
+      while (bytes_consumed < chunk.size()) {
+        size_t bytes_consumed_this_time = 0U;
+        if (parser.add_data(bytes + bytes_consumed, (uint32_t)(chunk.size() - bytes_consumed), bytes_consumed_this_time)) {
+          auto [service, out] = parser.gen_msg();
+          events += service != nullptr;
+          msgs++;
+          parser.reset();
+        }
+        bytes_consumed += bytes_consumed_this_time;
+      }
+    }
+  }
+  double elapsed = cpu_time() - start;
+  steady_allocations = allocations - steady_allocations;
+
+  printf("%zu ubloxRaw chunks, %.1f kB, %d passes\n", chunks.size(), total_bytes / 1e3, passes);
+  printf("%d messages, %d events\n", msgs, events);
+  printf("%.1f MB/s, %.2f us/msg\n", total_bytes * passes / elapsed / 1e6, elapsed * 1e6 / std::max(msgs, 1));
+  printf("%.3f allocations/msg after the first pass\n", passes > 1 ? (double)steady_allocations / (msgs * (passes - 1) / passes) : 0.);
+  return 0;
+}
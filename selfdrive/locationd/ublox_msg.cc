@@ -1,52 +1,164 @@
 #include "ublox_msg.h"
 
-#include <unistd.h>
-
-#include <cassert>
-#include <chrono>
+#include <algorithm>
 #include <cmath>
-#include <cstdio>
-#include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <unordered_map>
+
+#include <capnp/serialize.h>
 
 #include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
 
 const double gpsPi = 3.1415926535898;
-#define UBLOX_MSG_SIZE(hdr) (*(uint16_t *)&hdr[4])
+
+// First segment of the builder, large enough for a RAWX with 64 measurements
+const size_t FIRST_SEGMENT_WORDS = 2048;
+
+template <typename T>
+inline static T read_le(const uint8_t *p) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+inline static uint32_t read_u_be(const uint8_t *p, int bytes) {
+  uint32_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+inline static int32_t read_s_be(const uint8_t *p, int bytes) {
+  return (int32_t)(read_u_be(p, bytes) << (32 - 8 * bytes)) >> (32 - 8 * bytes);
+}
+
+// signed field of the given width in the top bits of a big endian word
+inline static int32_t read_bits_s_be(const uint8_t *p, int bytes, int bits) {
+  return (int32_t)(read_u_be(p, bytes) << (32 - 8 * bytes)) >> (32 - bits);
+}
 
 inline static bool bit_to_bool(uint8_t val, int shifts) {
   return (bool)(val & (1 << shifts));
 }
 
+bool EphemerisStore::add_subframe(uint8_t sv_id, const uint8_t *subframe) {
+  // TLM preamble, then the subframe id in the HOW
+  const int subframe_id = (subframe[5] >> 2) & 0x7;
+  if (subframe[0] != 0x8B || subframe_id < 1 || subframe_id > 5) {
+    return false;
+  }
+
+  Sv &sv = svs[sv_id];
+  if (subframe_id == 1) sv.received = 0;
+  memcpy(sv.subframes[subframe_id - 1], subframe, ublox::GPS_SUBFRAME_SIZE);
+  sv.received |= 1 << (subframe_id - 1);
+  if (sv.received != 0b11111) {
+    return false;
+  }
+
+  const uint8_t *sf1 = sv.subframes[0], *sf2 = sv.subframes[1], *sf3 = sv.subframes[2];
+  GpsEphemeris &e = sv.eph;
+  e.gps_week = (sf1[6] << 2) | (sf1[7] >> 6);
+
+  // The ephemeris is broadcast every 30s but only changes every two hours, it's only
+  // decoded again when the issue of data (IODC and both IODEs) changed
+  const int iode = sf3[27];
+  const bool consistent = sf1[21] == iode && sf2[6] == iode;
+  if (sv.eph_valid && consistent && e.iode == iode) {
+    return true;
+  }
+
+  // Subframe 1
+  e.tgd = (int8_t)sf1[20] * pow(2, -31);
+  e.toc = read_u_be(&sf1[22], 2) * pow(2, 4);
+  e.af2 = (int8_t)sf1[24] * pow(2, -55);
+  e.af1 = read_s_be(&sf1[25], 2) * pow(2, -43);
+  e.af0 = read_bits_s_be(&sf1[27], 3, 22) * pow(2, -31);
+
+  // Subframe 2
+  e.crs = read_s_be(&sf2[7], 2) * pow(2, -5);
+  e.delta_n = read_s_be(&sf2[9], 2) * pow(2, -43) * gpsPi;
+  e.m0 = read_s_be(&sf2[11], 4) * pow(2, -31) * gpsPi;
+  e.cuc = read_s_be(&sf2[15], 2) * pow(2, -29);
+  e.ecc = read_u_be(&sf2[17], 4) * pow(2, -33);
+  e.cus = read_s_be(&sf2[21], 2) * pow(2, -29);
+  e.a = pow(read_u_be(&sf2[23], 4) * pow(2, -19), 2.0);
+  e.toe = read_u_be(&sf2[27], 2) * pow(2, 4);
+
+  // Subframe 3
+  e.cic = read_s_be(&sf3[6], 2) * pow(2, -29);
+  e.omega0 = read_s_be(&sf3[8], 4) * pow(2, -31) * gpsPi;
+  e.cis = read_s_be(&sf3[12], 2) * pow(2, -29);
+  e.i0 = read_s_be(&sf3[14], 4) * pow(2, -31) * gpsPi;
+  e.crc = read_s_be(&sf3[18], 2) * pow(2, -5);
+  e.omega = read_s_be(&sf3[20], 4) * pow(2, -31) * gpsPi;
+  e.omega_dot = read_bits_s_be(&sf3[24], 3, 24) * pow(2, -43) * gpsPi;
+  e.iode = iode;
+  e.i_dot = read_bits_s_be(&sf3[28], 2, 14) * pow(2, -43) * gpsPi;
+
+  // an orbit decoded across an ephemeris change isn't cached
+  sv.eph_valid = consistent;
+  return true;
+}
+
+bool EphemerisStore::iono(uint8_t sv_id, double alpha[4], double beta[4]) const {
+  const uint8_t *sf4 = svs[sv_id].subframes[3];
+
+  // This is page 18, why is the page id 56?
+  const int data_id = sf4[6] >> 6, page_id = sf4[6] & 0x3F;
+  if (data_id != 1 || page_id != 56) {
+    return false;
+  }
+
+  alpha[0] = (int8_t)sf4[7] * pow(2, -30);
+  alpha[1] = (int8_t)sf4[8] * pow(2, -27);
+  alpha[2] = (int8_t)sf4[9] * pow(2, -24);
+  alpha[3] = (int8_t)sf4[10] * pow(2, -24);
+  beta[0] = (int8_t)sf4[11] * pow(2, 11);
+  beta[1] = (int8_t)sf4[12] * pow(2, 14);
+  beta[2] = (int8_t)sf4[13] * pow(2, 16);
+  beta[3] = (int8_t)sf4[14] * pow(2, 16);
+  return true;
+}
+
+UbloxMsgParser::UbloxMsgParser() : first_segment(kj::heapArray<capnp::word>(FIRST_SEGMENT_WORDS)) {
+  memset(first_segment.begin(), 0, first_segment.asBytes().size());
+}
+
 inline int UbloxMsgParser::needed_bytes() {
   // Msg header incomplete?
   if(bytes_in_parse_buf < ublox::UBLOX_HEADER_SIZE)
     return ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE - bytes_in_parse_buf;
-  uint16_t needed = UBLOX_MSG_SIZE(msg_parse_buf) + ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE;
+  int needed = read_le<uint16_t>(&msg_parse_buf[4]) + ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE;
   // too much data
-  if(needed < (uint16_t)bytes_in_parse_buf)
+  if(needed < (int)bytes_in_parse_buf)
     return -1;
-  return needed - (uint16_t)bytes_in_parse_buf;
+  return needed - (int)bytes_in_parse_buf;
 }
 
-inline bool UbloxMsgParser::valid_cheksum() {
+inline static bool checksum_valid(const uint8_t *msg, size_t len) {
   uint8_t ck_a = 0, ck_b = 0;
-  for(int i = 2; i < bytes_in_parse_buf - ublox::UBLOX_CHECKSUM_SIZE;i++) {
-    ck_a = (ck_a + msg_parse_buf[i]) & 0xFF;
+  for(int i = 2; i < len - ublox::UBLOX_CHECKSUM_SIZE;i++) {
+    ck_a = (ck_a + msg[i]) & 0xFF;
     ck_b = (ck_b + ck_a) & 0xFF;
   }
-  if(ck_a != msg_parse_buf[bytes_in_parse_buf - 2]) {
-    LOGD("Checksum a mismtach: %02X, %02X", ck_a, msg_parse_buf[6]);
+  if(ck_a != msg[len - 2]) {
+    LOGD("Checksum a mismtach: %02X, %02X", ck_a, msg[6]);
     return false;
   }
-  if(ck_b != msg_parse_buf[bytes_in_parse_buf - 1]) {
-    LOGD("Checksum b mismtach: %02X, %02X", ck_b, msg_parse_buf[7]);
+  if(ck_b != msg[len - 1]) {
+    LOGD("Checksum b mismtach: %02X, %02X", ck_b, msg[7]);
     return false;
   }
   return true;
 }
 
+inline bool UbloxMsgParser::valid_cheksum() {
+  return checksum_valid(msg_parse_buf, bytes_in_parse_buf);
+}
+
 inline bool UbloxMsgParser::valid() {
   return bytes_in_parse_buf >= ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE &&
          needed_bytes() == 0 && valid_cheksum();
@@ -67,6 +179,20 @@ inline bool UbloxMsgParser::valid_so_far() {
 
 
 bool UbloxMsgParser::add_data(const uint8_t *incoming_data, uint32_t incoming_data_len, size_t &bytes_consumed) {
+  // A complete message at the start of the input is decoded from there without copying
+  if(bytes_in_parse_buf == 0 && incoming_data_len >= ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE &&
+     incoming_data[0] == ublox::PREAMBLE1 && incoming_data[1] == ublox::PREAMBLE2) {
+    const size_t len = read_le<uint16_t>(&incoming_data[4]) + ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE;
+    if(len <= incoming_data_len && checksum_valid(incoming_data, len)) {
+      frame = incoming_data;
+      frame_len = len;
+      bytes_consumed = len;
+      return true;
+    }
+  }
+  frame = msg_parse_buf;
+  frame_len = bytes_in_parse_buf;
+
   int needed = needed_bytes();
   if(needed > 0) {
     bytes_consumed = std::min((uint32_t)needed, incoming_data_len );
@@ -89,246 +215,241 @@ bool UbloxMsgParser::add_data(const uint8_t *incoming_data, uint32_t incoming_da
   if(needed_bytes() == -1) {
     bytes_in_parse_buf = 0;
   }
+  frame_len = bytes_in_parse_buf;
   return valid();
 }
 
 
-std::pair<std::string, kj::Array<capnp::word>> UbloxMsgParser::gen_msg() {
-  std::string dat = data();
-  kaitai::kstream stream(dat);
 
-  ubx_t ubx_message(&stream);
-  auto body = ubx_message.body();
+std::pair<const char *, kj::ArrayPtr<capnp::byte>> UbloxMsgParser::gen_msg() {
+  const uint16_t msg_type = read_u_be(&frame[2], 2);
+  const uint8_t *msg = &frame[ublox::UBLOX_HEADER_SIZE];
+  const size_t len = read_le<uint16_t>(&frame[4]);
+
+  // the builder zeroes the used part of the first segment again when it's destroyed
+  capnp::MallocMessageBuilder msg_builder(first_segment);
+  cereal::Event::Builder event = msg_builder.initRoot<cereal::Event>();
+  event.setLogMonoTime(nanos_since_boot());
+  event.setValid(true);
 
-  switch (ubx_message.msg_type()) {
-  case 0x0107:
-    return {"gpsLocationExternal", gen_nav_pvt(static_cast<ubx_t::nav_pvt_t*>(body))};
+  const char *service = nullptr;
+  bool ok = false;
+  switch (msg_type) {
+  case ublox::MSG_NAV_PVT:
+    service = "gpsLocationExternal";
+    ok = gen_nav_pvt(event, msg, len);
     break;
-  case 0x0213:
-    return {"ubloxGnss", gen_rxm_sfrbx(static_cast<ubx_t::rxm_sfrbx_t*>(body))};
+  case ublox::MSG_RXM_SFRBX:
+    service = "ubloxGnss";
+    ok = gen_rxm_sfrbx(event, msg, len);
     break;
-  case 0x0215:
-    return {"ubloxGnss", gen_rxm_rawx(static_cast<ubx_t::rxm_rawx_t*>(body))};
+  case ublox::MSG_RXM_RAWX:
+    service = "ubloxGnss";
+    ok = gen_rxm_rawx(event, msg, len);
     break;
-  case 0x0a09:
-    return {"ubloxGnss", gen_mon_hw(static_cast<ubx_t::mon_hw_t*>(body))};
+  case ublox::MSG_MON_HW:
+    service = "ubloxGnss";
+    ok = gen_mon_hw(event, msg, len);
     break;
-  case 0x0a0b:
-    return {"ubloxGnss", gen_mon_hw2(static_cast<ubx_t::mon_hw2_t*>(body))};
+  case ublox::MSG_MON_HW2:
+    service = "ubloxGnss";
+    ok = gen_mon_hw2(event, msg, len);
     break;
   default:
-    LOGE("Unknown message type %x", ubx_message.msg_type());
-    return {"ubloxGnss", kj::Array<capnp::word>()};
+    LOGE("Unknown message type %x", msg_type);
     break;
   }
+  if (!ok) {
+    return {nullptr, {}};
+  }
+
+  const size_t size = capnp::computeSerializedSizeInWords(msg_builder);
+  if (out_buf.size() < size) {
+    out_buf = kj::heapArray<capnp::word>(std::max(size, FIRST_SEGMENT_WORDS));
+  }
+  auto bytes = out_buf.asBytes().slice(0, size * sizeof(capnp::word));
+  kj::ArrayOutputStream output_stream(bytes);
+  capnp::writeMessage(output_stream, msg_builder);
+  return {service, bytes};
 }
 
 
-kj::Array<capnp::word> UbloxMsgParser::gen_nav_pvt(ubx_t::nav_pvt_t *msg) {
-  MessageBuilder msg_builder;
-  auto gpsLoc = msg_builder.initEvent().initGpsLocationExternal();
+bool UbloxMsgParser::gen_nav_pvt(cereal::Event::Builder event, const uint8_t *msg, size_t len) {
+  if (len < 92) {
+    LOGE("NAV-PVT too short: %zu", len);
+    return false;
+  }
+
+  auto gpsLoc = event.initGpsLocationExternal();
   gpsLoc.setSource(cereal::GpsLocationData::SensorSource::UBLOX);
-  gpsLoc.setFlags(msg->flags());
-  gpsLoc.setLatitude(msg->lat() * 1e-07);
-  gpsLoc.setLongitude(msg->lon() * 1e-07);
-  gpsLoc.setAltitude(msg->height() * 1e-03);
-  gpsLoc.setSpeed(msg->g_speed() * 1e-03);
-  gpsLoc.setBearingDeg(msg->head_mot() * 1e-5);
-  gpsLoc.setAccuracy(msg->h_acc() * 1e-03);
+  gpsLoc.setFlags(msg[21]);
+  gpsLoc.setLatitude(read_le<int32_t>(&msg[28]) * 1e-07);
+  gpsLoc.setLongitude(read_le<int32_t>(&msg[24]) * 1e-07);
+  gpsLoc.setAltitude(read_le<int32_t>(&msg[32]) * 1e-03);
+  gpsLoc.setSpeed(read_le<int32_t>(&msg[60]) * 1e-03);
+  gpsLoc.setBearingDeg(read_le<int32_t>(&msg[64]) * 1e-5);
+  gpsLoc.setAccuracy(read_le<uint32_t>(&msg[40]) * 1e-03);
   std::tm timeinfo = std::tm();
-  timeinfo.tm_year = msg->year() - 1900;
-  timeinfo.tm_mon = msg->month() - 1;
-  timeinfo.tm_mday = msg->day();
-  timeinfo.tm_hour = msg->hour();
-  timeinfo.tm_min = msg->min();
-  timeinfo.tm_sec = msg->sec();
+  timeinfo.tm_year = read_le<uint16_t>(&msg[4]) - 1900;
+  timeinfo.tm_mon = msg[6] - 1;
+  timeinfo.tm_mday = msg[7];
+  timeinfo.tm_hour = msg[8];
+  timeinfo.tm_min = msg[9];
+  timeinfo.tm_sec = msg[10];
 
   std::time_t utc_tt = timegm(&timeinfo);
-  gpsLoc.setTimestamp(utc_tt * 1e+03 + msg->nano() * 1e-06);
-  float f[] = { msg->vel_n() * 1e-03f, msg->vel_e() * 1e-03f, msg->vel_d() * 1e-03f };
+  gpsLoc.setTimestamp(utc_tt * 1e+03 + read_le<int32_t>(&msg[16]) * 1e-06);
+  float f[] = { read_le<int32_t>(&msg[48]) * 1e-03f, read_le<int32_t>(&msg[52]) * 1e-03f, read_le<int32_t>(&msg[56]) * 1e-03f };
   gpsLoc.setVNED(f);
-  gpsLoc.setVerticalAccuracy(msg->v_acc() * 1e-03);
-  gpsLoc.setSpeedAccuracy(msg->s_acc() * 1e-03);
-  gpsLoc.setBearingAccuracyDeg(msg->head_acc() * 1e-05);
-  return capnp::messageToFlatArray(msg_builder);
+  gpsLoc.setVerticalAccuracy(read_le<uint32_t>(&msg[44]) * 1e-03);
+  gpsLoc.setSpeedAccuracy(read_le<int32_t>(&msg[68]) * 1e-03);
+  gpsLoc.setBearingAccuracyDeg(read_le<uint32_t>(&msg[72]) * 1e-05);
+  return true;
 }
 
 
-kj::Array<capnp::word> UbloxMsgParser::gen_rxm_sfrbx(ubx_t::rxm_sfrbx_t *msg) {
-  auto body = *msg->body();
+bool UbloxMsgParser::gen_rxm_sfrbx(cereal::Event::Builder event, const uint8_t *msg, size_t len) {
+  if (len < 8 || len < 8 + 4 * msg[4]) {
+    LOGE("RXM-SFRBX too short: %zu", len);
+    return false;
+  }
 
-  if (msg->gnss_id() == ubx_t::gnss_type_t::GNSS_TYPE_GPS) {
-    // GPS subframes are packed into 10x 4 bytes, each containing 3 actual bytes
-    // We will first need to separate the data from the padding and parity
-    assert(body.size() == 10);
+  const uint8_t gnss_id = msg[0], sv_id = msg[1], num_words = msg[4];
+  if (gnss_id != 0 || num_words != 10) {  // only GPS L1 C/A
+    return false;
+  }
 
-    std::string subframe_data;
-    subframe_data.reserve(30);
-    for (uint32_t word : body) {
-      word = word >> 6; // TODO: Verify parity
-      subframe_data.push_back(word >> 16);
-      subframe_data.push_back(word >> 8);
-      subframe_data.push_back(word >> 0);
-    }
+  // GPS subframes are packed into 10x 4 bytes, each containing 3 actual bytes
+  // We will first need to separate the data from the padding and parity
+  uint8_t subframe[ublox::GPS_SUBFRAME_SIZE];
+  for (int i = 0; i < 10; i++) {
+    uint32_t word = read_le<uint32_t>(&msg[8 + 4 * i]) >> 6; // TODO: Verify parity
+    subframe[3 * i + 0] = word >> 16;
+    subframe[3 * i + 1] = word >> 8;
+    subframe[3 * i + 2] = word >> 0;
+  }
 
-    // Collect subframes in map and parse when we have all the parts
-    kaitai::kstream stream(subframe_data);
-    gps_t subframe(&stream);
-    int subframe_id = subframe.how()->subframe_id();
-
-    if (subframe_id == 1) gps_subframes[msg->sv_id()].clear();
-    gps_subframes[msg->sv_id()][subframe_id] = subframe_data;
-
-    if (gps_subframes[msg->sv_id()].size() == 5) {
-      MessageBuilder msg_builder;
-      auto eph = msg_builder.initEvent().initUbloxGnss().initEphemeris();
-      eph.setSvId(msg->sv_id());
-
-      // Subframe 1
-      {
-        kaitai::kstream stream(gps_subframes[msg->sv_id()][1]);
-        gps_t subframe(&stream);
-        gps_t::subframe_1_t* subframe_1 = static_cast<gps_t::subframe_1_t*>(subframe.body());
-
-        eph.setGpsWeek(subframe_1->week_no());
-        eph.setTgd(subframe_1->t_gd() * pow(2, -31));
-        eph.setToc(subframe_1->t_oc() * pow(2, 4));
-        eph.setAf2(subframe_1->af_2() * pow(2, -55));
-        eph.setAf1(subframe_1->af_1() * pow(2, -43));
-        eph.setAf0(subframe_1->af_0() * pow(2, -31));
-      }
-
-      // Subframe 2
-      {
-        kaitai::kstream stream(gps_subframes[msg->sv_id()][2]);
-        gps_t subframe(&stream);
-        gps_t::subframe_2_t* subframe_2 = static_cast<gps_t::subframe_2_t*>(subframe.body());
-
-        eph.setCrs(subframe_2->c_rs() * pow(2, -5));
-        eph.setDeltaN(subframe_2->delta_n() * pow(2, -43) * gpsPi);
-        eph.setM0(subframe_2->m_0() * pow(2, -31) * gpsPi);
-        eph.setCuc(subframe_2->c_uc() * pow(2, -29));
-        eph.setEcc(subframe_2->e() * pow(2, -33));
-        eph.setCus(subframe_2->c_us() * pow(2, -29));
-        eph.setA(pow(subframe_2->sqrt_a() * pow(2, -19), 2.0));
-        eph.setToe(subframe_2->t_oe() * pow(2, 4));
-      }
-
-      // Subframe 3
-      {
-        kaitai::kstream stream(gps_subframes[msg->sv_id()][3]);
-        gps_t subframe(&stream);
-        gps_t::subframe_3_t* subframe_3 = static_cast<gps_t::subframe_3_t*>(subframe.body());
-
-        eph.setCic(subframe_3->c_ic() * pow(2, -29));
-        eph.setOmega0(subframe_3->omega_0() * pow(2, -31) * gpsPi);
-        eph.setCis(subframe_3->c_is() * pow(2, -29));
-        eph.setI0(subframe_3->i_0() * pow(2, -31) * gpsPi);
-        eph.setCrc(subframe_3->c_rc() * pow(2, -5));
-        eph.setOmega(subframe_3->omega() * pow(2, -31) * gpsPi);
-        eph.setOmegaDot(subframe_3->omega_dot() * pow(2, -43) * gpsPi);
-        eph.setIode(subframe_3->iode());
-        eph.setIDot(subframe_3->idot() * pow(2, -43) * gpsPi);
-      }
-
-      // Subframe 4
-      {
-        kaitai::kstream stream(gps_subframes[msg->sv_id()][4]);
-        gps_t subframe(&stream);
-        gps_t::subframe_4_t* subframe_4 = static_cast<gps_t::subframe_4_t*>(subframe.body());
-
-        // This is page 18, why is the page id 56?
-        if (subframe_4->data_id() == 1 && subframe_4->page_id() == 56) {
-          auto iono = static_cast<gps_t::subframe_4_t::ionosphere_data_t*>(subframe_4->body());
-          double a0 = iono->a0() * pow(2, -30);
-          double a1 = iono->a1() * pow(2, -27);
-          double a2 = iono->a2() * pow(2, -24);
-          double a3 = iono->a3() * pow(2, -24);
-          eph.setIonoAlpha({a0, a1, a2, a3});
-
-          double b0 = iono->b0() * pow(2, 11);
-          double b1 = iono->b1() * pow(2, 14);
-          double b2 = iono->b2() * pow(2, 16);
-          double b3 = iono->b3() * pow(2, 16);
-          eph.setIonoBeta({b0, b1, b2, b3});
-        }
-      }
-
-      return capnp::messageToFlatArray(msg_builder);
-    }
+  if (!ephemerides.add_subframe(sv_id, subframe)) {
+    return false;
   }
-  return kj::Array<capnp::word>();
+
+  const GpsEphemeris &e = ephemerides.get(sv_id);
+  auto eph = event.initUbloxGnss().initEphemeris();
+  eph.setSvId(sv_id);
+  eph.setGpsWeek(e.gps_week);
+  eph.setTgd(e.tgd);
+  eph.setToc(e.toc);
+  eph.setAf2(e.af2);
+  eph.setAf1(e.af1);
+  eph.setAf0(e.af0);
+  eph.setCrs(e.crs);
+  eph.setDeltaN(e.delta_n);
+  eph.setM0(e.m0);
+  eph.setCuc(e.cuc);
+  eph.setEcc(e.ecc);
+  eph.setCus(e.cus);
+  eph.setA(e.a);
+  eph.setToe(e.toe);
+  eph.setCic(e.cic);
+  eph.setOmega0(e.omega0);
+  eph.setCis(e.cis);
+  eph.setI0(e.i0);
+  eph.setCrc(e.crc);
+  eph.setOmega(e.omega);
+  eph.setOmegaDot(e.omega_dot);
+  eph.setIode(e.iode);
+  eph.setIDot(e.i_dot);
+
+  double alpha[4], beta[4];
+  if (ephemerides.iono(sv_id, alpha, beta)) {
+    eph.setIonoAlpha(kj::arrayPtr(alpha, 4));
+    eph.setIonoBeta(kj::arrayPtr(beta, 4));
+  }
+  return true;
 }
 
-kj::Array<capnp::word> UbloxMsgParser::gen_rxm_rawx(ubx_t::rxm_rawx_t *msg) {
-  MessageBuilder msg_builder;
-  auto mr = msg_builder.initEvent().initUbloxGnss().initMeasurementReport();
-  mr.setRcvTow(msg->rcv_tow());
-  mr.setGpsWeek(msg->week());
-  mr.setLeapSeconds(msg->leap_s());
-  mr.setGpsWeek(msg->week());
-
-  auto mb = mr.initMeasurements(msg->num_meas());
-  auto measurements = *msg->measurements();
-  for(int8_t i = 0; i < msg->num_meas(); i++) {
-    mb[i].setSvId(measurements[i]->sv_id());
-    mb[i].setPseudorange(measurements[i]->pr_mes());
-    mb[i].setCarrierCycles(measurements[i]->cp_mes());
-    mb[i].setDoppler(measurements[i]->do_mes());
-    mb[i].setGnssId(measurements[i]->gnss_id());
-    mb[i].setGlonassFrequencyIndex(measurements[i]->freq_id());
-    mb[i].setLocktime(measurements[i]->lock_time());
-    mb[i].setCno(measurements[i]->cno());
-    mb[i].setPseudorangeStdev(0.01 * (pow(2, (measurements[i]->pr_stdev() & 15)))); // weird scaling, might be wrong
-    mb[i].setCarrierPhaseStdev(0.004 * (measurements[i]->cp_stdev() & 15));
-    mb[i].setDopplerStdev(0.002 * (pow(2, (measurements[i]->do_stdev() & 15)))); // weird scaling, might be wrong
+bool UbloxMsgParser::gen_rxm_rawx(cereal::Event::Builder event, const uint8_t *msg, size_t len) {
+  if (len < 16 || len < 16 + 32 * msg[11]) {
+    LOGE("RXM-RAWX too short: %zu", len);
+    return false;
+  }
+
+  const int num_meas = msg[11];
+  const uint8_t rec_stat = msg[12];
+  auto mr = event.initUbloxGnss().initMeasurementReport();
+  mr.setRcvTow(read_le<double>(&msg[0]));
+  mr.setGpsWeek(read_le<uint16_t>(&msg[8]));
+  mr.setLeapSeconds((int8_t)msg[10]);
+
+  auto mb = mr.initMeasurements(num_meas);
+  for (int i = 0; i < num_meas; i++) {
+    const uint8_t *meas = &msg[16 + 32 * i];
+    mb[i].setSvId(meas[21]);
+    mb[i].setPseudorange(read_le<double>(&meas[0]));
+    mb[i].setCarrierCycles(read_le<double>(&meas[8]));
+    mb[i].setDoppler(read_le<float>(&meas[16]));
+    mb[i].setGnssId(meas[20]);
+    mb[i].setGlonassFrequencyIndex(meas[23]);
+    mb[i].setLocktime(read_le<uint16_t>(&meas[24]));
+    mb[i].setCno(meas[26]);
+    mb[i].setPseudorangeStdev(0.01 * (pow(2, (meas[27] & 15)))); // weird scaling, might be wrong
+    mb[i].setCarrierPhaseStdev(0.004 * (meas[28] & 15));
+    mb[i].setDopplerStdev(0.002 * (pow(2, (meas[29] & 15)))); // weird scaling, might be wrong
 
     auto ts = mb[i].initTrackingStatus();
-    auto trk_stat = measurements[i]->trk_stat();
+    auto trk_stat = meas[30];
     ts.setPseudorangeValid(bit_to_bool(trk_stat, 0));
     ts.setCarrierPhaseValid(bit_to_bool(trk_stat, 1));
     ts.setHalfCycleValid(bit_to_bool(trk_stat, 2));
     ts.setHalfCycleSubtracted(bit_to_bool(trk_stat, 3));
   }
 
-  mr.setNumMeas(msg->num_meas());
+  mr.setNumMeas(num_meas);
   auto rs = mr.initReceiverStatus();
-  rs.setLeapSecValid(bit_to_bool(msg->rec_stat(), 0));
-  rs.setClkReset(bit_to_bool(msg->rec_stat(), 2));
-  return capnp::messageToFlatArray(msg_builder);
+  rs.setLeapSecValid(bit_to_bool(rec_stat, 0));
+  rs.setClkReset(bit_to_bool(rec_stat, 2));
+  return true;
 }
 
-kj::Array<capnp::word> UbloxMsgParser::gen_mon_hw(ubx_t::mon_hw_t *msg) {
-  MessageBuilder msg_builder;
-  auto hwStatus = msg_builder.initEvent().initUbloxGnss().initHwStatus();
-  hwStatus.setNoisePerMS(msg->noise_per_ms());
-  hwStatus.setFlags(msg->flags());
-  hwStatus.setAgcCnt(msg->agc_cnt());
-  hwStatus.setAStatus((cereal::UbloxGnss::HwStatus::AntennaSupervisorState) msg->a_status());
-  hwStatus.setAPower((cereal::UbloxGnss::HwStatus::AntennaPowerStatus) msg->a_power());
-  hwStatus.setJamInd(msg->jam_ind());
-  return capnp::messageToFlatArray(msg_builder);
+bool UbloxMsgParser::gen_mon_hw(cereal::Event::Builder event, const uint8_t *msg, size_t len) {
+  if (len < 60) {
+    LOGE("MON-HW too short: %zu", len);
+    return false;
+  }
+
+  auto hwStatus = event.initUbloxGnss().initHwStatus();
+  hwStatus.setNoisePerMS(read_le<uint16_t>(&msg[16]));
+  hwStatus.setFlags(msg[22]);
+  hwStatus.setAgcCnt(read_le<uint16_t>(&msg[18]));
+  hwStatus.setAStatus((cereal::UbloxGnss::HwStatus::AntennaSupervisorState) msg[20]);
+  hwStatus.setAPower((cereal::UbloxGnss::HwStatus::AntennaPowerStatus) msg[21]);
+  hwStatus.setJamInd(msg[45]);
+  return true;
 }
 
-kj::Array<capnp::word> UbloxMsgParser::gen_mon_hw2(ubx_t::mon_hw2_t *msg) {
-  MessageBuilder msg_builder;
-  auto hwStatus = msg_builder.initEvent().initUbloxGnss().initHwStatus2();
-  hwStatus.setOfsI(msg->ofs_i());
-  hwStatus.setMagI(msg->mag_i());
-  hwStatus.setOfsQ(msg->ofs_q());
-  hwStatus.setMagQ(msg->mag_q());
+bool UbloxMsgParser::gen_mon_hw2(cereal::Event::Builder event, const uint8_t *msg, size_t len) {
+  if (len < 28) {
+    LOGE("MON-HW2 too short: %zu", len);
+    return false;
+  }
+
+  auto hwStatus = event.initUbloxGnss().initHwStatus2();
+  hwStatus.setOfsI((int8_t)msg[0]);
+  hwStatus.setMagI(msg[1]);
+  hwStatus.setOfsQ((int8_t)msg[2]);
+  hwStatus.setMagQ(msg[3]);
 
-  switch (msg->cfg_source()) {
-    case ubx_t::mon_hw2_t::config_source_t::CONFIG_SOURCE_ROM:
+  switch (msg[4]) {
+    case 113:
       hwStatus.setCfgSource(cereal::UbloxGnss::HwStatus2::ConfigSource::ROM);
       break;
-    case ubx_t::mon_hw2_t::config_source_t::CONFIG_SOURCE_OTP:
+    case 111:
       hwStatus.setCfgSource(cereal::UbloxGnss::HwStatus2::ConfigSource::OTP);
       break;
-    case ubx_t::mon_hw2_t::config_source_t::CONFIG_SOURCE_CONFIG_PINS:
+    case 112:
       hwStatus.setCfgSource(cereal::UbloxGnss::HwStatus2::ConfigSource::CONFIGPINS);
       break;
-    case ubx_t::mon_hw2_t::config_source_t::CONFIG_SOURCE_FLASH:
+    case 102:
       hwStatus.setCfgSource(cereal::UbloxGnss::HwStatus2::ConfigSource::FLASH);
       break;
     default:
@@ -336,8 +457,7 @@ kj::Array<capnp::word> UbloxMsgParser::gen_mon_hw2(ubx_t::mon_hw2_t *msg) {
       break;
   }
 
-  hwStatus.setLowLevCfg(msg->low_lev_cfg());
-  hwStatus.setPostStatus(msg->post_status());
-
-  return capnp::messageToFlatArray(msg_builder);
+  hwStatus.setLowLevCfg(read_le<uint32_t>(&msg[8]));
+  hwStatus.setPostStatus(read_le<uint32_t>(&msg[20]));
+  return true;
 }
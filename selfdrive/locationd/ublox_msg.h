@@ -2,15 +2,12 @@
 
 #include <cassert>
 #include <cstdint>
-#include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <ctime>
 
 #include "cereal/messaging/messaging.h"
 #include "selfdrive/common/util.h"
-#include "selfdrive/locationd/generated/gps.h"
-#include "selfdrive/locationd/generated/ubx.h"
 
 using namespace std::string_literals;
 
@@ -28,6 +25,15 @@ namespace ublox {
   const uint8_t CLASS_RXM = 0x02;
   const uint8_t CLASS_MON = 0x0A;
 
+  // class and id
+  const uint16_t MSG_NAV_PVT = 0x0107;
+  const uint16_t MSG_RXM_SFRBX = 0x0213;
+  const uint16_t MSG_RXM_RAWX = 0x0215;
+  const uint16_t MSG_MON_HW = 0x0a09;
+  const uint16_t MSG_MON_HW2 = 0x0a0b;
+
+  const int GPS_SUBFRAME_SIZE = 30;
+
   struct ubx_mga_ini_time_utc_t {
     uint8_t type;
     uint8_t version;
@@ -88,29 +94,76 @@ namespace ublox {
   }
 }
 
+// GPS orbit and clock parameters from subframes 1-3, scaled to SI units
+struct GpsEphemeris {
+  int iode;
+  int gps_week;
+  double tgd, toc, af0, af1, af2;
+  double crs, delta_n, m0, cuc, ecc, cus, a, toe;
+  double cic, omega0, cis, i0, crc, omega, omega_dot, i_dot;
+};
+
+// Collects the subframes of the GPS navigation message per SV. The orbit is decoded
+// once per issue of data and cached, repeated broadcasts of the same ephemeris only
+// compare the IODE.
+class EphemerisStore {
+  public:
+    // Adds a subframe with the parity bits removed. Returns true once subframes 1-5 were
+    // received in one cycle, get() and iono() then hold the SV's data.
+    bool add_subframe(uint8_t sv_id, const uint8_t *subframe);
+    const GpsEphemeris &get(uint8_t sv_id) const { return svs[sv_id].eph; }
+    // Klobuchar parameters, only if the last subframe 4 was page 18
+    bool iono(uint8_t sv_id, double alpha[4], double beta[4]) const;
+
+  private:
+    struct Sv {
+      uint8_t subframes[5][ublox::GPS_SUBFRAME_SIZE];
+      uint8_t received = 0;  // bitmask of subframes in this cycle
+      bool eph_valid = false;
+      GpsEphemeris eph;
+    };
+    Sv svs[256];
+};
+
+// Streaming UBX parser. Messages that arrive whole are decoded straight from the input,
+// only split ones are collected in the parse buffer. Decoding goes into a message builder
+// whose first segment is allocated once, and the event is serialized into a reused
+// buffer, so steady state parsing doesn't allocate.
 class UbloxMsgParser {
   public:
+    UbloxMsgParser();
+    // Returns true when a complete message is available, which can point into
+    // incoming_data until the next call.
     bool add_data(const uint8_t *incoming_data, uint32_t incoming_data_len, size_t &bytes_consumed);
-    inline void reset() {bytes_in_parse_buf = 0;}
+    inline void reset() {bytes_in_parse_buf = 0; frame_len = 0;}
     inline int needed_bytes();
-    inline std::string data() {return std::string((const char*)msg_parse_buf, bytes_in_parse_buf);}
+    inline std::string data() {return std::string((const char*)frame, frame_len);}
 
-    std::pair<std::string, kj::Array<capnp::word>> gen_msg();
-    kj::Array<capnp::word> gen_nav_pvt(ubx_t::nav_pvt_t *msg);
-    kj::Array<capnp::word> gen_rxm_sfrbx(ubx_t::rxm_sfrbx_t *msg);
-    kj::Array<capnp::word> gen_rxm_rawx(ubx_t::rxm_rawx_t *msg);
-    kj::Array<capnp::word> gen_mon_hw(ubx_t::mon_hw_t *msg);
-    kj::Array<capnp::word> gen_mon_hw2(ubx_t::mon_hw2_t *msg);
+    // Decodes the complete message. Returns the service to publish it on and the
+    // serialized event, which stays valid until the next call, or NULL if there is nothing
+    // to publish.
+    std::pair<const char *, kj::ArrayPtr<capnp::byte>> gen_msg();
 
   private:
     inline bool valid_cheksum();
     inline bool valid();
     inline bool valid_so_far();
 
-    std::unordered_map<int, std::unordered_map<int, std::string>> gps_subframes;
+    bool gen_nav_pvt(cereal::Event::Builder event, const uint8_t *msg, size_t len);
+    bool gen_rxm_sfrbx(cereal::Event::Builder event, const uint8_t *msg, size_t len);
+    bool gen_rxm_rawx(cereal::Event::Builder event, const uint8_t *msg, size_t len);
+    bool gen_mon_hw(cereal::Event::Builder event, const uint8_t *msg, size_t len);
+    bool gen_mon_hw2(cereal::Event::Builder event, const uint8_t *msg, size_t len);
+
+    EphemerisStore ephemerides;
+
+    kj::Array<capnp::word> first_segment;
+    kj::Array<capnp::word> out_buf;
+
+    const uint8_t *frame = msg_parse_buf;
+    size_t frame_len = 0;
 
     size_t bytes_in_parse_buf = 0;
-    uint8_t msg_parse_buf[ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_MAX_MSG_SIZE];
+    uint8_t msg_parse_buf[ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_MAX_MSG_SIZE + ublox::UBLOX_CHECKSUM_SIZE];
 
 };
-
@@ -1,7 +1,5 @@
 #include <cassert>
 
-#include <kaitai/kaitaistream.h>
-
 #include "cereal/messaging/messaging.h"
 #include "selfdrive/common/swaglog.h"
 #include "selfdrive/common/util.h"
@@ -44,14 +42,9 @@ int main() {
       size_t bytes_consumed_this_time = 0U;
       if(parser.add_data(data + bytes_consumed, (uint32_t)(len - bytes_consumed), bytes_consumed_this_time)) {
 
-        try {
-          auto msg = parser.gen_msg();
-          if (msg.second.size() > 0) {
-            auto bytes = msg.second.asBytes();
-            pm.send(msg.first.c_str(), bytes.begin(), bytes.size());
-          }
-        } catch (const std::exception& e) {
-          LOGE("Error parsing ublox message %s", e.what());
+        auto [service, bytes] = parser.gen_msg();
+        if (service) {
+          pm.send(service, bytes.begin(), bytes.size());
         }
 
         parser.reset();
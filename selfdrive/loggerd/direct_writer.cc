@@ -0,0 +1,363 @@
+#include "selfdrive/loggerd/direct_writer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
+#include "selfdrive/common/util.h"
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+// O_DIRECT needs the buffer, offset and length aligned to the logical block size
+const size_t ALIGNMENT = 4096;
+const size_t CHUNK_SIZE = 256 * 1024;
+// write() blocks once this much is queued, 32 MB
+const size_t MAX_QUEUED_CHUNKS = 128;
+
+const int LATENCY_BUCKETS = 7;
+const double LATENCY_BUCKET_MS[LATENCY_BUCKETS] = {1, 2, 5, 10, 20, 50, 100};
+
+struct DirectWriter::File {
+  std::string path;
+  int fd = -1;
+  size_t prealloc = 0;
+  size_t offset = 0;
+};
+
+namespace {
+
+struct LatencyStats {
+  uint64_t hist[LATENCY_BUCKETS + 1] = {};
+  uint64_t writes = 0;
+  double max_ms = 0;
+};
+
+struct Preopened {
+  int fd;
+  size_t prealloc;
+  int generation;
+};
+
+struct Request {
+  enum Type { OPEN, WRITE, CLOSE, PREOPEN, DISCARD, CALL } type;
+  std::shared_ptr<DirectWriter::File> file;
+  uint8_t *buf = nullptr;
+  size_t len = 0;
+  // CLOSE: the size of the file, the last block is padded
+  size_t size = 0;
+  std::string dir;
+  std::vector<std::string> names;
+  std::function<void()> fn;
+};
+
+// a minute of video at the encoder bitrates, the logs are a lot smaller
+size_t prealloc_size(const std::string &name) {
+  const size_t ext = name.rfind('.');
+  if (ext != std::string::npos && name.compare(ext, std::string::npos, ".hevc") == 0) return 80 << 20;
+  if (name.compare(0, 4, "rlog") == 0) return 32 << 20;
+  return 4 << 20;
+}
+
+int open_file(const std::string &path, size_t prealloc) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  int fd = HANDLE_EINTR(open(path.c_str(), flags | O_DIRECT, 0664));
+  if (fd < 0 && errno == EINVAL) {
+    // e.g. tmpfs doesn't support O_DIRECT
+    fd = HANDLE_EINTR(open(path.c_str(), flags, 0664));
+  }
+  if (fd < 0) {
+    LOGE("failed to open %s: %s", path.c_str(), strerror(errno));
+    return -1;
+  }
+#ifdef __linux__
+  // the size grows with the writes, the blocks are reserved ahead
+  if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, prealloc) != 0) {
+    LOGD("fallocate %s failed: %s", path.c_str(), strerror(errno));
+  }
+#endif
+  return fd;
+}
+
+class Writer {
+public:
+  Writer() {
+    thread = std::thread(&Writer::run, this);
+  }
+  ~Writer() {
+    {
+      std::unique_lock lk(lock);
+      exit = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
+
+  void push(Request &&req) {
+    std::unique_lock lk(lock);
+    if (req.type == Request::WRITE) {
+      space_cv.wait(lk, [&] { return queued_chunks < MAX_QUEUED_CHUNKS; });
+      queued_chunks++;
+    }
+    queue.push_back(std::move(req));
+    cv.notify_all();
+  }
+
+  void wait_idle() {
+    std::unique_lock lk(lock);
+    space_cv.wait(lk, [&] { return queue.empty() && !busy; });
+  }
+
+  std::string report() {
+    std::map<std::string, LatencyStats> s;
+    {
+      std::unique_lock lk(stats_lock);
+      s.swap(stats);
+    }
+    std::string out;
+    for (auto &[name, st] : s) {
+      out += util::string_format("%s%s: %lu writes, max %.1f ms |", out.empty() ? "" : ", ", name.c_str(), (unsigned long)st.writes, st.max_ms);
+      for (int i = 0; i <= LATENCY_BUCKETS; ++i) {
+        out += util::string_format(" %s%gms %.1f%%", i < LATENCY_BUCKETS ? "<" : ">", LATENCY_BUCKET_MS[std::min(i, LATENCY_BUCKETS - 1)],
+                                   100. * st.hist[i] / st.writes);
+      }
+    }
+    return out;
+  }
+
+private:
+  void run() {
+    set_thread_name("loggerd_writer");
+    std::unique_lock lk(lock);
+    while (true) {
+      cv.wait(lk, [&] { return exit || !queue.empty(); });
+      if (queue.empty()) break;
+
+      Request req = std::move(queue.front());
+      queue.pop_front();
+      busy = true;
+      lk.unlock();
+      process(req);
+      lk.lock();
+      busy = false;
+      if (req.type == Request::WRITE) queued_chunks--;
+      space_cv.notify_all();
+    }
+  }
+
+  void process(Request &req) {
+    switch (req.type) {
+      case Request::OPEN: open(*req.file); break;
+      case Request::WRITE: write(*req.file, req.buf, req.len); break;
+      case Request::CLOSE: close(*req.file, req.buf, req.len, req.size); break;
+      case Request::PREOPEN: preopen(req.dir, req.names); break;
+      case Request::DISCARD: discard(INT32_MAX); break;
+      case Request::CALL: req.fn(); break;
+    }
+  }
+
+  void open(DirectWriter::File &f) {
+    auto it = preopened.find(f.path);
+    if (it != preopened.end()) {
+      Preopened p = it->second;
+      preopened.erase(it);
+      if (rename((f.path + ".tmp").c_str(), f.path.c_str()) == 0) {
+        f.fd = p.fd;
+        f.prealloc = p.prealloc;
+        return;
+      }
+      LOGE("failed to rename pre-opened %s: %s", f.path.c_str(), strerror(errno));
+      ::close(p.fd);
+      unlink((f.path + ".tmp").c_str());
+    }
+    f.prealloc = prealloc_size(util::base_name(f.path));
+    f.fd = open_file(f.path, f.prealloc);
+  }
+
+  void write(DirectWriter::File &f, uint8_t *buf, size_t len) {
+    if (f.fd >= 0 && len > 0) {
+      const double start = millis_since_boot();
+      size_t done = 0;
+      while (done < len) {
+        ssize_t ret = pwrite(f.fd, buf + done, len - done, f.offset + done);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+          LOGE("failed to write %s: %s", f.path.c_str(), strerror(errno));
+          break;
+        }
+        done += ret;
+      }
+      f.offset += len;
+      record(f.path, millis_since_boot() - start);
+    }
+    free(buf);
+  }
+
+  void close(DirectWriter::File &f, uint8_t *buf, size_t len, size_t size) {
+    write(f, buf, len);
+    if (f.fd < 0) return;
+
+    // drop the padding of the last block and the preallocated space that wasn't used
+    if (ftruncate(f.fd, size) != 0) {
+      LOGE("failed to truncate %s: %s", f.path.c_str(), strerror(errno));
+    }
+#ifdef __linux__
+    if (f.prealloc > f.offset) {
+      fallocate(f.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, f.offset, f.prealloc - f.offset);
+    }
+#endif
+    ::close(f.fd);
+    f.fd = -1;
+  }
+
+  void preopen(const std::string &dir, const std::vector<std::string> &names) {
+    // the previous segment's files may still be opened by the encoders
+    discard(++generation - 1);
+
+    if (!util::file_exists(dir)) {
+      util::create_directories(dir, 0775);
+      created_dirs[dir] = generation;
+    }
+    for (const auto &name : names) {
+      const std::string path = dir + "/" + name;
+      if (preopened.count(path)) continue;
+
+      const size_t prealloc = prealloc_size(name);
+      int fd = open_file(path + ".tmp", prealloc);
+      if (fd >= 0) {
+        preopened[path] = {fd, prealloc, generation};
+      }
+    }
+  }
+
+  void discard(int before_generation) {
+    for (auto it = preopened.begin(); it != preopened.end();) {
+      if (it->second.generation < before_generation) {
+        ::close(it->second.fd);
+        unlink((it->first + ".tmp").c_str());
+        it = preopened.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    // a segment that never started leaves its directory empty, the ones in use aren't removed
+    for (auto it = created_dirs.begin(); it != created_dirs.end();) {
+      if (it->second < before_generation) {
+        rmdir(it->first.c_str());
+        it = created_dirs.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void record(const std::string &path, double ms) {
+    int i = 0;
+    while (i < LATENCY_BUCKETS && ms >= LATENCY_BUCKET_MS[i]) ++i;
+
+    std::unique_lock lk(stats_lock);
+    LatencyStats &s = stats[util::base_name(path)];
+    s.hist[i]++;
+    s.writes++;
+    s.max_ms = std::max(s.max_ms, ms);
+  }
+
+  std::mutex lock;
+  std::condition_variable cv, space_cv;
+  std::deque<Request> queue;
+  size_t queued_chunks = 0;
+  bool busy = false, exit = false;
+
+  // only used on the writer thread
+  std::map<std::string, Preopened> preopened;
+  // segment directories created by preopen, with their generation
+  std::map<std::string, int> created_dirs;
+  int generation = 0;
+
+  std::mutex stats_lock;
+  std::map<std::string, LatencyStats> stats;
+
+  std::thread thread;
+};
+
+Writer &writer() {
+  static Writer w;
+  return w;
+}
+
+uint8_t *alloc_chunk() {
+  void *buf = aligned_alloc(ALIGNMENT, CHUNK_SIZE);
+  assert(buf);
+  return (uint8_t *)buf;
+}
+
+}  // namespace
+
+DirectWriter::DirectWriter(const std::string &path) : file_(std::make_shared<File>()) {
+  file_->path = path;
+  writer().push({.type = Request::OPEN, .file = file_});
+  buf_ = alloc_chunk();
+}
+
+DirectWriter::~DirectWriter() {
+  // zero the padding of the last block, it's truncated away
+  const size_t padded = (buf_len_ + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  memset(buf_ + buf_len_, 0, padded - buf_len_);
+  writer().push({.type = Request::CLOSE, .file = file_, .buf = buf_, .len = padded, .size = size_});
+}
+
+void DirectWriter::write(const void *data, size_t size) {
+  const uint8_t *src = (const uint8_t *)data;
+  size_ += size;
+  while (size > 0) {
+    const size_t n = std::min(size, CHUNK_SIZE - buf_len_);
+    memcpy(buf_ + buf_len_, src, n);
+    buf_len_ += n;
+    src += n;
+    size -= n;
+    if (buf_len_ == CHUNK_SIZE) {
+      writer().push({.type = Request::WRITE, .file = file_, .buf = buf_, .len = buf_len_});
+      buf_ = alloc_chunk();
+      buf_len_ = 0;
+    }
+  }
+}
+
+void DirectWriter::preopen(const std::string &segment_path, const std::vector<std::string> &names) {
+  writer().push({.type = Request::PREOPEN, .dir = segment_path, .names = names});
+}
+
+void DirectWriter::discard_preopened() {
+  writer().push({.type = Request::DISCARD});
+}
+
+void DirectWriter::after_pending(std::function<void()> f) {
+  writer().push({.type = Request::CALL, .fn = std::move(f)});
+}
+
+void DirectWriter::wait_idle() {
+  writer().wait_idle();
+}
+
+std::string DirectWriter::stats_report() {
+  return writer().report();
+}
+
+int direct_writer_write_packet(void *opaque, uint8_t *buf, int buf_size) {
+  ((DirectWriter *)opaque)->write(buf, buf_size);
+  return buf_size;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Appends to a file from a single writer thread, so loggerd and the encoders don't
+// wait on the disk. Data goes out in aligned blocks with O_DIRECT, bypassing the page
+// cache the camera and model buffers need, into space preallocated with fallocate.
+// Everything queued runs in order, the files are complete once the writer is destroyed
+// and after_pending() callbacks queued after that have run.
+class DirectWriter {
+public:
+  // a file pre-opened for this path is taken over
+  DirectWriter(const std::string &path);
+  ~DirectWriter();
+  void write(const void *data, size_t size);
+
+  // creates the files of a segment ahead of its rotation, under .tmp names until they're
+  // opened. The ones still not opened a segment later are removed, and so is the directory
+  // if preopen created it and nothing else was written there.
+  static void preopen(const std::string &segment_path, const std::vector<std::string> &names);
+  static void discard_preopened();
+  // runs f on the writer thread once everything queued before it is written
+  static void after_pending(std::function<void()> f);
+  // waits until everything queued is written
+  static void wait_idle();
+  // write latency histograms per file name since the last report
+  static std::string stats_report();
+
+  struct File;
+
+private:
+  std::shared_ptr<File> file_;
+  uint8_t *buf_ = nullptr;
+  size_t buf_len_ = 0;
+  size_t size_ = 0;
+};
+
+// write_packet callback for avio_alloc_context, opaque is the DirectWriter
+const int DIRECT_WRITER_AVIO_BUF_SIZE = 64 * 1024;
+int direct_writer_write_packet(void *opaque, uint8_t *buf, int buf_size);
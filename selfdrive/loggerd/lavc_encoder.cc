@@ -0,0 +1,127 @@
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+
+#include "selfdrive/loggerd/lavc_encoder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "libyuv.h"
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/util.h"
+
+LavcEncoder::LavcEncoder(const char* filename, int width, int height, int fps, int bitrate, bool h265, bool downscale, bool write)
+  : filename(filename), width(width), height(height), fps(fps), bitrate(bitrate), h265(h265), downscale(downscale), write(write) {
+  preset = util::getenv("LOGGERD_ENCODER_PRESET", "ultrafast");
+  threads = util::getenv("LOGGERD_ENCODER_THREADS", 0);
+
+  av_register_all();
+  codec = avcodec_find_encoder_by_name(h265 ? "libx265" : "libx264");
+  if (!codec) {
+    codec = avcodec_find_encoder(h265 ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264);
+  }
+  assert(codec);
+
+  frame = av_frame_alloc();
+  assert(frame);
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = width;
+  frame->height = height;
+  frame->linesize[0] = width;
+  frame->linesize[1] = width / 2;
+  frame->linesize[2] = width / 2;
+
+  if (downscale) {
+    downscale_buf.resize(width * height * 3 / 2);
+  }
+}
+
+LavcEncoder::~LavcEncoder() {
+  assert(!is_open);
+  av_frame_free(&frame);
+}
+
+void LavcEncoder::encoder_open(const char* path) {
+  vid_path = util::string_format("%s/%s", path, filename);
+  lock_path = util::string_format("%s/%s.lock", path, filename);
+
+  int lock_fd = HANDLE_EINTR(open(lock_path.c_str(), O_RDWR | O_CREAT, 0664));
+  assert(lock_fd >= 0);
+  close(lock_fd);
+
+  is_open = true;
+  counter = 0;
+  if (!write) return;
+
+  // same keyframe interval as the OMX h264 encoder, a second for hevc
+  LavcOutputConfig cfg = {width, height, fps, bitrate, (AVRational){ 1, fps }, h265 ? fps : 16};
+
+  // zerolatency: a packet out for every frame in, so the returned frame index is the packet's
+  AVDictionary *opts = NULL;
+  av_dict_set(&opts, "preset", preset.c_str(), 0);
+  av_dict_set(&opts, "tune", "zerolatency", 0);
+  if (strcmp(codec->name, "libx265") == 0) {
+    std::string params = "log-level=error";
+    if (threads > 0) {
+      params += util::string_format(":pools=%d:frame-threads=%d", threads, std::min(threads, 4));
+    }
+    av_dict_set(&opts, "x265-params", params.c_str(), 0);
+  } else {
+    av_dict_set_int(&opts, "threads", threads, 0);
+  }
+
+  // .hevc is the raw stream, qcamera.ts is mpegts. Neither muxer seeks, the file is
+  // appended to by the writer thread
+  writer = std::make_unique<DirectWriter>(vid_path);
+  output.open(codec, cfg, &opts, vid_path, writer.get(), direct_writer_write_packet);
+  av_dict_free(&opts);
+
+  LOGD("encoder_open %s (%s %s)", vid_path.c_str(), codec->name, preset.c_str());
+}
+
+void LavcEncoder::encoder_close() {
+  if (!is_open) return;
+
+  if (output.is_open()) {
+    output.close();
+    writer.reset();
+  }
+
+  DirectWriter::after_pending([lock_path = lock_path] { unlink(lock_path.c_str()); });
+  is_open = false;
+}
+
+int LavcEncoder::encode_frame(const uint8_t *y_ptr, const uint8_t *u_ptr, const uint8_t *v_ptr,
+                              int in_width, int in_height, uint64_t ts) {
+  if (!is_open) {
+    return -1;
+  }
+  if (!output.is_open()) {
+    // not recorded, only counted
+    return counter++;
+  }
+
+  if (downscale) {
+    uint8_t *y = downscale_buf.data(), *u = y + width * height, *v = u + width * height / 4;
+    libyuv::I420Scale(y_ptr, in_width, u_ptr, in_width / 2, v_ptr, in_width / 2,
+                      in_width, in_height,
+                      y, width, u, width / 2, v, width / 2,
+                      width, height, libyuv::kFilterNone);
+    y_ptr = y;
+    u_ptr = u;
+    v_ptr = v;
+  }
+  frame->data[0] = (uint8_t *)y_ptr;
+  frame->data[1] = (uint8_t *)u_ptr;
+  frame->data[2] = (uint8_t *)v_ptr;
+  frame->pts = counter;
+
+  if (output.encode(frame) < 0) {
+    return -1;
+  }
+  return counter++;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "selfdrive/loggerd/direct_writer.h"
+#include "selfdrive/loggerd/encoder.h"
+#include "selfdrive/loggerd/lavc_output.h"
+
+// LavcEncoder, lossy software hevc/h264 through libavcodec (libx265/libx264) for PC.
+// Writes the same files as OmxEncoder: raw hevc with in-band parameter sets and h264
+// remuxed into the container of the filename. Every file gets its own codec context,
+// so it starts with a keyframe and the frames still in the encoder end up in it.
+//
+// LOGGERD_ENCODER_PRESET (default "ultrafast") and LOGGERD_ENCODER_THREADS (default 0,
+// the encoder's choice) configure the encoder.
+class LavcEncoder : public VideoEncoder {
+public:
+  LavcEncoder(const char* filename, int width, int height, int fps, int bitrate, bool h265, bool downscale, bool write = true);
+  ~LavcEncoder();
+  int encode_frame(const uint8_t *y_ptr, const uint8_t *u_ptr, const uint8_t *v_ptr,
+                   int in_width, int in_height, uint64_t ts);
+  void encoder_open(const char* path);
+  void encoder_close();
+
+private:
+  const char* filename;
+  int width, height, fps, bitrate;
+  bool h265, downscale, write;
+  std::string preset;
+  int threads;
+
+  std::string vid_path, lock_path;
+  bool is_open = false;
+  int counter = 0;
+
+  AVCodec *codec = nullptr;
+  std::unique_ptr<DirectWriter> writer;
+  LavcOutput output;
+  AVFrame *frame = nullptr;
+  std::vector<uint8_t> downscale_buf;
+};
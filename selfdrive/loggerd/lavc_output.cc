@@ -0,0 +1,98 @@
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+
+#include "selfdrive/loggerd/lavc_output.h"
+
+#include <cassert>
+
+#include "selfdrive/common/swaglog.h"
+
+// custom IO buffer size
+const int AVIO_BUF_SIZE = 64 * 1024;
+
+void LavcOutput::open(AVCodec *codec, const LavcOutputConfig &cfg, AVDictionary **opts, const std::string &path,
+                      void *opaque, int (*write_packet)(void *opaque, uint8_t *buf, int buf_size)) {
+  assert(!is_open());
+  this->path = path;
+
+  codec_ctx = avcodec_alloc_context3(codec);
+  assert(codec_ctx);
+  codec_ctx->width = cfg.width;
+  codec_ctx->height = cfg.height;
+  codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  codec_ctx->bit_rate = cfg.bitrate;
+  codec_ctx->time_base = cfg.time_base;
+  codec_ctx->framerate = (AVRational){ cfg.fps, 1 };
+  codec_ctx->gop_size = cfg.gop_size;
+  codec_ctx->max_b_frames = 0;
+
+  avformat_alloc_output_context2(&format_ctx, NULL, NULL, path.c_str());
+  assert(format_ctx);
+  if (format_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+    codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  int err = avcodec_open2(codec_ctx, codec, opts);
+  assert(err >= 0);
+
+  stream = avformat_new_stream(format_ctx, codec);
+  assert(stream);
+  stream->time_base = codec_ctx->time_base;
+  err = avcodec_parameters_from_context(stream->codecpar, codec_ctx);
+  assert(err >= 0);
+
+  custom_io = write_packet != nullptr;
+  if (custom_io) {
+    format_ctx->pb = avio_alloc_context((uint8_t *)av_malloc(AVIO_BUF_SIZE), AVIO_BUF_SIZE, 1, opaque, NULL, write_packet, NULL);
+    assert(format_ctx->pb);
+    format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+  } else {
+    err = avio_open(&format_ctx->pb, path.c_str(), AVIO_FLAG_WRITE);
+    assert(err >= 0);
+  }
+  err = avformat_write_header(format_ctx, NULL);
+  assert(err >= 0);
+}
+
+void LavcOutput::close() {
+  if (!is_open()) return;
+
+  // drain the delayed frames into this file
+  while (encode(NULL) > 0) {}
+
+  av_write_trailer(format_ctx);
+  avcodec_free_context(&codec_ctx);
+  if (custom_io) {
+    avio_flush(format_ctx->pb);
+    av_freep(&format_ctx->pb->buffer);
+    avio_context_free(&format_ctx->pb);
+  } else {
+    avio_closep(&format_ctx->pb);
+  }
+  avformat_free_context(format_ctx);
+  format_ctx = NULL;
+  stream = NULL;
+}
+
+int LavcOutput::encode(AVFrame *frame) {
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = NULL;
+  pkt.size = 0;
+
+  int got_output = 0;
+  int err = avcodec_encode_video2(codec_ctx, &pkt, frame, &got_output);
+  if (err < 0) {
+    LOGE("%s encoding error %d", path.c_str(), err);
+    return -1;
+  }
+  if (got_output) {
+    av_packet_rescale_ts(&pkt, codec_ctx->time_base, stream->time_base);
+    pkt.stream_index = stream->index;
+    err = av_interleaved_write_frame(format_ctx, &pkt);
+    if (err < 0) {
+      LOGE("%s writer error %d", path.c_str(), err);
+      return -1;
+    }
+  }
+  return got_output;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+struct LavcOutputConfig {
+  int width, height, fps, bitrate;
+  AVRational time_base;
+  int gop_size;
+};
+
+// One encoded file through libavcodec: an encoder context and the muxer, which is picked
+// from the file name. Every open() gets a fresh codec context, so each file starts with
+// a keyframe and its own headers, and close() drains the frames still in the encoder
+// into it. Used by loggerd's LavcEncoder and the UI's screen recorder.
+class LavcOutput {
+public:
+  ~LavcOutput() { close(); }
+
+  // opts are passed to avcodec_open2. With write_packet the muxed bytes go to it with
+  // opaque through a custom AVIOContext, the muxer must not seek. Otherwise the file
+  // is opened with avio.
+  void open(AVCodec *codec, const LavcOutputConfig &cfg, AVDictionary **opts, const std::string &path,
+            void *opaque = nullptr, int (*write_packet)(void *opaque, uint8_t *buf, int buf_size) = nullptr);
+  // encodes and writes a frame with its pts in time_base units, NULL drains the encoder.
+  // Returns 1 if a packet was written, 0 if the encoder held it back, < 0 on error.
+  int encode(AVFrame *frame);
+  void close();
+  bool is_open() const { return format_ctx != nullptr; }
+
+private:
+  std::string path;
+  bool custom_io = false;
+  AVCodecContext *codec_ctx = nullptr;
+  AVFormatContext *format_ctx = nullptr;
+  AVStream *stream = nullptr;
+};
@@ -278,7 +278,8 @@ void lh_close(LoggerHandle* h) {
   if (h->refcnt == 0) {
     h->log.reset(nullptr);
     h->q_log.reset(nullptr);
-    unlink(h->lock_path);
+    // the handle is reused, the lock goes once the logs are on disk
+    DirectWriter::after_pending([lock_path = std::string(h->lock_path)] { unlink(lock_path.c_str()); });
     pthread_mutex_unlock(&h->lock);
     pthread_mutex_destroy(&h->lock);
     return;
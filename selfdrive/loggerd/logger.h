@@ -15,46 +15,49 @@
 #include "selfdrive/common/util.h"
 #include "selfdrive/common/swaglog.h"
 #include "selfdrive/hardware/hw.h"
+#include "selfdrive/loggerd/direct_writer.h"
 
 const std::string LOG_ROOT = Path::log_root();
 
 #define LOGGER_MAX_HANDLES 16
 
+// bzip2 compressed file written through DirectWriter
 class BZFile {
  public:
-  BZFile(const char* path) {
-    file = fopen(path, "wb");
-    assert(file != nullptr);
-    int bzerror;
-    bz_file = BZ2_bzWriteOpen(&bzerror, file, 9, 0, 30);
-    assert(bzerror == BZ_OK);
+  BZFile(const char* path) : file(path) {
+    int ret = BZ2_bzCompressInit(&strm, 9, 0, 30);
+    assert(ret == BZ_OK);
   }
   ~BZFile() {
-    int bzerror;
-    BZ2_bzWriteClose(&bzerror, bz_file, 0, nullptr, nullptr);
-    if (bzerror != BZ_OK) {
-      LOGE("BZ2_bzWriteClose error, bzerror=%d", bzerror);
-    }
-    int err = fclose(file);
-    assert(err == 0);
+    compress(nullptr, 0, BZ_FINISH);
+    BZ2_bzCompressEnd(&strm);
   }
-  inline void write(void* data, size_t size) {
-    int bzerror;
+  inline void write(void* data, size_t size) { compress(data, size, BZ_RUN); }
+  inline void write(kj::ArrayPtr<capnp::byte> array) { write(array.begin(), array.size()); }
+
+ private:
+  void compress(void* data, size_t size, int action) {
+    strm.next_in = (char*)data;
+    strm.avail_in = size;
+    int ret;
     do {
-      BZ2_bzWrite(&bzerror, bz_file, data, size);
-    } while (bzerror == BZ_IO_ERROR && errno == EINTR);
+      strm.next_out = out;
+      strm.avail_out = sizeof(out);
+      ret = BZ2_bzCompress(&strm, action);
+      file.write(out, sizeof(out) - strm.avail_out);
+    } while ((action == BZ_RUN && ret == BZ_RUN_OK && strm.avail_in > 0) || (action == BZ_FINISH && ret == BZ_FINISH_OK));
 
-    if (bzerror != BZ_OK && !error_logged) {
-      LOGE("BZ2_bzWrite error, bzerror=%d", bzerror);
+    const int ok = action == BZ_RUN ? BZ_RUN_OK : BZ_STREAM_END;
+    if (ret != ok && !error_logged) {
+      LOGE("BZ2_bzCompress error, ret=%d", ret);
       error_logged = true;
     }
   }
-  inline void write(kj::ArrayPtr<capnp::byte> array) { write(array.begin(), array.size()); }
 
- private:
   bool error_logged = false;
-  FILE* file = nullptr;
-  BZFILE* bz_file = nullptr;
+  bz_stream strm = {};
+  char out[64 * 1024];
+  DirectWriter file;
 };
 
 typedef cereal::Sentinel::SentinelType SentinelType;
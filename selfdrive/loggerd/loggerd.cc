@@ -3,6 +3,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cerrno>
@@ -11,6 +12,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <string>
@@ -28,19 +30,26 @@
 #include "selfdrive/common/util.h"
 #include "selfdrive/hardware/hw.h"
 
+#include "selfdrive/loggerd/direct_writer.h"
 #include "selfdrive/loggerd/encoder.h"
 #include "selfdrive/loggerd/logger.h"
 #if defined(QCOM) || defined(QCOM2)
 #include "selfdrive/loggerd/omx_encoder.h"
 #define Encoder OmxEncoder
 #else
+#include "selfdrive/loggerd/lavc_encoder.h"
 #include "selfdrive/loggerd/raw_logger.h"
-#define Encoder RawLogger
+#define Encoder LavcEncoder
 #endif
 
 namespace {
 
 constexpr int MAIN_FPS = 20;
+// frames queued per encoder before new ones are dropped
+constexpr int MAX_QUEUED_FRAMES = MAIN_FPS;
+// camerad reuses its VisionIPC buffers in turn, a queued frame is dropped once it's this
+// many frames short of being overwritten, so it can't be reused while it's encoded
+constexpr int BUFFER_REUSE_MARGIN = MAIN_FPS / 2;
 const int MAIN_BITRATE = Hardware::TICI() ? 10000000 : 5000000;
 const int DCAM_BITRATE = Hardware::TICI() ? MAIN_BITRATE : 2500000;
 
@@ -48,6 +57,8 @@ const int DCAM_BITRATE = Hardware::TICI() ? MAIN_BITRATE : 2500000;
 
 const bool LOGGERD_TEST = getenv("LOGGERD_TEST");
 const int SEGMENT_LENGTH = LOGGERD_TEST ? atoi(getenv("LOGGERD_SEGMENT_LENGTH")) : 60;
+// lossless ffvhuff mkv instead of hevc on PC
+const bool LOGGERD_RAW_ENCODER = getenv("LOGGERD_RAW_ENCODER");
 
 ExitHandler do_exit;
 
@@ -105,6 +116,15 @@ const LogCameraInfo qcam_info = {
   .frame_height = Hardware::TICI() ? 330 : 360 // keep pixel count the same?
 };
 
+VideoEncoder *new_encoder(const char *filename, int width, int height, int fps, int bitrate, bool h265, bool downscale, bool write = true) {
+#if !defined(QCOM) && !defined(QCOM2)
+  if (LOGGERD_RAW_ENCODER) {
+    return new RawLogger(filename, width, height, fps, bitrate, h265, downscale, write);
+  }
+#endif
+  return new Encoder(filename, width, height, fps, bitrate, h265, downscale, write);
+}
+
 struct LoggerdState {
   Context *ctx;
   LoggerState logger = {};
@@ -125,13 +145,126 @@ struct LoggerdState {
 };
 LoggerdState s;
 
-void encoder_thread(const LogCameraInfo &cam_info) {
+// A queued frame, references the VisionIPC buffer instead of copying it. The worker drops
+// it instead of encoding it once camerad is about to reuse the buffer.
+struct EncoderJob {
+  VisionBuf *buf;  // nullptr to exit
+  VisionIpcBufExtra extra;
+  // segment boundaries the camera passed before this frame
+  int boundaries;
+};
+
+struct EncoderWorker {
+  VideoEncoder *encoder;
+  bool log_idx;  // encodeIdx of the main encoder only
+  SafeQueue<EncoderJob> queue;
+  // frames dropped because the queue was full or their buffer was about to be reused
+  std::atomic<uint32_t> dropped = 0;
+  std::thread thread;
+};
+
+// the newest frame the camera thread received, and how far behind it a queued frame can be
+struct FrameAge {
+  std::atomic<uint32_t> latest_frame_id = 0;
+  uint32_t max_age = 1;
+};
+
+void encoder_worker(const LogCameraInfo &cam_info, EncoderWorker &w, const FrameAge &age) {
   set_thread_name(cam_info.filename);
 
-  int cnt = 0, cur_seg = -1;
+  int cur_seg = -1, boundaries = 0;
   int encode_idx = 0;
+  uint32_t seg_dropped = 0;
   LoggerHandle *lh = NULL;
-  std::vector<Encoder *> encoders;
+
+  while (!do_exit) {
+    EncoderJob job = w.queue.pop();
+    if (job.buf == nullptr) break;
+
+    std::unique_lock lk(s.rotate_lock);
+    // the cameras that trigger the rotation rotate at their boundary frame, the frames queued
+    // before it still belong to the old segment. The others follow the logger.
+    bool rotate = cur_seg == -1 || (!cam_info.trigger_rotate && s.rotate_segment > cur_seg);
+    if (job.boundaries > boundaries) {
+      // only this encoder waits for the logger to rotate, its frames queue up meanwhile
+      s.rotate_cv.wait(lk, [&] { return s.rotate_segment > cur_seg || do_exit; });
+      boundaries = job.boundaries;
+      rotate = true;
+    }
+    if (do_exit) break;
+
+    if (rotate) {
+      cur_seg = s.rotate_segment;
+      std::string segment_path = s.segment_path;
+      lk.unlock();
+
+      LOGW("camera %d rotate encoder to %s", cam_info.type, segment_path.c_str());
+      w.encoder->encoder_close();
+      w.encoder->encoder_open(segment_path.c_str());
+      if (w.log_idx) {
+        if (lh) {
+          lh_close(lh);
+        }
+        lh = logger_get_handle(&s.logger);
+      }
+      seg_dropped = w.dropped;
+    } else {
+      lk.unlock();
+    }
+
+    if (age.latest_frame_id - job.extra.frame_id >= age.max_age) {
+      if (w.dropped++ % MAIN_FPS == 0) {
+        LOGW("%s encoder behind, dropped stale frame %d, %u dropped", cam_info.filename, job.extra.frame_id, w.dropped.load());
+      }
+      continue;
+    }
+
+    // encode a frame
+    VisionBuf *buf = job.buf;
+    const VisionIpcBufExtra &extra = job.extra;
+    int out_id = w.encoder->encode_frame(buf->y, buf->u, buf->v, buf->width, buf->height, extra.timestamp_eof);
+    if (out_id == -1) {
+      LOGE("Failed to encode frame. frame_id: %d encode_id: %d", extra.frame_id, encode_idx);
+    }
+
+    // publish encode index
+    if (w.log_idx && out_id != -1) {
+      MessageBuilder msg;
+      // this is really ugly
+      auto eidx = cam_info.type == DriverCam ? msg.initEvent().initDriverEncodeIdx() :
+                 (cam_info.type == WideRoadCam ? msg.initEvent().initWideRoadEncodeIdx() : msg.initEvent().initRoadEncodeIdx());
+      eidx.setFrameId(extra.frame_id);
+      eidx.setTimestampSof(extra.timestamp_sof);
+      eidx.setTimestampEof(extra.timestamp_eof);
+      if (Hardware::TICI()) {
+        eidx.setType(cereal::EncodeIndex::Type::FULL_H_E_V_C);
+      } else {
+        eidx.setType(cam_info.type == DriverCam ? cereal::EncodeIndex::Type::FRONT : cereal::EncodeIndex::Type::FULL_H_E_V_C);
+      }
+      eidx.setEncodeId(encode_idx);
+      eidx.setSegmentNum(cur_seg);
+      eidx.setSegmentId(out_id);
+      eidx.setDroppedFrames(w.dropped - seg_dropped);
+      if (lh) {
+        // TODO: this should read cereal/services.h for qlog decimation
+        auto bytes = msg.toBytes();
+        lh_log(lh, bytes.begin(), bytes.size(), true);
+      }
+    }
+    encode_idx++;
+  }
+
+  if (lh) {
+    lh_close(lh);
+  }
+}
+
+void encoder_thread(const LogCameraInfo &cam_info) {
+  set_thread_name(cam_info.filename);
+
+  int cnt = 0, boundaries = 0;
+  FrameAge age;
+  std::vector<std::unique_ptr<EncoderWorker>> workers;
   VisionIpcClient vipc_client = VisionIpcClient("camerad", cam_info.stream_type, false);
 
   bool ready = false;
@@ -142,19 +275,27 @@ void encoder_thread(const LogCameraInfo &cam_info) {
       continue;
     }
 
-    // init encoders
-    if (encoders.empty()) {
+    // init encoders, each on its own worker
+    if (workers.empty()) {
       VisionBuf buf_info = vipc_client.buffers[0];
       LOGD("encoder init %dx%d", buf_info.width, buf_info.height);
 
       // main encoder
-      encoders.push_back(new Encoder(cam_info.filename, buf_info.width, buf_info.height,
-                                     cam_info.fps, cam_info.bitrate, cam_info.is_h265,
-                                     cam_info.downscale, cam_info.record));
+      workers.push_back(std::make_unique<EncoderWorker>());
+      workers.back()->encoder = new_encoder(cam_info.filename, buf_info.width, buf_info.height,
+                                            cam_info.fps, cam_info.bitrate, cam_info.is_h265,
+                                            cam_info.downscale, cam_info.record);
+      workers.back()->log_idx = true;
       // qcamera encoder
       if (cam_info.has_qcamera) {
-        encoders.push_back(new Encoder(qcam_info.filename, qcam_info.frame_width, qcam_info.frame_height,
-                                       qcam_info.fps, qcam_info.bitrate, qcam_info.is_h265, qcam_info.downscale));
+        workers.push_back(std::make_unique<EncoderWorker>());
+        workers.back()->encoder = new_encoder(qcam_info.filename, qcam_info.frame_width, qcam_info.frame_height,
+                                              qcam_info.fps, qcam_info.bitrate, qcam_info.is_h265, qcam_info.downscale);
+        workers.back()->log_idx = false;
+      }
+      age.max_age = std::max(vipc_client.num_buffers - BUFFER_REUSE_MARGIN, 1);
+      for (auto &w : workers) {
+        w->thread = std::thread(encoder_worker, std::cref(cam_info), std::ref(*w), std::cref(age));
       }
     }
 
@@ -186,78 +327,36 @@ void encoder_thread(const LogCameraInfo &cam_info) {
         s.last_camera_seen_tms = millis_since_boot();
       }
 
+      // trigger rotate, the workers wait for the logger before the next frame
       if (cam_info.trigger_rotate && (cnt >= SEGMENT_LENGTH * MAIN_FPS)) {
-        // trigger rotate and wait logger rotated to new segment
         ++s.waiting_rotate;
-        std::unique_lock lk(s.rotate_lock);
-        s.rotate_cv.wait(lk, [&] { return s.rotate_segment > cur_seg || do_exit; });
-      }
-      if (do_exit) break;
-
-      // rotate the encoder if the logger is on a newer segment
-      if (s.rotate_segment > cur_seg) {
-        cur_seg = s.rotate_segment;
+        ++boundaries;
         cnt = 0;
-
-        LOGW("camera %d rotate encoder to %s", cam_info.type, s.segment_path);
-        for (auto &e : encoders) {
-          e->encoder_close();
-          e->encoder_open(s.segment_path);
-        }
-        if (lh) {
-          lh_close(lh);
-        }
-        lh = logger_get_handle(&s.logger);
       }
 
-      // encode a frame
-      for (int i = 0; i < encoders.size(); ++i) {
-        int out_id = encoders[i]->encode_frame(buf->y, buf->u, buf->v,
-                                               buf->width, buf->height, extra.timestamp_eof);
-
-        if (out_id == -1) {
-          LOGE("Failed to encode frame. frame_id: %d encode_id: %d", extra.frame_id, encode_idx);
-        }
-
-        // publish encode index
-        if (i == 0 && out_id != -1) {
-          MessageBuilder msg;
-          // this is really ugly
-          auto eidx = cam_info.type == DriverCam ? msg.initEvent().initDriverEncodeIdx() :
-                     (cam_info.type == WideRoadCam ? msg.initEvent().initWideRoadEncodeIdx() : msg.initEvent().initRoadEncodeIdx());
-          eidx.setFrameId(extra.frame_id);
-          eidx.setTimestampSof(extra.timestamp_sof);
-          eidx.setTimestampEof(extra.timestamp_eof);
-          if (Hardware::TICI()) {
-            eidx.setType(cereal::EncodeIndex::Type::FULL_H_E_V_C);
-          } else {
-            eidx.setType(cam_info.type == DriverCam ? cereal::EncodeIndex::Type::FRONT : cereal::EncodeIndex::Type::FULL_H_E_V_C);
-          }
-          eidx.setEncodeId(encode_idx);
-          eidx.setSegmentNum(cur_seg);
-          eidx.setSegmentId(out_id);
-          if (lh) {
-            // TODO: this should read cereal/services.h for qlog decimation
-            auto bytes = msg.toBytes();
-            lh_log(lh, bytes.begin(), bytes.size(), true);
+      // a full queue drops the new frame, the workers drop the queued ones that got too old
+      age.latest_frame_id = extra.frame_id;
+      for (auto &w : workers) {
+        if (w->queue.size() >= MAX_QUEUED_FRAMES) {
+          if (w->dropped++ % MAIN_FPS == 0) {
+            LOGW("%s encoder behind, dropped frame %d, %u dropped", cam_info.filename, extra.frame_id, w->dropped.load());
           }
+        } else {
+          w->queue.push({buf, extra, boundaries});
         }
       }
-
       cnt++;
-      encode_idx++;
-    }
-
-    if (lh) {
-      lh_close(lh);
-      lh = NULL;
     }
   }
 
   LOG("encoder destroy");
-  for(auto &e : encoders) {
-    e->encoder_close();
-    delete e;
+  for (auto &w : workers) {
+    w->queue.push({});
+  }
+  for (auto &w : workers) {
+    w->thread.join();
+    w->encoder->encoder_close();
+    delete w->encoder;
   }
 }
 
@@ -273,6 +372,20 @@ void clear_locks() {
   ftw(LOG_ROOT.c_str(), clear_locks_fn, 16);
 }
 
+// creates the files of the next segment ahead, so opening them doesn't wait on the disk at the rotation
+void preopen_next_segment() {
+  std::vector<std::string> names = {std::string(s.logger.log_name) + ".bz2"};
+  if (s.logger.has_qlog) names.push_back("qlog.bz2");
+  if (!LOGGERD_RAW_ENCODER) {
+    for (const auto &ci : cameras_logged) {
+      if (!ci.enable) continue;
+      if (ci.record) names.push_back(ci.filename);
+      if (ci.has_qcamera) names.push_back(qcam_info.filename);
+    }
+  }
+  DirectWriter::preopen(util::string_format("%s/%s--%d", LOG_ROOT.c_str(), s.logger.route_name.c_str(), s.logger.part + 1), names);
+}
+
 void logger_rotate() {
   {
     std::unique_lock lk(s.rotate_lock);
@@ -282,9 +395,15 @@ void logger_rotate() {
     s.rotate_segment = segment;
     s.waiting_rotate = 0;
     s.last_rotate_tms = millis_since_boot();
+    preopen_next_segment();
   }
   s.rotate_cv.notify_all();
   LOGW((s.logger.part == 0) ? "logging to %s" : "rotated to %s", s.segment_path);
+
+  std::string write_stats = DirectWriter::stats_report();
+  if (!write_stats.empty()) {
+    LOGW("write latency: %s", write_stats.c_str());
+  }
 }
 
 void rotate_if_needed() {
@@ -390,6 +509,8 @@ int main(int argc, char** argv) {
 
   LOGW("closing logger");
   logger_close(&s.logger, &do_exit);
+  DirectWriter::discard_preopened();
+  DirectWriter::wait_idle();
 
   if (do_exit.power_failure) {
     LOGE("power failure");
@@ -344,7 +344,7 @@ void OmxEncoder::handle_out_buf(OmxEncoder *e, OMX_BUFFERHEADERTYPE *out_buf) {
 
   if (e->of) {
     //printf("write %d flags 0x%x\n", out_buf->nFilledLen, out_buf->nFlags);
-    fwrite(buf_data, out_buf->nFilledLen, 1, e->of);
+    e->of->write(buf_data, out_buf->nFilledLen);
   }
 
   if (e->remuxing) {
@@ -473,8 +473,6 @@ int OmxEncoder::encode_frame(const uint8_t *y_ptr, const uint8_t *u_ptr, const u
 }
 
 void OmxEncoder::encoder_open(const char* path) {
-  int err;
-
   snprintf(this->vid_path, sizeof(this->vid_path), "%s/%s", path, this->filename);
   LOGD("encoder_open %s remuxing:%d", this->vid_path, this->remuxing);
 
@@ -499,17 +497,20 @@ void OmxEncoder::encoder_open(const char* path) {
     this->codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
     this->codec_ctx->time_base = (AVRational){ 1, this->fps };
 
-    err = avio_open(&this->ofmt_ctx->pb, this->vid_path, AVIO_FLAG_WRITE);
-    assert(err >= 0);
+    // mpegts doesn't seek, the file is appended to by the writer thread
+    this->remux_of = std::make_unique<DirectWriter>(this->vid_path);
+    this->ofmt_ctx->pb = avio_alloc_context((uint8_t *)av_malloc(DIRECT_WRITER_AVIO_BUF_SIZE), DIRECT_WRITER_AVIO_BUF_SIZE, 1,
+                                            this->remux_of.get(), NULL, direct_writer_write_packet, NULL);
+    assert(this->ofmt_ctx->pb);
+    this->ofmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
 
     this->wrote_codec_config = false;
   } else {
     if (this->write) {
-      this->of = fopen(this->vid_path, "wb");
-      assert(this->of);
+      this->of = std::make_unique<DirectWriter>(this->vid_path);
 #ifndef QCOM2
       if (this->codec_config_len > 0) {
-        fwrite(this->codec_config, this->codec_config_len, 1, this->of);
+        this->of->write(this->codec_config, this->codec_config_len);
       }
 #endif
     }
@@ -553,15 +554,15 @@ void OmxEncoder::encoder_close() {
     if (this->remuxing) {
       av_write_trailer(this->ofmt_ctx);
       avcodec_free_context(&this->codec_ctx);
-      avio_closep(&this->ofmt_ctx->pb);
+      avio_flush(this->ofmt_ctx->pb);
+      av_freep(&this->ofmt_ctx->pb->buffer);
+      avio_context_free(&this->ofmt_ctx->pb);
       avformat_free_context(this->ofmt_ctx);
+      this->remux_of.reset();
     } else {
-      if (this->of) {
-        fclose(this->of);
-        this->of = nullptr;
-      }
+      this->of.reset();
     }
-    unlink(this->lock_path);
+    DirectWriter::after_pending([lock_path = std::string(this->lock_path)] { unlink(lock_path.c_str()); });
   }
   this->is_open = false;
 }
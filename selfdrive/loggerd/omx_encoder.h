@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <vector>
 
 #include <OMX_Component.h>
@@ -10,6 +11,7 @@ extern "C" {
 }
 
 #include "selfdrive/common/queue.h"
+#include "selfdrive/loggerd/direct_writer.h"
 #include "selfdrive/loggerd/encoder.h"
 
 // OmxEncoder, lossey codec using hardware hevc
@@ -43,7 +45,7 @@ private:
   int counter = 0;
 
   const char* filename;
-  FILE *of = nullptr;
+  std::unique_ptr<DirectWriter> of, remux_of;
 
   size_t codec_config_len;
   uint8_t *codec_config = NULL;
@@ -1,4 +1,3 @@
-
 #include <sys/resource.h>
 
 #include "selfdrive/common/util.h"
@@ -9,10 +8,21 @@ ExitHandler do_exit;
 int main(int argc, char **argv) {
   setpriority(PRIO_PROCESS, 0, -15);
 
+  // ProcCollector keeps a fd open per process and per openpilot thread
+  struct rlimit rlim;
+  if (getrlimit(RLIMIT_NOFILE, &rlim) == 0) {
+    rlim.rlim_cur = rlim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rlim);
+  }
+
+  // per thread stats every n messages, every 10s by default
+  const char *thread_interval = getenv("PROCLOG_THREAD_INTERVAL");
+  ProcCollector collector(thread_interval ? atoi(thread_interval) : 5);
+
   PubMaster publisher({"procLog"});
   while (!do_exit) {
     MessageBuilder msg;
-    buildProcLogMessage(msg);
+    collector.build(msg);
     publisher.send("procLog", msg);
 
     util::sleep_for(2000);  // 2 secs
@@ -1,8 +1,12 @@
 #include "selfdrive/proclogd/proclog.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <sstream>
@@ -154,13 +158,161 @@ const ProcCache &getProcExtraInfo(int pid, const std::string &name) {
 
 }  // namespace Parser
 
+namespace Scanner {
+
+namespace {
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\n';
+}
+
+// parses the whole token [s, e) as a decimal number
+template <typename T>
+bool to_num(const char *s, const char *e, T &v) {
+  bool neg = s < e && *s == '-';
+  if (neg) s++;
+  if (s == e) return false;
+
+  T r = 0;
+  for (; s < e; s++) {
+    if (*s < '0' || *s > '9') return false;
+    r = r * 10 + (*s - '0');
+  }
+  v = neg ? T(0) - r : r;
+  return true;
+}
+
+// advances s to the next space separated token on the line and returns its end
+inline const char *next_token(const char *&s, const char *end) {
+  while (s < end && *s == ' ') s++;
+  const char *e = s;
+  while (e < end && !is_space(*e)) e++;
+  return e;
+}
+
+}  // namespace
+
+bool procStat(const char *buf, size_t len, ProcStat &p) {
+  // To avoid being fooled by names containing a closing paren, scan backwards.
+  const char *end = buf + len;
+  const char *open_paren = (const char *)memchr(buf, '(', len);
+  const char *close_paren = (const char *)memrchr(buf, ')', len);
+  if (!open_paren || !close_paren || open_paren > close_paren) {
+    return false;
+  }
+
+  const char *s = buf;
+  const char *e = next_token(s, open_paren);
+  if (!to_num(s, e, p.pid)) return false;
+  p.name.assign(open_paren + 1, close_paren);
+
+  using Parser::StatPos;
+  int field = 2;
+  s = close_paren + 1;
+  while (true) {
+    while (s < end && is_space(*s)) s++;
+    if (s == end) break;
+    e = next_token(s, end);
+    bool ok = true;
+    switch (++field) {
+      case StatPos::state: p.state = *s; break;
+      case StatPos::ppid: ok = to_num(s, e, p.ppid); break;
+      case StatPos::utime: ok = to_num(s, e, p.utime); break;
+      case StatPos::stime: ok = to_num(s, e, p.stime); break;
+      case StatPos::cutime: ok = to_num(s, e, p.cutime); break;
+      case StatPos::cstime: ok = to_num(s, e, p.cstime); break;
+      case StatPos::priority: ok = to_num(s, e, p.priority); break;
+      case StatPos::nice: ok = to_num(s, e, p.nice); break;
+      case StatPos::num_threads: ok = to_num(s, e, p.num_threads); break;
+      case StatPos::starttime: ok = to_num(s, e, p.starttime); break;
+      case StatPos::vsize: ok = to_num(s, e, p.vms); break;
+      case StatPos::rss: ok = to_num(s, e, p.rss); break;
+      case StatPos::processor: ok = to_num(s, e, p.processor); break;
+      default: break;
+    }
+    if (!ok) return false;
+    s = e;
+  }
+  return field == StatPos::MAX_FIELD;
+}
+
+void cmdline(const char *buf, size_t len, std::vector<std::string> &args) {
+  args.clear();
+  const char *end = buf + len;
+  while (buf < end) {
+    const char *e = (const char *)memchr(buf, '\0', end - buf);
+    if (!e) e = end;
+    if (e > buf) {
+      args.emplace_back(buf, e);
+    }
+    buf = e + 1;
+  }
+}
+
+void cpuTimes(const char *buf, size_t len, std::vector<CPUTime> &cpu_times) {
+  cpu_times.clear();
+  const char *end = buf + len;
+  // skip the first line for cpu total
+  const char *s = (const char *)memchr(buf, '\n', len);
+  while (s && ++s < end && end - s > 3 && memcmp(s, "cpu", 3) == 0) {
+    s += 3;
+    CPUTime t = {};
+    const char *e = next_token(s, end);
+    bool ok = to_num(s, e, t.id);
+    for (unsigned long *v : {&t.utime, &t.ntime, &t.stime, &t.itime, &t.iowtime, &t.irqtime, &t.sirqtime}) {
+      s = e;
+      e = next_token(s, end);
+      ok = ok && to_num(s, e, *v);
+    }
+    s = e;
+    if (ok) {
+      cpu_times.push_back(t);
+    }
+    s = (const char *)memchr(s, '\n', end - s);
+  }
+}
+
+void memInfo(const char *buf, size_t len, MemInfo &mem) {
+  static const struct {
+    const char *key;
+    uint64_t MemInfo::*value;
+  } keys[] = {
+    {"MemTotal:", &MemInfo::total},
+    {"MemFree:", &MemInfo::free},
+    {"MemAvailable:", &MemInfo::available},
+    {"Buffers:", &MemInfo::buffers},
+    {"Cached:", &MemInfo::cached},
+    {"Active:", &MemInfo::active},
+    {"Inactive:", &MemInfo::inactive},
+    {"Shmem:", &MemInfo::shared},
+  };
+
+  mem = {};
+  const char *s = buf, *end = buf + len;
+  while (s < end) {
+    const char *key_end = next_token(s, end);
+    for (const auto &k : keys) {
+      if (key_end - s == (ptrdiff_t)strlen(k.key) && memcmp(s, k.key, key_end - s) == 0) {
+        const char *v = key_end;
+        const char *v_end = next_token(v, end);
+        if (to_num(v, v_end, mem.*k.value)) {
+          mem.*k.value *= 1024;
+        }
+        break;
+      }
+    }
+    s = (const char *)memchr(key_end, '\n', end - key_end);
+    if (!s) break;
+    s++;
+  }
+}
+
+}  // namespace Scanner
+
 const double jiffy = sysconf(_SC_CLK_TCK);
 const size_t page_size = sysconf(_SC_PAGE_SIZE);
 
-void buildCPUTimes(cereal::ProcLog::Builder &builder) {
-  std::ifstream stream("/proc/stat");
-  std::vector<CPUTime> stats = Parser::cpuTimes(stream);
-
+static void setCPUTimes(cereal::ProcLog::Builder &builder, const std::vector<CPUTime> &stats) {
   auto log_cpu_times = builder.initCpuTimes(stats.size());
   for (int i = 0; i < stats.size(); ++i) {
     auto l = log_cpu_times[i];
@@ -176,19 +328,61 @@ void buildCPUTimes(cereal::ProcLog::Builder &builder) {
   }
 }
 
+static void setMemInfo(cereal::ProcLog::Builder &builder, const MemInfo &mem_info) {
+  auto mem = builder.initMem();
+  mem.setTotal(mem_info.total);
+  mem.setFree(mem_info.free);
+  mem.setAvailable(mem_info.available);
+  mem.setBuffers(mem_info.buffers);
+  mem.setCached(mem_info.cached);
+  mem.setActive(mem_info.active);
+  mem.setInactive(mem_info.inactive);
+  mem.setShared(mem_info.shared);
+}
+
+static void setProc(cereal::ProcLog::Process::Builder &l, const ProcStat &r, const std::string &exe, const std::vector<std::string> &cmdline) {
+  l.setPid(r.pid);
+  l.setState(r.state);
+  l.setPpid(r.ppid);
+  l.setCpuUser(r.utime / jiffy);
+  l.setCpuSystem(r.stime / jiffy);
+  l.setCpuChildrenUser(r.cutime / jiffy);
+  l.setCpuChildrenSystem(r.cstime / jiffy);
+  l.setPriority(r.priority);
+  l.setNice(r.nice);
+  l.setNumThreads(r.num_threads);
+  l.setStartTime(r.starttime / jiffy);
+  l.setMemVms(r.vms);
+  l.setMemRss((uint64_t)r.rss * page_size);
+  l.setProcessor(r.processor);
+  l.setName(r.name);
+
+  l.setExe(exe);
+  auto lcmdline = l.initCmdline(cmdline.size());
+  for (size_t i = 0; i < lcmdline.size(); i++) {
+    lcmdline.set(i, cmdline[i]);
+  }
+}
+
+void buildCPUTimes(cereal::ProcLog::Builder &builder) {
+  std::ifstream stream("/proc/stat");
+  setCPUTimes(builder, Parser::cpuTimes(stream));
+}
+
 void buildMemInfo(cereal::ProcLog::Builder &builder) {
   std::ifstream stream("/proc/meminfo");
   auto mem_info = Parser::memInfo(stream);
 
-  auto mem = builder.initMem();
-  mem.setTotal(mem_info["MemTotal:"]);
-  mem.setFree(mem_info["MemFree:"]);
-  mem.setAvailable(mem_info["MemAvailable:"]);
-  mem.setBuffers(mem_info["Buffers:"]);
-  mem.setCached(mem_info["Cached:"]);
-  mem.setActive(mem_info["Active:"]);
-  mem.setInactive(mem_info["Inactive:"]);
-  mem.setShared(mem_info["Shmem:"]);
+  setMemInfo(builder, {
+    .total = mem_info["MemTotal:"],
+    .free = mem_info["MemFree:"],
+    .available = mem_info["MemAvailable:"],
+    .buffers = mem_info["Buffers:"],
+    .cached = mem_info["Cached:"],
+    .active = mem_info["Active:"],
+    .inactive = mem_info["Inactive:"],
+    .shared = mem_info["Shmem:"],
+  });
 }
 
 void buildProcs(cereal::ProcLog::Builder &builder) {
@@ -206,28 +400,8 @@ void buildProcs(cereal::ProcLog::Builder &builder) {
   for (size_t i = 0; i < proc_stats.size(); i++) {
     auto l = procs[i];
     const ProcStat &r = proc_stats[i];
-    l.setPid(r.pid);
-    l.setState(r.state);
-    l.setPpid(r.ppid);
-    l.setCpuUser(r.utime / jiffy);
-    l.setCpuSystem(r.stime / jiffy);
-    l.setCpuChildrenUser(r.cutime / jiffy);
-    l.setCpuChildrenSystem(r.cstime / jiffy);
-    l.setPriority(r.priority);
-    l.setNice(r.nice);
-    l.setNumThreads(r.num_threads);
-    l.setStartTime(r.starttime / jiffy);
-    l.setMemVms(r.vms);
-    l.setMemRss((uint64_t)r.rss * page_size);
-    l.setProcessor(r.processor);
-    l.setName(r.name);
-
     const ProcCache &extra_info = Parser::getProcExtraInfo(r.pid, r.name);
-    l.setExe(extra_info.exe);
-    auto lcmdline = l.initCmdline(extra_info.cmdline.size());
-    for (size_t i = 0; i < lcmdline.size(); i++) {
-      lcmdline.set(i, extra_info.cmdline[i]);
-    }
+    setProc(l, r, extra_info.exe, extra_info.cmdline);
   }
 }
 
@@ -237,3 +411,177 @@ void buildProcLogMessage(MessageBuilder &msg) {
   buildCPUTimes(procLog);
   buildMemInfo(procLog);
 }
+
+// ProcCollector
+
+ProcCollector::ProcCollector(int thread_interval) : buf(4096), thread_interval(thread_interval) {
+  stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+  meminfo_fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+  proc_dir = opendir("/proc");
+  assert(stat_fd >= 0 && meminfo_fd >= 0 && proc_dir);
+}
+
+ProcCollector::~ProcCollector() {
+  for (auto &[pid, proc] : procs) {
+    for (auto &[tid, t] : proc.threads) {
+      if (t.fd >= 0) close(t.fd);
+    }
+    if (proc.fd >= 0) close(proc.fd);
+  }
+  closedir(proc_dir);
+  close(meminfo_fd);
+  close(stat_fd);
+}
+
+// Reads a whole procfs file into buf. These files are generated in one go on the
+// first read, so a read that doesn't fill buf reached the end.
+ssize_t ProcCollector::read_fd(int fd) {
+  size_t len = 0;
+  while (true) {
+    ssize_t n = HANDLE_EINTR(pread(fd, buf.data() + len, buf.size() - len, len));
+    if (n < 0) return -1;
+    len += n;
+    if (len < buf.size()) return len;
+    buf.resize(buf.size() * 2);
+  }
+}
+
+bool ProcCollector::update_proc(int pid, Proc &proc) {
+  char path[64];
+  // Once a process exits reading its stat fails, even if the pid is reused.
+  ssize_t len = proc.fd >= 0 ? read_fd(proc.fd) : -1;
+  if (len <= 0) {
+    if (proc.fd >= 0) close(proc.fd);
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    proc.fd = open(path, O_RDONLY | O_CLOEXEC);
+    len = proc.fd >= 0 ? read_fd(proc.fd) : -1;
+  }
+  if (len <= 0 || !Scanner::procStat(buf.data(), len, proc.stat)) {
+    return false;
+  }
+
+  // exe and cmdline only change on exec or setproctitle, which also change the name
+  if (proc.stat.starttime != proc.info_starttime || proc.stat.name != proc.info_name) {
+    proc.info_starttime = proc.stat.starttime;
+    proc.info_name = proc.stat.name;
+
+    snprintf(path, sizeof(path), "/proc/%d/exe", pid);
+    proc.exe = util::readlink(path);
+
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    len = fd >= 0 ? read_fd(fd) : -1;
+    if (fd >= 0) close(fd);
+    Scanner::cmdline(buf.data(), std::max(len, (ssize_t)0), proc.cmdline);
+
+    // python processes are named after their module by the manager
+    proc.openpilot = (!proc.cmdline.empty() && proc.cmdline[0].compare(0, 10, "selfdrive.") == 0) ||
+                     proc.exe.find("/selfdrive/") != std::string::npos;
+  }
+  return true;
+}
+
+void ProcCollector::update_threads(int pid, Proc &proc) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task", pid);
+  DIR *d = opendir(path);
+  if (!d) return;
+
+  for (auto &[tid, t] : proc.threads) {
+    t.alive = false;
+  }
+  struct dirent *de = NULL;
+  while ((de = readdir(d))) {
+    int tid = atoi(de->d_name);
+    if (tid <= 0) continue;
+
+    Thread &t = proc.threads[tid];
+    if (t.fd < 0) {
+      snprintf(path, sizeof(path), "/proc/%d/task/%d/stat", pid, tid);
+      t.fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+    ssize_t len = t.fd >= 0 ? read_fd(t.fd) : -1;
+    t.alive = len > 0 && Scanner::procStat(buf.data(), len, t.stat);
+  }
+  closedir(d);
+
+  for (auto it = proc.threads.begin(); it != proc.threads.end();) {
+    if (!it->second.alive) {
+      if (it->second.fd >= 0) close(it->second.fd);
+      it = proc.threads.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ProcCollector::build_procs(cereal::ProcLog::Builder &builder, bool with_threads) {
+  for (auto &[pid, proc] : procs) {
+    proc.alive = false;
+  }
+  order.clear();
+
+  rewinddir(proc_dir);
+  struct dirent *de = NULL;
+  while ((de = readdir(proc_dir))) {
+    int pid = 0;
+    if (de->d_type != DT_DIR || !Scanner::to_num(de->d_name, de->d_name + strlen(de->d_name), pid)) continue;
+
+    Proc &proc = procs[pid];
+    proc.alive = update_proc(pid, proc);
+    if (proc.alive) {
+      if (with_threads && proc.openpilot) {
+        update_threads(pid, proc);
+      }
+      order.push_back(&proc);
+    }
+  }
+
+  for (auto it = procs.begin(); it != procs.end();) {
+    Proc &proc = it->second;
+    if (!proc.alive) {
+      for (auto &[tid, t] : proc.threads) {
+        if (t.fd >= 0) close(t.fd);
+      }
+      if (proc.fd >= 0) close(proc.fd);
+      it = procs.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto log_procs = builder.initProcs(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    auto l = log_procs[i];
+    const Proc &proc = *order[i];
+    setProc(l, proc.stat, proc.exe, proc.cmdline);
+
+    if (with_threads && proc.openpilot) {
+      auto threads = l.initThreads(proc.threads.size());
+      int j = 0;
+      for (auto &[tid, t] : proc.threads) {
+        auto lt = threads[j++];
+        lt.setTid(t.stat.pid);
+        lt.setName(t.stat.name);
+        lt.setState(t.stat.state);
+        lt.setCpuUser(t.stat.utime / jiffy);
+        lt.setCpuSystem(t.stat.stime / jiffy);
+        lt.setProcessor(t.stat.processor);
+      }
+    }
+  }
+}
+
+void ProcCollector::build(MessageBuilder &msg) {
+  auto procLog = msg.initEvent().initProcLog();
+  build_procs(procLog, thread_interval > 0 && updates++ % thread_interval == 0);
+
+  ssize_t len = read_fd(stat_fd);
+  Scanner::cpuTimes(buf.data(), std::max(len, (ssize_t)0), cpu_times);
+  setCPUTimes(procLog, cpu_times);
+
+  MemInfo mem = {};
+  len = read_fd(meminfo_fd);
+  Scanner::memInfo(buf.data(), std::max(len, (ssize_t)0), mem);
+  setMemInfo(procLog, mem);
+}
@@ -1,3 +1,5 @@
+#include <dirent.h>
+
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -26,6 +28,10 @@ struct ProcStat {
   std::string name;
 };
 
+struct MemInfo {
+  uint64_t total, free, available, buffers, cached, active, inactive, shared;
+};
+
 namespace Parser {
 
 std::vector<int> pids();
@@ -37,4 +43,58 @@ const ProcCache &getProcExtraInfo(int pid, const std::string &name);
 
 };  // namespace Parser
 
+// Allocation free counterparts of the Parser functions, working on the raw file contents.
+namespace Scanner {
+
+bool procStat(const char *buf, size_t len, ProcStat &p);
+void cmdline(const char *buf, size_t len, std::vector<std::string> &args);
+void cpuTimes(const char *buf, size_t len, std::vector<CPUTime> &cpu_times);
+void memInfo(const char *buf, size_t len, MemInfo &mem);
+
+};  // namespace Scanner
+
 void buildProcLogMessage(MessageBuilder &msg);
+
+// Builds the same procLog as buildProcLogMessage, but keeps /proc/stat, /proc/meminfo
+// and the stat file of every process open between updates and re-reads them with
+// pread. exe and cmdline are only read again when a process execs or renames itself.
+// For openpilot processes the stats of each thread from /proc/<pid>/task are added
+// every thread_interval updates, 0 disables them.
+class ProcCollector {
+public:
+  ProcCollector(int thread_interval = 0);
+  ~ProcCollector();
+  void build(MessageBuilder &msg);
+
+private:
+  struct Thread {
+    int fd = -1;
+    bool alive;
+    ProcStat stat;
+  };
+
+  struct Proc {
+    int fd = -1;
+    bool alive, openpilot = false;
+    ProcStat stat;
+    std::string exe;
+    std::vector<std::string> cmdline;
+    std::string info_name;  // name and start time exe and cmdline were read at
+    unsigned long long info_starttime = 0;
+    std::unordered_map<int, Thread> threads;
+  };
+
+  ssize_t read_fd(int fd);
+  bool update_proc(int pid, Proc &proc);
+  void update_threads(int pid, Proc &proc);
+  void build_procs(cereal::ProcLog::Builder &builder, bool with_threads);
+
+  int stat_fd, meminfo_fd;
+  DIR *proc_dir;
+  std::vector<char> buf;
+  std::unordered_map<int, Proc> procs;
+  std::vector<Proc *> order;  // alive processes in /proc order
+  std::vector<CPUTime> cpu_times;
+  const int thread_interval;
+  int updates = 0;
+};
@@ -0,0 +1,114 @@
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "selfdrive/common/util.h"
+#include "selfdrive/proclogd/proclog.h"
+
+// Builds procLog from the live /proc with buildProcLogMessage and with ProcCollector
+// and reports the CPU time per message of both. Also checks that the scanner parses
+// every /proc/<pid>/stat, cmdline, /proc/stat and /proc/meminfo like the Parser does.
+
+static double cpu_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool same_stat(const ProcStat &a, const ProcStat &b) {
+  return a.pid == b.pid && a.name == b.name && a.state == b.state && a.ppid == b.ppid &&
+         a.utime == b.utime && a.stime == b.stime && a.cutime == b.cutime && a.cstime == b.cstime &&
+         a.priority == b.priority && a.nice == b.nice && a.num_threads == b.num_threads &&
+         a.starttime == b.starttime && a.vms == b.vms && a.rss == b.rss && a.processor == b.processor;
+}
+
+static int check_scanner() {
+  int mismatches = 0;
+  for (int pid : Parser::pids()) {
+    std::string path = "/proc/" + std::to_string(pid);
+    std::string stat = util::read_file(path + "/stat");
+    std::string cmdline = util::read_file(path + "/cmdline");
+
+    auto expected = Parser::procStat(stat);
+    ProcStat p = {};
+    bool ok = Scanner::procStat(stat.data(), stat.size(), p);
+    if (ok != expected.has_value() || (ok && !same_stat(p, *expected))) {
+      printf("stat mismatch: %s", stat.c_str());
+      mismatches++;
+    }
+
+    std::istringstream stream(cmdline);
+    std::vector<std::string> args;
+    Scanner::cmdline(cmdline.data(), cmdline.size(), args);
+    if (args != Parser::cmdline(stream)) {
+      printf("cmdline mismatch for %d\n", pid);
+      mismatches++;
+    }
+  }
+
+  std::string stat = util::read_file("/proc/stat");
+  std::istringstream stat_stream(stat);
+  std::vector<CPUTime> cpu_times, expected_times = Parser::cpuTimes(stat_stream);
+  Scanner::cpuTimes(stat.data(), stat.size(), cpu_times);
+  bool same = cpu_times.size() == expected_times.size();
+  for (int i = 0; same && i < cpu_times.size(); i++) {
+    const CPUTime &a = cpu_times[i], &b = expected_times[i];
+    same = a.id == b.id && a.utime == b.utime && a.ntime == b.ntime && a.stime == b.stime && a.itime == b.itime &&
+           a.iowtime == b.iowtime && a.irqtime == b.irqtime && a.sirqtime == b.sirqtime;
+  }
+  if (!same) {
+    printf("cpu times mismatch\n");
+    mismatches++;
+  }
+
+  std::string meminfo = util::read_file("/proc/meminfo");
+  std::istringstream mem_stream(meminfo);
+  auto expected_mem = Parser::memInfo(mem_stream);
+  MemInfo mem;
+  Scanner::memInfo(meminfo.data(), meminfo.size(), mem);
+  if (mem.total != expected_mem["MemTotal:"] || mem.free != expected_mem["MemFree:"] ||
+      mem.available != expected_mem["MemAvailable:"] || mem.buffers != expected_mem["Buffers:"] ||
+      mem.cached != expected_mem["Cached:"] || mem.active != expected_mem["Active:"] ||
+      mem.inactive != expected_mem["Inactive:"] || mem.shared != expected_mem["Shmem:"]) {
+    printf("meminfo mismatch\n");
+    mismatches++;
+  }
+  return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 100;
+
+  int mismatches = check_scanner();
+  printf("scanner mismatches: %d\n", mismatches);
+
+  double start = cpu_time();
+  for (int i = 0; i < iterations; i++) {
+    MessageBuilder msg;
+    buildProcLogMessage(msg);
+  }
+  const double parser_time = cpu_time() - start;
+
+  ProcCollector collector, collector_threads(1);
+  start = cpu_time();
+  for (int i = 0; i < iterations; i++) {
+    MessageBuilder msg;
+    collector.build(msg);
+  }
+  const double collector_time = cpu_time() - start;
+
+  start = cpu_time();
+  for (int i = 0; i < iterations; i++) {
+    MessageBuilder msg;
+    collector_threads.build(msg);
+  }
+  const double threads_time = cpu_time() - start;
+
+  printf("%d messages\n", iterations);
+  printf("parser:              %.2f ms/msg\n", parser_time * 1e3 / iterations);
+  printf("collector:           %.2f ms/msg\n", collector_time * 1e3 / iterations);
+  printf("collector + threads: %.2f ms/msg\n", threads_time * 1e3 / iterations);
+  return mismatches > 0;
+}
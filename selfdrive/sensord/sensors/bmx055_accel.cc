@@ -1,11 +1,12 @@
 #include "bmx055_accel.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "selfdrive/common/swaglog.h"
 #include "selfdrive/common/timing.h"
 
-BMX055_Accel::BMX055_Accel(I2CBus *bus) : I2CSensor(bus) {}
+BMX055_Accel::BMX055_Accel(I2CBus *bus, bool fifo) : I2CSensor(bus), fifo(fifo), fifo_timestamps(BMX055_ACCEL_ODR_HZ) {}
 
 int BMX055_Accel::init(){
   int ret = 0;
@@ -39,6 +40,24 @@ int BMX055_Accel::init(){
     goto fail;
   }
 
+  if (fifo) {
+    // Stream mode keeps the newest 32 XYZ frames, writing the config also clears the FIFO
+    ret = set_register(BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1, BMX055_ACCEL_FIFO_MODE_STREAM);
+    if (ret < 0){
+      goto fail;
+    }
+
+    // New data interrupt on INT1, so the FIFO can be drained as soon as a frame is in
+    ret = set_register(BMX055_ACCEL_I2C_REG_INT_EN_1, BMX055_ACCEL_INT_EN_1_DATA);
+    if (ret < 0){
+      goto fail;
+    }
+    ret = set_register(BMX055_ACCEL_I2C_REG_INT_MAP_1, BMX055_ACCEL_INT_MAP_1_INT1_DATA);
+    if (ret < 0){
+      goto fail;
+    }
+  }
+
 fail:
   return ret;
 }
@@ -49,6 +68,46 @@ void BMX055_Accel::get_event(cereal::SensorEventData::Builder &event){
   int len = read_register(BMX055_ACCEL_I2C_REG_X_LSB, buffer, sizeof(buffer));
   assert(len == 6);
 
+  fill_event(event, buffer, start_time);
+}
+
+int BMX055_Accel::read_fifo(uint64_t read_time){
+  if (!fifo) {
+    return 1;
+  }
+
+  uint8_t status;
+  int ret = read_register(BMX055_ACCEL_I2C_REG_FIFO_STATUS, &status, 1);
+  if (ret < 0){
+    return ret;
+  }
+
+  int frames = std::min(status & BMX055_ACCEL_FIFO_FRAMES, BMX055_ACCEL_FIFO_DEPTH);
+  if (frames > 0) {
+    ret = read_burst(BMX055_ACCEL_I2C_REG_FIFO, fifo_data, frames * BMX055_ACCEL_FIFO_FRAME_SIZE);
+    if (ret < 0){
+      return ret;
+    }
+  }
+
+  if (status & BMX055_ACCEL_FIFO_OVERRUN) {
+    LOGW("BMX055 accel FIFO overrun");
+    fifo_timestamps.reset();
+    set_register(BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1, BMX055_ACCEL_FIFO_MODE_STREAM);
+  }
+  fifo_timestamps.update(read_time, frames);
+  return frames;
+}
+
+void BMX055_Accel::get_fifo_event(int i, cereal::SensorEventData::Builder &event){
+  if (!fifo) {
+    get_event(event);
+    return;
+  }
+  fill_event(event, &fifo_data[i * BMX055_ACCEL_FIFO_FRAME_SIZE], fifo_timestamps[i]);
+}
+
+void BMX055_Accel::fill_event(cereal::SensorEventData::Builder &event, const uint8_t *buffer, uint64_t timestamp){
   // 12 bit = +-2g
   float scale = 9.81 * 2.0f / (1 << 11);
   float x = -read_12_bit(buffer[0], buffer[1]) * scale;
@@ -59,7 +118,7 @@ void BMX055_Accel::get_event(cereal::SensorEventData::Builder &event){
   event.setVersion(1);
   event.setSensor(SENSOR_ACCELEROMETER);
   event.setType(SENSOR_TYPE_ACCELEROMETER);
-  event.setTimestamp(start_time);
+  event.setTimestamp(timestamp);
 
   float xyz[] = {x, y, z};
   auto svec = event.initAcceleration();
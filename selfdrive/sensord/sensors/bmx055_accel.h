@@ -1,5 +1,6 @@
 #pragma once
 
+#include "selfdrive/sensord/sensors/fifo.h"
 #include "selfdrive/sensord/sensors/i2c_sensor.h"
 
 // Address of the chip on the bus
@@ -9,8 +10,12 @@
 #define BMX055_ACCEL_I2C_REG_ID     0x00
 #define BMX055_ACCEL_I2C_REG_X_LSB  0x02
 #define BMX055_ACCEL_I2C_REG_TEMP   0x08
+#define BMX055_ACCEL_I2C_REG_FIFO_STATUS 0x0E
 #define BMX055_ACCEL_I2C_REG_BW     0x10
 #define BMX055_ACCEL_I2C_REG_HBW    0x13
+#define BMX055_ACCEL_I2C_REG_INT_EN_1  0x17
+#define BMX055_ACCEL_I2C_REG_INT_MAP_1 0x1A
+#define BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1 0x3E
 #define BMX055_ACCEL_I2C_REG_FIFO   0x3F
 
 // Constants
@@ -28,10 +33,29 @@
 #define BMX055_ACCEL_BW_500HZ   0b01110
 #define BMX055_ACCEL_BW_1000HZ  0b01111
 
+// Filtered data is output at twice the bandwidth
+#define BMX055_ACCEL_ODR_HZ     250
+
+#define BMX055_ACCEL_FIFO_MODE_STREAM (0b10 << 6)
+#define BMX055_ACCEL_FIFO_OVERRUN     0b10000000
+#define BMX055_ACCEL_FIFO_FRAMES      0b01111111
+#define BMX055_ACCEL_FIFO_DEPTH       32
+#define BMX055_ACCEL_FIFO_FRAME_SIZE  6
+
+#define BMX055_ACCEL_INT_EN_1_DATA    0b00010000
+#define BMX055_ACCEL_INT_MAP_1_INT1_DATA 0b00000001
+
 class BMX055_Accel : public I2CSensor {
   uint8_t get_device_address() {return BMX055_ACCEL_I2C_ADDR;}
+  void fill_event(cereal::SensorEventData::Builder &event, const uint8_t *data, uint64_t timestamp);
+
+  const bool fifo;
+  FifoTimestamps fifo_timestamps;
+  uint8_t fifo_data[BMX055_ACCEL_FIFO_DEPTH * BMX055_ACCEL_FIFO_FRAME_SIZE];
 public:
-  BMX055_Accel(I2CBus *bus);
+  BMX055_Accel(I2CBus *bus, bool fifo = false);
   int init();
   void get_event(cereal::SensorEventData::Builder &event);
+  int read_fifo(uint64_t read_time);
+  void get_fifo_event(int i, cereal::SensorEventData::Builder &event);
 };
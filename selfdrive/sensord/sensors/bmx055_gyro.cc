@@ -1,14 +1,16 @@
 #include "bmx055_gyro.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
 #include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
 
 #define DEG2RAD(x) ((x) * M_PI / 180.0)
 
 
-BMX055_Gyro::BMX055_Gyro(I2CBus *bus) : I2CSensor(bus) {}
+BMX055_Gyro::BMX055_Gyro(I2CBus *bus, bool fifo) : I2CSensor(bus), fifo(fifo), fifo_timestamps(BMX055_GYRO_FIFO_ODR_HZ) {}
 
 int BMX055_Gyro::init(){
   int ret = 0;
@@ -38,8 +40,8 @@ int BMX055_Gyro::init(){
     goto fail;
   }
 
-  // 116 Hz filter
-  ret = set_register(BMX055_GYRO_I2C_REG_BW, BMX055_GYRO_BW_116HZ);
+  // 116 Hz filter. The FIFO only holds 100 frames, so it runs at 200 Hz with a 64 Hz filter
+  ret = set_register(BMX055_GYRO_I2C_REG_BW, fifo ? BMX055_GYRO_BW_64HZ : BMX055_GYRO_BW_116HZ);
   if (ret < 0){
     goto fail;
   }
@@ -50,6 +52,28 @@ int BMX055_Gyro::init(){
     goto fail;
   }
 
+  if (fifo) {
+    // Stream mode keeps the newest 100 XYZ frames, writing the config also clears the FIFO
+    ret = set_register(BMX055_GYRO_I2C_REG_FIFO_CONFIG_1, BMX055_GYRO_FIFO_MODE_STREAM);
+    if (ret < 0){
+      goto fail;
+    }
+
+    // New data interrupt on INT1, so the FIFO can be drained as soon as a frame is in
+    ret = set_register(BMX055_GYRO_I2C_REG_INT_EN_0, BMX055_GYRO_INT_EN_0_DATA);
+    if (ret < 0){
+      goto fail;
+    }
+    ret = set_register(BMX055_GYRO_I2C_REG_INT_EN_1, BMX055_GYRO_INT_EN_1_INT1_PUSH_PULL);
+    if (ret < 0){
+      goto fail;
+    }
+    ret = set_register(BMX055_GYRO_I2C_REG_INT_MAP_1, BMX055_GYRO_INT_MAP_1_INT1_DATA);
+    if (ret < 0){
+      goto fail;
+    }
+  }
+
 fail:
   return ret;
 }
@@ -60,6 +84,46 @@ void BMX055_Gyro::get_event(cereal::SensorEventData::Builder &event){
   int len = read_register(BMX055_GYRO_I2C_REG_RATE_X_LSB, buffer, sizeof(buffer));
   assert(len == 6);
 
+  fill_event(event, buffer, start_time);
+}
+
+int BMX055_Gyro::read_fifo(uint64_t read_time){
+  if (!fifo) {
+    return 1;
+  }
+
+  uint8_t status;
+  int ret = read_register(BMX055_GYRO_I2C_REG_FIFO_STATUS, &status, 1);
+  if (ret < 0){
+    return ret;
+  }
+
+  int frames = std::min(status & BMX055_GYRO_FIFO_FRAMES, BMX055_GYRO_FIFO_DEPTH);
+  if (frames > 0) {
+    ret = read_burst(BMX055_GYRO_I2C_REG_FIFO, fifo_data, frames * BMX055_GYRO_FIFO_FRAME_SIZE);
+    if (ret < 0){
+      return ret;
+    }
+  }
+
+  if (status & BMX055_GYRO_FIFO_OVERRUN) {
+    LOGW("BMX055 gyro FIFO overrun");
+    fifo_timestamps.reset();
+    set_register(BMX055_GYRO_I2C_REG_FIFO_CONFIG_1, BMX055_GYRO_FIFO_MODE_STREAM);
+  }
+  fifo_timestamps.update(read_time, frames);
+  return frames;
+}
+
+void BMX055_Gyro::get_fifo_event(int i, cereal::SensorEventData::Builder &event){
+  if (!fifo) {
+    get_event(event);
+    return;
+  }
+  fill_event(event, &fifo_data[i * BMX055_GYRO_FIFO_FRAME_SIZE], fifo_timestamps[i]);
+}
+
+void BMX055_Gyro::fill_event(cereal::SensorEventData::Builder &event, const uint8_t *buffer, uint64_t timestamp){
   // 16 bit = +- 125 deg/s
   float scale = 125.0f / (1 << 15);
   float x = -DEG2RAD(read_16_bit(buffer[0], buffer[1]) * scale);
@@ -70,7 +134,7 @@ void BMX055_Gyro::get_event(cereal::SensorEventData::Builder &event){
   event.setVersion(1);
   event.setSensor(SENSOR_GYRO_UNCALIBRATED);
   event.setType(SENSOR_TYPE_GYROSCOPE_UNCALIBRATED);
-  event.setTimestamp(start_time);
+  event.setTimestamp(timestamp);
 
   float xyz[] = {x, y, z};
   auto svec = event.initGyroUncalibrated();
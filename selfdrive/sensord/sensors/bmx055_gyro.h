@@ -1,5 +1,6 @@
 #pragma once
 
+#include "selfdrive/sensord/sensors/fifo.h"
 #include "selfdrive/sensord/sensors/i2c_sensor.h"
 
 // Address of the chip on the bus
@@ -8,9 +9,14 @@
 // Registers of the chip
 #define BMX055_GYRO_I2C_REG_ID         0x00
 #define BMX055_GYRO_I2C_REG_RATE_X_LSB 0x02
+#define BMX055_GYRO_I2C_REG_FIFO_STATUS 0x0E
 #define BMX055_GYRO_I2C_REG_RANGE      0x0F
 #define BMX055_GYRO_I2C_REG_BW         0x10
 #define BMX055_GYRO_I2C_REG_HBW        0x13
+#define BMX055_GYRO_I2C_REG_INT_EN_0   0x15
+#define BMX055_GYRO_I2C_REG_INT_EN_1   0x16
+#define BMX055_GYRO_I2C_REG_INT_MAP_1  0x18
+#define BMX055_GYRO_I2C_REG_FIFO_CONFIG_1 0x3E
 #define BMX055_GYRO_I2C_REG_FIFO       0x3F
 
 // Constants
@@ -25,13 +31,32 @@
 #define BMX055_GYRO_RANGE_250       0b011
 #define BMX055_GYRO_RANGE_125       0b100
 
-#define BMX055_GYRO_BW_116HZ 0b0010
+#define BMX055_GYRO_BW_116HZ 0b0010  // ODR 1000 Hz
+#define BMX055_GYRO_BW_64HZ  0b0110  // ODR 200 Hz
+
+#define BMX055_GYRO_FIFO_ODR_HZ       200
+#define BMX055_GYRO_FIFO_MODE_STREAM  (0b10 << 6)
+#define BMX055_GYRO_FIFO_OVERRUN      0b10000000
+#define BMX055_GYRO_FIFO_FRAMES       0b01111111
+#define BMX055_GYRO_FIFO_DEPTH        100
+#define BMX055_GYRO_FIFO_FRAME_SIZE   6
+
+#define BMX055_GYRO_INT_EN_0_DATA           0b10000000
+#define BMX055_GYRO_INT_EN_1_INT1_PUSH_PULL 0b00000001  // active high
+#define BMX055_GYRO_INT_MAP_1_INT1_DATA     0b00000001
 
 
 class BMX055_Gyro : public I2CSensor {
   uint8_t get_device_address() {return BMX055_GYRO_I2C_ADDR;}
+  void fill_event(cereal::SensorEventData::Builder &event, const uint8_t *data, uint64_t timestamp);
+
+  const bool fifo;
+  FifoTimestamps fifo_timestamps;
+  uint8_t fifo_data[BMX055_GYRO_FIFO_DEPTH * BMX055_GYRO_FIFO_FRAME_SIZE];
 public:
-  BMX055_Gyro(I2CBus *bus);
+  BMX055_Gyro(I2CBus *bus, bool fifo = false);
   int init();
   void get_event(cereal::SensorEventData::Builder &event);
+  int read_fifo(uint64_t read_time);
+  void get_fifo_event(int i, cereal::SensorEventData::Builder &event);
 };
@@ -0,0 +1,28 @@
+#include "fifo.h"
+
+#include <algorithm>
+
+FifoTimestamps::FifoTimestamps(double odr_hz) : nominal_period(1e9 / odr_hz), period(1e9 / odr_hz) {}
+
+void FifoTimestamps::reset() {
+  newest = 0;
+  last_t = 0;
+}
+
+void FifoTimestamps::update(uint64_t t, int n) {
+  this->n = n;
+  if (n == 0) return;
+
+  if (last_t != 0 && t > last_t) {
+    // n samples arrived since the last drain, slowly track the actual rate
+    const double measured = (double)(t - last_t) / n;
+    period += 0.02 * (measured - period);
+    period = std::clamp(period, 0.9 * nominal_period, 1.1 * nominal_period);
+  }
+  last_t = t;
+
+  // continue the previous timeline, but the newest sample can't be after t and
+  // must be within a period of it, otherwise the next one would have been drained too
+  const uint64_t predicted = newest == 0 ? t : newest + (uint64_t)(n * period);
+  newest = std::clamp(predicted, t - std::min(t, (uint64_t)period), t);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Reconstructs sample times for a sensor FIFO that is drained at irregular times.
+// Samples are spaced by the output data rate period, and the newest sample of a drain
+// was taken at most one period before it was known to be there (the read, or the
+// data ready interrupt). Consecutive drains continue the same timeline, and the period
+// is learned from the sample counts since the chip's ODR is only accurate to a few
+// percent.
+class FifoTimestamps {
+public:
+  FifoTimestamps(double odr_hz);
+
+  // n samples were drained, the newest of them known to exist at time t
+  void update(uint64_t t, int n);
+  // after an overrun samples are missing, start a new timeline
+  void reset();
+
+  // time of sample i of the last update, oldest first
+  uint64_t operator[](int i) const { return newest - (uint64_t)((n - 1 - i) * period); }
+
+private:
+  const double nominal_period;
+  double period;
+  uint64_t newest = 0;
+  uint64_t last_t = 0;
+  int n = 0;
+};
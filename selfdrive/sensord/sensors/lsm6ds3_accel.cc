@@ -5,7 +5,7 @@
 #include "selfdrive/common/swaglog.h"
 #include "selfdrive/common/timing.h"
 
-LSM6DS3_Accel::LSM6DS3_Accel(I2CBus *bus) : I2CSensor(bus) {}
+LSM6DS3_Accel::LSM6DS3_Accel(I2CBus *bus, LSM6DS3_Fifo *fifo) : I2CSensor(bus), fifo(fifo) {}
 
 int LSM6DS3_Accel::init() {
   int ret = 0;
@@ -33,6 +33,12 @@ int LSM6DS3_Accel::init() {
     goto fail;
   }
 
+  if (fifo) {
+    ret = fifo->enable(false);
+    if (ret < 0) {
+      goto fail;
+    }
+  }
 
 fail:
   return ret;
@@ -45,6 +51,27 @@ void LSM6DS3_Accel::get_event(cereal::SensorEventData::Builder &event) {
   int len = read_register(LSM6DS3_ACCEL_I2C_REG_OUTX_L_XL, buffer, sizeof(buffer));
   assert(len == sizeof(buffer));
 
+  fill_event(event, buffer, start_time);
+}
+
+int LSM6DS3_Accel::read_fifo(uint64_t read_time) {
+  if (!fifo) {
+    return 1;
+  }
+
+  int ret = fifo->read(read_time);
+  return ret < 0 ? ret : fifo->size();
+}
+
+void LSM6DS3_Accel::get_fifo_event(int i, cereal::SensorEventData::Builder &event) {
+  if (!fifo) {
+    get_event(event);
+    return;
+  }
+  fill_event(event, fifo->accel_data(i), fifo->timestamp(i));
+}
+
+void LSM6DS3_Accel::fill_event(cereal::SensorEventData::Builder &event, const uint8_t *buffer, uint64_t timestamp) {
   float scale = 9.81 * 2.0f / (1 << 15);
   float x = read_16_bit(buffer[0], buffer[1]) * scale;
   float y = read_16_bit(buffer[2], buffer[3]) * scale;
@@ -54,7 +81,7 @@ void LSM6DS3_Accel::get_event(cereal::SensorEventData::Builder &event) {
   event.setVersion(1);
   event.setSensor(SENSOR_ACCELEROMETER);
   event.setType(SENSOR_TYPE_ACCELEROMETER);
-  event.setTimestamp(start_time);
+  event.setTimestamp(timestamp);
 
   float xyz[] = {y, -x, z};
   auto svec = event.initAcceleration();
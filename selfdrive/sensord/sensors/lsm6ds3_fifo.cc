@@ -0,0 +1,93 @@
+#include "lsm6ds3_fifo.h"
+
+#include <algorithm>
+
+#include "selfdrive/common/swaglog.h"
+
+LSM6DS3_Fifo::LSM6DS3_Fifo(I2CBus *bus) : bus(bus), timestamps(LSM6DS3_FIFO_ODR_HZ) {}
+
+int LSM6DS3_Fifo::enable(bool gyro) {
+  int ret = 0;
+
+  if (gyro) {
+    gyro_enabled = true;
+  } else {
+    accel_enabled = true;
+  }
+  set_size = (gyro_enabled ? 6 : 0) + (accel_enabled ? 6 : 0);
+
+  uint8_t decimation = (gyro_enabled ? LSM6DS3_FIFO_DEC_GYRO_NONE : 0) | (accel_enabled ? LSM6DS3_FIFO_DEC_XL_NONE : 0);
+  ret = bus->set_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_CTRL3, decimation);
+  if (ret < 0) {
+    goto fail;
+  }
+
+  // Data ready pulses on INT1 when a data set is complete. Both sensors run at the same
+  // rate, so only one of them is routed to get a single edge per set.
+  ret = bus->set_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_DRDY_PULSE_CFG, LSM6DS3_FIFO_DRDY_PULSED);
+  if (ret < 0) {
+    goto fail;
+  }
+  ret = bus->set_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_INT1_CTRL, gyro_enabled ? LSM6DS3_FIFO_INT1_DRDY_G : LSM6DS3_FIFO_INT1_DRDY_XL);
+  if (ret < 0) {
+    goto fail;
+  }
+
+  // Going through bypass mode empties the FIFO, so data sets stay aligned
+  ret = bus->set_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_CTRL5, LSM6DS3_FIFO_MODE_BYPASS);
+  if (ret < 0) {
+    goto fail;
+  }
+  ret = bus->set_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_CTRL5, LSM6DS3_FIFO_ODR_104HZ | LSM6DS3_FIFO_MODE_CONTINUOUS);
+  if (ret < 0) {
+    goto fail;
+  }
+  timestamps.reset();
+
+fail:
+  return ret;
+}
+
+int LSM6DS3_Fifo::read(uint64_t read_time) {
+  if (read_time == last_read_time) {
+    return last_ret;
+  }
+  last_read_time = read_time;
+  n_sets = 0;
+
+  // FIFO_STATUS1-4: unread words, flags and the position in the data set
+  uint8_t status[4];
+  last_ret = bus->read_register(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1, status, sizeof(status));
+  if (last_ret < 0) {
+    return last_ret;
+  }
+
+  const int words = status[0] | ((status[1] & LSM6DS3_FIFO_DIFF_H) << 8);
+  const int pattern = status[2] | ((status[3] & LSM6DS3_FIFO_PATTERN_H) << 8);
+  const int set_words = set_size / 2;
+
+  // the rest of a partially read data set is dropped, so sets start with the gyro
+  const int skip = (set_words - pattern % set_words) % set_words;
+  const int sets = std::max(words - skip, 0) / set_words;
+  if (sets > 0) {
+    const int len = (skip + sets * set_words) * 2;
+    if (buffer.size() < len) {
+      buffer.resize(len);
+    }
+    last_ret = bus->read_burst(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT, buffer.data(), len);
+    if (last_ret < 0) {
+      return last_ret;
+    }
+    data = buffer.data() + skip * 2;
+    n_sets = sets;
+  }
+
+  if (status[1] & LSM6DS3_FIFO_OVER_RUN) {
+    LOGW("LSM6DS3 FIFO overrun");
+    timestamps.reset();
+  }
+  timestamps.update(read_time, n_sets);
+
+  last_ret = 0;
+  return last_ret;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "selfdrive/common/i2c.h"
+#include "selfdrive/sensord/sensors/fifo.h"
+
+// Address of the chip on the bus
+#define LSM6DS3_FIFO_I2C_ADDR               0x6A
+
+// Registers of the chip
+#define LSM6DS3_FIFO_I2C_REG_FIFO_CTRL3     0x08
+#define LSM6DS3_FIFO_I2C_REG_FIFO_CTRL5     0x0A
+#define LSM6DS3_FIFO_I2C_REG_DRDY_PULSE_CFG 0x0B
+#define LSM6DS3_FIFO_I2C_REG_INT1_CTRL      0x0D
+#define LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1   0x3A
+#define LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT  0x3E
+
+// Constants
+#define LSM6DS3_FIFO_DEC_GYRO_NONE   (0b001 << 3)
+#define LSM6DS3_FIFO_DEC_XL_NONE     0b001
+#define LSM6DS3_FIFO_ODR_104HZ       (0b0100 << 3)
+#define LSM6DS3_FIFO_MODE_BYPASS     0b000
+#define LSM6DS3_FIFO_MODE_CONTINUOUS 0b110
+#define LSM6DS3_FIFO_DRDY_PULSED     0b10000000
+#define LSM6DS3_FIFO_INT1_DRDY_XL    0b00000001
+#define LSM6DS3_FIFO_INT1_DRDY_G     0b00000010
+
+#define LSM6DS3_FIFO_ODR_HZ          104
+#define LSM6DS3_FIFO_OVER_RUN        0b01000000
+#define LSM6DS3_FIFO_DIFF_H          0b00001111
+#define LSM6DS3_FIFO_PATTERN_H       0b00000011
+
+
+// The LSM6DS3 has one FIFO for the gyroscope and the accelerometer. Both sensors share
+// this object, whichever is read first in a loop drains the FIFO for both. A data set
+// is the gyro sample followed by the accel sample, 3 words each.
+class LSM6DS3_Fifo {
+public:
+  LSM6DS3_Fifo(I2CBus *bus);
+
+  // called by the sensors' init, (re)starts continuous mode with the enabled sensors
+  int enable(bool gyro);
+
+  // Drains the FIFO, unless that already happened at read_time. Returns < 0 on error.
+  int read(uint64_t read_time);
+  int size() const { return n_sets; }
+  const uint8_t *gyro_data(int i) const { return data + i * set_size; }
+  const uint8_t *accel_data(int i) const { return data + i * set_size + (gyro_enabled ? 6 : 0); }
+  uint64_t timestamp(int i) const { return timestamps[i]; }
+
+private:
+  I2CBus *bus;
+  bool gyro_enabled = false, accel_enabled = false;
+  int set_size = 0;  // bytes
+
+  uint64_t last_read_time = 0;
+  int last_ret = 0;
+  FifoTimestamps timestamps;
+  std::vector<uint8_t> buffer;
+  const uint8_t *data = nullptr;
+  int n_sets = 0;
+};
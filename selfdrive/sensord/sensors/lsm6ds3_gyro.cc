@@ -9,7 +9,7 @@
 #define DEG2RAD(x) ((x) * M_PI / 180.0)
 
 
-LSM6DS3_Gyro::LSM6DS3_Gyro(I2CBus *bus) : I2CSensor(bus) {}
+LSM6DS3_Gyro::LSM6DS3_Gyro(I2CBus *bus, LSM6DS3_Fifo *fifo) : I2CSensor(bus), fifo(fifo) {}
 
 int LSM6DS3_Gyro::init() {
   int ret = 0;
@@ -37,6 +37,12 @@ int LSM6DS3_Gyro::init() {
     goto fail;
   }
 
+  if (fifo) {
+    ret = fifo->enable(true);
+    if (ret < 0) {
+      goto fail;
+    }
+  }
 
 fail:
   return ret;
@@ -49,6 +55,27 @@ void LSM6DS3_Gyro::get_event(cereal::SensorEventData::Builder &event) {
   int len = read_register(LSM6DS3_GYRO_I2C_REG_OUTX_L_G, buffer, sizeof(buffer));
   assert(len == sizeof(buffer));
 
+  fill_event(event, buffer, start_time);
+}
+
+int LSM6DS3_Gyro::read_fifo(uint64_t read_time) {
+  if (!fifo) {
+    return 1;
+  }
+
+  int ret = fifo->read(read_time);
+  return ret < 0 ? ret : fifo->size();
+}
+
+void LSM6DS3_Gyro::get_fifo_event(int i, cereal::SensorEventData::Builder &event) {
+  if (!fifo) {
+    get_event(event);
+    return;
+  }
+  fill_event(event, fifo->gyro_data(i), fifo->timestamp(i));
+}
+
+void LSM6DS3_Gyro::fill_event(cereal::SensorEventData::Builder &event, const uint8_t *buffer, uint64_t timestamp) {
   float scale = 8.75 / 1000.0;
   float x = DEG2RAD(read_16_bit(buffer[0], buffer[1]) * scale);
   float y = DEG2RAD(read_16_bit(buffer[2], buffer[3]) * scale);
@@ -58,7 +85,7 @@ void LSM6DS3_Gyro::get_event(cereal::SensorEventData::Builder &event) {
   event.setVersion(2);
   event.setSensor(SENSOR_GYRO_UNCALIBRATED);
   event.setType(SENSOR_TYPE_GYROSCOPE_UNCALIBRATED);
-  event.setTimestamp(start_time);
+  event.setTimestamp(timestamp);
 
   float xyz[] = {y, -x, z};
   auto svec = event.initGyroUncalibrated();
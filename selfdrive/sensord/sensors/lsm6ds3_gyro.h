@@ -1,6 +1,7 @@
 #pragma once
 
 #include "selfdrive/sensord/sensors/i2c_sensor.h"
+#include "selfdrive/sensord/sensors/lsm6ds3_fifo.h"
 
 // Address of the chip on the bus
 #define LSM6DS3_GYRO_I2C_ADDR       0x6A
@@ -19,8 +20,13 @@
 class LSM6DS3_Gyro : public I2CSensor {
   uint8_t get_device_address() {return LSM6DS3_GYRO_I2C_ADDR;}
   cereal::SensorEventData::SensorSource source = cereal::SensorEventData::SensorSource::LSM6DS3;
+  void fill_event(cereal::SensorEventData::Builder &event, const uint8_t *data, uint64_t timestamp);
+
+  LSM6DS3_Fifo *fifo;
 public:
-  LSM6DS3_Gyro(I2CBus *bus);
+  LSM6DS3_Gyro(I2CBus *bus, LSM6DS3_Fifo *fifo = nullptr);
   int init();
   void get_event(cereal::SensorEventData::Builder &event);
+  int read_fifo(uint64_t read_time);
+  void get_fifo_event(int i, cereal::SensorEventData::Builder &event);
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include "cereal/gen/cpp/log.capnp.h"
 
 class Sensor {
@@ -7,4 +9,11 @@ public:
   virtual ~Sensor() {};
   virtual int init() = 0;
   virtual void get_event(cereal::SensorEventData::Builder &event) = 0;
+
+  // Sensors in FIFO mode drain all samples since the last call in one burst read here,
+  // get_fifo_event then fills one event per sample, stamped with its sample time.
+  // read_time is the time of the read, or of the data ready interrupt that triggered it.
+  // Returns the number of events, < 0 on error. Other sensors give a single event.
+  virtual int read_fifo(uint64_t read_time) { return 1; }
+  virtual void get_fifo_event(int i, cereal::SensorEventData::Builder &event) { get_event(event); }
 };
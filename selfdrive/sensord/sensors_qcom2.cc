@@ -1,10 +1,15 @@
+#include <poll.h>
 #include <sys/resource.h>
+#include <unistd.h>
 
-#include <chrono>
-#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "cereal/messaging/messaging.h"
+#include "selfdrive/common/gpio.h"
 #include "selfdrive/common/i2c.h"
 #include "selfdrive/common/swaglog.h"
 #include "selfdrive/common/timing.h"
@@ -25,6 +30,11 @@
 
 ExitHandler do_exit;
 
+struct SensorGroup {
+  int fd;  // data ready line events, -1 for the polled sensors
+  std::vector<Sensor *> sensors;
+};
+
 int sensor_loop() {
   I2CBus *i2c_bus_imu;
 
@@ -35,13 +45,15 @@ int sensor_loop() {
     return -1;
   }
 
-  BMX055_Accel bmx055_accel(i2c_bus_imu);
-  BMX055_Gyro bmx055_gyro(i2c_bus_imu);
+  // The IMUs buffer samples in their FIFOs, which are drained on every read
+  BMX055_Accel bmx055_accel(i2c_bus_imu, true);
+  BMX055_Gyro bmx055_gyro(i2c_bus_imu, true);
   BMX055_Magn bmx055_magn(i2c_bus_imu);
   BMX055_Temp bmx055_temp(i2c_bus_imu);
 
-  LSM6DS3_Accel lsm6ds3_accel(i2c_bus_imu);
-  LSM6DS3_Gyro lsm6ds3_gyro(i2c_bus_imu);
+  LSM6DS3_Fifo lsm6ds3_fifo(i2c_bus_imu);
+  LSM6DS3_Accel lsm6ds3_accel(i2c_bus_imu, &lsm6ds3_fifo);
+  LSM6DS3_Gyro lsm6ds3_gyro(i2c_bus_imu, &lsm6ds3_fifo);
   LSM6DS3_Temp lsm6ds3_temp(i2c_bus_imu);
 
   MMC5603NJ_Magn mmc5603nj_magn(i2c_bus_imu);
@@ -79,24 +91,97 @@ int sensor_loop() {
     }
   }
 
+  // IMUs with a data ready line are read when it fires, stamped with the interrupt time.
+  // The other sensors, and IMUs whose line can't be requested, are read every 10ms.
+  std::map<Sensor *, int> data_ready_pins = {
+    {&bmx055_accel, GPIO_BMX_ACCEL_INT},
+    {&bmx055_gyro, GPIO_BMX_GYRO_INT},
+    {&lsm6ds3_accel, GPIO_LSM_INT},
+    {&lsm6ds3_gyro, GPIO_LSM_INT},  // shares the FIFO and line with the accel
+  };
+
+  std::vector<SensorGroup> groups(1, {-1, {}});
+  std::map<int, int> group_of_pin;
+  for (Sensor *sensor : sensors) {
+    auto pin = data_ready_pins.find(sensor);
+    if (pin != data_ready_pins.end() && group_of_pin.count(pin->second) == 0) {
+      int fd = gpio_event_init("sensord", GPIOCHIP_INT, pin->second);
+      if (fd < 0) {
+        LOGW("falling back to polling for gpio %d", pin->second);
+      } else {
+        group_of_pin[pin->second] = groups.size();
+        groups.push_back({fd, {}});
+      }
+    }
+    int group = pin != data_ready_pins.end() && group_of_pin.count(pin->second) ? group_of_pin[pin->second] : 0;
+    groups[group].sensors.push_back(sensor);
+  }
+
+  std::vector<struct pollfd> fds;
+  for (int i = 1; i < groups.size(); i++) {
+    fds.push_back({.fd = groups[i].fd, .events = POLLIN | POLLPRI});
+  }
+
   PubMaster pm({"sensorEvents"});
+  std::vector<std::pair<int, uint64_t>> ready;  // group, read time
+  // The samples read on the interrupts are collected and go out together on the 10ms
+  // tick, sensorEvents is published at its service rate however often the lines fire.
+  auto pending = std::make_unique<capnp::MallocMessageBuilder>();
+  std::vector<capnp::Orphan<cereal::SensorEventData>> events;
+  uint64_t next_tick = nanos_since_boot();
 
   while (!do_exit) {
-    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    const int64_t wait = std::max<int64_t>(next_tick - nanos_since_boot(), 0);
+    const struct timespec timeout = {.tv_sec = (time_t)(wait / 1000000000), .tv_nsec = (long)(wait % 1000000000)};
+    int ret = ppoll(fds.data(), fds.size(), &timeout, nullptr);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      LOGE("poll failed: %d", errno);
+      break;
+    }
 
-    const int num_events = sensors.size();
-    MessageBuilder msg;
-    auto sensor_events = msg.initEvent().initSensorEvents(num_events);
+    ready.clear();
+    for (int i = 0; i < fds.size(); i++) {
+      uint64_t t;
+      if (fds[i].revents && gpio_read_events(fds[i].fd, &t) > 0) {
+        ready.push_back({i + 1, t});
+      }
+    }
+    const uint64_t now = nanos_since_boot();
+    const bool tick = now >= next_tick;
+    if (tick) {
+      ready.push_back({0, now});
+      next_tick += 10000000ULL;
+      if (next_tick < now) {
+        next_tick = now + 10000000ULL;
+      }
+    }
 
-    for (int i = 0; i < num_events; i++) {
-      auto event = sensor_events[i];
-      sensors[i]->get_event(event);
+    for (auto &[group, read_time] : ready) {
+      for (Sensor *sensor : groups[group].sensors) {
+        int n = sensor->read_fifo(read_time);
+        for (int j = 0; j < n; j++) {
+          events.push_back(pending->getOrphanage().newOrphan<cereal::SensorEventData>());
+          auto event = events.back().get();
+          sensor->get_fifo_event(j, event);
+        }
+      }
     }
+    if (!tick || events.empty()) continue;
 
+    MessageBuilder msg;
+    auto sensor_events = msg.initEvent().initSensorEvents(events.size());
+    for (int i = 0; i < events.size(); i++) {
+      sensor_events.setWithCaveats(i, events[i].getReader());
+    }
     pm.send("sensorEvents", msg);
 
-    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-    std::this_thread::sleep_for(std::chrono::milliseconds(10) - (end - begin));
+    events.clear();
+    pending = std::make_unique<capnp::MallocMessageBuilder>();
+  }
+
+  for (int i = 1; i < groups.size(); i++) {
+    close(groups[i].fd);
   }
   return 0;
 }
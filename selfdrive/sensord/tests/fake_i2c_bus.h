@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+
+#include "selfdrive/common/i2c.h"
+
+// I2C bus backed by register maps, for testing sensors without hardware. Plain reads
+// go through the register map, burst reads pop from a FIFO queue at that register.
+class FakeI2CBus : public I2CBus {
+public:
+  int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len) {
+    reads++;
+    for (int i = 0; i < len; i++) {
+      buffer[i] = reg(device_address, register_address + i);
+    }
+    return len;
+  }
+
+  int set_register(uint8_t device_address, uint register_address, uint8_t data) {
+    reg(device_address, register_address) = data;
+    return 0;
+  }
+
+  int read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len) {
+    bursts++;
+    std::deque<uint8_t> &data = fifo(device_address, register_address);
+    if (data.size() < len) {
+      return -1;
+    }
+    std::copy(data.begin(), data.begin() + len, buffer);
+    data.erase(data.begin(), data.begin() + len);
+    return len;
+  }
+
+  uint8_t &reg(uint8_t device_address, uint register_address) {
+    return registers[{device_address, register_address}];
+  }
+
+  std::deque<uint8_t> &fifo(uint8_t device_address, uint register_address) {
+    return fifos[{device_address, register_address}];
+  }
+
+  void push_word(uint8_t device_address, uint register_address, int16_t word) {
+    fifo(device_address, register_address).push_back(word & 0xFF);
+    fifo(device_address, register_address).push_back((word >> 8) & 0xFF);
+  }
+
+  std::map<std::pair<uint8_t, uint>, uint8_t> registers;
+  std::map<std::pair<uint8_t, uint>, std::deque<uint8_t>> fifos;
+  int reads = 0, bursts = 0;
+};
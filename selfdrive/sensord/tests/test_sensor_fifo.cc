@@ -0,0 +1,138 @@
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+
+#include "cereal/messaging/messaging.h"
+#include "selfdrive/sensord/sensors/bmx055_accel.h"
+#include "selfdrive/sensord/sensors/lsm6ds3_accel.h"
+#include "selfdrive/sensord/sensors/lsm6ds3_fifo.h"
+#include "selfdrive/sensord/tests/fake_i2c_bus.h"
+
+// Drains the IMU FIFOs from a fake bus and checks the samples, the number of bus
+// transactions and the reconstructed sample times.
+
+const uint64_t LSM6DS3_PERIOD = 1e9 / LSM6DS3_FIFO_ODR_HZ;
+
+static void set_lsm6ds3_status(FakeI2CBus &bus, int words, int pattern) {
+  bus.reg(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1) = words & 0xFF;
+  bus.reg(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1 + 1) = words >> 8;
+  bus.reg(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1 + 2) = pattern & 0xFF;
+  bus.reg(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_STATUS1 + 3) = pattern >> 8;
+}
+
+static void push_lsm6ds3_sets(FakeI2CBus &bus, int first, int n) {
+  for (int s = first; s < first + n; s++) {
+    for (int k = 0; k < 3; k++) bus.push_word(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT, 100 * s + k);  // gyro
+    for (int k = 0; k < 3; k++) bus.push_word(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT, -100 * s - k);  // accel
+  }
+}
+
+static int16_t word(const uint8_t *data, int k) {
+  return read_16_bit(data[2 * k], data[2 * k + 1]);
+}
+
+void test_lsm6ds3_shared_drain() {
+  FakeI2CBus bus;
+  LSM6DS3_Fifo fifo(&bus);
+  LSM6DS3_Accel accel(&bus, &fifo);
+  assert(fifo.enable(false) == 0);
+  assert(fifo.enable(true) == 0);
+  assert(bus.reg(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_CTRL5) == (LSM6DS3_FIFO_ODR_104HZ | LSM6DS3_FIFO_MODE_CONTINUOUS));
+
+  push_lsm6ds3_sets(bus, 0, 3);
+  set_lsm6ds3_status(bus, 18, 0);
+  const uint64_t t = 1e9;
+  assert(fifo.read(t) == 0);
+  assert(fifo.size() == 3);
+  assert(bus.bursts == 1);
+  for (int s = 0; s < 3; s++) {
+    for (int k = 0; k < 3; k++) {
+      assert(word(fifo.gyro_data(s), k) == 100 * s + k);
+      assert(word(fifo.accel_data(s), k) == -100 * s - k);
+    }
+  }
+  assert(fifo.timestamp(2) <= t && fifo.timestamp(2) + LSM6DS3_PERIOD >= t);
+  assert(fifo.timestamp(1) < fifo.timestamp(2) && fifo.timestamp(2) - fifo.timestamp(1) == LSM6DS3_PERIOD);
+
+  // the second sensor of the chip reuses the drain
+  const int reads = bus.reads;
+  assert(accel.read_fifo(t) == 3);
+  assert(bus.reads == reads && bus.bursts == 1);
+
+  MessageBuilder msg;
+  auto events = msg.initEvent().initSensorEvents(1);
+  auto event = events[0];
+  accel.get_fifo_event(1, event);
+  assert(event.getTimestamp() == fifo.timestamp(1));
+  auto v = event.getAcceleration().getV();
+  const float scale = 9.81 * 2.0f / (1 << 15);
+  assert(std::abs(v[0] - (-101 * scale)) < 1e-6 && std::abs(v[1] - (100 * scale)) < 1e-6);
+
+  // the next drain continues the timeline
+  const uint64_t last = fifo.timestamp(2);
+  push_lsm6ds3_sets(bus, 3, 1);
+  set_lsm6ds3_status(bus, 6, 0);
+  assert(fifo.read(t + LSM6DS3_PERIOD) == 0 && fifo.size() == 1);
+  assert(std::abs((int64_t)(fifo.timestamp(0) - last) - (int64_t)LSM6DS3_PERIOD) <= 1);
+}
+
+void test_lsm6ds3_misaligned() {
+  FakeI2CBus bus;
+  LSM6DS3_Fifo fifo(&bus);
+  fifo.enable(false);
+  fifo.enable(true);
+
+  // the gyro X and Y words of a set were read before, its remaining 4 words are dropped
+  for (int k = 0; k < 4; k++) bus.push_word(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT, 7777);
+  push_lsm6ds3_sets(bus, 1, 2);
+  bus.push_word(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT, 9999);  // incomplete set stays in the FIFO
+  set_lsm6ds3_status(bus, 17, 2);
+  assert(fifo.read(1e9) == 0);
+  assert(fifo.size() == 2);
+  assert(word(fifo.gyro_data(0), 0) == 100);
+  assert(word(fifo.accel_data(1), 2) == -202);
+  assert(bus.fifo(LSM6DS3_FIFO_I2C_ADDR, LSM6DS3_FIFO_I2C_REG_FIFO_DATA_OUT).size() == 2);
+}
+
+void test_bmx055_frames_and_overrun() {
+  FakeI2CBus bus;
+  BMX055_Accel accel(&bus, true);
+
+  for (int f = 0; f < 4; f++) {
+    for (int k = 0; k < 3; k++) bus.push_word(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO, (10 * f + k) << 4);
+  }
+  bus.reg(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO_STATUS) = 4;
+  const uint64_t t = 2e9;
+  assert(accel.read_fifo(t) == 4);
+  assert(bus.bursts == 1);
+
+  MessageBuilder msg;
+  auto events = msg.initEvent().initSensorEvents(4);
+  for (int i = 0; i < 4; i++) {
+    auto event = events[i];
+    accel.get_fifo_event(i, event);
+  }
+  const float scale = 9.81 * 2.0f / (1 << 11);
+  assert(std::abs(events[3].getAcceleration().getV()[2] - 32 * scale) < 1e-6);
+  assert(events[3].getTimestamp() <= t);
+  assert(events[3].getTimestamp() - events[0].getTimestamp() == 3 * (uint64_t)(1e9 / BMX055_ACCEL_ODR_HZ));
+
+  // on overrun the samples in the FIFO are still used and stream mode is restarted
+  for (int k = 0; k < 3; k++) bus.push_word(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO, 0);
+  bus.reg(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO_STATUS) = BMX055_ACCEL_FIFO_OVERRUN | 1;
+  bus.reg(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1) = 0;
+  assert(accel.read_fifo(t + 1e9) == 1);
+  assert(bus.reg(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1) == BMX055_ACCEL_FIFO_MODE_STREAM);
+  auto event = events[0];
+  accel.get_fifo_event(0, event);
+  assert(event.getTimestamp() == t + 1e9);
+}
+
+int main() {
+  test_lsm6ds3_shared_drain();
+  test_lsm6ds3_misaligned();
+  test_bmx055_frames_and_overrun();
+  printf("ok\n");
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "selfdrive/ui/paint.h"
 
 #include <cassert>
+#include <cmath>
 
 #ifdef __APPLE__
 #include <OpenGL/gl3.h>
@@ -17,6 +18,7 @@
 #include <nanovg_gl_utils.h>
 #include <time.h> //opkr
 #include <string>
+#include "selfdrive/common/glutil.h"
 #include "selfdrive/common/util.h"
 #include "selfdrive/hardware/hw.h"
 #include "selfdrive/ui/ui.h"
@@ -37,6 +39,85 @@ const int box_y = bdr_s;
 const int box_w = vwp_w-sbr_w-(bdr_s*2);
 const int box_h = vwp_h-(bdr_s*2);
 
+// Model lines are drawn with their own shader under the nanovg layer. The vertices
+// stay in the calibrated frame in one buffer that is only uploaded again for a new
+// model frame, calibration and screen transform are applied in the vertex shader.
+const char line_vertex_shader[] =
+#ifdef __APPLE__
+  "#version 150 core\n"
+#else
+  "#version 300 es\n"
+#endif
+  "in vec3 aPosition;\n"
+  "uniform mat3 uTransform;\n"
+  "void main() {\n"
+  "  vec3 p = uTransform * aPosition;\n"
+  "  gl_Position = vec4(p.xy, 0.0, p.z);\n"
+  "}\n";
+
+const char line_fragment_shader[] =
+#ifdef __APPLE__
+  "#version 150 core\n"
+#else
+  "#version 300 es\n"
+#endif
+  "precision mediump float;\n"
+  "uniform vec4 uColor;\n"
+  "uniform vec4 uColorTop;\n"
+  "uniform vec2 uGradient;\n"
+  "out vec4 colorOut;\n"
+  "void main() {\n"
+  "  float t = clamp((gl_FragCoord.y - uGradient.x) / (uGradient.y - uGradient.x), 0.0, 1.0);\n"
+  "  colorOut = mix(uColor, uColorTop, t);\n"
+  "}\n";
+
+// lane lines, road edges, path
+const int LINE_COUNT = 7;
+const int LINE_VERTICES = TRAJECTORY_SIZE * 2;
+
+static struct {
+  GLuint program, vao, vbo;
+  GLint transform_loc, color_loc, color_top_loc, gradient_loc;
+  uint32_t frame_id;
+} lines;
+
+static void ui_lines_init() {
+  lines.program = gl_program_from_source(line_vertex_shader, line_fragment_shader);
+
+  lines.transform_loc = glGetUniformLocation(lines.program, "uTransform");
+  lines.color_loc = glGetUniformLocation(lines.program, "uColor");
+  lines.color_top_loc = glGetUniformLocation(lines.program, "uColorTop");
+  lines.gradient_loc = glGetUniformLocation(lines.program, "uGradient");
+
+  glGenVertexArrays(1, &lines.vao);
+  glBindVertexArray(lines.vao);
+  glGenBuffers(1, &lines.vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, lines.vbo);
+  glBufferData(GL_ARRAY_BUFFER, LINE_COUNT * LINE_VERTICES * sizeof(vec3), NULL, GL_DYNAMIC_DRAW);
+  GLint pos_loc = glGetAttribLocation(lines.program, "aPosition");
+  glEnableVertexAttribArray(pos_loc);
+  glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (const void *)0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// calibrated frame to clip space, with the depth as w
+static mat3 line_transform(const UIState *s) {
+  const float *t = s->car_space_transform;
+  const mat3 screen_from_image = {{
+    t[0], t[2], t[4],
+    t[1], t[3], t[5],
+    0.0f, 0.0f, 1.0f,
+  }};
+  const mat3 clip_from_screen = {{
+    2.0f / s->fb_w, 0.0f, -1.0f,
+    0.0f, -2.0f / s->fb_h, 1.0f,
+    0.0f, 0.0f, 1.0f,
+  }};
+  const mat3 &intrinsic_matrix = s->wide_camera ? ecam_intrinsic_matrix : fcam_intrinsic_matrix;
+  return matmul3(matmul3(clip_from_screen, screen_from_image), matmul3(intrinsic_matrix, s->scene.view_from_calib));
+}
+
 
 static void ui_draw_text(const UIState *s, float x, float y, const char *string, float size, NVGcolor color, const char *font_name) {
   nvgFontFace(s->vg, font_name);
@@ -188,30 +269,42 @@ static void draw_lead_custom(UIState *s, const cereal::RadarState::LeadData::Rea
     nvgRestore(s->vg);
 }
 
-static void ui_draw_line(UIState *s, const line_vertices_data &vd, NVGcolor *color, NVGpaint *paint) {
+static void ui_draw_line(UIState *s, int line, const line_vertices_data &vd, const NVGcolor &color, const NVGcolor &color_top) {
   if (vd.cnt == 0) return;
 
-  const vertex_data *v = &vd.v[0];
-  nvgBeginPath(s->vg);
-  nvgMoveTo(s->vg, v[0].x, v[0].y);
-  for (int i = 1; i < vd.cnt; i++) {
-    nvgLineTo(s->vg, v[i].x, v[i].y);
-  }
-  nvgClosePath(s->vg);
-  if (color) {
-    nvgFillColor(s->vg, *color);
-  } else if (paint) {
-    nvgFillPaint(s->vg, *paint);
-  }
-  nvgFill(s->vg);
+  glUniform4fv(lines.color_loc, 1, color.rgba);
+  glUniform4fv(lines.color_top_loc, 1, color_top.rgba);
+  glDrawArrays(GL_TRIANGLE_STRIP, line * LINE_VERTICES, vd.cnt);
 }
 
 static void ui_draw_vision_lane_lines(UIState *s) {
   const UIScene &scene = s->scene;
-  NVGpaint track_bg;
+  const line_vertices_data *line_data[LINE_COUNT] = {
+    &scene.lane_line_vertices[0], &scene.lane_line_vertices[1], &scene.lane_line_vertices[2], &scene.lane_line_vertices[3],
+    &scene.road_edge_vertices[0], &scene.road_edge_vertices[1], &scene.track_vertices,
+  };
+  const int road_edge_line = 4, track_line = 6;
+
+  // the colors aren't premultiplied, unlike what nanovg blends with
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glUseProgram(lines.program);
+  glBindVertexArray(lines.vao);
+  if (scene.model_frame_id != lines.frame_id) {
+    glBindBuffer(GL_ARRAY_BUFFER, lines.vbo);
+    for (int i = 0; i < LINE_COUNT; i++) {
+      glBufferSubData(GL_ARRAY_BUFFER, i * LINE_VERTICES * sizeof(vec3), line_data[i]->cnt * sizeof(vec3), line_data[i]->v);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    lines.frame_id = scene.model_frame_id;
+  }
+  const mat3 transform = line_transform(s);
+  glUniformMatrix3fv(lines.transform_loc, 1, GL_TRUE, transform.v);
+  // the path fades from the bottom of the screen to 40% of its height
+  glUniform2f(lines.gradient_loc, 0.0, s->fb_h * .6);
+
+  NVGcolor track_bg, track_bg_top;
   int steerOverride = scene.car_state.getSteeringPressed();
-  int red_lvl = 0;
-  int green_lvl = 0;
 
   float red_lvl_line = 0;
   float green_lvl_line = 0;
@@ -226,35 +319,37 @@ static void ui_draw_vision_lane_lines(UIState *s) {
         red_lvl_line = 1.0;
         green_lvl_line = 1.0 - ((0.4 - scene.lane_line_probs[i]) * 2.5);
       }
-      NVGcolor color = nvgRGBAf(1.0, 1.0, 1.0, scene.lane_line_probs[i]);
-      color = nvgRGBAf(red_lvl_line, green_lvl_line, 0, 1);
-      ui_draw_line(s, scene.lane_line_vertices[i], &color, nullptr); 
+      NVGcolor color = nvgRGBAf(red_lvl_line, green_lvl_line, 0, 1);
+      ui_draw_line(s, i, scene.lane_line_vertices[i], color, color);
     }
   }
   if (scene.controls_state.getEnabled()) {
     if (steerOverride) {
-      track_bg = nvgLinearGradient(s->vg, s->fb_w, s->fb_h, s->fb_w, s->fb_h*.4,
-        COLOR_RED_ALPHA(80), COLOR_RED_ALPHA(20));
+      track_bg = COLOR_RED_ALPHA(80);
+      track_bg_top = COLOR_RED_ALPHA(20);
     } else if (!scene.lateralPlan.lanelessModeStatus) {
-      track_bg = nvgLinearGradient(s->vg, s->fb_w, s->fb_h, s->fb_w, s->fb_h*.4,
-        nvgRGBA(135, 206, 235, 250), nvgRGBA(135, 206, 235, 50));
+      track_bg = nvgRGBA(135, 206, 235, 250);
+      track_bg_top = nvgRGBA(135, 206, 235, 50);
     } else { // differentiate laneless mode color (Grace blue)
-        track_bg = nvgLinearGradient(s->vg, s->fb_w, s->fb_h, s->fb_w, s->fb_h * .4,
-          nvgRGBA(0, 100, 255, 250), nvgRGBA(0, 100, 255, 50));
+      track_bg = nvgRGBA(0, 100, 255, 250);
+      track_bg_top = nvgRGBA(0, 100, 255, 50);
     }
     // paint road edges
     for (int i = 0; i < std::size(scene.road_edge_vertices); i++) {
       NVGcolor color = nvgRGBAf(1.0, 0.0, 0.0, std::clamp<float>(1.0 - scene.road_edge_stds[i], 0.0, 1.0));
-      ui_draw_line(s, scene.road_edge_vertices[i], &color, nullptr);
+      ui_draw_line(s, road_edge_line + i, scene.road_edge_vertices[i], color, color);
     }
   } else {
     // Draw white vision track  
-    track_bg = nvgLinearGradient(s->vg, s->fb_w, s->fb_h, s->fb_w, s->fb_h * .4,
-                                        COLOR_WHITE_ALPHA(150), COLOR_WHITE_ALPHA(20));  
+    track_bg = COLOR_WHITE_ALPHA(150);
+    track_bg_top = COLOR_WHITE_ALPHA(20);
   }
   
   // paint path
-  ui_draw_line(s, scene.track_vertices, nullptr, &track_bg);
+  ui_draw_line(s, track_line, scene.track_vertices, track_bg, track_bg_top);
+
+  glBindVertexArray(0);
+  glUseProgram(0);
 }
 
 // Draw all world space objects.
@@ -682,9 +777,8 @@ static void bb_ui_draw_measures_right(UIState *s, int bb_x, int bb_y, int bb_w )
   nvgStroke(s->vg);*/
 }
 
-static void bb_ui_draw_basic_info(UIState *s) {
+static void bb_ui_basic_info_text(const UIState *s, char *str, size_t size) {
     const UIScene *scene = &s->scene;
-    char str[1024];
     std::string sccLogMessage = "";
 
     if(s->show_debug_ui)
@@ -704,7 +798,7 @@ static void bb_ui_draw_basic_info(UIState *s) {
     //int mdps_bus = scene->car_params.getMdpsBus();
     int scc_bus = scene->car_params.getSccBus();
 
-    snprintf(str, sizeof(str), " %s (SR%.2f)(SRC%.2f)(SAD%.2f)(%d)(A%.2f/B%.2f/C%.2f/D%.2f/%.2f)%s%s",
+    snprintf(str, size, " %s (SR%.2f)(SRC%.2f)(SAD%.2f)(%d)(A%.2f/B%.2f/C%.2f/D%.2f/%.2f)%s%s",
                         lateral_state[lateralControlState],
                         //live_params.getAngleOffsetDeg(),
                         //live_params.getAngleOffsetAverageDeg(),
@@ -721,7 +815,9 @@ static void bb_ui_draw_basic_info(UIState *s) {
                         sccLogMessage.size() > 0 ? ", " : "",
                         sccLogMessage.c_str()
                         );
+}
 
+static void bb_ui_draw_basic_info(UIState *s, const char *str) {
     int x = (bdr_s * 2) + 135;
     int y = s->fb_h - 24;
 
@@ -839,33 +935,11 @@ static void bb_ui_draw_cgear(UIState *s)
   }
 }
 
-static void bb_ui_draw_UI(UIState *s) {
-  const int bb_dml_w = 180;
-  const int bb_dml_x = bdr_is * 2;
-  const int bb_dml_y = (box_y + (bdr_is * 1.5)) + 270 + 20;//UI_FEATURE_LEFT_Y;
-
-  const int bb_dmr_w = 180;
-  const int bb_dmr_x = s->fb_w - bb_dmr_w - (bdr_is * 2);
-  const int bb_dmr_y = (box_y + (bdr_is * 1.5)) + 963;
-// 스위치 화면 비우기 시작
-#if UI_FEATURE_LEFT
-  if(s->show_debug_ui)
-    bb_ui_draw_measures_left(s, bb_dml_x, bb_dml_y, bb_dml_w);
-#endif
-
-#if UI_FEATURE_RIGHT
-  bb_ui_draw_measures_right(s, bb_dmr_x, bb_dmr_y, bb_dmr_w);
-  //if(s->show_debug_ui)
-   // bb_ui_draw_measures_right(s, bb_dmr_x, bb_dmr_y, bb_dmr_w);
-#endif
-
-  bb_ui_draw_basic_info(s);
-	
-  if(s->show_cgear_ui) 
-    bb_ui_draw_cgear(s);
-  if(s->show_debug_ui)
-    bb_ui_draw_debug(s);
-}
+const int bb_dml_w = 180;
+const int bb_dml_x = bdr_is * 2;
+const int bb_dml_y = (box_y + (bdr_is * 1.5)) + 270 + 20;//UI_FEATURE_LEFT_Y;
+const int bb_dmr_w = 180;
+const int bb_dmr_y = (box_y + (bdr_is * 1.5)) + 963;
 
 static void ui_draw_vision_scc_gap(UIState *s) {
   const UIScene *scene = &s->scene;
@@ -1180,6 +1254,7 @@ static void draw_laneless_button(UIState *s) {
     nvgStrokeColor(s->vg, nvgRGBA(0,0,0,80));
     nvgStrokeWidth(s->vg, 7);
     nvgStroke(s->vg);
+    nvgFontFace(s->vg, "sans-semibold");
     nvgFontSize(s->vg, 48);
 
     if (s->scene.laneless_mode == 0) {
@@ -1372,15 +1447,222 @@ static void ui_draw_tpms(UIState *s) {
   }
 }
 
+// HUD widgets that are rasterized into their own framebuffer, and only again when
+// the values they show change. Every frame just composites the cached textures.
+struct HudLayer {
+  // sets rect, visible and the key of everything the widget shows
+  void (*update)(const UIState *s, HudLayer &layer);
+  // draws the widget in screen coordinates
+  void (*draw)(UIState *s, const HudLayer &layer);
+
+  Rect rect;
+  bool visible;
+  std::string key, drawn_key;
+  NVGLUframebuffer *fb;
+};
+
+template <typename T>
+static void key_append(std::string &key, const T &v) {
+  key.append((const char *)&v, sizeof(v));
+}
+
+template <typename... Args>
+static void layer_key(HudLayer &layer, const Args &...args) {
+  layer.key.clear();
+  (key_append(layer.key, args), ...);
+}
+
+// value as it is printed with the given number of decimals
+static inline int displayed(float v, float scale) {
+  return std::nearbyint(v * scale);
+}
+
+static void update_maxspeed(const UIState *s, HudLayer &layer) {
+  auto scc_smoother = s->scene.car_control.getSccSmoother();
+  const float cruiseMaxSpeed = scc_smoother.getCruiseMaxSpeed();
+  const double scale = s->scene.is_metric ? 1.0 : 0.621371;
+  layer.rect = {bdr_s * 2 - 10, int(bdr_s * 1.5) - 10, 184 + 20, 202 + 20};
+  layer.visible = true;
+  layer_key(layer, scc_smoother.getLongControl(), cruiseMaxSpeed > 0 && cruiseMaxSpeed < 255,
+            (int)(scc_smoother.getApplyMaxSpeed() * scale + 0.5), (int)(cruiseMaxSpeed * scale + 0.5));
+}
+
+static void update_measures_left(const UIState *s, HudLayer &layer) {
+  auto lead_one = (*s->sm)["radarState"].getRadarState().getLeadOne();
+  const float angleSteers = (*s->sm)["controlsState"].getControlsState().getAngleSteers();
+  auto carControl = (*s->sm)["carControl"].getCarControl();
+  const float steeringAngleDeg = carControl.getActuators().getSteeringAngleDeg();
+  layer.rect = {bb_dml_x - 10, bb_dml_y - 10, bb_dml_w + 20, 540};
+  layer.visible = UI_FEATURE_LEFT && s->show_debug_ui;
+  layer_key(layer, lead_one.getStatus(), displayed(lead_one.getDRel(), 10), (int)lead_one.getDRel(),
+            displayed(angleSteers, 10), (int)angleSteers, carControl.getEnabled(), displayed(steeringAngleDeg, 10),
+            s->scene.gps_ext.getAccuracy(), s->scene.gps_ext.getVerticalAccuracy());
+}
+
+static void update_measures_right(const UIState *s, HudLayer &layer) {
+  auto cpuList = (*s->sm)["deviceState"].getDeviceState().getCpuTempC();
+  float cpuTemp = 0;
+  for (int i = 0; i < cpuList.size(); i++) {
+    cpuTemp += cpuList[i];
+  }
+  if (cpuList.size() > 0) {
+    cpuTemp /= cpuList.size();
+  }
+  layer.rect = {s->fb_w - bb_dmr_w - (bdr_is * 2) - 10, bb_dmr_y - 10, bb_dmr_w + 20, 110};
+  layer.visible = UI_FEATURE_RIGHT;
+  layer_key(layer, displayed(cpuTemp, 10), cpuTemp > 80.f, cpuTemp > 92.f);
+}
+
+static void update_basic_info(const UIState *s, HudLayer &layer) {
+  char str[1024];
+  bb_ui_basic_info_text(s, str, sizeof(str));
+  layer.rect = {0, s->fb_h - 80, s->fb_w, 80};
+  layer.visible = true;
+  layer.key.assign(str);
+}
+
+static void update_cgear(const UIState *s, HudLayer &layer) {
+  layer.rect = {(bdr_s * 2) + 20, s->fb_h - 157 + 28 - 110, 180, 220};
+  layer.visible = s->show_cgear_ui;
+  layer_key(layer, s->scene.currentGear, s->scene.getGearShifter);
+}
+
+static void update_tpms(const UIState *s, HudLayer &layer) {
+  const UIScene &scene = s->scene;
+  layer.rect = {s->fb_w - 185 - 10, 860 - 10, 140 + 20, 130 + 20};
+  layer.visible = true;
+  layer_key(layer, displayed(scene.tpmsFl, 1), scene.tpmsFl < 30, scene.tpmsFl > 40,
+            displayed(scene.tpmsFr, 1), scene.tpmsFr < 30, scene.tpmsFr > 40,
+            displayed(scene.tpmsRl, 1), scene.tpmsRl < 30, scene.tpmsRl > 40,
+            displayed(scene.tpmsRr, 1), scene.tpmsRr < 30, scene.tpmsRr > 40);
+}
+
+static void update_date_time(const UIState *s, HudLayer &layer) {
+  layer.rect = {s->fb_w / 2 - 300, 0, 600, 60};
+  layer.visible = s->scene.kr_date_show || s->scene.kr_time_show;
+  layer_key(layer, time(NULL), s->scene.kr_date_show, s->scene.kr_time_show);
+}
+
+enum HudLayerId {
+  LAYER_MAXSPEED,
+  LAYER_MEASURES_LEFT,
+  LAYER_MEASURES_RIGHT,
+  LAYER_BASIC_INFO,
+  LAYER_CGEAR,
+  LAYER_TPMS,
+  LAYER_DATE_TIME,
+  LAYER_COUNT,
+};
+
+static HudLayer hud_layers[LAYER_COUNT] = {
+  [LAYER_MAXSPEED] = {update_maxspeed, [](UIState *s, const HudLayer &) { ui_draw_vision_maxspeed(s); }},
+  [LAYER_MEASURES_LEFT] = {update_measures_left, [](UIState *s, const HudLayer &) {
+    bb_ui_draw_measures_left(s, bb_dml_x, bb_dml_y, bb_dml_w);
+  }},
+  [LAYER_MEASURES_RIGHT] = {update_measures_right, [](UIState *s, const HudLayer &) {
+    bb_ui_draw_measures_right(s, s->fb_w - bb_dmr_w - (bdr_is * 2), bb_dmr_y, bb_dmr_w);
+  }},
+  [LAYER_BASIC_INFO] = {update_basic_info, [](UIState *s, const HudLayer &layer) {
+    bb_ui_draw_basic_info(s, layer.key.c_str());
+  }},
+  [LAYER_CGEAR] = {update_cgear, [](UIState *s, const HudLayer &) {
+    nvgTextAlign(s->vg, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
+    bb_ui_draw_cgear(s);
+  }},
+  [LAYER_TPMS] = {update_tpms, [](UIState *s, const HudLayer &) { ui_draw_tpms(s); }},
+  [LAYER_DATE_TIME] = {update_date_time, [](UIState *s, const HudLayer &) {
+    nvgFontFace(s->vg, "sans-semibold");
+    draw_kr_date_time(s);
+  }},
+};
+
+static bool hud_layers_enabled = true;
+
+void ui_set_hud_layers(bool enabled) {
+  hud_layers_enabled = enabled;
+}
+
+// Rasterizes the layers whose key changed. Runs outside of the main nanovg frame.
+static void ui_update_layers(UIState *s) {
+  GLint fbo = 0, viewport[4] = {};
+  GLfloat clear_color[4] = {};
+  bool bound = false;
+
+  for (HudLayer &layer : hud_layers) {
+    layer.update(s, layer);
+    if (!layer.visible || !hud_layers_enabled) continue;
+
+    int fb_w = 0, fb_h = 0;
+    if (layer.fb) {
+      nvgImageSize(s->vg, layer.fb->image, &fb_w, &fb_h);
+    }
+    const bool resized = fb_w != layer.rect.w || fb_h != layer.rect.h;
+    if (!resized && layer.key == layer.drawn_key) continue;
+
+    if (!bound) {
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+      glClearColor(0, 0, 0, 0);
+      bound = true;
+    }
+    if (resized) {
+      nvgluDeleteFramebuffer(layer.fb);
+      layer.fb = nvgluCreateFramebuffer(s->vg, layer.rect.w, layer.rect.h, 0);
+      assert(layer.fb);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, layer.fb->fbo);
+    glViewport(0, 0, layer.rect.w, layer.rect.h);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    nvgBeginFrame(s->vg, layer.rect.w, layer.rect.h, 1.0f);
+    nvgTranslate(s->vg, -layer.rect.x, -layer.rect.y);
+    layer.draw(s, layer);
+    nvgEndFrame(s->vg);
+    layer.drawn_key = layer.key;
+  }
+
+  if (bound) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+  }
+}
+
+static void ui_draw_layer(UIState *s, HudLayerId id) {
+  const HudLayer &layer = hud_layers[id];
+  if (!layer.visible) return;
+
+  if (!hud_layers_enabled) {
+    nvgSave(s->vg);
+    layer.draw(s, layer);
+    nvgRestore(s->vg);
+    return;
+  }
+  if (!layer.fb) return;
+
+  const Rect &r = layer.rect;
+  nvgBeginPath(s->vg);
+  NVGpaint paint = nvgImagePattern(s->vg, r.x, r.y, r.w, r.h, 0, layer.fb->image, 1.0f);
+  nvgRect(s->vg, r.x, r.y, r.w, r.h);
+  nvgFillPaint(s->vg, paint);
+  nvgFill(s->vg);
+}
+
 static void ui_draw_vision_header(UIState *s) {
   NVGpaint gradient = nvgLinearGradient(s->vg, 0, header_h - (header_h / 2.5), 0, header_h,
                                         nvgRGBAf(0, 0, 0, 0.45), nvgRGBAf(0, 0, 0, 0));
   ui_fill_rect(s->vg, {0, 0, s->fb_w , header_h}, gradient);
-  ui_draw_vision_maxspeed(s);
+  ui_draw_layer(s, LAYER_MAXSPEED);
   ui_draw_vision_speed(s);
   ui_draw_vision_event(s);
   ui_draw_vision_lane_change_ready(s);
-  bb_ui_draw_UI(s);
+  ui_draw_layer(s, LAYER_MEASURES_LEFT);
+  ui_draw_layer(s, LAYER_MEASURES_RIGHT);
+  ui_draw_layer(s, LAYER_BASIC_INFO);
+  ui_draw_layer(s, LAYER_CGEAR);
+  if(s->show_debug_ui)
+    bb_ui_draw_debug(s);
   //draw_currentgear(s);
   ui_draw_extras(s);
 	
@@ -1397,13 +1679,11 @@ static void ui_draw_vision(UIState *s) {
   }
   // Set Speed, Current Speed, Status/Events
   ui_draw_vision_header(s);
-  if (scene->kr_date_show || scene->kr_time_show) {
-    draw_kr_date_time(s);
-  }
+  ui_draw_layer(s, LAYER_DATE_TIME);
   //bsd
     ui_draw_vision_car(s);
     ui_draw_vision_scc_gap(s);
-    ui_draw_tpms(s);
+    ui_draw_layer(s, LAYER_TPMS);
     ui_draw_gps(s);
     //ui_draw_vision_brake(s);
     //ui_draw_vision_autohold(s);
@@ -1414,6 +1694,8 @@ void ui_draw(UIState *s, int w, int h) {
   if (s->fb_w != w || s->fb_h != h) {
     ui_resize(s, w, h);
   }
+  // rasterizing a layer leaves nanovg's premultiplied blend behind
+  ui_update_layers(s);
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   nvgBeginFrame(s->vg, s->fb_w, s->fb_h, 1.0f);
@@ -1488,6 +1770,8 @@ void ui_nvg_init(UIState *s) {
     s->images[name] = nvgCreateImage(s->vg, file, 1);
     assert(s->images[name] != 0);
   }
+
+  ui_lines_init();
 }
 
 void ui_resize(UIState *s, int width, int height) {
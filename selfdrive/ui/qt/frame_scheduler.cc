@@ -0,0 +1,89 @@
+#include "selfdrive/ui/qt/frame_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QGuiApplication>
+#include <QScreen>
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
+
+const double RENDER_MARGIN = 2.;  // ms of slack before the vsync
+const double METRICS_INTERVAL = 10000.;
+
+FrameScheduler::FrameScheduler(QOpenGLWidget *widget, std::function<bool()> poll)
+    : QObject(widget), widget(widget), poll(poll) {
+  const double refresh_rate = QGuiApplication::primaryScreen()->refreshRate();
+  period = 1000. / (refresh_rate > 0 ? refresh_rate : 60.);
+
+  timer = new QTimer(this);
+  timer->setTimerType(Qt::PreciseTimer);
+  timer->setSingleShot(true);
+  QObject::connect(timer, &QTimer::timeout, this, &FrameScheduler::tick);
+  QObject::connect(widget, &QOpenGLWidget::aboutToCompose, [=]() {
+    if (paint_pending) {
+      render_time = 0.9 * render_time + 0.1 * (millis_since_boot() - tick_t);
+    }
+  });
+  QObject::connect(widget, &QOpenGLWidget::frameSwapped, this, &FrameScheduler::frameSwapped);
+}
+
+void FrameScheduler::start() {
+  swap_t = metrics_t = millis_since_boot();
+  timer->start(0);
+}
+
+void FrameScheduler::stop() {
+  timer->stop();
+  paint_pending = false;
+}
+
+void FrameScheduler::tick() {
+  tick_t = millis_since_boot();
+  if (poll()) {
+    // the next frameSwapped schedules the following tick
+    paint_pending = true;
+    widget->update();
+  } else {
+    skipped++;
+  }
+
+  // Keep polling at the refresh rate in the phase of the last swap, also while a paint
+  // is pending in case it never happens (e.g. the window is covered).
+  double delay = period - std::fmod(tick_t - swap_t, period) - render_time - RENDER_MARGIN;
+  while (delay < 1.) {
+    delay += period;
+  }
+  timer->start(delay + (paint_pending ? period : 0));
+}
+
+void FrameScheduler::frameSwapped() {
+  const double t = millis_since_boot();
+  if (paint_pending) {
+    const double frame_time = t - swap_t;
+    frames++;
+    frame_time_sum += frame_time;
+    frame_time_max = std::max(frame_time_max, frame_time);
+    render_time_sum += render_time;
+    if (frame_eof > 0) {
+      latency_sum += (nanos_since_boot() - frame_eof) * 1e-6;
+      latency_count++;
+      frame_eof = 0;
+    }
+  }
+  paint_pending = false;
+  swap_t = t;
+  timer->start(std::max(0., period - render_time - RENDER_MARGIN));
+
+  if (t - metrics_t > METRICS_INTERVAL) {
+    if (frames > 0) {
+      LOGD("frames: %.1f fps, frame time %.2f ms (max %.2f), render %.2f ms, latency %.2f ms, %d polls skipped",
+           frames * 1000. / (t - metrics_t), frame_time_sum / frames, frame_time_max, render_time_sum / frames,
+           latency_count > 0 ? latency_sum / latency_count : 0., skipped);
+    }
+    metrics_t = t;
+    frames = skipped = latency_count = 0;
+    frame_time_sum = frame_time_max = render_time_sum = latency_sum = 0;
+  }
+}
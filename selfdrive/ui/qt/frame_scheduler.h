@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+
+#include <QOpenGLWidget>
+#include <QTimer>
+
+// Paces the repaints of a QOpenGLWidget to the display. Every frameSwapped() marks a
+// vsync and the next poll is scheduled one refresh later, minus the time a repaint
+// takes, so the newest camera frame and state are picked up right before the frame is
+// rendered. The paint is skipped when poll reports nothing new.
+class FrameScheduler : public QObject {
+  Q_OBJECT
+
+public:
+  FrameScheduler(QOpenGLWidget *widget, std::function<bool()> poll);
+  void start();
+  void stop();
+
+  // eof timestamp of the camera frame the next paint shows, for the latency metric
+  void setFrameTimestamp(uint64_t timestamp_eof) { frame_eof = timestamp_eof; }
+
+private:
+  void tick();
+  void frameSwapped();
+
+  QOpenGLWidget *widget;
+  std::function<bool()> poll;
+  QTimer *timer;
+  double period;  // ms between vsyncs
+
+  double tick_t = 0, swap_t = 0;
+  double render_time = 0;  // filtered time from the poll to composition
+  bool paint_pending = false;
+  uint64_t frame_eof = 0;
+
+  // metrics, logged every few seconds
+  double metrics_t = 0;
+  int frames = 0, skipped = 0;
+  double frame_time_sum = 0, frame_time_max = 0, render_time_sum = 0, latency_sum = 0;
+  int latency_count = 0;
+};
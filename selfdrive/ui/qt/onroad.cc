@@ -39,7 +39,7 @@ OnroadWindow::OnroadWindow(QWidget *parent) : QWidget(parent) {
   QObject::connect(this, &OnroadWindow::updateStateSignal, this, &OnroadWindow::updateState);
   QObject::connect(this, &OnroadWindow::offroadTransitionSignal, this, &OnroadWindow::offroadTransition);
 
-#ifdef QCOM2
+#ifndef QCOM
   // screen recoder - neokii
   QWidget* recorder_widget = new QWidget(this);
   QVBoxLayout * recorder_layout = new QVBoxLayout (recorder_widget);
@@ -175,7 +175,7 @@ void OnroadWindow::offroadTransition(bool offroad) {
   bool wide_cam = Hardware::TICI() && Params().getBool("EnableWideCamera");
   nvg->setStreamType(wide_cam ? VISION_STREAM_RGB_WIDE : VISION_STREAM_RGB_BACK);
 
-#ifdef QCOM2
+#ifndef QCOM
   if(offroad && recorder) {
     recorder->stop(false);
   }
@@ -260,11 +260,28 @@ void NvgWindow::initializeGL() {
   setBackgroundColor(bg_colors[STATUS_DISENGAGED]);
 }
 
+bool NvgWindow::updateFrame() {
+  const double t = millis_since_boot();
+  if (CameraViewWidget::updateFrame()) {
+    prev_frame_t = t;
+    return true;
+  }
+
+  // State updates are drawn with the next camera frame. Only repaint for them on their
+  // own if the camera stalls, so the HUD doesn't double the frame rate.
+  const uint64_t sm_frame = QUIState::ui_state.sm->frame;
+  if (sm_frame != prev_sm_frame && t - prev_frame_t > 2 * 1000. / UI_FREQ) {
+    prev_sm_frame = sm_frame;
+    return true;
+  }
+  return false;
+}
+
 void NvgWindow::paintGL() {
   CameraViewWidget::paintGL();
   ui_draw(&QUIState::ui_state, width(), height());
 
-#ifdef QCOM2
+#ifndef QCOM
   if(recorder)
     recorder->ui_draw(&QUIState::ui_state, width(), height());
 #endif
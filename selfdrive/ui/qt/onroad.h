@@ -6,7 +6,7 @@
 #include "selfdrive/ui/qt/widgets/cameraview.h"
 #include "selfdrive/ui/ui.h"
 
-#ifdef QCOM2
+#ifndef QCOM
 #include "selfdrive/ui/qt/screenrecorder/screenrecorder.h"
 #endif
 
@@ -35,14 +35,17 @@ class NvgWindow : public CameraViewWidget {
 public:
   explicit NvgWindow(VisionStreamType type, QWidget* parent = 0) : CameraViewWidget(type, true, parent) {}
 
-#ifdef QCOM2
-  ScreenRecoder* recorder;
+#ifndef QCOM
+  ScreenRecoder* recorder = nullptr;
 #endif
 
 protected:
   void paintGL() override;
   void initializeGL() override;
+  bool updateFrame() override;
   double prev_draw_t = 0;
+  double prev_frame_t = 0;
+  uint64_t prev_sm_frame = 0;
 };
 
 // container for all onroad widgets
@@ -66,9 +69,11 @@ private:
   QHBoxLayout* split;
 
   // neokii
-#ifdef QCOM2
 private:
+#ifndef QCOM
   ScreenRecoder* recorder;
+#endif
+#ifdef QCOM2
   QPoint startPos;
 #endif
 
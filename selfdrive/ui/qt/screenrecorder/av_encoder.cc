@@ -0,0 +1,99 @@
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+
+#include "selfdrive/ui/qt/screenrecorder/av_encoder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include "libyuv.h"
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/util.h"
+
+AvEncoder::AvEncoder(const char* path, int width, int height, int fps, int bitrate)
+  : width(width), height(height), fps(fps), bitrate(bitrate), path(path) {
+  av_register_all();
+  codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+  if (!codec) {
+    codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+  }
+  assert(codec);
+
+  yuv_buf = std::make_unique<uint8_t[]>(width * height * 3 / 2);
+  frame = av_frame_alloc();
+  assert(frame);
+  frame->format = AV_PIX_FMT_YUV420P;
+  frame->width = width;
+  frame->height = height;
+  frame->data[0] = yuv_buf.get();
+  frame->data[1] = frame->data[0] + width * height;
+  frame->data[2] = frame->data[1] + width * height / 4;
+  frame->linesize[0] = width;
+  frame->linesize[1] = width / 2;
+  frame->linesize[2] = width / 2;
+}
+
+AvEncoder::~AvEncoder() {
+  encoder_close();
+  av_frame_free(&frame);
+}
+
+void AvEncoder::encoder_open(const char* filename) {
+  util::create_directories(path, 0755);
+  vid_path = util::string_format("%s/%s", path.c_str(), filename);
+  lock_path = vid_path + ".lock";
+
+  int lock_fd = HANDLE_EINTR(open(lock_path.c_str(), O_RDWR | O_CREAT, 0664));
+  assert(lock_fd >= 0);
+  close(lock_fd);
+
+  // pts are the capture time in ms
+  LavcOutputConfig cfg = {width, height, fps, bitrate, (AVRational){ 1, 1000 }, fps};
+  AVDictionary *opts = NULL;
+  if (codec->id == AV_CODEC_ID_H264) {
+    av_dict_set(&opts, "preset", "veryfast", 0);
+  }
+  output.open(codec, cfg, &opts, vid_path);
+  av_dict_free(&opts);
+
+  LOGD("screen recorder open %s (%s)", vid_path.c_str(), codec->name);
+  is_open = true;
+  counter = 0;
+  last_pts = -1;
+}
+
+void AvEncoder::encoder_close() {
+  if (!is_open) return;
+
+  output.close();
+  unlink(lock_path.c_str());
+  is_open = false;
+}
+
+int AvEncoder::encode_frame_nv12(const uint8_t *y_ptr, const uint8_t *uv_ptr, uint64_t ts) {
+  if (!is_open) {
+    return -1;
+  }
+
+  int err = libyuv::NV12ToI420(y_ptr, width, uv_ptr, width,
+                               frame->data[0], frame->linesize[0],
+                               frame->data[1], frame->linesize[1],
+                               frame->data[2], frame->linesize[2],
+                               width, height);
+  assert(err == 0);
+
+  // frames come at the display's pace, stamp them with their capture time
+  if (counter == 0) {
+    first_ts = ts;
+  }
+  frame->pts = std::max<int64_t>((ts - first_ts) / 1000000, last_pts + 1);
+  last_pts = frame->pts;
+
+  if (output.encode(frame) < 0) {
+    return -1;
+  }
+  return counter++;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "selfdrive/loggerd/lavc_output.h"
+#include "selfdrive/ui/qt/screenrecorder/encoder.h"
+
+// AvEncoder, software h264 (or mpeg4 without libx264) through libavcodec, for PC
+class AvEncoder : public ScreenEncoder {
+public:
+  AvEncoder(const char* path, int width, int height, int fps, int bitrate);
+  ~AvEncoder();
+
+  int encode_frame_nv12(const uint8_t *y_ptr, const uint8_t *uv_ptr, uint64_t ts);
+  void encoder_open(const char* filename);
+  void encoder_close();
+
+private:
+  int width, height, fps, bitrate;
+  std::string path, vid_path, lock_path;
+  bool is_open = false;
+  int counter = 0;
+  uint64_t first_ts = 0;
+  int64_t last_pts = -1;
+
+  AVCodec *codec = NULL;
+  LavcOutput output;
+  AVFrame *frame = NULL;
+  std::unique_ptr<uint8_t[]> yuv_buf;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Encodes NV12 frames of a fixed size into mp4 files below the recorder's directory.
+class ScreenEncoder {
+public:
+  virtual ~ScreenEncoder() {}
+  virtual int encode_frame_nv12(const uint8_t *y_ptr, const uint8_t *uv_ptr, uint64_t ts) = 0;
+  virtual void encoder_open(const char* filename) = 0;
+  virtual void encoder_close() = 0;
+};
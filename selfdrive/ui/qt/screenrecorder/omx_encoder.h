@@ -11,14 +11,15 @@ extern "C" {
 }
 
 #include "selfdrive/common/queue.h"
+#include "selfdrive/ui/qt/screenrecorder/encoder.h"
 
 // OmxEncoder, lossey codec using hardware hevc
-class OmxEncoder {
+class OmxEncoder : public ScreenEncoder {
 public:
   OmxEncoder(const char* path, int width, int height, int fps, int bitrate, bool h265, bool downscale);
   ~OmxEncoder();
 
-  int encode_frame_rgba(const uint8_t *ptr, int in_width, int in_height, uint64_t ts);
+  int encode_frame_nv12(const uint8_t *y_ptr, const uint8_t *uv_ptr, uint64_t ts);
   void encoder_open(const char* filename);
   void encoder_close();
 
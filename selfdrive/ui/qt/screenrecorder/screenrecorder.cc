@@ -1,20 +1,71 @@
-#include <CL/cl.h>
 #include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <time.h>
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 
-#include "libyuv.h"
-#include "selfdrive/camerad/transforms/rgb_to_yuv.h"
-#include "selfdrive/common/clutil.h"
-
+#include "selfdrive/common/glutil.h"
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
 #include "selfdrive/ui/qt/screenrecorder/screenrecorder.h"
 #include "selfdrive/ui/qt/util.h"
 #include "selfdrive/ui/ui.h"
 #include "selfdrive/hardware/hw.h"
 
+#ifdef QCOM2
+#include "selfdrive/ui/qt/screenrecorder/omx_encoder.h"
+#else
+#include "selfdrive/ui/qt/screenrecorder/av_encoder.h"
+#endif
+
+const int FRAME_BUF_COUNT = 4;
+
+const char capture_vertex_shader[] =
+#ifdef NANOVG_GL3_IMPLEMENTATION
+  "#version 150 core\n"
+#else
+  "#version 300 es\n"
+#endif
+  "void main() {\n"
+  "  // one triangle covering the viewport\n"
+  "  gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);\n"
+  "}\n";
+
+// Every output texel packs four bytes of the NV12 frame: four Y samples in the first
+// uHeight rows, then two interleaved UV pairs, each averaged over 2x2 pixels by
+// sampling the bilinear texture at their shared corner. BT.601 limited range like
+// libyuv's ABGRToNV12.
+const char capture_fragment_shader[] =
+#ifdef NANOVG_GL3_IMPLEMENTATION
+  "#version 150 core\n"
+#else
+  "#version 300 es\n"
+#endif
+  "precision highp float;\n"
+  "uniform sampler2D uTexture;\n"
+  "uniform int uHeight;\n"
+  "out vec4 colorOut;\n"
+  "vec3 rgb(int x, int y) { return texelFetch(uTexture, ivec2(x, y), 0).rgb; }\n"
+  "void main() {\n"
+  "  ivec2 p = ivec2(gl_FragCoord.xy);\n"
+  "  int x = p.x * 4;\n"
+  "  if (p.y < uHeight) {\n"
+  "    vec3 w = vec3(0.257, 0.504, 0.098);\n"
+  "    colorOut = vec4(dot(rgb(x, p.y), w), dot(rgb(x + 1, p.y), w),\n"
+  "                    dot(rgb(x + 2, p.y), w), dot(rgb(x + 3, p.y), w)) + 0.0625;\n"
+  "  } else {\n"
+  "    vec2 size = vec2(textureSize(uTexture, 0));\n"
+  "    float y = float((p.y - uHeight) * 2 + 1);\n"
+  "    vec3 c0 = texture(uTexture, vec2(float(x + 1), y) / size).rgb;\n"
+  "    vec3 c1 = texture(uTexture, vec2(float(x + 3), y) / size).rgb;\n"
+  "    vec3 wu = vec3(-0.148, -0.291, 0.439), wv = vec3(0.439, -0.368, -0.071);\n"
+  "    colorOut = vec4(dot(c0, wu), dot(c0, wv), dot(c1, wu), dot(c1, wv)) + 0.5;\n"
+  "  }\n"
+  "}\n";
+
 static long long milliseconds(void) {
     struct timeval tv;
     gettimeofday(&tv,NULL);
@@ -35,7 +86,7 @@ ScreenRecoder::ScreenRecoder(QWidget *parent) : QPushButton(parent) {
 
     const int bitrate = Hardware::TICI() ? 4*1024*1024 : 3*1024*1024;
 
-    std::string path = "/data/media/0/videos";
+    std::string path = Hardware::PC() ? Path::HOME + "/.comma/media/0/videos" : "/data/media/0/videos";
     src_width = 2160;
     src_height = 1080;
 
@@ -47,15 +98,23 @@ ScreenRecoder::ScreenRecoder(QWidget *parent) : QPushButton(parent) {
     src_width -= bdr_s * 2;
     src_height -= bdr_s * 2;
 
+    // the NV12 packing needs a width that is a multiple of 4
     dst_height = 720;
     dst_width = src_width * dst_height / src_height;
-    if(dst_width % 2 != 0)
-        dst_width += 1;
-
-    rgb_buffer = std::make_unique<uint8_t[]>(src_width*src_height*4);
-    rgb_scale_buffer = std::make_unique<uint8_t[]>(dst_width*dst_height*4);
+    dst_width = (dst_width + 3) & ~3;
 
+#ifdef QCOM2
     encoder = std::make_unique<OmxEncoder>(path.c_str(), dst_width, dst_height, 20, bitrate, false, false);
+#else
+    encoder = std::make_unique<AvEncoder>(path.c_str(), dst_width, dst_height, 20, bitrate);
+#endif
+
+    const int frame_size = dst_width * dst_height * 3 / 2;
+    frame_bufs = std::make_unique<uint8_t[]>(frame_size * FRAME_BUF_COUNT);
+    for (int i = 0; i < FRAME_BUF_COUNT; i++) {
+        free_frames.push(frame_bufs.get() + i * frame_size);
+    }
+    encoder_thread = std::thread(&ScreenRecoder::encoderThread, this);
 
     soundStart.setSource(QUrl::fromLocalFile("../assets/sounds/start_record.wav"));
     soundStop.setSource(QUrl::fromLocalFile("../assets/sounds/stop_record.wav"));
@@ -66,6 +125,24 @@ ScreenRecoder::ScreenRecoder(QWidget *parent) : QPushButton(parent) {
 
 ScreenRecoder::~ScreenRecoder() {
   stop(false);
+  jobs.push({Job::EXIT});
+  encoder_thread.join();
+}
+
+void ScreenRecoder::encoderThread() {
+    while (true) {
+        Job job = jobs.pop();
+        if (job.type == Job::OPEN) {
+            encoder->encoder_open(job.filename.c_str());
+        } else if (job.type == Job::FRAME) {
+            encoder->encode_frame_nv12(job.frame, job.frame + dst_width * dst_height, job.ts);
+            free_frames.push(job.frame);
+        } else if (job.type == Job::CLOSE) {
+            encoder->encoder_close();
+        } else {
+            break;
+        }
+    }
 }
 
 void ScreenRecoder::applyColor() {
@@ -108,12 +185,17 @@ void ScreenRecoder::btnPressed(void) {
 }
 
 void ScreenRecoder::openEncoder(const char* filename) {
-    encoder->encoder_open(filename);
+    jobs.push({Job::OPEN, filename});
 }
 
 void ScreenRecoder::closeEncoder() {
-    if(encoder)
-        encoder->encoder_close();
+    // frames still being read back belong to the closed file
+    pbo_pending[0] = pbo_pending[1] = false;
+    jobs.push({Job::CLOSE});
+    if(dropped > 0) {
+        LOGW("screen recorder dropped %d frames", dropped);
+        dropped = 0;
+    }
 }
 
 void ScreenRecoder::toggle() {
@@ -169,29 +251,106 @@ void ScreenRecoder::ui_draw(UIState *s, int w, int h) {
 
         applyColor();
 
-        int src_w = std::min(src_width, w);
-        int src_h = std::min(src_height, h);
-
-        glReadPixels(0, 0, src_w, src_h, GL_RGBA, GL_UNSIGNED_BYTE, rgb_buffer.get());
+        capture(std::min(src_width, w), std::min(src_height, h));
+    }
 
-        libyuv::ARGBScale(rgb_buffer.get(), src_w*4,
-              src_w, src_h,
-              rgb_scale_buffer.get(), dst_width*4,
-              dst_width, dst_height,
-              libyuv::kFilterBilinear);
+    frame++;
+}
+void ScreenRecoder::initCapture() {
+    capture_program = gl_program_from_source(capture_vertex_shader, capture_fragment_shader);
+
+    glUseProgram(capture_program);
+    glUniform1i(glGetUniformLocation(capture_program, "uTexture"), 0);
+    glUniform1i(glGetUniformLocation(capture_program, "uHeight"), dst_height);
+    glUseProgram(0);
+    glGenVertexArrays(1, &capture_vao);
+
+    const int sizes[2][2] = {{dst_width, dst_height}, {dst_width / 4, dst_height * 3 / 2}};
+    glGenTextures(2, capture_tex);
+    glGenFramebuffers(2, capture_fbo);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, capture_tex[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sizes[i][0], sizes[i][1], 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindFramebuffer(GL_FRAMEBUFFER, capture_fbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, capture_tex[i], 0);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-        const uint8_t* src = rgb_scale_buffer.get();
-        const uint8_t* dst = rgb_buffer.get();
+    glGenBuffers(2, pbo);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, dst_width * dst_height * 3 / 2, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture_inited = true;
+}
 
-        int bytes_per_line = dst_width*4;
-        for (int i = 0; i < dst_height; i++) {
-            memcpy((void*)(dst + bytes_per_line * i),
-                   (void*)(src + bytes_per_line * (dst_height - i - 1)),
-                   bytes_per_line);
+// called at the end of the paint with the widget's framebuffer bound
+void ScreenRecoder::capture(int src_w, int src_h) {
+    GLint fbo, viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (!capture_inited) {
+        initCapture();
+    }
+    const bool blend = glIsEnabled(GL_BLEND), scissor = glIsEnabled(GL_SCISSOR_TEST), stencil = glIsEnabled(GL_STENCIL_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
+
+    // scale and flip to top-down rows
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, capture_fbo[0]);
+    glBlitFramebuffer(0, 0, src_w, src_h, 0, dst_height, dst_width, 0, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    // pack to NV12
+    const int packed_w = dst_width / 4, packed_h = dst_height * 3 / 2;
+    glBindFramebuffer(GL_FRAMEBUFFER, capture_fbo[1]);
+    glViewport(0, 0, packed_w, packed_h);
+    glUseProgram(capture_program);
+    glBindVertexArray(capture_vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, capture_tex[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // start reading back this frame and pass on the previous one, which has landed by now
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[pbo_index]);
+    glReadPixels(0, 0, packed_w, packed_h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    pbo_ts[pbo_index] = nanos_since_boot();
+    pbo_pending[pbo_index] = true;
+
+    pbo_index = 1 - pbo_index;
+    if (pbo_pending[pbo_index]) {
+        pbo_pending[pbo_index] = false;
+        uint8_t *buf = nullptr;
+        if (free_frames.try_pop(buf)) {
+            const int frame_size = dst_width * dst_height * 3 / 2;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[pbo_index]);
+            const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size, GL_MAP_READ_BIT);
+            if (data) {
+                memcpy(buf, data, frame_size);
+                jobs.push({Job::FRAME, "", buf, pbo_ts[pbo_index]});
+            } else {
+                free_frames.push(buf);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            dropped++;
         }
-
-        encoder->encode_frame_rgba(dst, dst_width, dst_height, (uint64_t)nanos_since_boot());
     }
 
-    frame++;
-}
\ No newline at end of file
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) glEnable(GL_BLEND);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+    if (stencil) glEnable(GL_STENCIL_TEST);
+}
@@ -2,11 +2,20 @@
 
 #include <memory>
 #include <cstdint>
+#include <string>
+#include <thread>
 #include <QPainter>
 #include <QPushButton>
 #include <QSoundEffect>
 
-#include "omx_encoder.h"
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GLES3/gl3.h>
+#endif
+
+#include "selfdrive/common/queue.h"
+#include "selfdrive/ui/qt/screenrecorder/encoder.h"
 #include "selfdrive/ui/ui.h"
 
 class ScreenRecoder : public QPushButton {
@@ -29,9 +38,30 @@ private:
     long long started;
     int src_width, src_height;
     int dst_width, dst_height;
-    std::unique_ptr<OmxEncoder> encoder;
-    std::unique_ptr<uint8_t[]> rgb_buffer;
-    std::unique_ptr<uint8_t[]> rgb_scale_buffer;
+    std::unique_ptr<ScreenEncoder> encoder;
+
+    // The screen is scaled and converted to NV12 on the GPU, and read back through two
+    // pixel buffers so that a frame is mapped one paint after its glReadPixels.
+    bool capture_inited = false;
+    GLuint capture_program, capture_vao;
+    GLuint capture_fbo[2], capture_tex[2];  // scaled RGBA, packed NV12
+    GLuint pbo[2];
+    uint64_t pbo_ts[2];
+    bool pbo_pending[2] = {};
+    int pbo_index = 0;
+
+    // frames are encoded on their own thread, a full pool drops frames
+    struct Job {
+      enum {OPEN, FRAME, CLOSE, EXIT} type;
+      std::string filename;
+      uint8_t *frame;
+      uint64_t ts;
+    };
+    std::unique_ptr<uint8_t[]> frame_bufs;
+    SafeQueue<uint8_t *> free_frames;
+    SafeQueue<Job> jobs;
+    std::thread encoder_thread;
+    int dropped = 0;
 
     QColor recording_color;
     int frame;
@@ -42,6 +72,9 @@ private:
     void applyColor();
     void openEncoder(const char* filename);
     void closeEncoder();
+    void initCapture();
+    void capture(int src_w, int src_h);
+    void encoderThread();
 
 public:
     void start(bool sound);
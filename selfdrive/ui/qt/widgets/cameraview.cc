@@ -24,14 +24,26 @@ const char frame_fragment_shader[] =
   "#version 300 es\n"
 #endif
   "precision mediump float;\n"
+#ifdef QCOM
   "uniform sampler2D uTexture;\n"
+#else
+  "uniform sampler2D uTextureY;\n"
+  "uniform sampler2D uTextureU;\n"
+  "uniform sampler2D uTextureV;\n"
+#endif
   "in vec4 vTexCoord;\n"
   "out vec4 colorOut;\n"
   "void main() {\n"
-  "  colorOut = texture(uTexture, vTexCoord.xy);\n"
 #ifdef QCOM
+  "  colorOut = texture(uTexture, vTexCoord.xy);\n"
   "  vec3 dz = vec3(0.0627f, 0.0627f, 0.0627f);\n"
   "  colorOut.rgb = ((vec3(1.0f, 1.0f, 1.0f) - dz) * colorOut.rgb / vec3(1.0f, 1.0f, 1.0f)) + dz;\n"
+#else
+  // BT.601 limited range, the inverse of camerad's rgb_to_yuv.cl
+  "  float y = 1.164 * (texture(uTextureY, vTexCoord.xy).r - 0.0625);\n"
+  "  float u = texture(uTextureU, vTexCoord.xy).r - 0.5;\n"
+  "  float v = texture(uTextureV, vTexCoord.xy).r - 0.5;\n"
+  "  colorOut = vec4(y + 1.596 * v, y - 0.391 * u - 0.813 * v, y + 2.018 * u, 1.0);\n"
 #endif
   "}\n";
 
@@ -42,6 +54,21 @@ const mat4 device_transform = {{
   0.0,  0.0, 0.0, 1.0,
 }};
 
+// The EON maps the RGB buffers as EGLImages. Everywhere else the frame is uploaded,
+// so the widget reads the smaller YUV stream and converts in the fragment shader.
+VisionStreamType get_vipc_stream_type(VisionStreamType type) {
+#ifdef QCOM
+  return type;
+#else
+  switch (type) {
+    case VISION_STREAM_RGB_BACK: return VISION_STREAM_YUV_BACK;
+    case VISION_STREAM_RGB_FRONT: return VISION_STREAM_YUV_FRONT;
+    case VISION_STREAM_RGB_WIDE: return VISION_STREAM_YUV_WIDE;
+    default: return type;
+  }
+#endif
+}
+
 mat4 get_driver_view_transform() {
   const float driver_view_ratio = 1.333;
   mat4 transform;
@@ -94,10 +121,7 @@ mat4 get_fit_view_transform(float widget_aspect_ratio, float frame_aspect_ratio)
 CameraViewWidget::CameraViewWidget(VisionStreamType stream_type, bool zoom, QWidget* parent) :
                                    stream_type(stream_type), zoomed_view(zoom), QOpenGLWidget(parent) {
   setAttribute(Qt::WA_OpaquePaintEvent);
-
-  QTimer *t = new QTimer(this);
-  connect(t, &QTimer::timeout, this, &CameraViewWidget::updateFrame);
-  t->start(10);
+  scheduler = new FrameScheduler(this, [=]() { return updateFrame(); });
 }
 
 CameraViewWidget::~CameraViewWidget() {
@@ -106,6 +130,9 @@ CameraViewWidget::~CameraViewWidget() {
     glDeleteVertexArrays(1, &frame_vao);
     glDeleteBuffers(1, &frame_vbo);
     glDeleteBuffers(1, &frame_ibo);
+#ifndef QCOM
+    glDeleteTextures(3, textures);
+#endif
   }
   doneCurrent();
 }
@@ -149,11 +176,20 @@ void CameraViewWidget::initializeGL() {
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindVertexArray(0);
 
+#ifndef QCOM
+  glGenTextures(3, textures);
+#endif
+
   setStreamType(stream_type);
 }
 
 
+void CameraViewWidget::showEvent(QShowEvent *event) {
+  scheduler->start();
+}
+
 void CameraViewWidget::hideEvent(QHideEvent *event) {
+  scheduler->stop();
   vipc_client->connected = false;
   latest_frame = nullptr;
 }
@@ -169,7 +205,7 @@ void CameraViewWidget::resizeGL(int w, int h) {
 void CameraViewWidget::setStreamType(VisionStreamType type) {
   if (!vipc_client || type != stream_type) {
     stream_type = type;
-    vipc_client.reset(new VisionIpcClient("camerad", stream_type, true));
+    vipc_client.reset(new VisionIpcClient("camerad", get_vipc_stream_type(stream_type), true));
     updateFrameMat(width(), height());
   }
 }
@@ -217,17 +253,29 @@ void CameraViewWidget::paintGL() {
   glViewport(0, 0, width(), height());
 
   glBindVertexArray(frame_vao);
-  glActiveTexture(GL_TEXTURE0);
+  glUseProgram(program->programId());
 
+#ifdef QCOM
+  // this is handled in ion on QCOM
+  glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, texture[latest_frame->idx]->frame_tex);
-  if (!Hardware::EON()) {
-    // this is handled in ion on QCOM
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, latest_frame->width, latest_frame->height,
-                  0, GL_RGB, GL_UNSIGNED_BYTE, latest_frame->addr);
-  }
-
-  glUseProgram(program->programId());
   glUniform1i(program->uniformLocation("uTexture"), 0);
+#else
+  // update the planes in place, the textures were sized on connect
+  const char *samplers[] = {"uTextureY", "uTextureU", "uTextureV"};
+  const uint8_t *planes[] = {latest_frame->y, latest_frame->u, latest_frame->v};
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (int i = 0; i < 3; i++) {
+    const int w = i == 0 ? latest_frame->width : latest_frame->width / 2;
+    const int h = i == 0 ? latest_frame->height : latest_frame->height / 2;
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RED, GL_UNSIGNED_BYTE, planes[i]);
+    glUniform1i(program->uniformLocation(samplers[i]), i);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glActiveTexture(GL_TEXTURE0);
+#endif
   glUniformMatrix4fv(program->uniformLocation("uTransform"), 1, GL_TRUE, frame_mat.v);
 
   assert(glGetError() == GL_NO_ERROR);
@@ -237,15 +285,16 @@ void CameraViewWidget::paintGL() {
   glBindVertexArray(0);
 }
 
-void CameraViewWidget::updateFrame() {
+bool CameraViewWidget::updateFrame() {
   if (!isVisible()) {
-    return;
+    return false;
   }
 
   if (!vipc_client->connected) {
     makeCurrent();
     if (vipc_client->connect(false)) {
       // init vision
+#ifdef QCOM
       for (int i = 0; i < vipc_client->num_buffers; i++) {
         texture[i].reset(new EGLImageTexture(&vipc_client->buffers[i]));
 
@@ -259,18 +308,38 @@ void CameraViewWidget::updateFrame() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
         assert(glGetError() == GL_NO_ERROR);
       }
+#else
+      // one full size Y plane and quarter size U and V planes
+      const VisionBuf &buf = vipc_client->buffers[0];
+      for (int i = 0; i < 3; i++) {
+        const int w = i == 0 ? buf.width : buf.width / 2;
+        const int h = i == 0 ? buf.height : buf.height / 2;
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, i == 0 ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, i == 0 ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        assert(glGetError() == GL_NO_ERROR);
+      }
+#endif
       latest_frame = nullptr;
       resizeGL(width(), height());
     }
   }
 
-  VisionBuf *buf = nullptr;
-  if (vipc_client->connected) {
-    buf = vipc_client->recv(nullptr, 0);
-    if (buf != nullptr) {
-      latest_frame = buf;
-      update();
-      emit frameUpdated();
-    }
+  // skip to the newest frame, the scheduler repaints
+  bool updated = false;
+  VisionIpcBufExtra extra;
+  while (vipc_client->connected) {
+    VisionBuf *buf = vipc_client->recv(&extra, 0);
+    if (buf == nullptr) break;
+    latest_frame = buf;
+    updated = true;
+  }
+  if (updated) {
+    scheduler->setFrameTimestamp(extra.timestamp_eof);
+    emit frameUpdated();
   }
+  return updated;
 }
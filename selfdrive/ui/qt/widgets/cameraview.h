@@ -9,6 +9,7 @@
 #include "cereal/visionipc/visionipc_client.h"
 #include "selfdrive/common/mat.h"
 #include "selfdrive/common/visionimg.h"
+#include "selfdrive/ui/qt/frame_scheduler.h"
 #include "selfdrive/ui/ui.h"
 
 class CameraViewWidget : public QOpenGLWidget, protected QOpenGLFunctions {
@@ -29,20 +30,25 @@ protected:
   void paintGL() override;
   void resizeGL(int w, int h) override;
   void initializeGL() override;
+  void showEvent(QShowEvent *event) override;
   void hideEvent(QHideEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
   void updateFrameMat(int w, int h);
+  // called by the scheduler before each vsync, returns whether to repaint
+  virtual bool updateFrame();
   std::unique_ptr<VisionIpcClient> vipc_client;
-
-protected slots:
-  void updateFrame();
+  FrameScheduler *scheduler;
 
 private:
   bool zoomed_view;
   VisionBuf *latest_frame = nullptr;
   GLuint frame_vao, frame_vbo, frame_ibo;
   mat4 frame_mat;
+#ifdef QCOM
   std::unique_ptr<EGLImageTexture> texture[UI_BUF_COUNT];
+#else
+  GLuint textures[3];  // Y, U and V planes
+#endif
   QOpenGLShaderProgram *program;
 
   VisionStreamType stream_type;
@@ -0,0 +1,84 @@
+#include "selfdrive/ui/replay/camera.h"
+
+#include <cstring>
+
+#include "libyuv.h"
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/util.h"
+
+const int RGB_BUF_COUNT = 4;
+const int YUV_BUF_COUNT = 40;
+// a camera further behind skips its oldest frames instead of serving them ever later
+const int MAX_QUEUED_FRAMES = 10;
+
+CameraServer::CameraServer(const std::pair<int, int> (&sizes)[MAX_CAMERAS]) {
+  vipc_server_ = std::make_unique<VisionIpcServer>("camerad");
+  for (auto &cam : cameras_) {
+    std::tie(cam.width, cam.height) = sizes[cam.type];
+    if (cam.width > 0 && cam.height > 0) {
+      vipc_server_->create_buffers(cam.rgb_type, RGB_BUF_COUNT, true, cam.width, cam.height);
+      vipc_server_->create_buffers(cam.yuv_type, YUV_BUF_COUNT, false, cam.width, cam.height);
+      cam.thread = std::thread(&CameraServer::cameraThread, this, std::ref(cam));
+    }
+  }
+  vipc_server_->start_listener();
+}
+
+CameraServer::~CameraServer() {
+  for (auto &cam : cameras_) {
+    if (cam.thread.joinable()) {
+      cam.queue.push({});
+      cam.thread.join();
+    }
+  }
+}
+
+void CameraServer::pushFrame(CameraType type, std::shared_ptr<FrameReader> fr, const Event::Frame &frame) {
+  Camera &cam = cameras_[type];
+  if (!cam.thread.joinable()) return;
+
+  if (fr->width != cam.width || fr->height != cam.height) {
+    LOGW("camera %d: skipping %dx%d frame, serving %dx%d", type, fr->width, fr->height, cam.width, cam.height);
+    return;
+  }
+  std::tuple<std::shared_ptr<FrameReader>, Event::Frame> oldest;
+  while (cam.queue.size() >= MAX_QUEUED_FRAMES && cam.queue.try_pop(oldest)) {
+    ++dropped_frames_;
+  }
+  cam.queue.push({fr, frame});
+}
+
+void CameraServer::cameraThread(Camera &cam) {
+  set_thread_name("replay_camera");
+
+  while (true) {
+    auto [fr, frame] = cam.queue.pop();
+    if (!fr) break;
+
+    FrameReader::YUVBuffer yuv = fr->get(frame.segment_id);
+    if (yuv) {
+      VisionBuf *yuv_buf = vipc_server_->get_buffer(cam.yuv_type);
+      memcpy(yuv_buf->addr, yuv->data(), yuv->size());
+
+      VisionBuf *rgb_buf = vipc_server_->get_buffer(cam.rgb_type);
+      const uint8_t *y = yuv->data(), *u = y + cam.width * cam.height, *v = u + (cam.width / 2) * (cam.height / 2);
+      libyuv::I420ToRGB24(y, cam.width, u, cam.width / 2, v, cam.width / 2,
+                          (uint8_t *)rgb_buf->addr, rgb_buf->stride, cam.width, cam.height);
+
+      VisionIpcBufExtra extra = {
+        .frame_id = frame.frame_id,
+        .timestamp_sof = frame.timestamp_sof,
+        .timestamp_eof = frame.timestamp_eof,
+      };
+      vipc_server_->send(rgb_buf, &extra, false);
+      vipc_server_->send(yuv_buf, &extra, false);
+    } else {
+      LOGW("camera %d: failed to decode frame %u of segment %d", cam.type, frame.segment_id, frame.segment_num);
+    }
+
+    if (!cam.queue.empty()) {
+      ++late_frames_;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <tuple>
+
+#include "cereal/visionipc/visionipc_server.h"
+#include "selfdrive/common/queue.h"
+#include "selfdrive/ui/replay/route.h"
+
+// Serves the replayed camera frames over VisionIPC like camerad, in RGB and YUV.
+// Each camera decodes and sends on its own thread, so a slow decode delays its frames
+// but not the messages of the replay thread.
+class CameraServer {
+public:
+  // width and height per camera, 0 for the cameras without frames
+  CameraServer(const std::pair<int, int> (&sizes)[MAX_CAMERAS]);
+  ~CameraServer();
+  void pushFrame(CameraType type, std::shared_ptr<FrameReader> fr, const Event::Frame &frame);
+  // frames sent after the next one was already pushed
+  size_t lateFrames() const { return late_frames_; }
+  // frames dropped unsent because the camera was too far behind
+  size_t droppedFrames() const { return dropped_frames_; }
+
+private:
+  struct Camera {
+    CameraType type;
+    VisionStreamType rgb_type, yuv_type;
+    int width, height;
+    std::thread thread;
+    SafeQueue<std::tuple<std::shared_ptr<FrameReader>, Event::Frame>> queue;
+  };
+  void cameraThread(Camera &cam);
+
+  Camera cameras_[MAX_CAMERAS] = {
+    {.type = RoadCam, .rgb_type = VISION_STREAM_RGB_BACK, .yuv_type = VISION_STREAM_YUV_BACK},
+    {.type = DriverCam, .rgb_type = VISION_STREAM_RGB_FRONT, .yuv_type = VISION_STREAM_YUV_FRONT},
+    {.type = WideRoadCam, .rgb_type = VISION_STREAM_RGB_WIDE, .yuv_type = VISION_STREAM_YUV_WIDE},
+  };
+  std::atomic<size_t> late_frames_ = 0, dropped_frames_ = 0;
+  std::unique_ptr<VisionIpcServer> vipc_server_;
+};
@@ -1,7 +1,9 @@
 #include "selfdrive/ui/replay/framereader.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <mutex>
 #include "libyuv.h"
 
@@ -9,13 +11,14 @@ static int ffmpeg_lockmgr_cb(void **arg, enum AVLockOp op) {
   std::mutex *mutex = (std::mutex *)*arg;
   switch (op) {
   case AV_LOCK_CREATE:
-    mutex = new std::mutex();
+    *arg = new std::mutex();
     break;
   case AV_LOCK_OBTAIN:
     mutex->lock();
     break;
   case AV_LOCK_RELEASE:
     mutex->unlock();
+    break;
   case AV_LOCK_DESTROY:
     delete mutex;
     break;
@@ -33,134 +36,340 @@ struct AVInitializer {
   ~AVInitializer() { avformat_network_deinit(); }
 };
 
-FrameReader::FrameReader() {
+// The parameter set NAL units (VPS/SPS/PPS, SPS/PPS for h264) of an Annex B packet
+static std::vector<uint8_t> get_param_sets(AVCodecID codec_id, const uint8_t *data, int size) {
+  auto next_start_code = [=](int from) {
+    for (int i = from; i + 3 <= size; ++i) {
+      if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) return i;
+    }
+    return size;
+  };
+
+  std::vector<uint8_t> param_sets;
+  for (int start = next_start_code(0); start < size;) {
+    const int nal = start + 3, end = next_start_code(nal);
+    int nal_end = end;
+    while (nal_end > nal && data[nal_end - 1] == 0) --nal_end;  // the next start code may have 4 bytes
+    if (nal < nal_end) {
+      const int type = codec_id == AV_CODEC_ID_HEVC ? (data[nal] >> 1) & 0x3f : data[nal] & 0x1f;
+      if (codec_id == AV_CODEC_ID_HEVC ? (type >= 32 && type <= 34) : (type == 7 || type == 8)) {
+        const uint8_t start_code[] = {0, 0, 0, 1};
+        param_sets.insert(param_sets.end(), start_code, start_code + 4);
+        param_sets.insert(param_sets.end(), data + nal, data + nal_end);
+      }
+    }
+    start = end;
+  }
+  return param_sets;
+}
+
+FrameReader::FrameReader(size_t max_cached_frames, int decode_threads)
+    : max_cached_frames_(std::max<size_t>(max_cached_frames, 1)) {
   static AVInitializer av_initializer;
+  decode_threads_ = decode_threads > 0 ? decode_threads : std::clamp((int)std::thread::hardware_concurrency() / 2, 1, 4);
 }
 
 FrameReader::~FrameReader() {
-  for (auto &f : frames_) {
-    av_free_packet(&f.pkt);
+  {
+    std::unique_lock lk(lock_);
+    exit_ = true;
   }
-  if (pCodecCtx_) {
-    avcodec_close(pCodecCtx_);
-    avcodec_free_context(&pCodecCtx_);
-  }
-  if (pFormatCtx_) {
-    avformat_close_input(&pFormatCtx_);
+  task_cv_.notify_all();
+  frame_cv_.notify_all();
+  for (auto &t : threads_) t.join();
+
+  for (auto &p : packets_) {
+    av_packet_unref(&p.pkt);
   }
-  if (av_frame_) {
-    av_frame_free(&av_frame_);
+  if (codecpar_) {
+    avcodec_parameters_free(&codecpar_);
   }
 }
 
 bool FrameReader::load(const std::string &url) {
-  pFormatCtx_ = avformat_alloc_context();
-  pFormatCtx_->probesize = 10 * 1024 * 1024;  // 10MB
-  if (avformat_open_input(&pFormatCtx_, url.c_str(), NULL, NULL) != 0) {
+  AVFormatContext *pFormatCtx = avformat_alloc_context();
+  pFormatCtx->probesize = 10 * 1024 * 1024;  // 10MB
+  if (avformat_open_input(&pFormatCtx, url.c_str(), NULL, NULL) != 0) {
     printf("error loading %s\n", url.c_str());
     return false;
   }
-  avformat_find_stream_info(pFormatCtx_, NULL);
-  // av_dump_format(pFormatCtx_, 0, url.c_str(), 0);
-
-  auto pCodecCtxOrig = pFormatCtx_->streams[0]->codec;
-  auto pCodec = avcodec_find_decoder(pCodecCtxOrig->codec_id);
-  if (!pCodec) return false;
-
-  pCodecCtx_ = avcodec_alloc_context3(pCodec);
-  int ret = avcodec_copy_context(pCodecCtx_, pCodecCtxOrig);
-  if (ret != 0) return false;
-
-  pCodecCtx_->thread_count = 0;
-  pCodecCtx_->thread_type = FF_THREAD_FRAME;
-  ret = avcodec_open2(pCodecCtx_, pCodec, NULL);
-  if (ret < 0) return false;
+  avformat_find_stream_info(pFormatCtx, NULL);
+  // av_dump_format(pFormatCtx, 0, url.c_str(), 0);
 
-  av_frame_ = av_frame_alloc();
+  codecpar_ = avcodec_parameters_alloc();
+  avcodec_parameters_copy(codecpar_, pFormatCtx->streams[0]->codecpar);
+  codec_ = avcodec_find_decoder(codecpar_->codec_id);
+  width = codecpar_->width;
+  height = codecpar_->height;
 
-  width = pCodecCtxOrig->width;
-  height = pCodecCtxOrig->height;
+  // Local raw Annex B streams (fcamera.hevc) are read again by offset, their packets are
+  // the bytes at pkt.pos. In containers like qcamera.ts or the raw logger's mkv the payload
+  // is interleaved with headers, so those, and remote streams, keep their packets.
+  url_ = url;
+  const std::string format = pFormatCtx->iformat->name;
+  lazy_ = url.find("://") == std::string::npos && (format == "hevc" || format == "h264");
 
-  frames_.reserve(60 * 20);  // 20fps, one minute
-  while (true) {
-    Frame &frame = frames_.emplace_back();
-    int err = av_read_frame(pFormatCtx_, &frame.pkt);
+  int key_frames_count = 0;
+  packets_.reserve(60 * 20);  // 20fps, one minute
+  while (codec_) {
+    AVPacket pkt;
+    int err = av_read_frame(pFormatCtx, &pkt);
     if (err < 0) {
-      frames_.pop_back();
       valid_ = (err == AVERROR_EOF);
       break;
     }
+    if (packets_.empty()) {
+      param_sets_ = get_param_sets(codecpar_->codec_id, pkt.data, pkt.size);
+    }
+    Packet &p = packets_.emplace_back();
+    p.pos = pkt.pos;
+    p.size = pkt.size;
+    p.key = pkt.flags & AV_PKT_FLAG_KEY;
+    if (lazy_) {
+      av_packet_unref(&pkt);
+    } else {
+      p.pkt = pkt;
+    }
     // some stream seems to contian no keyframes
-    key_frames_count_ += frame.pkt.flags & AV_PKT_FLAG_KEY;
+    key_frames_count += p.key;
+  }
+  avformat_close_input(&pFormatCtx);
+  if (!valid_ || packets_.empty()) {
+    valid_ = false;
+    return false;
+  }
+
+  // GOPs start at the keyframes, a stream without them is a single GOP
+  packet_gop_.resize(packets_.size());
+  for (int i = 0; i < packets_.size(); ++i) {
+    if (i == 0 || (packets_[i].key && key_frames_count > 1)) {
+      if (!gops_.empty()) gops_.back().end = i;
+      gops_.push_back({i, (int)packets_.size()});
+    }
+    packet_gop_[i] = gops_.size() - 1;
+  }
+  failed_.resize(packets_.size(), false);
+
+  // read ahead as many GOPs as there are workers, while they fit in the cache next to the current one
+  const size_t gop_size = packets_.size() / gops_.size();
+  read_ahead_ = std::min<int>(decode_threads_, std::max<int>(0, max_cached_frames_ / std::max<size_t>(gop_size, 1) - 1));
+  for (int i = 0; i < decode_threads_; ++i) {
+    threads_.emplace_back(&FrameReader::decodeThread, this);
   }
   return valid_;
 }
 
+FrameReader::YUVBuffer FrameReader::get(int idx) {
+  if (!valid_ || idx < 0 || idx >= packets_.size()) {
+    return nullptr;
+  }
+
+  std::unique_lock lk(lock_);
+  requested_ = idx;
+  schedule(packet_gop_[idx]);
+  frame_cv_.notify_all();
+  while (!exit_) {
+    if (YUVBuffer frame = cached(idx)) return frame;
+    if (failed_[idx]) return nullptr;
+    // decoded and already evicted again, or its GOP was abandoned
+    if (gops_[packet_gop_[idx]].state == Gop::IDLE) schedule(packet_gop_[idx]);
+    frame_cv_.wait(lk);
+  }
+  return nullptr;
+}
+
 bool FrameReader::get(int idx, uint8_t *rgb, uint8_t *yuv) {
-  assert(rgb != nullptr);
-  if (!valid_ || idx < 0 || idx >= frames_.size()) {
-    return false;
+  assert(rgb != nullptr || yuv != nullptr);
+  YUVBuffer frame = get(idx);
+  if (!frame) return false;
+
+  const uint8_t *y = frame->data();
+  if (yuv) {
+    memcpy(yuv, y, frame->size());
+  }
+  if (rgb) {
+    const uint8_t *u = y + width * height;
+    const uint8_t *v = u + (width / 2) * (height / 2);
+    libyuv::I420ToRGB24(y, width, u, width / 2, v, width / 2, rgb, width * 3, width, height);
   }
-  return decode(idx, rgb, yuv);
+  return true;
 }
 
-bool FrameReader::decode(int idx, uint8_t *rgb, uint8_t *yuv) {
-  auto get_keyframe = [=](int idx) {
-    for (int i = idx; i >= 0 && key_frames_count_ > 1; --i) {
-      if (frames_[i].pkt.flags & AV_PKT_FLAG_KEY) return i;
+// lock_ held
+void FrameReader::schedule(int gop) {
+  // drop queued read ahead outside the new window, e.g. after a seek
+  for (auto it = queue_.begin(); it != queue_.end();) {
+    if (*it < gop || *it > gop + read_ahead_) {
+      gops_[*it].state = Gop::IDLE;
+      it = queue_.erase(it);
+    } else {
+      ++it;
     }
-    return idx;
-  };
+  }
 
-  int from_idx = idx;
-  if (idx > 0 && !frames_[idx].decoded && !frames_[idx - 1].decoded) {
-    // find the previous keyframe
-    from_idx = get_keyframe(idx);
-  }
-
-  for (int i = from_idx; i <= idx; ++i) {
-    Frame &frame = frames_[i];
-    if ((!frame.decoded || i == idx) && !frame.failed) {
-      while (true) {
-        int ret = avcodec_decode_video2(pCodecCtx_, av_frame_, &frame.decoded, &(frame.pkt));
-        if (ret > 0 && !frame.decoded) {
-          // decode thread is still receiving the initial packets
-          usleep(0);
-        } else {
-          break;
-        }
-      }
-      frame.failed = !frame.decoded;
-      if (frame.decoded && i == idx) {
-        return decodeFrame(av_frame_, rgb, yuv);
-      }
+  if (gops_[gop].state == Gop::IDLE && !cache_.count(requested_)) {
+    gops_[gop].state = Gop::QUEUED;
+    queue_.push_front(gop);
+  }
+  for (int g = gop + 1; g <= std::min<int>(gop + read_ahead_, gops_.size() - 1); ++g) {
+    if (gops_[g].state == Gop::IDLE && (!cache_.count(gops_[g].start) || !cache_.count(gops_[g].end - 1))) {
+      gops_[g].state = Gop::QUEUED;
+      queue_.push_back(g);
     }
   }
-  return false;
+  task_cv_.notify_all();
 }
 
-bool FrameReader::decodeFrame(AVFrame *f, uint8_t *rgb, uint8_t *yuv) {
-  uint8_t *y = yuv;
-  if (!yuv) {
-    if (yuv_buf_.empty()) {
-      yuv_buf_.resize(getYUVSize());
+// lock_ held
+FrameReader::YUVBuffer FrameReader::cached(int idx) {
+  auto it = cache_.find(idx);
+  if (it == cache_.end()) return nullptr;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->second;
+}
+
+// lock_ held
+void FrameReader::insert(int idx, YUVBuffer frame) {
+  auto it = cache_.find(idx);
+  if (it != cache_.end()) {
+    lru_.erase(it->second);
+  }
+  lru_.emplace_front(idx, frame);
+  cache_[idx] = lru_.begin();
+  while (lru_.size() > max_cached_frames_) {
+    cache_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+void FrameReader::decodeThread() {
+  AVIOContext *io = nullptr;
+  if (lazy_ && avio_open(&io, url_.c_str(), AVIO_FLAG_READ) < 0) {
+    printf("error opening %s\n", url_.c_str());
+    io = nullptr;
+  }
+
+  while (true) {
+    int gop;
+    {
+      std::unique_lock lk(lock_);
+      task_cv_.wait(lk, [&] { return exit_ || !queue_.empty(); });
+      if (exit_) break;
+      gop = queue_.front();
+      queue_.pop_front();
+      gops_[gop].state = Gop::DECODING;
     }
-    y = yuv_buf_.data();
+    decodeGop(gop, io);
   }
 
-  int i, j, k;
-  for (i = 0; i < f->height; i++) {
-    memcpy(y + f->width * i, f->data[0] + f->linesize[0] * i, f->width);
+  if (io) {
+    avio_closep(&io);
   }
-  for (j = 0; j < f->height / 2; j++) {
-    memcpy(y + f->width * i + f->width / 2 * j, f->data[1] + f->linesize[1] * j, f->width / 2);
+}
+
+bool FrameReader::readPacket(int idx, AVIOContext *io, std::vector<uint8_t> &buf) {
+  const Packet &p = packets_[idx];
+  // prefix the parameter sets to the first packet of a GOP, for a decoder that starts there
+  const bool prefix = idx > 0 && idx == gops_[packet_gop_[idx]].start;
+  const int offset = prefix ? param_sets_.size() : 0;
+  buf.resize(offset + p.size + AV_INPUT_BUFFER_PADDING_SIZE);
+  if (prefix) {
+    memcpy(buf.data(), param_sets_.data(), offset);
   }
-  for (k = 0; k < f->height / 2; k++) {
-    memcpy(y + f->width * i + f->width / 2 * j + f->width / 2 * k, f->data[2] + f->linesize[2] * k, f->width / 2);
+  memset(buf.data() + offset + p.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+  if (!lazy_) {
+    memcpy(buf.data() + offset, p.pkt.data, p.size);
+    return true;
   }
+  return io && p.pos >= 0 && avio_seek(io, p.pos, SEEK_SET) == p.pos &&
+         avio_read(io, buf.data() + offset, p.size) == p.size;
+}
 
-  uint8_t *u = y + f->width * f->height;
-  uint8_t *v = u + (f->width / 2) * (f->height / 2);
-  libyuv::I420ToRGB24(y, f->width, u, f->width / 2, v, f->width / 2, rgb, f->width * 3, f->width, f->height);
-  return true;
+void FrameReader::decodeGop(int gop, AVIOContext *io) {
+  const int start = gops_[gop].start, end = gops_[gop].end;
+  // a GOP longer than the cache is decoded no further ahead of the reader than half of it
+  const int window = max_cached_frames_ / 2;
+  const bool long_gop = end - start > window;
+
+  AVCodecContext *ctx = avcodec_alloc_context3(codec_);
+  bool ok = avcodec_parameters_to_context(ctx, codecpar_) >= 0;
+  // the workers already decode GOPs in parallel
+  ctx->thread_count = 1;
+  ok = ok && avcodec_open2(ctx, codec_, NULL) >= 0;
+
+  AVFrame *f = av_frame_alloc();
+  std::vector<uint8_t> buf;
+  int next_frame = start;  // decoded frames belong to the packets in order
+  bool abandoned = false;
+
+  auto receive = [&]() {
+    auto frame = std::make_shared<std::vector<uint8_t>>(getYUVSize());
+    uint8_t *y = frame->data(), *u = y + width * height, *v = u + (width / 2) * (height / 2);
+    libyuv::I420Copy(f->data[0], f->linesize[0], f->data[1], f->linesize[1], f->data[2], f->linesize[2],
+                     y, width, u, width / 2, v, width / 2, width, height);
+
+    std::unique_lock lk(lock_);
+    while (next_frame < end && failed_[next_frame]) ++next_frame;
+    if (next_frame < end) {
+      insert(next_frame++, frame);
+    }
+    frame_cv_.notify_all();
+  };
+
+  for (int i = start; ok && i < end && !abandoned; ++i) {
+    if (long_gop) {
+      std::unique_lock lk(lock_);
+      frame_cv_.wait(lk, [&] {
+        abandoned = exit_ || requested_ < start || requested_ >= end || (requested_ < i && !cache_.count(requested_));
+        return abandoned || i < requested_ + window;
+      });
+      if (abandoned) break;
+    }
+
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    if (!readPacket(i, io, buf)) {
+      std::unique_lock lk(lock_);
+      failed_[i] = true;
+      continue;
+    }
+    pkt.data = buf.data();
+    pkt.size = buf.size() - AV_INPUT_BUFFER_PADDING_SIZE;
+    pkt.flags = packets_[i].key ? AV_PKT_FLAG_KEY : 0;
+
+    int got_frame = 0;
+    if (avcodec_decode_video2(ctx, f, &got_frame, &pkt) < 0) {
+      std::unique_lock lk(lock_);
+      failed_[i] = true;
+    } else if (got_frame) {
+      receive();
+    }
+    abandoned = abandoned || exit_;
+  }
+
+  if (ok && !abandoned) {
+    // flush the frames the decoder still holds
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    int got_frame = 0;
+    while (avcodec_decode_video2(ctx, f, &got_frame, &pkt) >= 0 && got_frame) {
+      receive();
+    }
+  }
+
+  av_frame_free(&f);
+  avcodec_free_context(&ctx);
+
+  std::unique_lock lk(lock_);
+  if (!abandoned) {
+    // packets without a frame failed
+    for (int i = next_frame; i < end; ++i) {
+      failed_[i] = true;
+    }
+  }
+  gops_[gop].state = Gop::IDLE;
+  frame_cv_.notify_all();
 }
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
@@ -8,33 +16,69 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
+// load() only indexes the packets and their GOPs. Packet data of local raw hevc/h264
+// files is read again when its GOP is decoded, other streams keep it in memory. Every
+// GOP is decoded with its own decoder context on a pool of workers, the GOP of a
+// requested frame first and the following ones ahead of it, into a bounded LRU cache
+// of I420 frames.
 class FrameReader {
 public:
-  FrameReader();
+  using YUVBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+  FrameReader(size_t max_cached_frames = 60, int decode_threads = 0);
   ~FrameReader();
   bool load(const std::string &url);
+  // the I420 frame, null if it failed to decode
+  YUVBuffer get(int idx);
+  // either output may be null, at least one is required
   bool get(int idx, uint8_t *rgb, uint8_t *yuv);
   int getRGBSize() const { return width * height * 3; }
   int getYUVSize() const { return width * height * 3 / 2; }
-  size_t getFrameCount() const { return frames_.size(); }
+  size_t getFrameCount() const { return packets_.size(); }
   bool valid() const { return valid_; }
 
   int width = 0, height = 0;
 
 private:
-  bool decode(int idx, uint8_t *rgb, uint8_t *yuv);
-  bool decodeFrame(AVFrame *f, uint8_t *rgb, uint8_t *yuv);
-
-  struct Frame {
-    AVPacket pkt = {};
-    int decoded = false;
-    bool failed = false;
+  struct Packet {
+    int64_t pos;
+    int size;
+    bool key;
+    AVPacket pkt = {};  // only without lazy reads
   };
-  std::vector<Frame> frames_;
-  AVFrame *av_frame_ = nullptr;
-  AVFormatContext *pFormatCtx_ = nullptr;
-  AVCodecContext *pCodecCtx_ = nullptr;
-  int key_frames_count_ = 0;
-  std::vector<uint8_t> yuv_buf_;
+  struct Gop {
+    int start, end;
+    enum {IDLE, QUEUED, DECODING} state = IDLE;
+  };
+
+  void decodeThread();
+  void decodeGop(int gop, AVIOContext *io);
+  bool readPacket(int idx, AVIOContext *io, std::vector<uint8_t> &buf);
+  void schedule(int gop);
+  YUVBuffer cached(int idx);
+  void insert(int idx, YUVBuffer frame);
+
+  std::string url_;
+  bool lazy_ = false;
+  std::vector<Packet> packets_;
+  std::vector<int> packet_gop_;
+  std::vector<Gop> gops_;
+  std::vector<uint8_t> param_sets_;  // prepended to every GOP, streams may only have them up front
+  AVCodec *codec_ = nullptr;
+  AVCodecParameters *codecpar_ = nullptr;
+
+  // LRU of decoded frames, most recently used at the front
+  const size_t max_cached_frames_;
+  std::list<std::pair<int, YUVBuffer>> lru_;
+  std::unordered_map<int, std::list<std::pair<int, YUVBuffer>>::iterator> cache_;
+  std::vector<char> failed_;
+
+  int decode_threads_, read_ahead_ = 0;
+  int requested_ = 0;
+  std::deque<int> queue_;
+  std::mutex lock_;
+  std::condition_variable task_cv_, frame_cv_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> exit_ = false;
   bool valid_ = false;
 };
@@ -0,0 +1,51 @@
+#include "selfdrive/ui/replay/logreader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/ui/replay/util.h"
+
+bool LogReader::load(const std::string &file) {
+  std::string data = readLogFile(file);
+  if (data.empty()) {
+    LOGE("failed to read log %s", file.c_str());
+    return false;
+  }
+
+  // the events point into words_, which also keeps them word aligned
+  words_ = kj::heapArray<capnp::word>(data.size() / sizeof(capnp::word));
+  memcpy(words_.begin(), data.data(), words_.size() * sizeof(capnp::word));
+
+  events.clear();
+  kj::ArrayPtr<const capnp::word> words = words_;
+  try {
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      kj::ArrayPtr<const capnp::word> msg(words.begin(), reader.getEnd());
+      words = kj::arrayPtr(reader.getEnd(), words.end());
+
+      cereal::Event::Reader event = reader.getRoot<cereal::Event>();
+      Event &e = events.emplace_back();
+      e.mono_time = event.getLogMonoTime();
+      e.which = event.which();
+      e.words = msg;
+      e.frame = {};
+
+      cereal::EncodeIndex::Reader idx;
+      switch (e.which) {
+        case cereal::Event::ROAD_ENCODE_IDX: idx = event.getRoadEncodeIdx(); break;
+        case cereal::Event::DRIVER_ENCODE_IDX: idx = event.getDriverEncodeIdx(); break;
+        case cereal::Event::WIDE_ROAD_ENCODE_IDX: idx = event.getWideRoadEncodeIdx(); break;
+        default: continue;
+      }
+      e.frame = {idx.getSegmentNum(), idx.getSegmentId(), idx.getFrameId(), idx.getTimestampSof(), idx.getTimestampEof()};
+    }
+  } catch (const kj::Exception &e) {
+    // a segment that wasn't closed cleanly ends in a partial message
+    LOGW("%s: stopped after %zu events: %s", file.c_str(), events.size(), e.getDescription().cStr());
+  }
+
+  std::stable_sort(events.begin(), events.end());
+  return !events.empty();
+}
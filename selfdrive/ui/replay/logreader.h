@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <capnp/serialize.h>
+
+#include "cereal/gen/cpp/log.capnp.h"
+
+// An event of a log, pointing into the words owned by its LogReader.
+struct Event {
+  uint64_t mono_time;
+  cereal::Event::Which which;
+  kj::ArrayPtr<const capnp::word> words;
+
+  // only set for the encodeIdx events
+  struct Frame {
+    int segment_num;
+    uint32_t segment_id, frame_id;
+    uint64_t timestamp_sof, timestamp_eof;
+  } frame;
+
+  inline kj::ArrayPtr<const capnp::byte> bytes() const { return words.asBytes(); }
+  inline bool operator<(const Event &other) const { return mono_time < other.mono_time; }
+};
+
+class LogReader {
+public:
+  // reads a rlog or qlog, bz2 compressed or not, events are sorted by logMonoTime
+  bool load(const std::string &file);
+
+  std::vector<Event> events;
+
+private:
+  kj::Array<capnp::word> words_;
+};
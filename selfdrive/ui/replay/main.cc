@@ -0,0 +1,142 @@
+#include <getopt.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "selfdrive/common/timing.h"
+#include "selfdrive/common/util.h"
+#include "selfdrive/ui/replay/replay.h"
+
+ExitHandler do_exit;
+
+const char *USAGE = R"(usage: replay [options] <route>
+
+Replays a route from data_dir at the recorded pace.
+
+  --data_dir <dir>    directory with the <route>--<n> segments, defaults to the log root
+  --allow <a,b,...>   only publish these services
+  --block <a,b,...>   never publish these services
+  --start <seconds>   start this far into the route
+  --speed <factor>    replay speed, 0.1 to 20
+  --no-vipc           don't serve camera frames
+  --stats <seconds>   timing report interval, 0 to only report on exit
+
+keys: space pause/resume, +/- speed, s/S seek +/-10s, m/M seek +/-60s, q quit
+)";
+
+static std::vector<std::string> split(const char *list) {
+  std::vector<std::string> out;
+  std::stringstream ss(list);
+  for (std::string s; std::getline(ss, s, ',');) {
+    if (!s.empty()) out.push_back(s);
+  }
+  return out;
+}
+
+static void print_stats(Replay &replay) {
+  const TimingStats s = replay.stats();
+  printf("%.1fs x%.1f%s: %lu events, late avg %.3f ms max %.3f ms |", replay.currentSeconds(), replay.speed(),
+         replay.isPaused() ? " paused" : "", (unsigned long)s.events, s.events ? s.sum_ms / s.events : 0., s.max_ms);
+  for (int i = 0; i <= TimingStats::BUCKETS; ++i) {
+    if (i < TimingStats::BUCKETS) {
+      printf(" <%gms %.1f%%", TimingStats::BUCKET_MS[i], s.events ? 100. * s.hist[i] / s.events : 0.);
+    } else {
+      printf(" >%gms %.1f%%", TimingStats::BUCKET_MS[i - 1], s.events ? 100. * s.hist[i] / s.events : 0.);
+    }
+  }
+  printf(" | resyncs %lu, stalls %lu, late frames %zu, dropped frames %zu\n", (unsigned long)s.resyncs, (unsigned long)s.stalls,
+         s.late_frames, s.dropped_frames);
+}
+
+static void handle_key(Replay &replay, char c) {
+  switch (c) {
+    case ' ': replay.pause(!replay.isPaused()); break;
+    case '+': case '=': replay.setSpeed(replay.speed() * 2); break;
+    case '-': replay.setSpeed(replay.speed() / 2); break;
+    case 's': replay.seekTo(10, true); break;
+    case 'S': replay.seekTo(-10, true); break;
+    case 'm': replay.seekTo(60, true); break;
+    case 'M': replay.seekTo(-60, true); break;
+    case 'q': do_exit = true; break;
+  }
+  print_stats(replay);
+}
+
+int main(int argc, char *argv[]) {
+  const struct option opts[] = {
+    {"data_dir", required_argument, nullptr, 'd'},
+    {"allow", required_argument, nullptr, 'a'},
+    {"block", required_argument, nullptr, 'b'},
+    {"start", required_argument, nullptr, 's'},
+    {"speed", required_argument, nullptr, 'x'},
+    {"no-vipc", no_argument, nullptr, 'n'},
+    {"stats", required_argument, nullptr, 'i'},
+    {"help", no_argument, nullptr, 'h'},
+    {},
+  };
+
+  std::string data_dir = Path::log_root();
+  std::vector<std::string> allow, block;
+  double start = 0, stats_interval = 10;
+  float speed = 1.0;
+  bool load_cameras = true;
+  for (int opt; (opt = getopt_long(argc, argv, "h", opts, nullptr)) != -1;) {
+    switch (opt) {
+      case 'd': data_dir = optarg; break;
+      case 'a': allow = split(optarg); break;
+      case 'b': block = split(optarg); break;
+      case 's': start = atof(optarg); break;
+      case 'x': speed = atof(optarg); break;
+      case 'n': load_cameras = false; break;
+      case 'i': stats_interval = atof(optarg); break;
+      default: printf("%s", USAGE); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    printf("%s", USAGE);
+    return 1;
+  }
+
+  Replay replay(argv[optind], allow, block, data_dir, load_cameras);
+  if (!replay.load()) {
+    return 1;
+  }
+  replay.setSpeed(speed);
+  replay.start(start);
+
+  // single key presses without echo
+  const bool tty = isatty(STDIN_FILENO);
+  struct termios old_attr = {};
+  if (tty) {
+    tcgetattr(STDIN_FILENO, &old_attr);
+    struct termios attr = old_attr;
+    attr.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &attr);
+  }
+
+  double last_stats = millis_since_boot();
+  while (!do_exit && !replay.finished()) {
+    struct pollfd fd = {.fd = STDIN_FILENO, .events = POLLIN};
+    char c;
+    if (tty && poll(&fd, 1, 100) > 0 && read(STDIN_FILENO, &c, 1) == 1) {
+      handle_key(replay, c);
+    } else if (!tty) {
+      util::sleep_for(100);
+    }
+
+    if (stats_interval > 0 && millis_since_boot() - last_stats > stats_interval * 1000) {
+      print_stats(replay);
+      last_stats = millis_since_boot();
+    }
+  }
+
+  if (tty) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_attr);
+  }
+  print_stats(replay);
+  return 0;
+}
@@ -0,0 +1,346 @@
+#include "selfdrive/ui/replay/replay.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <capnp/schema.h>
+
+#include "cereal/services.h"
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/timing.h"
+#include "selfdrive/common/util.h"
+
+void TimingStats::add(double late_ms) {
+  int i = 0;
+  while (i < BUCKETS && late_ms >= BUCKET_MS[i]) ++i;
+  hist[i]++;
+  events++;
+  sum_ms += late_ms;
+  max_ms = std::max(max_ms, late_ms);
+}
+
+static bool contains(const std::vector<std::string> &list, const char *name) {
+  return std::find(list.begin(), list.end(), name) != list.end();
+}
+
+// the first event of a segment, 0 if it has none
+static uint64_t segment_start(const Segment &seg) {
+  return seg.log.events.empty() ? 0 : seg.log.events.front().mono_time;
+}
+
+Replay::Replay(const std::string &route, const std::vector<std::string> &allow, const std::vector<std::string> &block,
+               const std::string &data_dir, bool load_cameras)
+    : load_cameras_(load_cameras), allow_(allow), block_(block) {
+  route_ = std::make_unique<Route>(route, data_dir);
+
+  // services are published by their union field of Event
+  auto event_struct = capnp::Schema::from<cereal::Event>().asStruct();
+  sockets_.resize(event_struct.getUnionFields().size(), nullptr);
+  std::vector<const char *> published;
+  for (const auto &it : services) {
+    if ((!allow_.empty() && !contains(allow_, it.name)) || contains(block_, it.name)) continue;
+
+    KJ_IF_MAYBE(field, event_struct.findFieldByName(it.name)) {
+      sockets_[field->getProto().getDiscriminantValue()] = it.name;
+      published.push_back(it.name);
+    }
+  }
+  pm_ = std::make_unique<PubMaster>(published);
+
+  // the frames of a camera go with its encodeIdx
+  publish_frames_[RoadCam] = load_cameras_ && sockets_[cereal::Event::ROAD_ENCODE_IDX];
+  publish_frames_[DriverCam] = load_cameras_ && sockets_[cereal::Event::DRIVER_ENCODE_IDX];
+  publish_frames_[WideRoadCam] = load_cameras_ && sockets_[cereal::Event::WIDE_ROAD_ENCODE_IDX];
+}
+
+Replay::~Replay() {
+  {
+    std::unique_lock lk(lock_);
+    exit_ = true;
+  }
+  stream_cv_.notify_all();
+  segment_cv_.notify_all();
+  if (stream_thread_.joinable()) stream_thread_.join();
+  if (segment_thread_.joinable()) segment_thread_.join();
+}
+
+bool Replay::load() {
+  if (!route_->load()) {
+    return false;
+  }
+  LOGW("replaying %s: %zu segments", route_->name().c_str(), route_->segments().size());
+  return true;
+}
+
+void Replay::start(double seconds) {
+  assert(!route_->segments().empty());
+  seekTo(seconds);
+  segment_thread_ = std::thread(&Replay::segmentThread, this);
+  stream_thread_ = std::thread(&Replay::streamThread, this);
+}
+
+void Replay::pause(bool pause) {
+  {
+    std::unique_lock lk(lock_);
+    paused_ = pause;
+    ++control_version_;
+  }
+  stream_cv_.notify_all();
+}
+
+void Replay::setSpeed(float speed) {
+  {
+    std::unique_lock lk(lock_);
+    speed_ = std::clamp(speed, 0.1f, 20.0f);
+    ++control_version_;
+  }
+  stream_cv_.notify_all();
+}
+
+void Replay::seekTo(double seconds, bool relative) {
+  {
+    std::unique_lock lk(lock_);
+    if (relative && route_start_ts_ > 0) {
+      seconds += ((int64_t)cur_mono_time_ - (int64_t)route_start_ts_) / 1e9;
+    }
+    seconds = std::max(0.0, seconds);
+
+    // seeking into a missing segment starts at the next one, past the end at the last one
+    const auto &segs = route_->segments();
+    const int first = segs.begin()->first;
+    auto it = segs.lower_bound(first + (int)(seconds / SEGMENT_LENGTH));
+    if (it == segs.end()) --it;
+    if (it->first != first + (int)(seconds / SEGMENT_LENGTH)) {
+      seconds = (it->first - first) * SEGMENT_LENGTH;
+    }
+
+    current_segment_ = it->first;
+    seek_seconds_ = seconds;
+    seeking_ = true;
+    finished_ = false;
+    ++control_version_;
+  }
+  segment_cv_.notify_all();
+  stream_cv_.notify_all();
+}
+
+double Replay::currentSeconds() const {
+  std::unique_lock lk(lock_);
+  return route_start_ts_ > 0 ? ((int64_t)cur_mono_time_ - (int64_t)route_start_ts_) / 1e9 : 0;
+}
+
+TimingStats Replay::stats() {
+  std::unique_lock lk(lock_);
+  TimingStats s = stats_;
+  s.late_frames = camera_server_ ? camera_server_->lateFrames() : 0;
+  s.dropped_frames = camera_server_ ? camera_server_->droppedFrames() : 0;
+  return s;
+}
+
+std::shared_ptr<Replay::EventList> Replay::mergeSegments(const std::map<int, std::shared_ptr<Segment>> &segments) {
+  auto list = std::make_shared<EventList>();
+  list->segments = segments;
+
+  size_t total = 0;
+  for (const auto &[n, seg] : segments) total += seg->log.events.size();
+  list->events.reserve(total);
+
+  // each log is sorted already, events of neighbouring segments overlap at the boundary
+  for (const auto &[n, seg] : segments) {
+    const size_t mid = list->events.size();
+    for (const Event &e : seg->log.events) {
+      list->events.push_back(&e);
+    }
+    std::inplace_merge(list->events.begin(), list->events.begin() + mid, list->events.end(),
+                       [](const Event *a, const Event *b) { return a->mono_time < b->mono_time; });
+  }
+  return list;
+}
+
+void Replay::segmentThread() {
+  set_thread_name("replay_segments");
+  const auto &route_segs = route_->segments();
+
+  std::unique_lock lk(lock_);
+  while (!exit_) {
+    const int cur = current_segment_;
+
+    // keep the current segment and the ones ahead of it, and the one before it while it's
+    // loaded for the events around the boundary
+    std::map<int, std::shared_ptr<Segment>> window;
+    int to_load = -1;
+    auto it = route_segs.lower_bound(cur);
+    if (it != route_segs.begin()) {
+      auto prev = segments_.find(std::prev(it)->first);
+      if (prev != segments_.end()) window.insert(*prev);
+    }
+    for (int i = 0; i <= FORWARD_SEGS && it != route_segs.end(); ++i, ++it) {
+      auto loaded = segments_.find(it->first);
+      if (loaded != segments_.end()) {
+        window.insert(*loaded);
+      } else if (to_load == -1) {
+        to_load = it->first;
+      }
+    }
+
+    bool changed = window.size() != segments_.size();
+    segments_ = window;
+
+    if (to_load != -1) {
+      lk.unlock();
+      auto seg = std::make_shared<Segment>(to_load, route_segs.at(to_load), load_cameras_);
+      if (!seg->load()) {
+        LOGE("failed to load segment %d", to_load);
+      }
+      lk.lock();
+
+      segments_[to_load] = seg;
+      changed = true;
+
+      // the route starts with its first segment, estimate it until that one is loaded
+      if (uint64_t start = segment_start(*seg)) {
+        if (to_load == route_segs.begin()->first) {
+          route_start_ts_ = start;
+        } else if (route_start_ts_ == 0) {
+          route_start_ts_ = start - (to_load - route_segs.begin()->first) * SEGMENT_LENGTH * 1e9;
+        }
+      }
+
+      // the VisionIPC buffers are sized by the first segment with camera files
+      if (!camera_server_) {
+        std::pair<int, int> sizes[MAX_CAMERAS] = {};
+        bool has_frames = false;
+        for (int i = 0; i < MAX_CAMERAS; ++i) {
+          if (seg->frames[i] && publish_frames_[i]) {
+            sizes[i] = {seg->frames[i]->width, seg->frames[i]->height};
+            has_frames = true;
+          }
+        }
+        if (has_frames) {
+          camera_server_ = std::make_unique<CameraServer>(sizes);
+        }
+      }
+    }
+
+    if (changed) {
+      auto segments = segments_;
+      lk.unlock();
+      auto list = mergeSegments(segments);
+      lk.lock();
+      events_ = list;
+      stream_cv_.notify_all();
+    }
+
+    if (to_load == -1) {
+      segment_cv_.wait(lk, [&] { return exit_ || current_segment_ != cur; });
+    }
+  }
+}
+
+void Replay::streamThread() {
+  set_thread_name("replay_stream");
+  auto after = [](uint64_t t, const Event *e) { return t < e->mono_time; };
+
+  std::unique_lock lk(lock_);
+  int version = -1;
+  double speed = 1.0;
+  uint64_t evt_start_ts = 0, loop_start_ts = 0;
+  while (true) {
+    stream_cv_.wait(lk, [&] {
+      return exit_ || (!paused_ && events_ && events_->segments.count(current_segment_));
+    });
+    if (exit_) break;
+
+    std::shared_ptr<EventList> list = events_;
+    const std::vector<const Event *> &events = list->events;
+    if (seeking_) {
+      seeking_ = false;
+      uint64_t t = std::max<uint64_t>(route_start_ts_ + seek_seconds_ * 1e9, segment_start(*list->segments[current_segment_]));
+      cur_mono_time_ = std::max<uint64_t>(t, 1) - 1;
+    }
+    // the clock restarts at the next event after a seek, pause or speed change
+    if (version != control_version_) {
+      version = control_version_;
+      speed = speed_;
+      evt_start_ts = 0;
+    }
+
+    // the next segment starts with its first event
+    auto next_segment = [&]() -> std::pair<int, uint64_t> {
+      for (auto it = list->segments.upper_bound(current_segment_); it != list->segments.end(); ++it) {
+        if (uint64_t start = segment_start(*it->second)) return {it->first, start};
+      }
+      return {-1, UINT64_MAX};
+    };
+    auto [next_seg, next_seg_start] = next_segment();
+
+    auto it = std::upper_bound(events.begin(), events.end(), cur_mono_time_.load(), after);
+    for (; it != events.end(); ++it) {
+      const Event *e = *it;
+      if (evt_start_ts == 0) {
+        evt_start_ts = e->mono_time;
+        loop_start_ts = nanos_since_boot();
+      }
+
+      const uint64_t target = loop_start_ts + (e->mono_time - evt_start_ts) / speed;
+      const uint64_t now = nanos_since_boot();
+      if (target > now) {
+        stream_cv_.wait_for(lk, std::chrono::nanoseconds(target - now), [&] { return exit_ || version != control_version_; });
+      }
+      if (exit_ || version != control_version_) break;
+
+      const double late_ms = (int64_t)(nanos_since_boot() - target) / 1e6;
+      if (late_ms > 1000) {
+        // too far behind to catch up, e.g. after the loader stalled
+        stats_.resyncs++;
+        evt_start_ts = e->mono_time;
+        loop_start_ts = nanos_since_boot();
+      } else {
+        stats_.add(std::abs(late_ms));
+      }
+
+      publish(e, *list);
+      cur_mono_time_ = e->mono_time;
+
+      if (e->mono_time >= next_seg_start) {
+        current_segment_ = next_seg;
+        segment_cv_.notify_all();
+        std::tie(next_seg, next_seg_start) = next_segment();
+      }
+      // continue from cur_mono_time_ in the new list
+      if (events_ != list) break;
+    }
+
+    if (it == events.end() && !exit_ && version == control_version_) {
+      if (route_->segments().upper_bound(list->segments.rbegin()->first) != route_->segments().end()) {
+        stats_.stalls++;
+        stream_cv_.wait(lk, [&] { return exit_ || events_ != list || version != control_version_; });
+      } else {
+        finished_ = true;
+        stream_cv_.wait(lk, [&] { return exit_ || version != control_version_; });
+      }
+    }
+  }
+}
+
+void Replay::publish(const Event *e, const EventList &list) {
+  if (const char *name = sockets_[e->which]) {
+    auto bytes = e->bytes();
+    pm_->send(name, (capnp::byte *)bytes.begin(), bytes.size());
+  }
+
+  CameraType cam;
+  switch (e->which) {
+    case cereal::Event::ROAD_ENCODE_IDX: cam = RoadCam; break;
+    case cereal::Event::DRIVER_ENCODE_IDX: cam = DriverCam; break;
+    case cereal::Event::WIDE_ROAD_ENCODE_IDX: cam = WideRoadCam; break;
+    default: return;
+  }
+  if (publish_frames_[cam] && camera_server_) {
+    auto seg = list.segments.find(e->frame.segment_num);
+    if (seg != list.segments.end() && seg->second->frames[cam]) {
+      camera_server_->pushFrame(cam, seg->second->frames[cam], e->frame);
+    }
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cereal/messaging/messaging.h"
+#include "selfdrive/hardware/hw.h"
+#include "selfdrive/ui/replay/camera.h"
+#include "selfdrive/ui/replay/route.h"
+
+// How late events are sent compared to their log time scaled by the replay speed.
+struct TimingStats {
+  static constexpr int BUCKETS = 6;
+  // upper bounds in ms, the last bucket counts everything beyond
+  static constexpr double BUCKET_MS[BUCKETS] = {0.1, 0.5, 1, 5, 10, 50};
+
+  uint64_t hist[BUCKETS + 1] = {};
+  uint64_t events = 0;
+  double sum_ms = 0, max_ms = 0;
+  // times the replay fell more than a second behind and restarted its clock
+  uint64_t resyncs = 0;
+  // times the replay caught up with the segment loader
+  uint64_t stalls = 0;
+  size_t late_frames = 0, dropped_frames = 0;
+
+  void add(double late_ms);
+};
+
+// Publishes a local route at the pace it was recorded: the log events through PubMaster
+// and the camera frames through VisionIPC at the time of their encodeIdx. Segments are
+// loaded ahead of the replay on their own thread, a seek only waits for its segment.
+class Replay {
+public:
+  // allow: only these services, all if empty. block: never these services.
+  Replay(const std::string &route, const std::vector<std::string> &allow, const std::vector<std::string> &block,
+         const std::string &data_dir = Path::log_root(), bool load_cameras = true);
+  ~Replay();
+  bool load();
+  void start(double seconds = 0);
+  void pause(bool pause);
+  void seekTo(double seconds, bool relative = false);
+  void setSpeed(float speed);
+
+  bool isPaused() const { return paused_; }
+  float speed() const { return speed_; }
+  bool finished() const { return finished_; }
+  // seconds since the start of the route
+  double currentSeconds() const;
+  TimingStats stats();
+
+  static constexpr int SEGMENT_LENGTH = 60;
+  // segments loaded ahead of the current one
+  static constexpr int FORWARD_SEGS = 1;
+
+private:
+  struct EventList {
+    std::vector<const Event *> events;
+    // keeps the events alive
+    std::map<int, std::shared_ptr<Segment>> segments;
+  };
+
+  void streamThread();
+  void segmentThread();
+  void publish(const Event *e, const EventList &list);
+  std::shared_ptr<EventList> mergeSegments(const std::map<int, std::shared_ptr<Segment>> &segments);
+
+  std::unique_ptr<Route> route_;
+  const bool load_cameras_;
+  std::vector<std::string> allow_, block_;
+  // service per Event::Which, null if it isn't published
+  std::vector<const char *> sockets_;
+  bool publish_frames_[MAX_CAMERAS] = {};
+  std::unique_ptr<PubMaster> pm_;
+  std::unique_ptr<CameraServer> camera_server_;
+
+  mutable std::mutex lock_;
+  std::condition_variable stream_cv_, segment_cv_;
+  std::map<int, std::shared_ptr<Segment>> segments_;
+  std::shared_ptr<EventList> events_;
+  int current_segment_ = 0;
+  uint64_t route_start_ts_ = 0;
+  std::atomic<uint64_t> cur_mono_time_ = 0;
+  double seek_seconds_ = 0;
+  bool seeking_ = false;
+  // bumped whenever the replay clock has to restart: seek, pause and speed changes
+  int control_version_ = 0;
+  std::atomic<bool> paused_ = false, finished_ = false;
+  std::atomic<float> speed_ = 1.0;
+  bool exit_ = false;
+  TimingStats stats_;
+
+  std::thread stream_thread_, segment_thread_;
+};
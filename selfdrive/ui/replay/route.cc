@@ -0,0 +1,76 @@
+#include "selfdrive/ui/replay/route.h"
+
+#include <dirent.h>
+
+#include <cstdlib>
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/util.h"
+
+Route::Route(const std::string &route, const std::string &data_dir) : route_(route), data_dir_(data_dir) {}
+
+bool Route::load() {
+  DIR *dir = opendir(data_dir_.c_str());
+  if (!dir) {
+    LOGE("failed to open %s", data_dir_.c_str());
+    return false;
+  }
+
+  const std::string prefix = route_ + "--";
+  while (struct dirent *entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, prefix.size(), prefix) != 0) continue;
+
+    char *end = nullptr;
+    const long n = strtol(name.c_str() + prefix.size(), &end, 10);
+    if (end == name.c_str() + prefix.size() || *end != '\0' || n < 0) continue;
+
+    const std::string path = data_dir_ + "/" + name + "/";
+    auto exists = [&](const char *file) { return util::file_exists(path + file) ? path + file : std::string(); };
+    SegmentFile files = {
+      .rlog = !exists("rlog.bz2").empty() ? exists("rlog.bz2") : exists("rlog"),
+      .qlog = !exists("qlog.bz2").empty() ? exists("qlog.bz2") : exists("qlog"),
+      .road_cam = exists("fcamera.hevc"),
+      .driver_cam = exists("dcamera.hevc"),
+      .wide_road_cam = exists("ecamera.hevc"),
+      .qcamera = exists("qcamera.ts"),
+    };
+    if (!files.rlog.empty() || !files.qlog.empty()) {
+      segments_[n] = files;
+    }
+  }
+  closedir(dir);
+
+  if (segments_.empty()) {
+    LOGE("no segments of %s in %s", route_.c_str(), data_dir_.c_str());
+    return false;
+  }
+  return true;
+}
+
+Segment::Segment(int n, const SegmentFile &files, bool load_cameras)
+    : seg_num(n), files_(files), load_cameras_(load_cameras) {}
+
+bool Segment::load() {
+  if (!log.load(files_.rlog.empty() ? files_.qlog : files_.rlog)) {
+    return false;
+  }
+  if (load_cameras_) {
+    const std::string cams[MAX_CAMERAS] = {
+      files_.road_cam.empty() ? files_.qcamera : files_.road_cam,
+      files_.driver_cam,
+      files_.wide_road_cam,
+    };
+    for (int i = 0; i < MAX_CAMERAS; ++i) {
+      if (cams[i].empty()) continue;
+
+      auto fr = std::make_shared<FrameReader>();
+      if (fr->load(cams[i])) {
+        frames[i] = fr;
+      } else {
+        LOGW("failed to load %s", cams[i].c_str());
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "selfdrive/ui/replay/framereader.h"
+#include "selfdrive/ui/replay/logreader.h"
+
+enum CameraType {
+  RoadCam = 0,
+  DriverCam,
+  WideRoadCam,
+  MAX_CAMERAS,
+};
+
+struct SegmentFile {
+  std::string rlog;
+  std::string qlog;
+  std::string road_cam;
+  std::string driver_cam;
+  std::string wide_road_cam;
+  std::string qcamera;
+};
+
+// A route recorded by loggerd, its segments are the <route>--<n> directories in data_dir.
+class Route {
+public:
+  Route(const std::string &route, const std::string &data_dir);
+  bool load();
+
+  const std::string &name() const { return route_; }
+  const std::map<int, SegmentFile> &segments() const { return segments_; }
+
+private:
+  std::string route_, data_dir_;
+  std::map<int, SegmentFile> segments_;
+};
+
+// The events of a segment and readers of its camera files. qlogs and qcamera are used
+// when the full resolution files weren't kept.
+class Segment {
+public:
+  Segment(int n, const SegmentFile &files, bool load_cameras);
+  bool load();
+
+  const int seg_num;
+  LogReader log;
+  std::shared_ptr<FrameReader> frames[MAX_CAMERAS];
+
+private:
+  const SegmentFile files_;
+  const bool load_cameras_;
+};
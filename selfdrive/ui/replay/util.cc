@@ -0,0 +1,47 @@
+#include "selfdrive/ui/replay/util.h"
+
+#include <bzlib.h>
+
+#include "selfdrive/common/swaglog.h"
+#include "selfdrive/common/util.h"
+
+std::string decompressBZ2(const std::string &in) {
+  if (in.empty()) return {};
+
+  bz_stream strm = {};
+  int ret = BZ2_bzDecompressInit(&strm, 0, 0);
+  if (ret != BZ_OK) return {};
+
+  // logs compress roughly 5x, grow from there
+  std::string out(in.size() * 5, '\0');
+  strm.next_in = (char *)in.data();
+  strm.avail_in = in.size();
+  size_t out_pos = 0;
+  do {
+    if (out_pos == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    strm.next_out = out.data() + out_pos;
+    strm.avail_out = out.size() - out_pos;
+    ret = BZ2_bzDecompress(&strm);
+    out_pos = out.size() - strm.avail_out;
+  } while (ret == BZ_OK && (strm.avail_in > 0 || strm.avail_out == 0));
+
+  BZ2_bzDecompressEnd(&strm);
+  if (ret != BZ_STREAM_END) {
+    return {};
+  }
+  out.resize(out_pos);
+  return out;
+}
+
+std::string readLogFile(const std::string &path) {
+  std::string data = util::read_file(path);
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".bz2") == 0) {
+    data = decompressBZ2(data);
+    if (data.empty()) {
+      LOGE("failed to decompress %s", path.c_str());
+    }
+  }
+  return data;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// empty if the data isn't a complete bz2 stream
+std::string decompressBZ2(const std::string &in);
+// the file contents, decompressed if it ends with .bz2
+std::string readLogFile(const std::string &path);
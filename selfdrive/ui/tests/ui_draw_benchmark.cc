@@ -0,0 +1,119 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+
+#include "cereal/messaging/messaging.h"
+#include "selfdrive/common/timing.h"
+#include "selfdrive/ui/paint.h"
+#include "selfdrive/ui/ui.h"
+
+// Renders ui_draw into an offscreen framebuffer with the HUD widgets cached in their
+// layers and with them drawn directly every frame, and reports the time per frame.
+// The speed changes every frame and the cached values every few seconds, like driving.
+//
+// usage: QT_QPA_PLATFORM=offscreen ./tests/ui_draw_benchmark [frames] [width] [height]
+// from selfdrive/ui, the assets are loaded relative to it.
+
+struct FrameMessages {
+  MessageBuilder car, controls, device, radar;
+};
+
+static void update_messages(UIState &s, FrameMessages &msgs, int frame) {
+  const double t = frame / (double)UI_FREQ;
+
+  auto cs = msgs.car.initEvent().initCarState();
+  cs.setVEgo(20 + 5 * std::sin(t / 4));
+  cs.setGearShifter(cereal::CarState::GearShifter::DRIVE);
+
+  auto ctrl = msgs.controls.initEvent().initControlsState();
+  ctrl.setEnabled(true);
+  ctrl.setEngageable(true);
+  ctrl.setVCruise(100);
+  ctrl.setAngleSteers(2 * std::sin(t));
+
+  auto ds = msgs.device.initEvent().initDeviceState();
+  ds.setStarted(true);
+  const float temp = 60 + (int)(t / 3) % 10;
+  ds.setCpuTempC({temp, temp, temp, temp});
+
+  auto lead = msgs.radar.initEvent().initRadarState().initLeadOne();
+  lead.setStatus(true);
+  lead.setDRel(40 + (int)(t / 2) % 20);
+  lead.setVRel(-1);
+
+  s.sm->update_msgs(nanos_since_boot(), {{"carState", msgs.car.getRoot<cereal::Event>().asReader()},
+                                         {"controlsState", msgs.controls.getRoot<cereal::Event>().asReader()},
+                                         {"deviceState", msgs.device.getRoot<cereal::Event>().asReader()},
+                                         {"radarState", msgs.radar.getRoot<cereal::Event>().asReader()}});
+  s.scene.started = true;
+}
+
+static double run(UIState &s, QOpenGLFramebufferObject &fbo, bool layers, int frames) {
+  QOpenGLFunctions *gl = QOpenGLContext::currentContext()->functions();
+  ui_set_hud_layers(layers);
+
+  double total = 0;
+  // the first second warms up the caches and isn't counted
+  for (int i = -UI_FREQ; i < frames; ++i) {
+    // the draw reads the messages, they live until it's done
+    FrameMessages msgs;
+    update_messages(s, msgs, i + UI_FREQ);
+
+    fbo.bind();
+    gl->glViewport(0, 0, fbo.width(), fbo.height());
+    gl->glClearColor(0, 0, 0, 0);
+    gl->glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    const double start = millis_since_boot();
+    ui_draw(&s, fbo.width(), fbo.height());
+    gl->glFinish();
+    if (i >= 0) total += millis_since_boot() - start;
+  }
+  return total / frames;
+}
+
+int main(int argc, char *argv[]) {
+  QSurfaceFormat fmt;
+  fmt.setRenderableType(QSurfaceFormat::OpenGLES);
+  fmt.setStencilBufferSize(8);
+  QSurfaceFormat::setDefaultFormat(fmt);
+  QGuiApplication app(argc, argv);
+
+  const int frames = argc > 1 ? atoi(argv[1]) : 60 * UI_FREQ;
+  const int width = argc > 2 ? atoi(argv[2]) : 1920;
+  const int height = argc > 3 ? atoi(argv[3]) : 1080;
+
+  QOffscreenSurface surface;
+  surface.create();
+  QOpenGLContext ctx;
+  if (!ctx.create() || !ctx.makeCurrent(&surface)) {
+    printf("failed to create an OpenGL context\n");
+    return 1;
+  }
+  QOpenGLFramebufferObject fbo(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+  UIState s = {};
+  s.sm = std::make_unique<SubMaster, const std::initializer_list<const char *>>({
+    "modelV2", "controlsState", "liveCalibration", "deviceState", "roadCameraState",
+    "pandaStates", "carParams", "driverMonitoringState", "sensorEvents", "carState", "liveLocationKalman",
+    "gpsLocationExternal", "radarState", "carControl", "liveParameters", "ubloxGnss", "lateralPlan",});
+  s.show_debug_ui = true;
+  s.show_cgear_ui = true;
+  s.scene.kr_date_show = true;
+  s.scene.kr_time_show = true;
+  fbo.bind();
+  ui_nvg_init(&s);
+
+  const double direct = run(s, fbo, false, frames);
+  const double layered = run(s, fbo, true, frames);
+  printf("%dx%d, %d frames\n", width, height, frames);
+  printf("widgets drawn every frame: %.3f ms/frame\n", direct);
+  printf("widgets in layers:         %.3f ms/frame\n", layered);
+  return 0;
+}
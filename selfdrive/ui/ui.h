@@ -142,8 +142,10 @@ typedef struct {
   float x, y;
 } vertex_data;
 
+// A model line as (left, right) point pairs in the calibrated frame, drawn as a
+// triangle strip. The projection to the screen happens in the line shader.
 typedef struct {
-  vertex_data v[TRAJECTORY_SIZE * 2];
+  vec3 v[TRAJECTORY_SIZE * 2];
   int cnt;
 } line_vertices_data;
 
@@ -188,6 +190,7 @@ typedef struct UIScene {
   cereal::LateralPlan::Reader lateral_plan;
 
   // modelV2
+  uint32_t model_frame_id;
   float lane_line_probs[4];
   float road_edge_stds[2];
   line_vertices_data track_vertices;